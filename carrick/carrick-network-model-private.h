@@ -0,0 +1,38 @@
+/*
+ * Carrick - a connection panel for the Dawati Netbook
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+#ifndef _CARRICK_NETWORK_MODEL_PRIVATE_H
+#define _CARRICK_NETWORK_MODEL_PRIVATE_H
+
+#include "carrick-network-model.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Applies a connman Manager property change as if it had come from the
+ * PropertyChanged signal; for the benchmarks.
+ */
+void carrick_network_model_update_property (CarrickNetworkModel *model,
+                                            const gchar         *property,
+                                            GValue              *value);
+
+G_END_DECLS
+
+#endif /* _CARRICK_NETWORK_MODEL_PRIVATE_H */
@@ -21,6 +21,7 @@
  */
 
 #include "carrick-network-model.h"
+#include "carrick-network-model-private.h"
 
 #include <config.h>
 #include <dbus/dbus.h>
@@ -982,6 +983,16 @@ carrick_network_model_get_proxy (CarrickNetworkModel *model)
   return priv->manager;
 }
 
+void
+carrick_network_model_update_property (CarrickNetworkModel *model,
+                                       const gchar         *property,
+                                       GValue              *value)
+{
+  g_return_if_fail (CARRICK_IS_NETWORK_MODEL (model));
+
+  network_model_update_property (property, value, model);
+}
+
 GtkTreeModel *
 carrick_network_model_new (void)
 {
@@ -70,6 +70,7 @@ struct GvcMixerControlPrivate
         guint             event_sink_input_id;
 
         GHashTable       *all_streams;
+        GHashTable       *streams_by_name; /* name -> stream, not owned */
         GHashTable       *sinks; /* fixed outputs */
         GHashTable       *sources; /* fixed inputs */
         GHashTable       *sink_inputs; /* routable output streams */
@@ -78,8 +79,27 @@ struct GvcMixerControlPrivate
         GHashTable       *cards;
 
         GvcMixerStream   *new_default_stream; /* new default stream, used in gvc_mixer_control_set_default_sink () */
+
+        /* Subscription events waiting to be handled, coalesced per
+         * (facility, index) so that a burst refreshes each object once */
+        GHashTable       *pending_events;
+        GQueue            pending_order;
+        guint             pending_events_id;
 };
 
+typedef struct {
+        gint64                        key; /* must be first, see g_int64_hash */
+        pa_subscription_event_type_t  facility;
+        pa_subscription_event_type_t  type;
+        uint32_t                      index;
+} GvcPendingEvent;
+
+static void
+gvc_pending_event_free (GvcPendingEvent *event)
+{
+        g_slice_free (GvcPendingEvent, event);
+}
+
 enum {
         CONNECTING,
         READY,
@@ -499,34 +519,56 @@ _set_default_sink (GvcMixerControl *control,
         }
 }
 
-static gboolean
-_stream_has_name (gpointer        key,
-                  GvcMixerStream *stream,
-                  const char     *name)
+static GvcMixerStream  *
+find_stream_for_name (GvcMixerControl *control,
+                      const char      *name)
 {
-        const char *t_name;
+        if (name == NULL)
+                return NULL;
 
-        t_name = gvc_mixer_stream_get_name (stream);
+        return g_hash_table_lookup (control->priv->streams_by_name, name);
+}
+
+static void
+unindex_stream_name (GvcMixerControl *control,
+                     GvcMixerStream  *stream)
+{
+        const char *name;
 
-        if (t_name != NULL
-            && name != NULL
-            && strcmp (t_name, name) == 0) {
-                return TRUE;
+        name = g_object_get_data (G_OBJECT (stream), "gvc-indexed-name");
+        if (name != NULL
+            && g_hash_table_lookup (control->priv->streams_by_name, name) == stream) {
+                g_hash_table_remove (control->priv->streams_by_name, name);
         }
 
-        return FALSE;
+        g_object_set_data (G_OBJECT (stream), "gvc-indexed-name", NULL);
 }
 
-static GvcMixerStream  *
-find_stream_for_name (GvcMixerControl *control,
-                      const char      *name)
+static void
+index_stream_name (GvcMixerControl *control,
+                   GvcMixerStream  *stream)
 {
-        GvcMixerStream *stream;
+        const char *name;
 
-        stream = g_hash_table_find (control->priv->all_streams,
-                                    (GHRFunc)_stream_has_name,
-                                    (char *)name);
-        return stream;
+        unindex_stream_name (control, stream);
+
+        name = gvc_mixer_stream_get_name (stream);
+        if (name == NULL)
+                return;
+
+        g_hash_table_insert (control->priv->streams_by_name,
+                             g_strdup (name),
+                             stream);
+        g_object_set_data_full (G_OBJECT (stream), "gvc-indexed-name",
+                                g_strdup (name), g_free);
+}
+
+static void
+on_stream_name_changed (GvcMixerStream  *stream,
+                        GParamSpec      *pspec,
+                        GvcMixerControl *control)
+{
+        index_stream_name (control, stream);
 }
 
 static void
@@ -606,6 +648,11 @@ remove_stream (GvcMixerControl *control,
                 _set_default_source (control, NULL);
         }
 
+        g_signal_handlers_disconnect_by_func (stream,
+                                              on_stream_name_changed,
+                                              control);
+        unindex_stream_name (control, stream);
+
         g_hash_table_remove (control->priv->all_streams,
                              GUINT_TO_POINTER (id));
         g_signal_emit (G_OBJECT (control),
@@ -622,6 +669,11 @@ add_stream (GvcMixerControl *control,
         g_hash_table_insert (control->priv->all_streams,
                              GUINT_TO_POINTER (gvc_mixer_stream_get_id (stream)),
                              stream);
+
+        index_stream_name (control, stream);
+        g_signal_connect (stream, "notify::name",
+                          G_CALLBACK (on_stream_name_changed), control);
+
         g_signal_emit (G_OBJECT (control),
                        signals[STREAM_ADDED],
                        0,
@@ -1644,68 +1696,133 @@ remove_source_output (GvcMixerControl *control,
 }
 
 static void
-_pa_context_subscribe_cb (pa_context                  *context,
-                          pa_subscription_event_type_t t,
-                          uint32_t                     index,
-                          void                        *userdata)
+handle_subscription_event (GvcMixerControl *control,
+                           GvcPendingEvent *event)
 {
-        GvcMixerControl *control = GVC_MIXER_CONTROL (userdata);
-
-        switch (t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) {
+        switch (event->facility) {
         case PA_SUBSCRIPTION_EVENT_SINK:
-                if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-                        remove_sink (control, index);
+                if (event->type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+                        remove_sink (control, event->index);
                 } else {
-                        req_update_sink_info (control, index);
+                        req_update_sink_info (control, event->index);
                 }
                 break;
 
         case PA_SUBSCRIPTION_EVENT_SOURCE:
-                if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-                        remove_source (control, index);
+                if (event->type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+                        remove_source (control, event->index);
                 } else {
-                        req_update_source_info (control, index);
+                        req_update_source_info (control, event->index);
                 }
                 break;
 
         case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
-                if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-                        remove_sink_input (control, index);
+                if (event->type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+                        remove_sink_input (control, event->index);
                 } else {
-                        req_update_sink_input_info (control, index);
+                        req_update_sink_input_info (control, event->index);
                 }
                 break;
 
         case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
-                if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-                        remove_source_output (control, index);
+                if (event->type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+                        remove_source_output (control, event->index);
                 } else {
-                        req_update_source_output_info (control, index);
+                        req_update_source_output_info (control, event->index);
                 }
                 break;
 
         case PA_SUBSCRIPTION_EVENT_CLIENT:
-                if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-                        remove_client (control, index);
+                if (event->type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+                        remove_client (control, event->index);
                 } else {
-                        req_update_client_info (control, index);
+                        req_update_client_info (control, event->index);
                 }
                 break;
 
         case PA_SUBSCRIPTION_EVENT_SERVER:
-                req_update_server_info (control, index);
+                req_update_server_info (control, event->index);
                 break;
 
         case PA_SUBSCRIPTION_EVENT_CARD:
-                if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-                        remove_card (control, index);
+                if (event->type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+                        remove_card (control, event->index);
                 } else {
-                        req_update_card (control, index);
+                        req_update_card (control, event->index);
                 }
                 break;
         }
 }
 
+static void
+clear_pending_events (GvcMixerControl *control)
+{
+        if (control->priv->pending_events_id != 0) {
+                g_source_remove (control->priv->pending_events_id);
+                control->priv->pending_events_id = 0;
+        }
+
+        g_queue_clear (&control->priv->pending_order);
+        g_hash_table_remove_all (control->priv->pending_events);
+}
+
+static gboolean
+idle_handle_pending_events (gpointer data)
+{
+        GvcMixerControl *control = GVC_MIXER_CONTROL (data);
+        GvcPendingEvent *event;
+
+        control->priv->pending_events_id = 0;
+
+        /* Handle objects in the order they first changed, so that e.g. a
+         * sink is known before the sink inputs that are routed to it */
+        while ((event = g_queue_pop_head (&control->priv->pending_order)) != NULL) {
+                g_hash_table_steal (control->priv->pending_events, event);
+                handle_subscription_event (control, event);
+                g_slice_free (GvcPendingEvent, event);
+        }
+
+        return FALSE;
+}
+
+static void
+_pa_context_subscribe_cb (pa_context                  *context,
+                          pa_subscription_event_type_t t,
+                          uint32_t                     index,
+                          void                        *userdata)
+{
+        GvcMixerControl *control = GVC_MIXER_CONTROL (userdata);
+        GvcPendingEvent *event;
+        GvcPendingEvent  lookup;
+
+        lookup.facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+        lookup.type = t & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+        lookup.index = index;
+
+        /* There is only one server, whatever index comes with it */
+        if (lookup.facility == PA_SUBSCRIPTION_EVENT_SERVER)
+                lookup.index = 0;
+
+        lookup.key = ((gint64) lookup.facility << 32) | lookup.index;
+
+        event = g_hash_table_lookup (control->priv->pending_events, &lookup);
+        if (event != NULL) {
+                /* The latest event wins; a new or changed object only
+                 * needs refreshing once, a removed one just goes */
+                event->type = lookup.type;
+                return;
+        }
+
+        event = g_slice_dup (GvcPendingEvent, &lookup);
+        g_hash_table_insert (control->priv->pending_events, event, event);
+        g_queue_push_tail (&control->priv->pending_order, event);
+
+        if (control->priv->pending_events_id == 0) {
+                control->priv->pending_events_id =
+                        g_idle_add (idle_handle_pending_events, control);
+        }
+}
+
 static void
 gvc_mixer_control_ready (GvcMixerControl *control)
 {
@@ -1824,6 +1941,8 @@ idle_reconnect (gpointer data)
                 gvc_mixer_new_pa_context (control);
         }
 
+        clear_pending_events (control);
+
         remove_all_streams (control, control->priv->sinks);
         remove_all_streams (control, control->priv->sources);
         remove_all_streams (control, control->priv->sink_inputs);
@@ -1912,6 +2031,12 @@ gvc_mixer_control_dispose (GObject *object)
                 control->priv->pa_context = NULL;
         }
 
+        if (control->priv->pending_events != NULL) {
+                clear_pending_events (control);
+                g_hash_table_destroy (control->priv->pending_events);
+                control->priv->pending_events = NULL;
+        }
+
         if (control->priv->default_source_name != NULL) {
                 g_free (control->priv->default_source_name);
                 control->priv->default_source_name = NULL;
@@ -1926,6 +2051,11 @@ gvc_mixer_control_dispose (GObject *object)
                 control->priv->pa_mainloop = NULL;
         }
 
+        if (control->priv->streams_by_name != NULL) {
+                g_hash_table_destroy (control->priv->streams_by_name);
+                control->priv->streams_by_name = NULL;
+        }
+
         if (control->priv->all_streams != NULL) {
                 g_hash_table_destroy (control->priv->all_streams);
                 control->priv->all_streams = NULL;
@@ -2114,6 +2244,7 @@ gvc_mixer_control_init (GvcMixerControl *control)
         g_assert (control->priv->pa_api);
 
         control->priv->all_streams = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_object_unref);
+        control->priv->streams_by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
         control->priv->sinks = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_object_unref);
         control->priv->sources = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_object_unref);
         control->priv->sink_inputs = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_object_unref);
@@ -2121,6 +2252,9 @@ gvc_mixer_control_init (GvcMixerControl *control)
         control->priv->cards = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_object_unref);
 
         control->priv->clients = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_free);
+
+        control->priv->pending_events = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, (GDestroyNotify)gvc_pending_event_free);
+        g_queue_init (&control->priv->pending_order);
 }
 
 static void
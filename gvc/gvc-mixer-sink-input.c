@@ -65,8 +65,8 @@ gvc_mixer_sink_input_push_volume (GvcMixerStream *stream, gpointer *op)
         o = pa_context_set_sink_input_volume (context,
                                               index,
                                               cv,
-                                              NULL,
-                                              NULL);
+                                              gvc_mixer_stream_volume_pushed_cb,
+                                              stream);
 
         if (o == NULL) {
                 g_warning ("pa_context_set_sink_input_volume() failed");
@@ -66,8 +66,8 @@ gvc_mixer_source_push_volume (GvcMixerStream *stream, gpointer *op)
         o = pa_context_set_source_volume_by_index (context,
                                                    index,
                                                    cv,
-                                                   NULL,
-                                                   NULL);
+                                                   gvc_mixer_stream_volume_pushed_cb,
+                                                   stream);
 
         if (o == NULL) {
                 g_warning ("pa_context_set_source_volume_by_index() failed: %s", pa_strerror(pa_context_errno(context)));
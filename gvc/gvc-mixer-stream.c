@@ -52,6 +52,7 @@ struct GvcMixerStreamPrivate
         gboolean       is_virtual;
         pa_volume_t    base_volume;
         pa_operation  *change_volume_op;
+        gboolean       volume_push_pending;
         char          *port;
         char          *human_port;
         GList         *ports;
@@ -675,20 +676,16 @@ gvc_mixer_stream_real_change_is_muted (GvcMixerStream *stream,
         return FALSE;
 }
 
-gboolean
-gvc_mixer_stream_push_volume (GvcMixerStream *stream)
+static gboolean
+gvc_mixer_stream_send_volume (GvcMixerStream *stream)
 {
         pa_operation *op;
         gboolean ret;
 
-        g_return_val_if_fail (GVC_IS_MIXER_STREAM (stream), FALSE);
-
-        if (stream->priv->is_event_stream != FALSE)
-                return TRUE;
-
         g_debug ("Pushing new volume to stream '%s' (%s)",
                  stream->priv->description, stream->priv->name);
 
+        op = NULL;
         ret = GVC_MIXER_STREAM_GET_CLASS (stream)->push_volume (stream, (gpointer *) &op);
         if (ret) {
                 if (stream->priv->change_volume_op != NULL)
@@ -698,6 +695,55 @@ gvc_mixer_stream_push_volume (GvcMixerStream *stream)
         return ret;
 }
 
+/* Completion callback for the operations created by the push_volume
+ * implementations. If the volume changed again while the operation was
+ * in flight, send the newest value now. */
+void
+gvc_mixer_stream_volume_pushed_cb (pa_context *context,
+                                   int         success,
+                                   void       *userdata)
+{
+        GvcMixerStream *stream = userdata;
+
+        if (!success)
+                g_debug ("Failed to set volume on stream '%s': %s",
+                         stream->priv->name,
+                         pa_strerror (pa_context_errno (context)));
+
+        if (stream->priv->change_volume_op != NULL) {
+                pa_operation_unref (stream->priv->change_volume_op);
+                stream->priv->change_volume_op = NULL;
+        }
+
+        if (stream->priv->volume_push_pending) {
+                stream->priv->volume_push_pending = FALSE;
+                gvc_mixer_stream_send_volume (stream);
+        }
+}
+
+/* At most one volume operation is in flight per stream. While one is
+ * running, further pushes only mark the stream as pending; the channel
+ * map already holds the newest value, so that is what gets sent once the
+ * server acknowledges the previous one. */
+gboolean
+gvc_mixer_stream_push_volume (GvcMixerStream *stream)
+{
+        g_return_val_if_fail (GVC_IS_MIXER_STREAM (stream), FALSE);
+
+        if (stream->priv->is_event_stream != FALSE)
+                return TRUE;
+
+        if (stream->priv->change_volume_op != NULL &&
+            pa_operation_get_state (stream->priv->change_volume_op) == PA_OPERATION_RUNNING) {
+                stream->priv->volume_push_pending = TRUE;
+                return TRUE;
+        }
+
+        stream->priv->volume_push_pending = FALSE;
+
+        return gvc_mixer_stream_send_volume (stream);
+}
+
 gboolean
 gvc_mixer_stream_change_is_muted (GvcMixerStream *stream,
                                   gboolean        is_muted)
@@ -708,17 +754,27 @@ gvc_mixer_stream_change_is_muted (GvcMixerStream *stream,
         return ret;
 }
 
+/* TRUE while the local volume is ahead of the server's; the mixer control
+ * ignores volume updates from the server meanwhile, so that the echoes of
+ * earlier pushes don't drag the local value back. */
 gboolean
 gvc_mixer_stream_is_running (GvcMixerStream *stream)
 {
-        if (stream->priv->change_volume_op == NULL)
-                return FALSE;
+        if (stream->priv->change_volume_op != NULL) {
+                if (pa_operation_get_state (stream->priv->change_volume_op) == PA_OPERATION_RUNNING)
+                        return TRUE;
 
-        if ((pa_operation_get_state(stream->priv->change_volume_op) == PA_OPERATION_RUNNING))
-                return TRUE;
+                pa_operation_unref (stream->priv->change_volume_op);
+                stream->priv->change_volume_op = NULL;
+        }
 
-        pa_operation_unref(stream->priv->change_volume_op);
-        stream->priv->change_volume_op = NULL;
+        /* The operation finished without reaching our callback (e.g. it
+         * was cancelled); don't leave the newest value unsent */
+        if (stream->priv->volume_push_pending) {
+                stream->priv->volume_push_pending = FALSE;
+                gvc_mixer_stream_send_volume (stream);
+                return stream->priv->change_volume_op != NULL;
+        }
 
         return FALSE;
 }
@@ -904,6 +960,7 @@ gvc_mixer_stream_finalize (GObject *object)
         mixer_stream->priv->ports = NULL;
 
        if (mixer_stream->priv->change_volume_op) {
+               pa_operation_cancel(mixer_stream->priv->change_volume_op);
                pa_operation_unref(mixer_stream->priv->change_volume_op);
                mixer_stream->priv->change_volume_op = NULL;
        }
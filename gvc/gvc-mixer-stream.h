@@ -121,6 +121,9 @@ gboolean            gvc_mixer_stream_set_ports       (GvcMixerStream *stream,
                                                       GList          *ports);
 gboolean            gvc_mixer_stream_set_card_index  (GvcMixerStream *stream,
                                                       gint            card_index);
+void                gvc_mixer_stream_volume_pushed_cb (pa_context *context,
+                                                       int         success,
+                                                       void       *userdata);
 
 G_END_DECLS
 
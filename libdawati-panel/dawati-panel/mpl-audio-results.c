@@ -0,0 +1,807 @@
+/*
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include "mpl-audio-results.h"
+#include "mpl-utils.h"
+
+/**
+ * SECTION:mpl-audio-results
+ * @short_description: Cached audio result views.
+ * @Title: MplAudioResults
+ *
+ * #MplAudioResults keeps one #GtkListStore per named view of the audio
+ * library, so that switching between views does not re-run any query.
+ *
+ * A query view is filled from a Tracker SPARQL query selecting the url,
+ * title, artist name and album title of each piece, in that order; the
+ * query is run one page at a time when the view is first requested.
+ *
+ * An uri view is filled from a list of candidate uris, for example from
+ * Zeitgeist. The files are checked for existence asynchronously, a batch
+ * at a time, and the surviving uris are then looked up in Tracker in
+ * chunks, preserving the order of the candidates.
+ *
+ * The ::view-loaded signal is emitted once a view is complete.
+ */
+
+G_DEFINE_TYPE (MplAudioResults, mpl_audio_results, G_TYPE_OBJECT)
+
+#define GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), MPL_TYPE_AUDIO_RESULTS, MplAudioResultsPrivate))
+
+typedef struct _MplAudioResultsPrivate MplAudioResultsPrivate;
+
+struct _MplAudioResultsPrivate {
+  GDBusConnection *connection;
+  GHashTable      *views;
+};
+
+#define TRACKER_SERVICE   "org.freedesktop.Tracker1"
+#define TRACKER_PATH      "/org/freedesktop/Tracker1/Resources"
+#define TRACKER_INTERFACE "org.freedesktop.Tracker1.Resources"
+
+/* Rows requested from Tracker per query */
+#define QUERY_PAGE_SIZE 50
+/* Candidate files checked for existence concurrently */
+#define VALIDATE_BATCH_SIZE 16
+/* Uris looked up in Tracker per query */
+#define LOOKUP_CHUNK_SIZE 25
+
+enum
+{
+  VIEW_LOADED,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+typedef enum
+{
+  VIEW_QUERY,
+  VIEW_URIS
+} ViewType;
+
+typedef struct
+{
+  MplAudioResults *results;
+  gchar           *name;
+  ViewType         type;
+  guint            max_rows;
+  GtkListStore    *store;
+
+  gboolean         loaded;
+  GCancellable    *cancellable; /* non-NULL while loading */
+
+  /* VIEW_QUERY */
+  gchar           *query;
+  guint            offset;
+
+  /* VIEW_URIS */
+  gchar          **uris;
+  guint            next_uri;
+  guint            n_checks;
+  gboolean        *batch_exists;
+  guint            batch_start;
+  guint            batch_len;
+  GPtrArray       *valid;
+  guint            next_lookup;
+} View;
+
+/* One outstanding operation; the view is only touched if the load it
+ * belongs to has not been cancelled. */
+typedef struct
+{
+  View         *view;
+  GCancellable *cancellable;
+  guint         index;
+} Pending;
+
+static void view_load_next (View *view);
+
+static Pending *
+pending_new (View  *view,
+             guint  index)
+{
+  Pending *pending = g_slice_new (Pending);
+
+  pending->view = view;
+  pending->cancellable = g_object_ref (view->cancellable);
+  pending->index = index;
+
+  return pending;
+}
+
+static gboolean
+pending_finish (Pending *pending)
+{
+  gboolean cancelled = g_cancellable_is_cancelled (pending->cancellable);
+
+  g_object_unref (pending->cancellable);
+  g_slice_free (Pending, pending);
+
+  return !cancelled;
+}
+
+static void
+view_cancel (View *view)
+{
+  if (view->cancellable)
+    {
+      g_cancellable_cancel (view->cancellable);
+      g_object_unref (view->cancellable);
+      view->cancellable = NULL;
+    }
+
+  g_free (view->batch_exists);
+  view->batch_exists = NULL;
+  view->n_checks = 0;
+
+  if (view->valid)
+    {
+      g_ptr_array_free (view->valid, TRUE);
+      view->valid = NULL;
+    }
+}
+
+static void
+view_free (View *view)
+{
+  view_cancel (view);
+
+  g_object_unref (view->store);
+  g_strfreev (view->uris);
+  g_free (view->query);
+  g_free (view->name);
+
+  g_slice_free (View, view);
+}
+
+static void
+view_done (View *view)
+{
+  view_cancel (view);
+  view->loaded = TRUE;
+
+  g_signal_emit (view->results, signals[VIEW_LOADED], 0, view->name);
+}
+
+static void
+view_start (View *view)
+{
+  view_cancel (view);
+
+  gtk_list_store_clear (view->store);
+  view->loaded = FALSE;
+  view->cancellable = g_cancellable_new ();
+  view->offset = 0;
+  view->next_uri = 0;
+  view->next_lookup = 0;
+
+  if (view->type == VIEW_URIS)
+    view->valid = g_ptr_array_new_with_free_func (g_free);
+
+  view_load_next (view);
+}
+
+static const gchar *
+non_empty (const gchar *str)
+{
+  return (str && *str) ? str : NULL;
+}
+
+static void
+view_append_row (View         *view,
+                 const gchar **row)
+{
+  GtkTreeIter iter;
+
+  gtk_list_store_append (view->store, &iter);
+  mpl_audio_store_set (view->store, &iter,
+                       "",
+                       row[0],
+                       non_empty (row[1]),
+                       non_empty (row[2]),
+                       non_empty (row[3]));
+}
+
+/*
+ * Tracker queries
+ */
+
+static GDBusConnection *
+get_connection (MplAudioResults *results)
+{
+  MplAudioResultsPrivate *priv = GET_PRIVATE (results);
+  GError *error = NULL;
+
+  if (priv->connection)
+    return priv->connection;
+
+  priv->connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+  if (error)
+    {
+      g_warning (G_STRLOC ": Cannot connect to the session bus: %s",
+                 error->message);
+      g_clear_error (&error);
+    }
+
+  return priv->connection;
+}
+
+static void
+run_query (View                *view,
+           const gchar         *query,
+           guint                index,
+           GAsyncReadyCallback  callback)
+{
+  GDBusConnection *connection = get_connection (view->results);
+
+  if (!connection)
+    {
+      view_done (view);
+      return;
+    }
+
+  g_dbus_connection_call (connection,
+                          TRACKER_SERVICE,
+                          TRACKER_PATH,
+                          TRACKER_INTERFACE,
+                          "SparqlQuery",
+                          g_variant_new ("(s)", query),
+                          G_VARIANT_TYPE ("(aas)"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          view->cancellable,
+                          callback,
+                          pending_new (view, index));
+}
+
+/* Returns the rows of a SparqlQuery reply, or NULL on error */
+static GVariant *
+finish_query (GObject      *source,
+              GAsyncResult *res)
+{
+  GVariant *reply, *rows;
+  GError *error = NULL;
+
+  reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source),
+                                         res, &error);
+  if (error)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning (G_STRLOC ": Tracker query failed: %s", error->message);
+      g_clear_error (&error);
+      return NULL;
+    }
+
+  rows = g_variant_get_child_value (reply, 0);
+  g_variant_unref (reply);
+
+  return rows;
+}
+
+static void
+query_page_cb (GObject      *source,
+               GAsyncResult *res,
+               gpointer      data)
+{
+  Pending *pending = data;
+  View *view = pending->view;
+  GVariant *rows;
+  gsize i, n_rows = 0;
+
+  rows = finish_query (source, res);
+
+  if (!pending_finish (pending))
+    {
+      if (rows)
+        g_variant_unref (rows);
+      return;
+    }
+
+  if (rows)
+    {
+      n_rows = g_variant_n_children (rows);
+
+      for (i = 0; i < n_rows && view->offset < view->max_rows; i++)
+        {
+          GVariant *row = g_variant_get_child_value (rows, i);
+          const gchar **columns = g_variant_get_strv (row, NULL);
+
+          if (g_strv_length ((gchar **) columns) >= 4)
+            view_append_row (view, columns);
+
+          view->offset++;
+
+          g_free (columns);
+          g_variant_unref (row);
+        }
+
+      g_variant_unref (rows);
+    }
+
+  if (n_rows < QUERY_PAGE_SIZE || view->offset >= view->max_rows)
+    view_done (view);
+  else
+    view_load_next (view);
+}
+
+static void
+query_load_page (View *view)
+{
+  gchar *query;
+
+  query = g_strdup_printf ("%s LIMIT %u OFFSET %u",
+                           view->query,
+                           MIN (QUERY_PAGE_SIZE, view->max_rows - view->offset),
+                           view->offset);
+  run_query (view, query, view->offset, query_page_cb);
+  g_free (query);
+}
+
+/*
+ * Uri views: lookup of the validated uris
+ */
+
+static void
+append_sparql_string (GString     *str,
+                      const gchar *value)
+{
+  const gchar *p;
+
+  g_string_append_c (str, '\'');
+  for (p = value; *p; p++)
+    {
+      if (*p == '\'' || *p == '\\')
+        g_string_append_c (str, '\\');
+      g_string_append_c (str, *p);
+    }
+  g_string_append_c (str, '\'');
+}
+
+static void
+lookup_chunk_cb (GObject      *source,
+                 GAsyncResult *res,
+                 gpointer      data)
+{
+  Pending *pending = data;
+  View *view = pending->view;
+  guint start = pending->index;
+  GHashTable *found;
+  GVariant *rows;
+  gsize i, n_rows;
+
+  rows = finish_query (source, res);
+
+  if (!pending_finish (pending))
+    {
+      if (rows)
+        g_variant_unref (rows);
+      return;
+    }
+
+  if (rows)
+    {
+      found = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                     NULL, (GDestroyNotify) g_free);
+
+      n_rows = g_variant_n_children (rows);
+      for (i = 0; i < n_rows; i++)
+        {
+          GVariant *row = g_variant_get_child_value (rows, i);
+          const gchar **columns = g_variant_get_strv (row, NULL);
+
+          if (g_strv_length ((gchar **) columns) >= 4)
+            g_hash_table_insert (found, (gpointer) columns[0], columns);
+          else
+            g_free (columns);
+
+          g_variant_unref (row);
+        }
+
+      /* Keep the order the uris were given in */
+      for (i = start; i < view->next_lookup; i++)
+        {
+          const gchar **columns;
+
+          columns = g_hash_table_lookup (found,
+                                         g_ptr_array_index (view->valid, i));
+          if (columns)
+            view_append_row (view, columns);
+        }
+
+      g_hash_table_destroy (found);
+      g_variant_unref (rows);
+    }
+
+  view_load_next (view);
+}
+
+static void
+uris_lookup_chunk (View *view)
+{
+  GString *query;
+  guint start = view->next_lookup;
+  guint i;
+
+  query = g_string_new ("select"
+                        " nie:url(?u)"
+                        " nie:title(?u)"
+                        " nmm:artistName(nmm:performer(?u))"
+                        " nmm:albumTitle(nmm:musicAlbum(?u))"
+                        " where { ?u a nmm:MusicPiece; nie:url ?url ."
+                        " FILTER (?url IN (");
+
+  for (i = start;
+       i < view->valid->len && i < start + LOOKUP_CHUNK_SIZE;
+       i++)
+    {
+      if (i > start)
+        g_string_append (query, ", ");
+      append_sparql_string (query, g_ptr_array_index (view->valid, i));
+    }
+  g_string_append (query, ")) }");
+
+  view->next_lookup = i;
+
+  run_query (view, query->str, start, lookup_chunk_cb);
+  g_string_free (query, TRUE);
+}
+
+/*
+ * Uri views: existence checks
+ */
+
+static void
+validate_cb (GObject      *source,
+             GAsyncResult *res,
+             gpointer      data)
+{
+  Pending *pending = data;
+  View *view = pending->view;
+  guint index = pending->index;
+  GFileInfo *info;
+  guint i;
+
+  info = g_file_query_info_finish (G_FILE (source), res, NULL);
+  if (info)
+    g_object_unref (info);
+
+  if (!pending_finish (pending))
+    return;
+
+  view->batch_exists[index - view->batch_start] = (info != NULL);
+
+  if (--view->n_checks > 0)
+    return;
+
+  for (i = 0;
+       i < view->batch_len && view->valid->len < view->max_rows;
+       i++)
+    {
+      if (view->batch_exists[i])
+        g_ptr_array_add (view->valid,
+                         g_strdup (view->uris[view->batch_start + i]));
+    }
+
+  g_free (view->batch_exists);
+  view->batch_exists = NULL;
+
+  view_load_next (view);
+}
+
+static void
+uris_validate_batch (View *view)
+{
+  guint n_uris = g_strv_length (view->uris);
+  guint i;
+
+  view->batch_start = view->next_uri;
+  view->batch_len = MIN (VALIDATE_BATCH_SIZE, n_uris - view->next_uri);
+  view->batch_exists = g_new0 (gboolean, view->batch_len);
+  view->n_checks = view->batch_len;
+  view->next_uri += view->batch_len;
+
+  for (i = view->batch_start; i < view->next_uri; i++)
+    {
+      GFile *file = g_file_new_for_uri (view->uris[i]);
+
+      g_file_query_info_async (file,
+                               G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                               G_FILE_QUERY_INFO_NONE,
+                               G_PRIORITY_LOW,
+                               view->cancellable,
+                               validate_cb,
+                               pending_new (view, i));
+      g_object_unref (file);
+    }
+}
+
+/* Runs the next step of loading a view */
+static void
+view_load_next (View *view)
+{
+  if (view->type == VIEW_QUERY)
+    {
+      query_load_page (view);
+      return;
+    }
+
+  if (view->uris &&
+      view->uris[view->next_uri] &&
+      view->valid->len < view->max_rows)
+    {
+      uris_validate_batch (view);
+      return;
+    }
+
+  if (view->next_lookup < view->valid->len)
+    {
+      uris_lookup_chunk (view);
+      return;
+    }
+
+  view_done (view);
+}
+
+static View *
+get_view (MplAudioResults *results,
+          const gchar     *name)
+{
+  MplAudioResultsPrivate *priv = GET_PRIVATE (results);
+  View *view;
+
+  view = g_hash_table_lookup (priv->views, name);
+  if (!view)
+    g_warning (G_STRLOC ": No audio results view named '%s'", name);
+
+  return view;
+}
+
+static View *
+add_view (MplAudioResults *results,
+          const gchar     *name,
+          ViewType         type,
+          guint            max_rows)
+{
+  MplAudioResultsPrivate *priv = GET_PRIVATE (results);
+  View *view = g_slice_new0 (View);
+
+  view->results = results;
+  view->name = g_strdup (name);
+  view->type = type;
+  view->max_rows = max_rows;
+  view->store = mpl_create_audio_store ();
+
+  g_hash_table_replace (priv->views, view->name, view);
+
+  return view;
+}
+
+static void
+mpl_audio_results_dispose (GObject *object)
+{
+  MplAudioResultsPrivate *priv = GET_PRIVATE (object);
+
+  if (priv->views)
+    {
+      g_hash_table_destroy (priv->views);
+      priv->views = NULL;
+    }
+
+  if (priv->connection)
+    {
+      g_object_unref (priv->connection);
+      priv->connection = NULL;
+    }
+
+  G_OBJECT_CLASS (mpl_audio_results_parent_class)->dispose (object);
+}
+
+static void
+mpl_audio_results_class_init (MplAudioResultsClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (MplAudioResultsPrivate));
+
+  object_class->dispose = mpl_audio_results_dispose;
+
+  /**
+   * MplAudioResults::view-loaded:
+   * @results: the object that received the signal
+   * @view: name of the view
+   *
+   * Emitted when all the results of a view have been loaded into its store.
+   */
+  signals[VIEW_LOADED] =
+    g_signal_new ("view-loaded",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (MplAudioResultsClass, view_loaded),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__STRING,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_STRING);
+}
+
+static void
+mpl_audio_results_init (MplAudioResults *self)
+{
+  MplAudioResultsPrivate *priv = GET_PRIVATE (self);
+
+  priv->views = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                       NULL, (GDestroyNotify) view_free);
+}
+
+/**
+ * mpl_audio_results_new:
+ *
+ * Creates a new #MplAudioResults with no views.
+ *
+ * Return value: (transfer full): a #MplAudioResults
+ */
+MplAudioResults *
+mpl_audio_results_new (void)
+{
+  return g_object_new (MPL_TYPE_AUDIO_RESULTS, NULL);
+}
+
+/**
+ * mpl_audio_results_add_query_view:
+ * @results: a #MplAudioResults
+ * @view: name of the view
+ * @query: a SPARQL query, without LIMIT or OFFSET, selecting the url,
+ *   title, artist name and album title of each piece
+ * @max_rows: maximum number of rows in the view
+ *
+ * Adds a view filled from a Tracker query. The query is run when the
+ * view's store is first requested.
+ */
+void
+mpl_audio_results_add_query_view (MplAudioResults *results,
+                                  const gchar     *view,
+                                  const gchar     *query,
+                                  guint            max_rows)
+{
+  View *v;
+
+  g_return_if_fail (MPL_IS_AUDIO_RESULTS (results));
+  g_return_if_fail (view && query);
+
+  v = add_view (results, view, VIEW_QUERY, max_rows);
+  v->query = g_strdup (query);
+}
+
+/**
+ * mpl_audio_results_add_uri_view:
+ * @results: a #MplAudioResults
+ * @view: name of the view
+ * @max_rows: maximum number of rows in the view
+ *
+ * Adds a view filled from a list of uris set with
+ * mpl_audio_results_set_view_uris().
+ */
+void
+mpl_audio_results_add_uri_view (MplAudioResults *results,
+                                const gchar     *view,
+                                guint            max_rows)
+{
+  g_return_if_fail (MPL_IS_AUDIO_RESULTS (results));
+  g_return_if_fail (view);
+
+  add_view (results, view, VIEW_URIS, max_rows);
+}
+
+/**
+ * mpl_audio_results_set_view_uris:
+ * @results: a #MplAudioResults
+ * @view: name of an uri view
+ * @uris: (array zero-terminated=1): candidate uris, most relevant first
+ *
+ * Sets the candidate uris of @view and starts loading it. Duplicate uris
+ * and uris of files that no longer exist are skipped.
+ */
+void
+mpl_audio_results_set_view_uris (MplAudioResults    *results,
+                                 const gchar        *view,
+                                 const gchar *const *uris)
+{
+  GHashTable *seen;
+  GPtrArray *unique;
+  View *v;
+
+  g_return_if_fail (MPL_IS_AUDIO_RESULTS (results));
+
+  v = get_view (results, view);
+  if (!v)
+    return;
+
+  g_return_if_fail (v->type == VIEW_URIS);
+
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  unique = g_ptr_array_new ();
+
+  for (; uris && *uris; uris++)
+    {
+      if (g_hash_table_lookup (seen, *uris))
+        continue;
+
+      g_hash_table_insert (seen, (gpointer) *uris, (gpointer) *uris);
+      g_ptr_array_add (unique, g_strdup (*uris));
+    }
+  g_ptr_array_add (unique, NULL);
+
+  g_hash_table_destroy (seen);
+
+  g_strfreev (v->uris);
+  v->uris = (gchar **) g_ptr_array_free (unique, FALSE);
+
+  view_start (v);
+}
+
+/**
+ * mpl_audio_results_get_store:
+ * @results: a #MplAudioResults
+ * @view: name of the view
+ *
+ * Retrieves the store of @view, starting to load it if it was never
+ * loaded. Rows are appended to the store as they arrive.
+ *
+ * Return value: (transfer none): a #GtkListStore created with
+ * mpl_create_audio_store(), or %NULL if there is no such view.
+ */
+GtkListStore *
+mpl_audio_results_get_store (MplAudioResults *results,
+                             const gchar     *view)
+{
+  View *v;
+
+  g_return_val_if_fail (MPL_IS_AUDIO_RESULTS (results), NULL);
+
+  v = get_view (results, view);
+  if (!v)
+    return NULL;
+
+  if (v->type == VIEW_QUERY && !v->loaded && !v->cancellable)
+    view_start (v);
+
+  return v->store;
+}
+
+/**
+ * mpl_audio_results_reload:
+ * @results: a #MplAudioResults
+ * @view: name of the view
+ *
+ * Discards the cached results of @view and loads it again.
+ */
+void
+mpl_audio_results_reload (MplAudioResults *results,
+                          const gchar     *view)
+{
+  View *v;
+
+  g_return_if_fail (MPL_IS_AUDIO_RESULTS (results));
+
+  v = get_view (results, view);
+  if (v)
+    view_start (v);
+}
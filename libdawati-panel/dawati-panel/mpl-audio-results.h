@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MPL_AUDIO_RESULTS
+#define _MPL_AUDIO_RESULTS
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define MPL_TYPE_AUDIO_RESULTS mpl_audio_results_get_type()
+
+#define MPL_AUDIO_RESULTS(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), MPL_TYPE_AUDIO_RESULTS, MplAudioResults))
+
+#define MPL_AUDIO_RESULTS_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), MPL_TYPE_AUDIO_RESULTS, MplAudioResultsClass))
+
+#define MPL_IS_AUDIO_RESULTS(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), MPL_TYPE_AUDIO_RESULTS))
+
+#define MPL_IS_AUDIO_RESULTS_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), MPL_TYPE_AUDIO_RESULTS))
+
+#define MPL_AUDIO_RESULTS_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), MPL_TYPE_AUDIO_RESULTS, MplAudioResultsClass))
+
+typedef struct _MplAudioResults      MplAudioResults;
+typedef struct _MplAudioResultsClass MplAudioResultsClass;
+
+/**
+ * MplAudioResults:
+ *
+ * Cached audio result views, each backed by a store created with
+ * mpl_create_audio_store().
+ */
+struct _MplAudioResults
+{
+  /*<private>*/
+  GObject parent;
+};
+
+/**
+ * MplAudioResultsClass:
+ * @view_loaded: signal closure for the MplAudioResults::view-loaded signal.
+ *
+ * Class struct for #MplAudioResults.
+ */
+struct _MplAudioResultsClass
+{
+  /*<private>*/
+  GObjectClass parent_class;
+
+  /*<public>*/
+  void (*view_loaded) (MplAudioResults *results,
+                       const gchar     *view);
+};
+
+GType mpl_audio_results_get_type (void);
+
+MplAudioResults *mpl_audio_results_new (void);
+
+void mpl_audio_results_add_query_view (MplAudioResults *results,
+                                       const gchar     *view,
+                                       const gchar     *query,
+                                       guint            max_rows);
+
+void mpl_audio_results_add_uri_view (MplAudioResults *results,
+                                     const gchar     *view,
+                                     guint            max_rows);
+
+void mpl_audio_results_set_view_uris (MplAudioResults    *results,
+                                      const gchar        *view,
+                                      const gchar *const *uris);
+
+GtkListStore *mpl_audio_results_get_store (MplAudioResults *results,
+                                           const gchar     *view);
+
+void mpl_audio_results_reload (MplAudioResults *results,
+                               const gchar     *view);
+
+G_END_DECLS
+
+#endif /* _MPL_AUDIO_RESULTS */
@@ -37,6 +37,7 @@
 #include "mpl-app-launches-store.h"
 #include "mpl-panel-client.h"
 #include "mpl-panel-common.h"
+#include "mpl-trace.h"
 #include "mpl-utils.h"
 #include "marshal.h"
 #include "mnb-enum-types.h"
@@ -82,6 +83,7 @@ enum
   HIDE,
   HIDE_BEGIN,
   HIDE_END,
+  PRE_WARM,
 
   REQUEST_FOCUS,
   REQUEST_BUTTON_STYLE,
@@ -418,6 +420,8 @@ mnb_panel_dbus_set_position (MplPanelClient  *self,
 static gboolean
 mnb_panel_dbus_show (MplPanelClient *self, GError **error)
 {
+  MPL_TRACE_SCOPE ("panel", "Show");
+
   g_signal_emit (self, signals[SHOW], 0);
   return TRUE;
 }
@@ -425,6 +429,8 @@ mnb_panel_dbus_show (MplPanelClient *self, GError **error)
 static gboolean
 mnb_panel_dbus_show_begin (MplPanelClient *self, GError **error)
 {
+  MPL_TRACE_SCOPE ("panel", "ShowBegin");
+
   g_signal_emit (self, signals[SHOW_BEGIN], 0);
   return TRUE;
 }
@@ -432,6 +438,8 @@ mnb_panel_dbus_show_begin (MplPanelClient *self, GError **error)
 static gboolean
 mnb_panel_dbus_show_end (MplPanelClient *self, GError **error)
 {
+  MPL_TRACE_SCOPE ("panel", "ShowEnd");
+
   g_signal_emit (self, signals[SHOW_END], 0);
   return TRUE;
 }
@@ -439,6 +447,8 @@ mnb_panel_dbus_show_end (MplPanelClient *self, GError **error)
 static gboolean
 mnb_panel_dbus_hide (MplPanelClient *self, GError **error)
 {
+  MPL_TRACE_SCOPE ("panel", "Hide");
+
   g_signal_emit (self, signals[HIDE], 0);
   return TRUE;
 }
@@ -446,6 +456,8 @@ mnb_panel_dbus_hide (MplPanelClient *self, GError **error)
 static gboolean
 mnb_panel_dbus_hide_begin (MplPanelClient *self, GError **error)
 {
+  MPL_TRACE_SCOPE ("panel", "HideBegin");
+
   g_signal_emit (self, signals[HIDE_BEGIN], 0);
   return TRUE;
 }
@@ -453,6 +465,8 @@ mnb_panel_dbus_hide_begin (MplPanelClient *self, GError **error)
 static gboolean
 mnb_panel_dbus_hide_end (MplPanelClient *self, GError **error)
 {
+  MPL_TRACE_SCOPE ("panel", "HideEnd");
+
   g_signal_emit (self, signals[HIDE_END], 0);
   return TRUE;
 }
@@ -463,6 +477,13 @@ mnb_panel_dbus_ping (MplPanelClient *self, GError **error)
   return TRUE;
 }
 
+static gboolean
+mnb_panel_dbus_pre_warm (MplPanelClient *self, GError **error)
+{
+  g_signal_emit (self, signals[PRE_WARM], 0);
+  return TRUE;
+}
+
 static gboolean
 mnb_panel_dbus_unload (MplPanelClient *self, GError **error)
 {
@@ -471,6 +492,21 @@ mnb_panel_dbus_unload (MplPanelClient *self, GError **error)
   return TRUE;
 }
 
+static gboolean
+mnb_panel_dbus_set_tracing (MplPanelClient  *self,
+                            gboolean         enabled,
+                            gchar           *directory,
+                            GError         **error)
+{
+  if (enabled)
+    {
+      mpl_trace_set_enabled (TRUE);
+      return TRUE;
+    }
+
+  return mpl_trace_stop (directory, error);
+}
+
 #include "mnb-panel-dbus-glue.h"
 
 static void
@@ -725,6 +761,24 @@ mpl_panel_client_class_init (MplPanelClientClass *klass)
                   g_cclosure_marshal_VOID__VOID,
                   G_TYPE_NONE, 0);
 
+  /**
+   * MplPanelClient::pre-warm:
+   * @panel: panel that received the signal
+   *
+   * The ::pre-warm signal is emitted when the pointer approaches the panel's
+   * Toolbar button, shortly before the panel is likely to be shown. Panels
+   * that do expensive work in #MplPanelClient::show-begin can start it here
+   * so that the show animation does not have to wait for it.
+   */
+  signals[PRE_WARM] =
+    g_signal_new ("pre-warm",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (MplPanelClientClass, pre_warm),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
+
   /*
    * The following signals are here for the Panel dbus interface
    */
@@ -1047,6 +1101,13 @@ mpl_panel_client_constructed (GObject *self)
   if (G_OBJECT_CLASS (mpl_panel_client_parent_class)->constructed)
     G_OBJECT_CLASS (mpl_panel_client_parent_class)->constructed (self);
 
+  /*
+   * The panel name doubles as the process name in traces; with only one
+   * client per process, this is the process main loop.
+   */
+  mpl_trace_init (priv->name);
+  mpl_trace_instrument_main_context (NULL);
+
   conn = mpl_panel_client_connect_to_dbus (MPL_PANEL_CLIENT (self));
 
   if (!conn)
@@ -77,6 +77,7 @@ struct _MplPanelClient
  * @hide: signal closure for the #MplPanelClient::hide signal
  * @hide_begin: signal closure for the #MplPanelClient::hide_begin signal
  * @hide_end: signal closure for the #MplPanelClient::hide_end signal
+ * @pre_warm: signal closure for the #MplPanelClient::pre-warm signal
  *
  * Base class for panels.
  */
@@ -110,6 +111,9 @@ struct _MplPanelClientClass
   void (*request_tooltip)      (MplPanelClient *panel, const gchar *tooltip);
   void (*request_button_state) (MplPanelClient *panel, MnbButtonState state);
   void (*request_modality)     (MplPanelClient *panel, gboolean modal);
+
+  /*<public>*/
+  void (*pre_warm)             (MplPanelClient *panel);
 };
 
 GType mpl_panel_client_get_type (void);
@@ -0,0 +1,582 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* mpl-trace.c */
+/*
+ * Copyright (c) 2012 Intel Corp.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mpl-trace.h"
+
+/**
+ * SECTION:mpl-trace
+ * @short_description: Lightweight tracing of the shell and panels.
+ * @Title: Tracing
+ *
+ * Spans, counters and asynchronous operations recorded into per-thread ring
+ * buffers, and written out in the Chrome trace event format (load the file
+ * in chrome://tracing). All timestamps come from the monotonic clock, so the
+ * traces of the shell and the panel processes line up with each other.
+ *
+ * Tracing is off unless the %MPL_TRACE_ENV environment variable is set, or
+ * it is switched on with the SetTracing method of the Toolbar or panel DBus
+ * interfaces. While off, each trace point costs a single flag test.
+ *
+ * Category and name strings are stored by reference, so they must be static,
+ * or interned with g_intern_string().
+ */
+
+/* Events kept per thread; the oldest are overwritten once the ring is full */
+#define RING_SIZE 8192
+
+typedef struct
+{
+  const gchar *category;
+  const gchar *name;
+  gint64       ts;
+  gint64       value; /* duration, counter value or async id */
+  guint        tid;
+  gchar        phase;
+} MplTraceEvent;
+
+/*
+ * The lock is only ever contended by a dump or reset; rings outlive their
+ * threads, and are handed on to the next thread that needs one.
+ */
+typedef struct
+{
+  GMutex        lock;
+  gboolean      in_use;
+  guint         head;
+  guint         n_events;
+  MplTraceEvent events[RING_SIZE];
+} MplTraceRing;
+
+static volatile gint  trace_enabled = 0;
+static gchar         *trace_process_name = NULL;
+static gchar         *trace_directory = NULL;
+
+static GMutex         rings_lock;
+static GSList        *rings = NULL;
+static guint          next_tid = 1;
+
+static void mpl_trace_thread_exit (gpointer data);
+
+static GPrivate       ring_key = G_PRIVATE_INIT (mpl_trace_thread_exit);
+static GPrivate       tid_key  = G_PRIVATE_INIT (NULL);
+
+static GPollFunc      trace_poll_chain = NULL;
+static gint64         trace_poll_returned = 0;
+
+static void
+mpl_trace_thread_exit (gpointer data)
+{
+  MplTraceRing *ring = data;
+
+  g_mutex_lock (&rings_lock);
+  ring->in_use = FALSE;
+  g_mutex_unlock (&rings_lock);
+}
+
+static MplTraceRing *
+mpl_trace_get_ring (guint *tid)
+{
+  MplTraceRing *ring = g_private_get (&ring_key);
+
+  if (G_UNLIKELY (!ring))
+    {
+      GSList *l;
+
+      g_mutex_lock (&rings_lock);
+
+      for (l = rings; l; l = l->next)
+        if (!((MplTraceRing *) l->data)->in_use)
+          {
+            ring = l->data;
+            break;
+          }
+
+      if (!ring)
+        {
+          ring = g_new0 (MplTraceRing, 1);
+          g_mutex_init (&ring->lock);
+          rings = g_slist_prepend (rings, ring);
+        }
+
+      ring->in_use = TRUE;
+
+      g_private_set (&tid_key, GUINT_TO_POINTER (next_tid++));
+
+      g_mutex_unlock (&rings_lock);
+
+      g_private_set (&ring_key, ring);
+    }
+
+  *tid = GPOINTER_TO_UINT (g_private_get (&tid_key));
+
+  return ring;
+}
+
+static void
+mpl_trace_record (gchar        phase,
+                  const gchar *category,
+                  const gchar *name,
+                  gint64       ts,
+                  gint64       value)
+{
+  MplTraceRing  *ring;
+  MplTraceEvent *event;
+  guint          tid;
+
+  ring = mpl_trace_get_ring (&tid);
+
+  g_mutex_lock (&ring->lock);
+
+  event = &ring->events[ring->head];
+  event->category = category;
+  event->name     = name;
+  event->ts       = ts;
+  event->value    = value;
+  event->tid      = tid;
+  event->phase    = phase;
+
+  ring->head = (ring->head + 1) % RING_SIZE;
+
+  if (ring->n_events < RING_SIZE)
+    ring->n_events++;
+
+  g_mutex_unlock (&ring->lock);
+}
+
+static void
+mpl_trace_reset (void)
+{
+  GSList *l;
+
+  g_mutex_lock (&rings_lock);
+
+  for (l = rings; l; l = l->next)
+    {
+      MplTraceRing *ring = l->data;
+
+      g_mutex_lock (&ring->lock);
+      ring->head = 0;
+      ring->n_events = 0;
+      g_mutex_unlock (&ring->lock);
+    }
+
+  g_mutex_unlock (&rings_lock);
+}
+
+static void
+mpl_trace_atexit (void)
+{
+  GError *error = NULL;
+
+  /* Already stopped, and written out if asked to, over DBus */
+  if (!mpl_trace_get_enabled ())
+    return;
+
+  if (!mpl_trace_stop (trace_directory, &error))
+    {
+      g_warning ("Failed to write trace: %s", error->message);
+      g_clear_error (&error);
+    }
+}
+
+/**
+ * mpl_trace_init:
+ * @process_name: name of the process in the trace
+ *
+ * Sets up tracing for the process; if the %MPL_TRACE_ENV environment
+ * variable is set, tracing starts right away, and the trace is written to
+ * the directory it names when the process exits.
+ *
+ * Only the first call has any effect.
+ */
+void
+mpl_trace_init (const gchar *process_name)
+{
+  const gchar *directory;
+
+  if (trace_process_name)
+    return;
+
+  trace_process_name = g_strdup (process_name);
+
+  directory = g_getenv (MPL_TRACE_ENV);
+
+  if (directory && *directory)
+    {
+      trace_directory = g_strdup (directory);
+      mpl_trace_set_enabled (TRUE);
+      atexit (mpl_trace_atexit);
+    }
+}
+
+/*
+ * The time between returning from one poll and entering the next is what
+ * the main loop spent dispatching (and preparing and checking) its sources.
+ */
+static gint
+mpl_trace_poll (GPollFD *fds, guint nfds, gint timeout)
+{
+  gint64 now;
+  gint   retval;
+
+  if (!g_atomic_int_get (&trace_enabled))
+    {
+      trace_poll_returned = 0;
+      return trace_poll_chain (fds, nfds, timeout);
+    }
+
+  now = g_get_monotonic_time ();
+
+  if (trace_poll_returned)
+    mpl_trace_record ('X', "mainloop", "dispatch",
+                      trace_poll_returned, now - trace_poll_returned);
+
+  retval = trace_poll_chain (fds, nfds, timeout);
+
+  trace_poll_returned = g_get_monotonic_time ();
+
+  return retval;
+}
+
+/**
+ * mpl_trace_instrument_main_context:
+ * @context: a #GMainContext, or %NULL for the default context
+ *
+ * Traces the time each iteration of @context spends outside of poll() as a
+ * span. Only one context per process can be instrumented, so only the first
+ * call has any effect.
+ */
+void
+mpl_trace_instrument_main_context (GMainContext *context)
+{
+  if (trace_poll_chain)
+    return;
+
+  if (!context)
+    context = g_main_context_default ();
+
+  trace_poll_chain = g_main_context_get_poll_func (context);
+  g_main_context_set_poll_func (context, mpl_trace_poll);
+}
+
+/**
+ * mpl_trace_set_enabled:
+ * @enabled: whether to record events
+ *
+ * Starts or stops recording; starting discards any previously recorded
+ * events.
+ */
+void
+mpl_trace_set_enabled (gboolean enabled)
+{
+  enabled = !!enabled;
+
+  if (enabled == (gboolean) g_atomic_int_get (&trace_enabled))
+    return;
+
+  if (enabled)
+    mpl_trace_reset ();
+
+  g_atomic_int_set (&trace_enabled, enabled);
+}
+
+/**
+ * mpl_trace_get_enabled:
+ *
+ * Return value: %TRUE if events are being recorded.
+ */
+gboolean
+mpl_trace_get_enabled (void)
+{
+  return g_atomic_int_get (&trace_enabled);
+}
+
+/**
+ * mpl_trace_build_filename:
+ * @directory: directory to write the trace to
+ *
+ * Return value: the file name for this process' trace in @directory, to be
+ * freed with g_free().
+ */
+gchar *
+mpl_trace_build_filename (const gchar *directory)
+{
+  gchar *basename;
+  gchar *filename;
+
+  basename = g_strdup_printf ("%s-%d.json",
+                              trace_process_name ? trace_process_name : "dawati",
+                              (gint) getpid ());
+  filename = g_build_filename (directory, basename, NULL);
+
+  g_free (basename);
+
+  return filename;
+}
+
+static void
+mpl_trace_append_string (GString *json, const gchar *s)
+{
+  g_string_append_c (json, '"');
+
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        g_string_append_printf (json, "\\%c", *s);
+      else if ((guchar) *s < 0x20)
+        g_string_append_printf (json, "\\u%04x", (guchar) *s);
+      else
+        g_string_append_c (json, *s);
+    }
+
+  g_string_append_c (json, '"');
+}
+
+static void
+mpl_trace_append_event (GString *json, MplTraceEvent *event, gint pid)
+{
+  g_string_append (json, ",\n{\"name\":");
+  mpl_trace_append_string (json, event->name);
+  g_string_append (json, ",\"cat\":");
+  mpl_trace_append_string (json, event->category);
+  g_string_append_printf (json,
+                          ",\"ph\":\"%c\",\"pid\":%d,\"tid\":%u"
+                          ",\"ts\":%" G_GINT64_FORMAT,
+                          event->phase, pid, event->tid, event->ts);
+
+  switch (event->phase)
+    {
+    case 'X':
+      g_string_append_printf (json, ",\"dur\":%" G_GINT64_FORMAT,
+                              event->value);
+      break;
+    case 'C':
+      g_string_append_printf (json, ",\"args\":{\"value\":%" G_GINT64_FORMAT
+                              "}", event->value);
+      break;
+    case 'b':
+    case 'e':
+      g_string_append_printf (json, ",\"id\":\"0x%" G_GINT64_MODIFIER "x\"",
+                              (guint64) event->value);
+      break;
+    case 'i':
+      g_string_append (json, ",\"s\":\"t\"");
+      break;
+    }
+
+  g_string_append_c (json, '}');
+}
+
+/**
+ * mpl_trace_dump:
+ * @filename: file to write the trace to
+ * @error: location to store error, or %NULL
+ *
+ * Writes the events recorded so far as Chrome trace event JSON.
+ *
+ * Return value: %TRUE on success.
+ */
+gboolean
+mpl_trace_dump (const gchar *filename, GError **error)
+{
+  GString  *json;
+  GSList   *l;
+  gint      pid = getpid ();
+  gboolean  retval;
+
+  json = g_string_new ("{\"traceEvents\":[\n"
+                       "{\"name\":\"process_name\",\"ph\":\"M\"");
+  g_string_append_printf (json, ",\"pid\":%d,\"tid\":0,\"args\":{\"name\":",
+                          pid);
+  mpl_trace_append_string (json,
+                           trace_process_name ? trace_process_name : "dawati");
+  g_string_append (json, "}}");
+
+  g_mutex_lock (&rings_lock);
+
+  for (l = rings; l; l = l->next)
+    {
+      MplTraceRing *ring = l->data;
+      guint         first, i;
+
+      g_mutex_lock (&ring->lock);
+
+      first = (ring->head + RING_SIZE - ring->n_events) % RING_SIZE;
+
+      for (i = 0; i < ring->n_events; i++)
+        mpl_trace_append_event (json,
+                                &ring->events[(first + i) % RING_SIZE],
+                                pid);
+
+      g_mutex_unlock (&ring->lock);
+    }
+
+  g_mutex_unlock (&rings_lock);
+
+  g_string_append (json, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  retval = g_file_set_contents (filename, json->str, json->len, error);
+
+  g_string_free (json, TRUE);
+
+  return retval;
+}
+
+/**
+ * mpl_trace_stop:
+ * @directory: directory to write the trace to, or %NULL
+ * @error: location to store error, or %NULL
+ *
+ * Stops recording and, if @directory is set, writes the trace to the file
+ * returned by mpl_trace_build_filename().
+ *
+ * Return value: %TRUE on success.
+ */
+gboolean
+mpl_trace_stop (const gchar *directory, GError **error)
+{
+  gchar    *filename;
+  gboolean  retval;
+
+  mpl_trace_set_enabled (FALSE);
+
+  if (!directory || !*directory)
+    return TRUE;
+
+  filename = mpl_trace_build_filename (directory);
+  retval = mpl_trace_dump (filename, error);
+
+  if (retval)
+    g_message ("Trace written to %s", filename);
+
+  g_free (filename);
+
+  return retval;
+}
+
+/**
+ * mpl_trace_span_start:
+ * @category: static string
+ * @name: static string
+ *
+ * Starts a span, to be finished with mpl_trace_span_end(); MPL_TRACE_SCOPE()
+ * does both for a block.
+ *
+ * Return value: the span.
+ */
+MplTraceSpan
+mpl_trace_span_start (const gchar *category, const gchar *name)
+{
+  MplTraceSpan span = { category, name, 0 };
+
+  if (g_atomic_int_get (&trace_enabled))
+    span.start = g_get_monotonic_time ();
+
+  return span;
+}
+
+/**
+ * mpl_trace_span_end:
+ * @span: a span started with mpl_trace_span_start()
+ *
+ * Records @span as lasting until now.
+ */
+void
+mpl_trace_span_end (MplTraceSpan *span)
+{
+  if (!span->start || !g_atomic_int_get (&trace_enabled))
+    return;
+
+  mpl_trace_record ('X', span->category, span->name, span->start,
+                    g_get_monotonic_time () - span->start);
+}
+
+/**
+ * mpl_trace_instant:
+ * @category: static string
+ * @name: static string
+ *
+ * Records a point in time.
+ */
+void
+mpl_trace_instant (const gchar *category, const gchar *name)
+{
+  if (!g_atomic_int_get (&trace_enabled))
+    return;
+
+  mpl_trace_record ('i', category, name, g_get_monotonic_time (), 0);
+}
+
+/**
+ * mpl_trace_counter:
+ * @category: static string
+ * @name: static string
+ * @value: current value of the counter
+ *
+ * Records the value of a counter.
+ */
+void
+mpl_trace_counter (const gchar *category, const gchar *name, gint64 value)
+{
+  if (!g_atomic_int_get (&trace_enabled))
+    return;
+
+  mpl_trace_record ('C', category, name, g_get_monotonic_time (), value);
+}
+
+/**
+ * mpl_trace_async_begin:
+ * @category: static string
+ * @name: static string
+ * @id: identifies the operation among others of the same @category
+ *
+ * Records the start of an operation that completes asynchronously, possibly
+ * on another thread.
+ */
+void
+mpl_trace_async_begin (const gchar *category, const gchar *name, guint64 id)
+{
+  if (!g_atomic_int_get (&trace_enabled))
+    return;
+
+  mpl_trace_record ('b', category, name, g_get_monotonic_time (), id);
+}
+
+/**
+ * mpl_trace_async_end:
+ * @category: static string
+ * @name: static string
+ * @id: the id passed to mpl_trace_async_begin()
+ *
+ * Records the completion of an asynchronous operation.
+ */
+void
+mpl_trace_async_end (const gchar *category, const gchar *name, guint64 id)
+{
+  if (!g_atomic_int_get (&trace_enabled))
+    return;
+
+  mpl_trace_record ('e', category, name, g_get_monotonic_time (), id);
+}
@@ -0,0 +1,94 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* mpl-trace.h */
+/*
+ * Copyright (c) 2012 Intel Corp.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _MPL_TRACE_H
+#define _MPL_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * MPL_TRACE_ENV:
+ *
+ * Name of the environment variable that turns tracing on at start up; its
+ * value is the directory the trace is written to when the process exits.
+ */
+#define MPL_TRACE_ENV "DAWATI_TRACE"
+
+/**
+ * MplTraceSpan:
+ *
+ * A span in progress, see mpl_trace_span_start(); the members are private.
+ */
+typedef struct
+{
+  /*< private >*/
+  const gchar *category;
+  const gchar *name;
+  gint64       start;
+} MplTraceSpan;
+
+void     mpl_trace_init              (const gchar   *process_name);
+void     mpl_trace_instrument_main_context (GMainContext *context);
+
+void     mpl_trace_set_enabled       (gboolean       enabled);
+gboolean mpl_trace_get_enabled       (void);
+
+gchar   *mpl_trace_build_filename    (const gchar   *directory);
+gboolean mpl_trace_dump              (const gchar   *filename,
+                                      GError       **error);
+gboolean mpl_trace_stop              (const gchar   *directory,
+                                      GError       **error);
+
+MplTraceSpan mpl_trace_span_start    (const gchar   *category,
+                                      const gchar   *name);
+void     mpl_trace_span_end          (MplTraceSpan  *span);
+
+void     mpl_trace_instant           (const gchar   *category,
+                                      const gchar   *name);
+void     mpl_trace_counter           (const gchar   *category,
+                                      const gchar   *name,
+                                      gint64         value);
+void     mpl_trace_async_begin       (const gchar   *category,
+                                      const gchar   *name,
+                                      guint64        id);
+void     mpl_trace_async_end         (const gchar   *category,
+                                      const gchar   *name,
+                                      guint64        id);
+
+/**
+ * MPL_TRACE_SCOPE:
+ * @category: static string
+ * @name: static string
+ *
+ * Traces the rest of the enclosing block as a span; must be placed among the
+ * declarations at the top of the block.
+ */
+#define MPL_TRACE_SCOPE(category, name)                                 \
+  MplTraceSpan G_PASTE (_mpl_trace_span_, __LINE__)                     \
+    __attribute__ ((cleanup (mpl_trace_span_end))) =                    \
+    mpl_trace_span_start ((category), (name))
+
+G_END_DECLS
+
+#endif /* _MPL_TRACE_H */
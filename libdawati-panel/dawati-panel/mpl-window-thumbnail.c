@@ -0,0 +1,488 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/*
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:mpl-window-thumbnail
+ * @short_description: Rate-limited downscaled copy of a window texture
+ * @Title: MplWindowThumbnail
+ *
+ * #MplWindowThumbnail shows a small offscreen copy of a window texture, so
+ * views of many windows do not sample full-size window textures on every
+ * paint. The owner reports damage with mpl_window_thumbnail_damage(); while
+ * the thumbnail is live and mapped, the copy is refreshed at most once
+ * every #MplWindowThumbnail:interval milliseconds, otherwise it is left
+ * until mpl_window_thumbnail_update() is called or it becomes live again.
+ */
+
+#include "mpl-window-thumbnail.h"
+
+G_DEFINE_TYPE (MplWindowThumbnail, mpl_window_thumbnail, CLUTTER_TYPE_TEXTURE)
+
+#define WINDOW_THUMBNAIL_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), MPL_TYPE_WINDOW_THUMBNAIL, MplWindowThumbnailPrivate))
+
+#define DEFAULT_INTERVAL 250
+
+struct _MplWindowThumbnailPrivate
+{
+  MplWindowThumbnailSourceFunc source_func;
+  gpointer                     source_data;
+  GDestroyNotify               source_notify;
+
+  CoglHandle  texture;
+  CoglHandle  fb;
+
+  gfloat      max_size;
+  guint       interval;
+  gint64      last_refresh;
+  guint       refresh_id;
+
+  gboolean    live  : 1;
+  gboolean    dirty : 1;
+};
+
+enum
+{
+  PROP_0,
+  PROP_MAX_SIZE,
+  PROP_INTERVAL,
+  PROP_LIVE
+};
+
+static void
+mpl_window_thumbnail_get_property (GObject    *object,
+                                   guint       property_id,
+                                   GValue     *value,
+                                   GParamSpec *pspec)
+{
+  MplWindowThumbnailPrivate *priv = MPL_WINDOW_THUMBNAIL (object)->priv;
+
+  switch (property_id)
+    {
+    case PROP_MAX_SIZE:
+      g_value_set_float (value, priv->max_size);
+      break;
+
+    case PROP_INTERVAL:
+      g_value_set_uint (value, priv->interval);
+      break;
+
+    case PROP_LIVE:
+      g_value_set_boolean (value, priv->live);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    }
+}
+
+static void
+mpl_window_thumbnail_set_property (GObject      *object,
+                                   guint         property_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+  MplWindowThumbnail *self = MPL_WINDOW_THUMBNAIL (object);
+
+  switch (property_id)
+    {
+    case PROP_MAX_SIZE:
+      mpl_window_thumbnail_set_max_size (self, g_value_get_float (value));
+      break;
+
+    case PROP_INTERVAL:
+      mpl_window_thumbnail_set_interval (self, g_value_get_uint (value));
+      break;
+
+    case PROP_LIVE:
+      mpl_window_thumbnail_set_live (self, g_value_get_boolean (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    }
+}
+
+static void
+mpl_window_thumbnail_cancel_refresh (MplWindowThumbnail *self)
+{
+  MplWindowThumbnailPrivate *priv = self->priv;
+
+  if (priv->refresh_id)
+    {
+      g_source_remove (priv->refresh_id);
+      priv->refresh_id = 0;
+    }
+}
+
+static void
+mpl_window_thumbnail_free_texture (MplWindowThumbnail *self)
+{
+  MplWindowThumbnailPrivate *priv = self->priv;
+
+  if (priv->fb)
+    {
+      cogl_handle_unref (priv->fb);
+      priv->fb = NULL;
+    }
+
+  if (priv->texture)
+    {
+      cogl_handle_unref (priv->texture);
+      priv->texture = NULL;
+    }
+}
+
+static void
+mpl_window_thumbnail_dispose (GObject *object)
+{
+  MplWindowThumbnail *self = MPL_WINDOW_THUMBNAIL (object);
+
+  mpl_window_thumbnail_cancel_refresh (self);
+  mpl_window_thumbnail_set_source_func (self, NULL, NULL, NULL);
+  mpl_window_thumbnail_free_texture (self);
+
+  G_OBJECT_CLASS (mpl_window_thumbnail_parent_class)->dispose (object);
+}
+
+/*
+ * Renders the current window texture into our small offscreen texture.
+ */
+static void
+mpl_window_thumbnail_refresh (MplWindowThumbnail *self)
+{
+  MplWindowThumbnailPrivate *priv = self->priv;
+  CoglHandle window_texture;
+  CoglColor  transparent;
+  gfloat     window_width, window_height, scale;
+  guint      width, height;
+
+  if (!priv->source_func)
+    return;
+
+  window_texture = priv->source_func (priv->source_data);
+
+  if (window_texture == COGL_INVALID_HANDLE)
+    return;
+
+  window_width  = cogl_texture_get_width (window_texture);
+  window_height = cogl_texture_get_height (window_texture);
+
+  scale = 1.0;
+  if (priv->max_size > 0)
+    scale = MIN (1.0, priv->max_size / MAX (window_width, window_height));
+
+  width  = MAX (1, window_width * scale);
+  height = MAX (1, window_height * scale);
+
+  if (priv->texture &&
+      (cogl_texture_get_width (priv->texture) != width ||
+       cogl_texture_get_height (priv->texture) != height))
+    mpl_window_thumbnail_free_texture (self);
+
+  if (!priv->texture)
+    {
+      priv->texture = cogl_texture_new_with_size (width, height,
+                                                  COGL_TEXTURE_NO_SLICING,
+                                                  COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+      priv->fb = cogl_offscreen_new_to_texture (priv->texture);
+
+      clutter_texture_set_cogl_texture (CLUTTER_TEXTURE (self), priv->texture);
+    }
+
+  cogl_push_framebuffer (priv->fb);
+  cogl_ortho (0, width, height, 0, -1, 1);
+  /* Texture storage starts out undefined; ARGB windows blend over it */
+  cogl_color_init_from_4ub (&transparent, 0, 0, 0, 0);
+  cogl_clear (&transparent, COGL_BUFFER_BIT_COLOR);
+  cogl_set_source_texture (window_texture);
+  cogl_rectangle (0, 0, width, height);
+  cogl_pop_framebuffer ();
+
+  priv->dirty = FALSE;
+  priv->last_refresh = g_get_monotonic_time ();
+
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (self));
+}
+
+static gboolean
+mpl_window_thumbnail_refresh_cb (gpointer data)
+{
+  MplWindowThumbnail        *self = data;
+  MplWindowThumbnailPrivate *priv = self->priv;
+
+  priv->refresh_id = 0;
+
+  if (priv->dirty && priv->live)
+    mpl_window_thumbnail_refresh (self);
+
+  return FALSE;
+}
+
+static void
+mpl_window_thumbnail_queue_refresh (MplWindowThumbnail *self)
+{
+  MplWindowThumbnailPrivate *priv = self->priv;
+  gint64 elapsed;
+
+  if (!priv->live || !CLUTTER_ACTOR_IS_MAPPED (self) || priv->refresh_id)
+    return;
+
+  elapsed = (g_get_monotonic_time () - priv->last_refresh) / 1000;
+
+  priv->refresh_id = g_timeout_add (MAX (0, (gint64) priv->interval - elapsed),
+                                    mpl_window_thumbnail_refresh_cb, self);
+}
+
+static void
+mpl_window_thumbnail_mapped_notify_cb (MplWindowThumbnail *self,
+                                       GParamSpec         *pspec,
+                                       gpointer            data)
+{
+  if (!CLUTTER_ACTOR_IS_MAPPED (self))
+    mpl_window_thumbnail_cancel_refresh (self);
+  else if (self->priv->dirty)
+    mpl_window_thumbnail_queue_refresh (self);
+}
+
+static void
+mpl_window_thumbnail_class_init (MplWindowThumbnailClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GParamSpec   *pspec;
+
+  g_type_class_add_private (klass, sizeof (MplWindowThumbnailPrivate));
+
+  object_class->get_property = mpl_window_thumbnail_get_property;
+  object_class->set_property = mpl_window_thumbnail_set_property;
+  object_class->dispose = mpl_window_thumbnail_dispose;
+
+  pspec = g_param_spec_float ("max-size",
+                              "Maximum size",
+                              "Size the longest side of the window is "
+                              "scaled down to, 0 to keep it",
+                              0, G_MAXFLOAT, 0,
+                              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_MAX_SIZE, pspec);
+
+  pspec = g_param_spec_uint ("interval",
+                             "Interval",
+                             "Minimum time between two refreshes, in ms",
+                             0, G_MAXUINT, DEFAULT_INTERVAL,
+                             G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_INTERVAL, pspec);
+
+  pspec = g_param_spec_boolean ("live",
+                                "Live",
+                                "Whether damage is picked up while mapped",
+                                TRUE,
+                                G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property (object_class, PROP_LIVE, pspec);
+}
+
+static void
+mpl_window_thumbnail_init (MplWindowThumbnail *self)
+{
+  MplWindowThumbnailPrivate *priv;
+
+  priv = self->priv = WINDOW_THUMBNAIL_PRIVATE (self);
+
+  priv->interval = DEFAULT_INTERVAL;
+  priv->live = TRUE;
+  priv->dirty = TRUE;
+
+  clutter_texture_set_keep_aspect_ratio (CLUTTER_TEXTURE (self), TRUE);
+
+  g_signal_connect (self, "notify::mapped",
+                    G_CALLBACK (mpl_window_thumbnail_mapped_notify_cb), NULL);
+}
+
+/**
+ * mpl_window_thumbnail_new:
+ *
+ * Creates a new #MplWindowThumbnail; it stays empty until it is given a
+ * source with mpl_window_thumbnail_set_source_func() and updated.
+ *
+ * Returns: a new #MplWindowThumbnail
+ */
+ClutterActor *
+mpl_window_thumbnail_new (void)
+{
+  return g_object_new (MPL_TYPE_WINDOW_THUMBNAIL, NULL);
+}
+
+/**
+ * mpl_window_thumbnail_set_source_func:
+ * @thumbnail: a #MplWindowThumbnail
+ * @func: (allow-none): function returning the window texture to copy
+ * @data: data for @func
+ * @notify: (allow-none): destroys @data
+ *
+ * The window texture is looked up through @func on every refresh, as it
+ * changes when the window is resized. Setting a new source marks the
+ * thumbnail as damaged.
+ */
+void
+mpl_window_thumbnail_set_source_func (MplWindowThumbnail          *thumbnail,
+                                      MplWindowThumbnailSourceFunc func,
+                                      gpointer                     data,
+                                      GDestroyNotify               notify)
+{
+  MplWindowThumbnailPrivate *priv;
+
+  g_return_if_fail (MPL_IS_WINDOW_THUMBNAIL (thumbnail));
+
+  priv = thumbnail->priv;
+
+  if (priv->source_notify)
+    priv->source_notify (priv->source_data);
+
+  priv->source_func = func;
+  priv->source_data = data;
+  priv->source_notify = notify;
+
+  if (func)
+    mpl_window_thumbnail_damage (thumbnail);
+}
+
+void
+mpl_window_thumbnail_set_max_size (MplWindowThumbnail *thumbnail,
+                                   gfloat              max_size)
+{
+  MplWindowThumbnailPrivate *priv;
+
+  g_return_if_fail (MPL_IS_WINDOW_THUMBNAIL (thumbnail));
+
+  priv = thumbnail->priv;
+
+  if (priv->max_size == max_size)
+    return;
+
+  priv->max_size = max_size;
+  mpl_window_thumbnail_damage (thumbnail);
+
+  g_object_notify (G_OBJECT (thumbnail), "max-size");
+}
+
+gfloat
+mpl_window_thumbnail_get_max_size (MplWindowThumbnail *thumbnail)
+{
+  g_return_val_if_fail (MPL_IS_WINDOW_THUMBNAIL (thumbnail), 0);
+
+  return thumbnail->priv->max_size;
+}
+
+void
+mpl_window_thumbnail_set_interval (MplWindowThumbnail *thumbnail,
+                                   guint               interval)
+{
+  g_return_if_fail (MPL_IS_WINDOW_THUMBNAIL (thumbnail));
+
+  if (thumbnail->priv->interval == interval)
+    return;
+
+  thumbnail->priv->interval = interval;
+
+  g_object_notify (G_OBJECT (thumbnail), "interval");
+}
+
+guint
+mpl_window_thumbnail_get_interval (MplWindowThumbnail *thumbnail)
+{
+  g_return_val_if_fail (MPL_IS_WINDOW_THUMBNAIL (thumbnail), 0);
+
+  return thumbnail->priv->interval;
+}
+
+/**
+ * mpl_window_thumbnail_set_live:
+ * @thumbnail: a #MplWindowThumbnail
+ * @live: whether to refresh on damage
+ *
+ * Owners that know the thumbnail can't be seen, e.g. because it is
+ * scrolled out of view, turn this off to stop timed refreshes. Damage
+ * reported meanwhile is picked up when it is turned back on.
+ */
+void
+mpl_window_thumbnail_set_live (MplWindowThumbnail *thumbnail,
+                               gboolean            live)
+{
+  MplWindowThumbnailPrivate *priv;
+
+  g_return_if_fail (MPL_IS_WINDOW_THUMBNAIL (thumbnail));
+
+  priv = thumbnail->priv;
+
+  if (priv->live == live)
+    return;
+
+  priv->live = live;
+
+  if (!live)
+    mpl_window_thumbnail_cancel_refresh (thumbnail);
+  else if (priv->dirty)
+    mpl_window_thumbnail_queue_refresh (thumbnail);
+
+  g_object_notify (G_OBJECT (thumbnail), "live");
+}
+
+gboolean
+mpl_window_thumbnail_get_live (MplWindowThumbnail *thumbnail)
+{
+  g_return_val_if_fail (MPL_IS_WINDOW_THUMBNAIL (thumbnail), FALSE);
+
+  return thumbnail->priv->live;
+}
+
+/**
+ * mpl_window_thumbnail_damage:
+ * @thumbnail: a #MplWindowThumbnail
+ *
+ * Marks the copy out of date; if the thumbnail is live and mapped, a
+ * refresh is scheduled no sooner than #MplWindowThumbnail:interval after
+ * the previous one.
+ */
+void
+mpl_window_thumbnail_damage (MplWindowThumbnail *thumbnail)
+{
+  g_return_if_fail (MPL_IS_WINDOW_THUMBNAIL (thumbnail));
+
+  thumbnail->priv->dirty = TRUE;
+
+  mpl_window_thumbnail_queue_refresh (thumbnail);
+}
+
+/**
+ * mpl_window_thumbnail_update:
+ * @thumbnail: a #MplWindowThumbnail
+ *
+ * Refreshes the copy straight away if it is out of date, e.g. before a
+ * view showing it appears.
+ */
+void
+mpl_window_thumbnail_update (MplWindowThumbnail *thumbnail)
+{
+  g_return_if_fail (MPL_IS_WINDOW_THUMBNAIL (thumbnail));
+
+  if (!thumbnail->priv->dirty)
+    return;
+
+  mpl_window_thumbnail_cancel_refresh (thumbnail);
+  mpl_window_thumbnail_refresh (thumbnail);
+}
@@ -0,0 +1,100 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/*
+ * Copyright (C) 2012 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MPL_WINDOW_THUMBNAIL_H
+#define _MPL_WINDOW_THUMBNAIL_H
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+#define MPL_TYPE_WINDOW_THUMBNAIL mpl_window_thumbnail_get_type()
+
+#define MPL_WINDOW_THUMBNAIL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), \
+  MPL_TYPE_WINDOW_THUMBNAIL, MplWindowThumbnail))
+
+#define MPL_WINDOW_THUMBNAIL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), \
+  MPL_TYPE_WINDOW_THUMBNAIL, MplWindowThumbnailClass))
+
+#define MPL_IS_WINDOW_THUMBNAIL(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), \
+  MPL_TYPE_WINDOW_THUMBNAIL))
+
+#define MPL_IS_WINDOW_THUMBNAIL_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), \
+  MPL_TYPE_WINDOW_THUMBNAIL))
+
+#define MPL_WINDOW_THUMBNAIL_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), \
+  MPL_TYPE_WINDOW_THUMBNAIL, MplWindowThumbnailClass))
+
+typedef struct _MplWindowThumbnail MplWindowThumbnail;
+typedef struct _MplWindowThumbnailClass MplWindowThumbnailClass;
+typedef struct _MplWindowThumbnailPrivate MplWindowThumbnailPrivate;
+
+struct _MplWindowThumbnail
+{
+  ClutterTexture parent;
+
+  MplWindowThumbnailPrivate *priv;
+};
+
+struct _MplWindowThumbnailClass
+{
+  ClutterTextureClass parent_class;
+};
+
+/**
+ * MplWindowThumbnailSourceFunc:
+ * @data: user data
+ *
+ * Returns: (transfer none): the current texture of the window, or
+ * %COGL_INVALID_HANDLE if there is none.
+ */
+typedef CoglHandle (*MplWindowThumbnailSourceFunc) (gpointer data);
+
+GType mpl_window_thumbnail_get_type (void) G_GNUC_CONST;
+
+ClutterActor *mpl_window_thumbnail_new (void);
+
+void mpl_window_thumbnail_set_source_func (MplWindowThumbnail          *thumbnail,
+                                           MplWindowThumbnailSourceFunc func,
+                                           gpointer                     data,
+                                           GDestroyNotify               notify);
+
+void   mpl_window_thumbnail_set_max_size (MplWindowThumbnail *thumbnail,
+                                          gfloat              max_size);
+gfloat mpl_window_thumbnail_get_max_size (MplWindowThumbnail *thumbnail);
+
+void  mpl_window_thumbnail_set_interval (MplWindowThumbnail *thumbnail,
+                                         guint               interval);
+guint mpl_window_thumbnail_get_interval (MplWindowThumbnail *thumbnail);
+
+void     mpl_window_thumbnail_set_live (MplWindowThumbnail *thumbnail,
+                                        gboolean            live);
+gboolean mpl_window_thumbnail_get_live (MplWindowThumbnail *thumbnail);
+
+void mpl_window_thumbnail_damage (MplWindowThumbnail *thumbnail);
+void mpl_window_thumbnail_update (MplWindowThumbnail *thumbnail);
+
+G_END_DECLS
+
+#endif /* _MPL_WINDOW_THUMBNAIL_H */
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2012 Intel Corp.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <glib/gstdio.h>
+#include <dawati-panel/mpl-app-launches-store.h>
+
+#include "dawati-bench.h"
+
+typedef struct
+{
+  gchar               *database_file;
+  MplAppLaunchesStore *store;
+  gchar              **executables;
+  guint                n_executables;
+} BenchData;
+
+static void
+reset_store (gpointer data)
+{
+  BenchData *bench = data;
+
+  if (bench->store)
+    g_object_unref (bench->store);
+
+  g_unlink (bench->database_file);
+
+  bench->store = g_object_new (MPL_TYPE_APP_LAUNCHES_STORE,
+                               "database-file", bench->database_file,
+                               NULL);
+}
+
+static void
+insert (gpointer data)
+{
+  BenchData *bench = data;
+  GError    *error = NULL;
+  guint      i;
+
+  for (i = 0; i < bench->n_executables; i++)
+    if (!mpl_app_launches_store_add (bench->store, bench->executables[i],
+                                     1000000 + i, &error))
+      {
+        g_critical ("%s", error->message);
+        g_clear_error (&error);
+      }
+}
+
+static void
+update (gpointer data)
+{
+  BenchData *bench = data;
+  GError    *error = NULL;
+  guint      i;
+
+  for (i = 0; i < bench->n_executables; i++)
+    if (!mpl_app_launches_store_add (bench->store, bench->executables[i],
+                                     2000000 + i, &error))
+      {
+        g_critical ("%s", error->message);
+        g_clear_error (&error);
+      }
+}
+
+static void
+lookup (gpointer data)
+{
+  BenchData *bench = data;
+  GError    *error = NULL;
+  time_t     last_launched;
+  uint32_t   n_launches;
+  guint      i;
+
+  for (i = 0; i < bench->n_executables; i++)
+    {
+      mpl_app_launches_store_lookup (bench->store, bench->executables[i],
+                                     &last_launched, &n_launches, &error);
+      if (error)
+        {
+          g_critical ("%s", error->message);
+          g_clear_error (&error);
+        }
+    }
+}
+
+static void
+lookup_missing (gpointer data)
+{
+  BenchData *bench = data;
+  GError    *error = NULL;
+  gchar      executable[64];
+  guint      i;
+
+  for (i = 0; i < bench->n_executables; i++)
+    {
+      g_snprintf (executable, sizeof (executable), "/usr/bin/missing-%u", i);
+      mpl_app_launches_store_lookup (bench->store, executable,
+                                     NULL, NULL, &error);
+      if (error)
+        {
+          g_critical ("%s", error->message);
+          g_clear_error (&error);
+        }
+    }
+}
+
+int
+main (int     argc,
+      char  **argv)
+{
+  DawatiBench  bench;
+  BenchData    data = { 0, };
+  gchar       *tmpdir;
+  guint        i;
+
+  g_type_init ();
+
+  dawati_bench_init (&bench, "app-launches-store", &argc, &argv);
+
+  tmpdir = g_dir_make_tmp ("dawati-bench-XXXXXX", NULL);
+  if (!tmpdir)
+    g_error ("Could not create temporary directory");
+
+  data.database_file = g_build_filename (tmpdir, "app-launches", NULL);
+  data.n_executables = bench.size;
+  data.executables = g_new0 (gchar *, data.n_executables + 1);
+
+  for (i = 0; i < data.n_executables; i++)
+    data.executables[i] = g_strdup_printf ("/usr/bin/app-%u --arg=%u", i, i);
+
+  dawati_bench_run (&bench, "insert", data.n_executables,
+                    reset_store, insert, &data);
+
+  /* The store is left populated by the last insert run */
+  dawati_bench_run (&bench, "update", data.n_executables,
+                    NULL, update, &data);
+  dawati_bench_run (&bench, "lookup", data.n_executables,
+                    NULL, lookup, &data);
+  dawati_bench_run (&bench, "lookup-missing", data.n_executables,
+                    NULL, lookup_missing, &data);
+
+  g_object_unref (data.store);
+  g_unlink (data.database_file);
+  g_rmdir (tmpdir);
+
+  g_strfreev (data.executables);
+  g_free (data.database_file);
+  g_free (tmpdir);
+
+  return dawati_bench_finish (&bench);
+}
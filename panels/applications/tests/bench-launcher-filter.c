@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2012 Intel Corp.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <clutter/clutter.h>
+#include <mx/mx.h>
+#include "mnb-launcher-button.h"
+
+#include "dawati-bench.h"
+
+/*
+ * Needles as typed into the launcher search box: short prefixes that match
+ * many launchers, longer ones that match a few, and one that matches none.
+ */
+static const gchar *needles[] = {
+  "a", "ap", "app", "app 1", "editor", "office", "zzz"
+};
+
+static const gchar *categories[] = {
+  "Accessories", "Games", "Graphics", "Internet", "Office", "Sound & Video"
+};
+
+typedef struct
+{
+  GSList *launchers;
+} BenchData;
+
+/*
+ * Mirrors mnb_launcher_filter_cb(): match every launcher against the needle
+ * and show or hide it accordingly.
+ */
+static void
+filter (gpointer data)
+{
+  BenchData *bench = data;
+  guint      i;
+
+  for (i = 0; i < G_N_ELEMENTS (needles); i++)
+    {
+      GSList *iter;
+
+      for (iter = bench->launchers; iter; iter = iter->next)
+        {
+          MnbLauncherButton *button = MNB_LAUNCHER_BUTTON (iter->data);
+
+          if (mnb_launcher_button_match (button, needles[i]))
+            clutter_actor_show (CLUTTER_ACTOR (button));
+          else
+            clutter_actor_hide (CLUTTER_ACTOR (button));
+        }
+    }
+}
+
+/* Just the matching, without the actor visibility changes */
+static void
+match (gpointer data)
+{
+  BenchData *bench = data;
+  guint      i;
+
+  for (i = 0; i < G_N_ELEMENTS (needles); i++)
+    {
+      GSList *iter;
+
+      for (iter = bench->launchers; iter; iter = iter->next)
+        mnb_launcher_button_match (MNB_LAUNCHER_BUTTON (iter->data),
+                                   needles[i]);
+    }
+}
+
+int
+main (int     argc,
+      char  **argv)
+{
+  DawatiBench  bench;
+  BenchData    data = { NULL, };
+  gint         i;
+
+  dawati_bench_init (&bench, "launcher-filter", &argc, &argv);
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    {
+      dawati_bench_skip (&bench, "filter", "clutter_init() failed");
+      return dawati_bench_finish (&bench);
+    }
+
+  for (i = 0; i < bench.size; i++)
+    {
+      gchar    *title = g_strdup_printf ("App %d", i);
+      gchar    *description = g_strdup_printf ("%s editor number %d for the "
+                                               "office and the home",
+                                               i % 2 ? "Text" : "Image", i);
+      gchar    *executable = g_strdup_printf ("/usr/bin/app-%d", i);
+      gchar    *desktop = g_strdup_printf ("/usr/share/applications/app-%d"
+                                           ".desktop", i);
+      MxWidget *button;
+
+      button = mnb_launcher_button_new ("applications-other", BENCH_ICON, 48,
+                                        title,
+                                        categories[i % G_N_ELEMENTS (categories)],
+                                        description, executable, desktop);
+
+      data.launchers = g_slist_prepend (data.launchers,
+                                        g_object_ref_sink (button));
+
+      g_free (title);
+      g_free (description);
+      g_free (executable);
+      g_free (desktop);
+    }
+
+  /* The first run fills the lower-case caches in the buttons */
+  dawati_bench_run (&bench, "filter",
+                    bench.size * G_N_ELEMENTS (needles),
+                    NULL, filter, &data);
+  dawati_bench_run (&bench, "match",
+                    bench.size * G_N_ELEMENTS (needles),
+                    NULL, match, &data);
+
+  g_slist_free_full (data.launchers, g_object_unref);
+
+  return dawati_bench_finish (&bench);
+}
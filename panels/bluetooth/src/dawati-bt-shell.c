@@ -62,6 +62,8 @@ struct _DawatiBtShellPrivate {
   ClutterActor *add_button;
 
   GHashTable *devices;
+  GHashTable *device_states;
+  guint       sync_devices_id;
   GHashTable *requests;
 
 
@@ -99,24 +101,35 @@ _bluetooth_simple_device_free (gpointer boxed)
   g_free (obj);
 }
 
+/* What the panel last saw of a device, to tell which ones changed */
+typedef struct {
+  char     *alias;
+  gboolean  connected;
+} DawatiBtDeviceState;
+
 static void
-_remove_non_connected_device (ClutterActor *actor, DawatiBtShell *shell)
+_device_state_free (gpointer data)
+{
+  DawatiBtDeviceState *state = (DawatiBtDeviceState *) data;
+
+  g_free (state->alias);
+  g_slice_free (DawatiBtDeviceState, state);
+}
+
+static gboolean
+_remove_device (DawatiBtShell *shell, const char *device_path)
 {
   DawatiBtShellPrivate *priv = GET_PRIVATE (shell);
-  gboolean connected;
-  char *path;
+  ClutterActor *dev_widget;
 
-  g_object_get (actor,
-                "connected", &connected,
-                "device-path", &path,
-                NULL);
-  if (connected) {
-    /* clear value for next round */
-    g_object_set (actor, "connected", FALSE, NULL);
-  } else {
-    g_hash_table_remove (priv->devices, path);
-    clutter_actor_remove_child (priv->device_box, actor);
-  }
+  dev_widget = g_hash_table_lookup (priv->devices, device_path);
+  if (!dev_widget)
+    return FALSE;
+
+  clutter_actor_remove_child (priv->device_box, dev_widget);
+  g_hash_table_remove (priv->devices, device_path);
+
+  return TRUE;
 }
 
 static void
@@ -176,24 +189,31 @@ _request_response_cb (DawatiBtRequest *request,
   g_hash_table_remove (priv->requests, path);
 }
 
-static void
+/* Returns whether a widget was added or removed */
+static gboolean
 _handle_device (BluetoothSimpleDevice *device,
                 DawatiBtShell         *shell)
 {
   DawatiBtShellPrivate *priv = GET_PRIVATE (shell);
   ClutterActor *dev_widget;
 
+  if (!device->connected)
+    return _remove_device (shell, device->device_path);
+
   dev_widget = g_hash_table_lookup (priv->devices, device->device_path);
   if (dev_widget) {
-    /* update existing widget if found: non-connected  will get removed
-     * later */
     g_object_set (dev_widget,
                   "name", device->alias,
-                  "connected", device->connected,
+                  "connected", TRUE,
                   NULL);
-  } else if (device->connected) {
-    dawati_bt_shell_add_device (shell, device->alias, device->device_path);
+    return FALSE;
   }
+
+  dev_widget = dawati_bt_shell_add_device (shell, device->alias,
+                                           device->device_path);
+  g_object_set (dev_widget, "connected", TRUE, NULL);
+
+  return TRUE;
 }
 
 static void
@@ -211,24 +231,86 @@ _discoverable_cb (BluetoothApplet *applet,
   }
 }
 
-static void
-_devices_changed_cb(BluetoothApplet *applet,
-                    DawatiBtShell   *shell)
+/*
+ * Only devices whose alias or connection state changed since the last sync
+ * get their widgets touched, and the rest of the panel is only updated when
+ * a widget came or went.
+ */
+static gboolean
+_sync_devices (DawatiBtShell *shell)
 {
   DawatiBtShellPrivate *priv = GET_PRIVATE (shell);
-  GList *devices;
-  ClutterActorIter iter;
-  ClutterActor *child;
+  GList *devices, *l;
+  GHashTable *seen;
+  GHashTableIter iter;
+  gpointer key, value;
+  gboolean widgets_changed = FALSE;
+
+  priv->sync_devices_id = 0;
 
-  devices = bluetooth_applet_get_devices (applet);
-  g_list_foreach (devices, (GFunc)_handle_device, shell);
+  devices = bluetooth_applet_get_devices (priv->applet);
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (l = devices; l; l = l->next) {
+    BluetoothSimpleDevice *device = l->data;
+    DawatiBtDeviceState *state;
+
+    g_hash_table_insert (seen, device->device_path, device);
+
+    state = g_hash_table_lookup (priv->device_states, device->device_path);
+    if (state &&
+        state->connected == device->connected &&
+        g_strcmp0 (state->alias, device->alias) == 0)
+      continue;
+
+    if (!state) {
+      state = g_slice_new0 (DawatiBtDeviceState);
+      g_hash_table_insert (priv->device_states,
+                           g_strdup (device->device_path), state);
+    }
+
+    g_free (state->alias);
+    state->alias = g_strdup (device->alias);
+    state->connected = device->connected;
+
+    if (_handle_device (device, shell))
+      widgets_changed = TRUE;
+  }
+
+  /* Devices the adapter no longer knows about */
+  g_hash_table_iter_init (&iter, priv->device_states);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    if (g_hash_table_lookup (seen, key))
+      continue;
+
+    if (_remove_device (shell, key))
+      widgets_changed = TRUE;
+    g_hash_table_iter_remove (&iter);
+  }
+
+  g_hash_table_unref (seen);
   g_list_free_full (devices, _bluetooth_simple_device_free);
 
-  clutter_actor_iter_init (&iter, priv->device_box);
-  while (clutter_actor_iter_next (&iter, &child))
-    _remove_non_connected_device (child, shell);
+  if (widgets_changed)
+    dawati_bt_shell_update (shell);
 
-  dawati_bt_shell_update (shell);
+  return FALSE;
+}
+
+static void
+_devices_changed_cb(BluetoothApplet *applet,
+                    DawatiBtShell   *shell)
+{
+  DawatiBtShellPrivate *priv = GET_PRIVATE (shell);
+
+  /* Fires for every device found during discovery: sync once per frame,
+   * after whatever signals are already queued */
+  if (priv->sync_devices_id == 0)
+    priv->sync_devices_id =
+      g_idle_add_full (CLUTTER_PRIORITY_REDRAW - 1,
+                       (GSourceFunc) _sync_devices,
+                       shell,
+                       NULL);
 }
 
 static void
@@ -619,10 +701,18 @@ dawati_bt_shell_dispose (GObject *object)
     g_object_unref (priv->panel_client);
   priv->panel_client = NULL;
 
+  if (priv->sync_devices_id)
+    g_source_remove (priv->sync_devices_id);
+  priv->sync_devices_id = 0;
+
   if (priv->devices)
     g_hash_table_unref (priv->devices);
   priv->devices = NULL;
 
+  if (priv->device_states)
+    g_hash_table_unref (priv->device_states);
+  priv->device_states = NULL;
+
   if (priv->device_panelbox)
     g_object_unref (priv->device_panelbox);
   priv->device_panelbox = NULL;
@@ -664,7 +754,7 @@ dawati_bt_shell_init_applet (DawatiBtShell *shell)
 
   g_signal_connect (priv->applet, "devices-changed",
                     G_CALLBACK (_devices_changed_cb), shell);
-  _devices_changed_cb (priv->applet, shell);
+  _sync_devices (shell);
 
   g_signal_connect (priv->applet, "pincode-request",
                     G_CALLBACK (_pincode_request_cb), shell);
@@ -684,6 +774,8 @@ dawati_bt_shell_init (DawatiBtShell *shell)
 
   priv->devices = g_hash_table_new_full (g_str_hash, g_str_equal,
                                          g_free, NULL);
+  priv->device_states = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, _device_state_free);
   priv->requests = g_hash_table_new_full (g_str_hash, g_str_equal,
                                          g_free, NULL);
 
@@ -19,12 +19,31 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
+
 #include <glib/gstdio.h>
+#include <gio/gio.h>
 #include "mnp-alarm-manager.h"
 #include "mnp-alarm-utils.h"
 #include "mnp-alarm-instance.h"
 #include <gconf/gconf-client.h>
 
+#if defined (HAVE_SYS_TIMERFD_H) && !defined (TFD_TIMER_CANCEL_ON_SET)
+#define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
+
+#define ALARMS_DIR "/apps/date-time-panel"
+#define ALARMS_KEY ALARMS_DIR "/alarms"
+#define LOCALTIME_FILE "/etc/localtime"
+
 G_DEFINE_TYPE (MnpAlarmManager, mnp_alarm_manager, G_TYPE_OBJECT)
 
 #define ALARM_MANAGER_PRIVATE(o) \
@@ -34,161 +53,502 @@ typedef struct _MnpAlarmManagerPrivate MnpAlarmManagerPrivate;
 
 struct _MnpAlarmManagerPrivate
 {
+	GConfClient *client;
+	guint notify_id;
+
+	/* AlarmNode by alarm id, and a min-heap of the scheduled ones */
+	GHashTable *alarms;
+	GPtrArray *heap;
+
+	int timer_fd;
+	int timer_flags;
+	gboolean timer_failed;
+	guint timer_watch;
 	guint timeout_source;
 
-	GList *alarm_items;
-	GList *alarm_instances;
+	GFileMonitor *zone_monitor;
 };
 
+/*
+ * One per alarm in gconf. due is the wall-clock time the alarm goes off
+ * next; index is its position in the heap, or -1 if it is not going to.
+ */
+typedef struct
+{
+  MnpAlarmManager *man;
+  MnpAlarmItem *item;
+  MnpAlarmInstance *instance;
+  char *spec;
+  time_t due;
+  gint index;
+} AlarmNode;
+
 static void load_alarms (MnpAlarmManager *man);
 
 static void
-mnp_alarm_manager_dispose (GObject *object)
+heap_set (GPtrArray *heap, guint i, AlarmNode *node)
 {
-  G_OBJECT_CLASS (mnp_alarm_manager_parent_class)->dispose (object);
+  g_ptr_array_index (heap, i) = node;
+  node->index = i;
 }
 
 static void
-mnp_alarm_manager_finalize (GObject *object)
+heap_sift_up (GPtrArray *heap, guint i)
 {
-  G_OBJECT_CLASS (mnp_alarm_manager_parent_class)->finalize (object);
+  AlarmNode *node = g_ptr_array_index (heap, i);
+
+  while (i > 0) {
+	  guint parent = (i - 1) / 2;
+	  AlarmNode *p = g_ptr_array_index (heap, parent);
+
+	  if (p->due <= node->due)
+		  break;
+
+	  heap_set (heap, i, p);
+	  i = parent;
+  }
+
+  heap_set (heap, i, node);
 }
 
 static void
-mnp_alarm_manager_class_init (MnpAlarmManagerClass *klass)
+heap_sift_down (GPtrArray *heap, guint i)
 {
-  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  AlarmNode *node = g_ptr_array_index (heap, i);
 
-  g_type_class_add_private (klass, sizeof (MnpAlarmManagerPrivate));
+  while (TRUE) {
+	  guint child = 2 * i + 1;
+	  AlarmNode *c;
 
-  object_class->dispose = mnp_alarm_manager_dispose;
-  object_class->finalize = mnp_alarm_manager_finalize;
+	  if (child >= heap->len)
+		  break;
+
+	  if (child + 1 < heap->len &&
+	      ((AlarmNode *)g_ptr_array_index (heap, child + 1))->due <
+	      ((AlarmNode *)g_ptr_array_index (heap, child))->due)
+		  child++;
+
+	  c = g_ptr_array_index (heap, child);
+	  if (node->due <= c->due)
+		  break;
+
+	  heap_set (heap, i, c);
+	  i = child;
+  }
+
+  heap_set (heap, i, node);
 }
 
 static void
-mnp_alarm_manager_init (MnpAlarmManager *self)
+heap_insert (GPtrArray *heap, AlarmNode *node)
 {
+  g_ptr_array_add (heap, node);
+  heap_sift_up (heap, heap->len - 1);
 }
 
 static void
-alarms_changed (GConfClient *client,
-		guint cnxn_id,
-		GConfEntry *entry,
-		gpointer user_data)
+heap_remove (GPtrArray *heap, AlarmNode *node)
 {
-	MnpAlarmManager *alarms = (MnpAlarmManager *)user_data;
+  guint i = node->index;
+  AlarmNode *last;
 
-	load_alarms(alarms);
+  last = g_ptr_array_remove_index (heap, heap->len - 1);
+  node->index = -1;
+
+  if (last != node) {
+	  heap_set (heap, i, last);
+	  heap_sift_up (heap, i);
+	  heap_sift_down (heap, last->index);
+  }
 }
 
-int
-instance_sort_func (MnpAlarmInstance *a1, MnpAlarmInstance *a2, gpointer not_used)
+static void
+alarm_node_free (AlarmNode *node)
+{
+  MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(node->man);
+
+  if (node->index >= 0)
+	  heap_remove (priv->heap, node);
+
+  g_signal_handlers_disconnect_matched (node->instance,
+					G_SIGNAL_MATCH_DATA,
+					0, 0, NULL, NULL, node);
+  g_object_unref (node->instance);
+  g_free (node->item);
+  g_free (node->spec);
+  g_slice_free (AlarmNode, node);
+}
+
+/* The instance must already have been worked out against now */
+static void
+alarm_node_schedule (AlarmNode *node, time_t now)
 {
-  time_t t1, t2;
+  MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(node->man);
+  time_t secs;
+
+  if (node->index >= 0)
+	  heap_remove (priv->heap, node);
+
+  /* One-off alarm whose time has already passed */
+  secs = mnp_alarm_instance_get_time (node->instance);
+  if (secs <= 0)
+	  return;
+
+  node->due = now + secs;
+  heap_insert (priv->heap, node);
+}
+
+static gboolean dispatch_alarms (MnpAlarmManager *man);
+
+#ifdef HAVE_SYS_TIMERFD_H
+static gboolean
+timer_fd_cb (GIOChannel *source, GIOCondition condition, MnpAlarmManager *man);
+#endif
+
+/*
+ * Arm the timer for the soonest alarm. The timerfd works on the wall clock,
+ * so it still goes off at the right time after a suspend, and it is
+ * cancelled if the clock is set; the relative timeout is only a fallback.
+ */
+static void
+rearm_timer (MnpAlarmManager *man)
+{
+  MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(man);
+  AlarmNode *next = NULL;
+
+  if (priv->heap->len)
+	  next = g_ptr_array_index (priv->heap, 0);
+
+#ifdef HAVE_SYS_TIMERFD_H
+  if (priv->timer_fd < 0 && !priv->timer_failed) {
+	  priv->timer_fd = timerfd_create (CLOCK_REALTIME,
+					   TFD_CLOEXEC | TFD_NONBLOCK);
+
+	  if (priv->timer_fd >= 0) {
+		  GIOChannel *channel = g_io_channel_unix_new (priv->timer_fd);
+
+		  priv->timer_watch = g_io_add_watch (channel, G_IO_IN,
+						      (GIOFunc)timer_fd_cb, man);
+		  g_io_channel_unref (channel);
+	  } else {
+		  g_warning ("Unable to create alarm timer: %s",
+			     g_strerror (errno));
+		  priv->timer_failed = TRUE;
+	  }
+  }
 
-  t1 = mnp_alarm_instance_get_time(a1);
-  t2 = mnp_alarm_instance_get_time(a2);
+  if (priv->timer_fd >= 0) {
+	  struct itimerspec spec;
+	  int ret;
+
+	  memset (&spec, 0, sizeof (spec));
+
+	  /* An all-zero value disarms it */
+	  if (next)
+		  spec.it_value.tv_sec = next->due;
+
+	  ret = timerfd_settime (priv->timer_fd, priv->timer_flags,
+				 &spec, NULL);
+
+	  /*
+	   * Kernels before 3.0 reject TFD_TIMER_CANCEL_ON_SET; do without it,
+	   * clock changes then only get noticed when the alarm goes off.
+	   */
+	  if (ret < 0 && errno == EINVAL &&
+	      (priv->timer_flags & TFD_TIMER_CANCEL_ON_SET)) {
+		  priv->timer_flags &= ~TFD_TIMER_CANCEL_ON_SET;
+		  ret = timerfd_settime (priv->timer_fd, priv->timer_flags,
+					 &spec, NULL);
+	  }
+
+	  if (ret == 0) {
+		  if (next)
+			  g_debug ("Wake up at %s", ctime (&next->due));
+		  return;
+	  }
+
+	  /* Use the timeout from now on */
+	  g_warning ("Unable to set alarm timer: %s", g_strerror (errno));
+	  priv->timer_failed = TRUE;
+
+	  g_source_remove (priv->timer_watch);
+	  priv->timer_watch = 0;
+	  close (priv->timer_fd);
+	  priv->timer_fd = -1;
+  }
+#endif
+
+  if (priv->timeout_source) {
+	  g_source_remove (priv->timeout_source);
+	  priv->timeout_source = 0;
+  }
 
-  return t1-t2;
+  if (next) {
+	  time_t now = time (NULL);
+
+	  priv->timeout_source =
+		  g_timeout_add_seconds (next->due > now ? next->due - now : 0,
+					 (GSourceFunc)dispatch_alarms, man);
+	  g_debug ("Wake up at %s", ctime (&next->due));
+  }
+}
+
+/* Work every alarm out again, for when the clock or the timezone changed */
+static void
+reschedule_all (MnpAlarmManager *man)
+{
+  MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(man);
+  time_t now = time (NULL);
+  GHashTableIter iter;
+  AlarmNode *node;
+
+  g_hash_table_iter_init (&iter, priv->alarms);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&node)) {
+	  mnp_alarm_instance_remanipulate (node->instance, now);
+	  alarm_node_schedule (node, now);
+  }
+
+  rearm_timer (man);
 }
 
 static gboolean
-mnp_alarm_handler(MnpAlarmManager *man)
+dispatch_alarms (MnpAlarmManager *man)
 {
   MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(man);
-  MnpAlarmInstance *alarm = (MnpAlarmInstance *) priv->alarm_instances->data;
+  time_t now = time (NULL);
+
   priv->timeout_source = 0;
 
-  mnp_alarm_instance_raise (alarm);
-  
+  /*
+   * Repeating alarms put themselves back in the heap from alarm-changed;
+   * one-off ones are deleted from gconf and go on the next reload.
+   */
+  while (priv->heap->len) {
+	  AlarmNode *node = g_ptr_array_index (priv->heap, 0);
+
+	  if (node->due > now)
+		  break;
+
+	  heap_remove (priv->heap, node);
+	  mnp_alarm_instance_raise (node->instance);
+  }
+
+  rearm_timer (man);
+
   return FALSE;
 }
 
-static void
-alarm_changed (MnpAlarmInstance *alarm, MnpAlarmManager *man)
+#ifdef HAVE_SYS_TIMERFD_H
+static gboolean
+timer_fd_cb (GIOChannel *source, GIOCondition condition, MnpAlarmManager *man)
 {
   MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(man);
-  time_t now = time(NULL);
-  GList *tmp = priv->alarm_instances;
+  guint64 expirations;
+
+  if (read (priv->timer_fd, &expirations, sizeof (expirations)) < 0) {
+	  if (errno == ECANCELED)
+		  reschedule_all (man);
 
-  while(tmp) {
-	  mnp_alarm_instance_remanipulate ((MnpAlarmInstance *)tmp->data, now);
-	  tmp = tmp->next;
+	  return TRUE;
   }
 
-  priv->alarm_instances = g_list_sort_with_data (priv->alarm_instances, (GCompareDataFunc)instance_sort_func, NULL);
+  dispatch_alarms (man);
+
+  return TRUE;
+}
+#endif
 
-  if (priv->timeout_source)
-	  g_source_remove(priv->timeout_source);
+static void
+zone_changed (GFileMonitor *monitor,
+	      GFile *file,
+	      GFile *other_file,
+	      GFileMonitorEvent event,
+	      MnpAlarmManager *man)
+{
+  if (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+      event != G_FILE_MONITOR_EVENT_CREATED &&
+      event != G_FILE_MONITOR_EVENT_DELETED)
+	  return;
 
-  priv->timeout_source = g_timeout_add_seconds(mnp_alarm_instance_get_time((MnpAlarmInstance *)priv->alarm_instances->data), (GSourceFunc)mnp_alarm_handler, man);
-  now += mnp_alarm_instance_get_time((MnpAlarmInstance *)priv->alarm_instances->data);
-  printf("\nRemanipulated: Wake up at %s", ctime(&now));
+  tzset ();
+  reschedule_all (man);
 }
 
+static void
+mnp_alarm_manager_dispose (GObject *object)
+{
+  MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(object);
+
+  if (priv->client) {
+	  if (priv->notify_id)
+		  gconf_client_notify_remove (priv->client, priv->notify_id);
+	  priv->notify_id = 0;
+
+	  g_object_unref (priv->client);
+	  priv->client = NULL;
+  }
+
+  if (priv->zone_monitor) {
+	  g_file_monitor_cancel (priv->zone_monitor);
+	  g_object_unref (priv->zone_monitor);
+	  priv->zone_monitor = NULL;
+  }
+
+  if (priv->timer_watch) {
+	  g_source_remove (priv->timer_watch);
+	  priv->timer_watch = 0;
+  }
+
+  if (priv->timer_fd >= 0) {
+	  close (priv->timer_fd);
+	  priv->timer_fd = -1;
+  }
+
+  if (priv->timeout_source) {
+	  g_source_remove (priv->timeout_source);
+	  priv->timeout_source = 0;
+  }
+
+  if (priv->alarms) {
+	  g_hash_table_unref (priv->alarms);
+	  priv->alarms = NULL;
+  }
+
+  G_OBJECT_CLASS (mnp_alarm_manager_parent_class)->dispose (object);
+}
+
+static void
+mnp_alarm_manager_finalize (GObject *object)
+{
+  MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(object);
+
+  g_ptr_array_free (priv->heap, TRUE);
+
+  G_OBJECT_CLASS (mnp_alarm_manager_parent_class)->finalize (object);
+}
+
+static void
+mnp_alarm_manager_class_init (MnpAlarmManagerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (MnpAlarmManagerPrivate));
+
+  object_class->dispose = mnp_alarm_manager_dispose;
+  object_class->finalize = mnp_alarm_manager_finalize;
+}
+
+static void
+mnp_alarm_manager_init (MnpAlarmManager *self)
+{
+  MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(self);
+
+  priv->alarms = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					NULL, (GDestroyNotify)alarm_node_free);
+  priv->heap = g_ptr_array_new ();
+  priv->timer_fd = -1;
+#ifdef HAVE_SYS_TIMERFD_H
+  priv->timer_flags = TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET;
+#endif
+}
+
+static void
+alarms_changed (GConfClient *client,
+		guint cnxn_id,
+		GConfEntry *entry,
+		gpointer user_data)
+{
+	MnpAlarmManager *alarms = (MnpAlarmManager *)user_data;
+
+	load_alarms(alarms);
+}
+
+static void
+alarm_changed (MnpAlarmInstance *alarm, AlarmNode *node)
+{
+  time_t now = time(NULL);
+
+  mnp_alarm_instance_remanipulate (alarm, now);
+  alarm_node_schedule (node, now);
+  rearm_timer (node->man);
+}
+
+/*
+ * Alarms are matched to what is already loaded by id; only the ones whose
+ * gconf string changed, or that are new or gone, are touched.
+ */
 static void
 load_alarms (MnpAlarmManager *man)
 {
-  GConfClient *client;
   GSList *alarms, *tmp;
-  MnpAlarmItem *item;
   MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(man);
   time_t now = time(NULL);
+  GHashTable *seen;
+  GHashTableIter iter;
+  gpointer key;
 
-  client = gconf_client_get_default();
-  
-  if (priv->alarm_items) {
-	  g_list_foreach (priv->alarm_items, (GFunc)g_free, NULL);
-	  g_list_free(priv->alarm_items);
-	  priv->alarm_items = NULL;
-	  g_list_foreach (priv->alarm_instances, (GFunc)g_object_unref, NULL);
-	  g_list_free(priv->alarm_instances);
-	  priv->alarm_instances = NULL;
-	  g_source_remove(priv->timeout_source);
-
-  } else {
-  	gconf_client_add_dir (client, "/apps/date-time-panel", GCONF_CLIENT_PRELOAD_ONELEVEL, NULL);
-  	gconf_client_notify_add (client, "/apps/date-time-panel/alarms", alarms_changed, man, NULL, NULL);
-  }
-  
-  alarms = gconf_client_get_list (client,"/apps/date-time-panel/alarms", GCONF_VALUE_STRING, NULL);
-  tmp = alarms;
-  while(tmp) {
+  alarms = gconf_client_get_list (priv->client, ALARMS_KEY, GCONF_VALUE_STRING, NULL);
+  seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (tmp = alarms; tmp; tmp = tmp->next) {
 	char *data = (char *)tmp->data;
-	MnpAlarmInstance *instance;
+	MnpAlarmItem *item;
+	AlarmNode *node;
 
 	item = g_new0(MnpAlarmItem, 1);
 	sscanf(data, "%d %d %d %d %d %d %d %d", &item->id, &item->on_off, &item->hour, &item->minute, &item->am_pm, &item->repeat, &item->snooze, &item->sound);
-	priv->alarm_items = g_list_append(priv->alarm_items, item);
-
-	instance = mnp_alarm_instance_new (item, now);
-	g_signal_connect (instance, "alarm-changed", G_CALLBACK(alarm_changed), man);
-	priv->alarm_instances = g_list_insert_sorted_with_data(priv->alarm_instances, instance, (GCompareDataFunc)instance_sort_func, NULL);
+	g_hash_table_insert (seen, GINT_TO_POINTER (item->id), NULL);
+
+	node = g_hash_table_lookup (priv->alarms, GINT_TO_POINTER (item->id));
+	if (node && g_strcmp0 (node->spec, data) == 0) {
+		g_free (item);
+		continue;
+	}
+
+	node = g_slice_new0 (AlarmNode);
+	node->man = man;
+	node->item = item;
+	node->spec = g_strdup (data);
+	node->index = -1;
+	node->instance = mnp_alarm_instance_new (item, now);
+	g_signal_connect (node->instance, "alarm-changed", G_CALLBACK(alarm_changed), node);
+
+	/* Replaces, and frees, the old node for this id */
+	g_hash_table_insert (priv->alarms, GINT_TO_POINTER (item->id), node);
+	alarm_node_schedule (node, now);
+  }
 
-	tmp = tmp->next;
+  g_hash_table_iter_init (&iter, priv->alarms);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+	  if (!g_hash_table_lookup_extended (seen, key, NULL, NULL))
+		  g_hash_table_iter_remove (&iter);
   }
 
+  g_hash_table_unref (seen);
   g_slist_foreach(alarms, (GFunc)g_free, NULL);
   g_slist_free(alarms);
-  g_object_unref(client);
 
-  priv->timeout_source = g_timeout_add_seconds(mnp_alarm_instance_get_time((MnpAlarmInstance *)priv->alarm_instances->data), (GSourceFunc)mnp_alarm_handler, man);
-  now += mnp_alarm_instance_get_time((MnpAlarmInstance *)priv->alarm_instances->data);
-  printf("\nWake up at %s", ctime(&now));
+  rearm_timer (man);
 }
 
 static void
 mnp_alarm_manager_construct (MnpAlarmManager *man)
 {
   MnpAlarmManagerPrivate *priv = ALARM_MANAGER_PRIVATE(man);
+  GFile *zone;
 
-  /* init */
-  priv->alarm_items = NULL;
-  priv->alarm_instances = NULL;
-  priv->timeout_source = 0;
+  priv->client = gconf_client_get_default();
+  gconf_client_add_dir (priv->client, ALARMS_DIR, GCONF_CLIENT_PRELOAD_ONELEVEL, NULL);
+  priv->notify_id = gconf_client_notify_add (priv->client, ALARMS_KEY, alarms_changed, man, NULL, NULL);
 
-  load_alarms(man);
+  /* The alarms are in local time, so a new timezone moves them all */
+  zone = g_file_new_for_path (LOCALTIME_FILE);
+  priv->zone_monitor = g_file_monitor_file (zone, G_FILE_MONITOR_NONE, NULL, NULL);
+  if (priv->zone_monitor)
+	  g_signal_connect (priv->zone_monitor, "changed", G_CALLBACK(zone_changed), man);
+  g_object_unref (zone);
 
+  load_alarms(man);
 }
 
 MnpAlarmManager*
@@ -33,14 +33,34 @@ enum {
   PROP_FPS
 };
 
+/*
+ * All frames of an animation decoded into one texture, with a sub-texture
+ * per frame. Shared by every icon that loads the same directory, and kept
+ * around for the life of the process so that an animation which starts
+ * again does not decode and upload the frames again.
+ */
+struct _MpdBatteryIconFrames
+{
+  unsigned int   ref_count;
+  char          *path;
+  CoglHandle     atlas;
+  unsigned int   n_frames;
+  CoglHandle    *frames;
+};
+
 typedef struct
 {
   unsigned int fps;
 
   /* Only while animating. */
-  GList const *iter;
+  MpdBatteryIconFrames  *frames;
+  ClutterTimeline       *timeline;
+  int                    current_frame;
 } MpdBatteryIconPrivate;
 
+/* path -> frames; holds a reference of its own, nothing is ever evicted */
+static GHashTable *_frames_cache = NULL;
+
 static void
 _get_property (GObject      *object,
                unsigned int  property_id,
@@ -74,17 +94,63 @@ _set_property (GObject      *object,
   }
 }
 
+static void
+stop_animation (MpdBatteryIcon *self)
+{
+  MpdBatteryIconPrivate *priv = GET_PRIVATE (self);
+
+  if (priv->timeline)
+  {
+    clutter_timeline_stop (priv->timeline);
+    g_object_unref (priv->timeline);
+    priv->timeline = NULL;
+  }
+
+  if (priv->frames)
+  {
+    mpd_battery_icon_frames_unref (priv->frames);
+    priv->frames = NULL;
+  }
+}
+
 static void
 _dispose (GObject *object)
 {
+  stop_animation (MPD_BATTERY_ICON (object));
+
   G_OBJECT_CLASS (mpd_battery_icon_parent_class)->dispose (object);
 }
 
+/* No point waking up for frames nobody sees. */
+
+static void
+_map (ClutterActor *actor)
+{
+  MpdBatteryIconPrivate *priv = GET_PRIVATE (actor);
+
+  CLUTTER_ACTOR_CLASS (mpd_battery_icon_parent_class)->map (actor);
+
+  if (priv->timeline)
+    clutter_timeline_start (priv->timeline);
+}
+
+static void
+_unmap (ClutterActor *actor)
+{
+  MpdBatteryIconPrivate *priv = GET_PRIVATE (actor);
+
+  if (priv->timeline)
+    clutter_timeline_pause (priv->timeline);
+
+  CLUTTER_ACTOR_CLASS (mpd_battery_icon_parent_class)->unmap (actor);
+}
+
 static void
 mpd_battery_icon_class_init (MpdBatteryIconClass *klass)
 {
-  GObjectClass *object_class = G_OBJECT_CLASS (klass);
-  GParamFlags   param_flags;
+  GObjectClass      *object_class = G_OBJECT_CLASS (klass);
+  ClutterActorClass *actor_class = CLUTTER_ACTOR_CLASS (klass);
+  GParamFlags        param_flags;
 
   g_type_class_add_private (klass, sizeof (MpdBatteryIconPrivate));
 
@@ -92,6 +158,9 @@ mpd_battery_icon_class_init (MpdBatteryIconClass *klass)
   object_class->set_property = _set_property;
   object_class->dispose = _dispose;
 
+  actor_class->map = _map;
+  actor_class->unmap = _unmap;
+
   /* Properties */
 
   param_flags = G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS;
@@ -140,53 +209,224 @@ mpd_battery_icon_set_fps (MpdBatteryIcon *self,
   if (fps != priv->fps)
   {
     priv->fps = fps;
+
+    if (priv->timeline)
+      clutter_timeline_set_duration (priv->timeline,
+                                     priv->frames->n_frames * 1000 / fps);
+
     g_object_notify (G_OBJECT (self), "fps");
   }
 }
 
-static bool
-render_frame (MpdBatteryIcon *self)
+static void
+render_frame (MpdBatteryIcon  *self,
+              int              frame)
 {
   MpdBatteryIconPrivate *priv = GET_PRIVATE (self);
 
-  /* At last frame? */
-  if (NULL == priv->iter)
-    return false;
+  if (frame == priv->current_frame)
+    return;
 
+  priv->current_frame = frame;
   clutter_texture_set_cogl_texture (CLUTTER_TEXTURE (self),
-                                    (CoglHandle) priv->iter->data);
+                                    priv->frames->frames[frame]);
+}
 
-  priv->iter = priv->iter->next;
-  return true;
+static void
+_timeline_new_frame_cb (ClutterTimeline *timeline,
+                        int              msecs,
+                        MpdBatteryIcon  *self)
+{
+  MpdBatteryIconPrivate *priv = GET_PRIVATE (self);
+  unsigned int frame;
+
+  frame = msecs * priv->fps / 1000;
+  render_frame (self, MIN (frame, priv->frames->n_frames - 1));
 }
 
-static bool
-_next_frame_cb (MpdBatteryIcon  *self)
+static void
+_timeline_completed_cb (ClutterTimeline *timeline,
+                        MpdBatteryIcon  *self)
 {
-  return render_frame (self);
+  MpdBatteryIconPrivate *priv = GET_PRIVATE (self);
+
+  /* Stay on the last frame. */
+  render_frame (self, priv->frames->n_frames - 1);
+  stop_animation (self);
 }
 
+/*
+ * Plays the frames once, in step with the stage's master clock. Playback
+ * is paused while the icon is not mapped.
+ */
 void
-mpd_battery_icon_animate (MpdBatteryIcon  *self,
-                          GList           *frames)
+mpd_battery_icon_animate (MpdBatteryIcon        *self,
+                          MpdBatteryIconFrames  *frames)
 {
   MpdBatteryIconPrivate *priv = GET_PRIVATE (self);
 
-  priv->iter = frames;
-  render_frame (self);
-  g_timeout_add (1000 / priv->fps, (GSourceFunc) _next_frame_cb, self);
+  g_return_if_fail (MPD_IS_BATTERY_ICON (self));
+  g_return_if_fail (frames);
+
+  mpd_battery_icon_frames_ref (frames);
+  stop_animation (self);
+  priv->frames = frames;
+
+  priv->current_frame = -1;
+  render_frame (self, 0);
+
+  priv->timeline = clutter_timeline_new (frames->n_frames * 1000 / priv->fps);
+  g_signal_connect (priv->timeline, "new-frame",
+                    G_CALLBACK (_timeline_new_frame_cb), self);
+  g_signal_connect (priv->timeline, "completed",
+                    G_CALLBACK (_timeline_completed_cb), self);
+
+  if (CLUTTER_ACTOR_IS_MAPPED (self))
+    clutter_timeline_start (priv->timeline);
+}
+
+static void
+_frames_free (MpdBatteryIconFrames *frames)
+{
+  unsigned int i;
+
+  for (i = 0; i < frames->n_frames; i++)
+    cogl_handle_unref (frames->frames[i]);
+  g_free (frames->frames);
+
+  if (frames->atlas)
+    cogl_handle_unref (frames->atlas);
+
+  g_free (frames->path);
+  g_slice_free (MpdBatteryIconFrames, frames);
+}
+
+MpdBatteryIconFrames *
+mpd_battery_icon_frames_ref (MpdBatteryIconFrames *frames)
+{
+  frames->ref_count++;
+
+  return frames;
 }
 
-GList *
+void
+mpd_battery_icon_frames_unref (MpdBatteryIconFrames *frames)
+{
+  if (--frames->ref_count > 0)
+    return;
+
+  _frames_free (frames);
+}
+
+/*
+ * Frames are packed into a roughly square grid, so the atlas stays within
+ * the maximum texture size for any reasonable number of them.
+ */
+static bool
+pack_frames (MpdBatteryIconFrames  *frames,
+             GList const           *pixbufs,
+             GError               **error)
+{
+  GdkPixbuf    *first = GDK_PIXBUF (pixbufs->data);
+  GdkPixbuf    *atlas;
+  GList const  *iter;
+  int           width = gdk_pixbuf_get_width (first);
+  int           height = gdk_pixbuf_get_height (first);
+  unsigned int  columns;
+  unsigned int  rows;
+  unsigned int  i;
+
+  for (columns = 1; columns * columns < frames->n_frames; columns++)
+    ;
+  rows = (frames->n_frames + columns - 1) / columns;
+
+  atlas = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                          columns * width, rows * height);
+  if (NULL == atlas)
+  {
+    g_set_error (error, GDK_PIXBUF_ERROR,
+                 GDK_PIXBUF_ERROR_INSUFFICIENT_MEMORY,
+                 "Could not allocate %u frame atlas", frames->n_frames);
+    return false;
+  }
+  gdk_pixbuf_fill (atlas, 0);
+
+  for (iter = pixbufs, i = 0; iter; iter = iter->next, i++)
+  {
+    GdkPixbuf *pixbuf = GDK_PIXBUF (iter->data);
+
+    if (gdk_pixbuf_get_width (pixbuf) != width ||
+        gdk_pixbuf_get_height (pixbuf) != height)
+    {
+      g_set_error (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_FAILED,
+                   "Frames in %s differ in size", frames->path);
+      g_object_unref (atlas);
+      return false;
+    }
+
+    /* Compositing onto a clear atlas also adds alpha where it is missing. */
+    gdk_pixbuf_composite (pixbuf, atlas,
+                          (i % columns) * width, (i / columns) * height,
+                          width, height,
+                          (i % columns) * width, (i / columns) * height,
+                          1.0, 1.0, GDK_INTERP_NEAREST, 0xff);
+  }
+
+  frames->atlas = cogl_texture_new_from_data (gdk_pixbuf_get_width (atlas),
+                                              gdk_pixbuf_get_height (atlas),
+                                              COGL_TEXTURE_NO_ATLAS,
+                                              COGL_PIXEL_FORMAT_RGBA_8888,
+                                              COGL_PIXEL_FORMAT_ANY,
+                                              gdk_pixbuf_get_rowstride (atlas),
+                                              gdk_pixbuf_get_pixels (atlas));
+  g_object_unref (atlas);
+
+  if (COGL_INVALID_HANDLE == frames->atlas)
+  {
+    g_set_error (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_FAILED,
+                 "Could not create texture for %s", frames->path);
+    return false;
+  }
+
+  frames->frames = g_new0 (CoglHandle, frames->n_frames);
+  for (i = 0; i < frames->n_frames; i++)
+  {
+    frames->frames[i] =
+      cogl_texture_new_from_sub_texture (frames->atlas,
+                                         (i % columns) * width,
+                                         (i / columns) * height,
+                                         width, height);
+  }
+
+  return true;
+}
+
+/*
+ * Returns the frames in path, in file name order, or NULL on error. The
+ * result is cached for the life of the process and shared with other
+ * callers that load the same path; release it with
+ * mpd_battery_icon_frames_unref().
+ */
+MpdBatteryIconFrames *
 mpd_battery_icon_load_frames_from_dir (char const  *path,
                                        GError     **error)
 {
-  GDir        *dir;
-  char const  *entry;
-  GList       *files = NULL;
-  GList       *frames = NULL;
-  CoglHandle   handle = COGL_INVALID_HANDLE;
-  GList const *files_iter;
+  MpdBatteryIconFrames  *frames;
+  GDir                  *dir;
+  char const            *entry;
+  GList                 *files = NULL;
+  GList                 *pixbufs = NULL;
+  GList const           *files_iter;
+  bool                   ok = true;
+
+  if (_frames_cache)
+  {
+    frames = g_hash_table_lookup (_frames_cache, path);
+    if (frames)
+      return mpd_battery_icon_frames_ref (frames);
+  } else {
+    _frames_cache = g_hash_table_new (g_str_hash, g_str_equal);
+  }
 
   dir = g_dir_open (path, 0, error);
   if (NULL == dir)
@@ -203,41 +443,54 @@ mpd_battery_icon_load_frames_from_dir (char const  *path,
       files = g_list_prepend (files, filename);
     }
   }
-  files = g_list_reverse (files);
+  g_dir_close (dir);
   files = g_list_sort (files, (GCompareFunc) g_strcmp0);
 
-  /* Load textures */
+  /* Decode images */
   for (files_iter = files;
-       files_iter;
+       files_iter && ok;
        files_iter = files_iter->next)
   {
-    handle = cogl_texture_new_from_file ((char *) files_iter->data,
-                                         COGL_TEXTURE_NO_ATLAS,
-                                         COGL_PIXEL_FORMAT_ANY,
-                                         error);
-    if (COGL_INVALID_HANDLE == handle)
-    {
-      break;
-    } else
-    {
-      /* List takes reference. */
-      frames = g_list_prepend (frames, handle);
-    }
+    GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file ((char *) files_iter->data,
+                                                  error);
+    if (NULL == pixbuf)
+      ok = false;
+    else
+      pixbufs = g_list_prepend (pixbufs, pixbuf);
   }
+  pixbufs = g_list_reverse (pixbufs);
+
+  g_list_foreach (files, (GFunc) g_free, NULL);
+  g_list_free (files);
 
-  if (COGL_INVALID_HANDLE == handle)
+  if (ok && NULL == pixbufs)
   {
-    /* Clean up after error. */
-    g_list_foreach (frames, (GFunc) cogl_handle_unref, NULL);
-    g_list_free (frames);
-    frames = NULL;
-  } else {
-    frames = g_list_reverse (frames);
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                 "No frames in %s", path);
+    ok = false;
   }
 
-  g_list_foreach (files, (GFunc) g_free, NULL);
-  g_list_free (files);
+  frames = NULL;
+  if (ok)
+  {
+    frames = g_slice_new0 (MpdBatteryIconFrames);
+    frames->ref_count = 1;
+    frames->path = g_strdup (path);
+    frames->n_frames = g_list_length (pixbufs);
+
+    if (pack_frames (frames, pixbufs, error))
+    {
+      g_hash_table_insert (_frames_cache, frames->path,
+                           mpd_battery_icon_frames_ref (frames));
+    } else {
+      /* Clean up after error. */
+      _frames_free (frames);
+      frames = NULL;
+    }
+  }
+
+  g_list_foreach (pixbufs, (GFunc) g_object_unref, NULL);
+  g_list_free (pixbufs);
 
   return frames;
 }
-
@@ -53,6 +53,8 @@ typedef struct
   ClutterTextureClass parent;
 } MpdBatteryIconClass;
 
+typedef struct _MpdBatteryIconFrames MpdBatteryIconFrames;
+
 GType
 mpd_battery_icon_get_type (void);
 
@@ -67,13 +69,19 @@ mpd_battery_icon_set_fps (MpdBatteryIcon *self,
                           unsigned int    fps);
 
 void
-mpd_battery_icon_animate (MpdBatteryIcon  *self,
-                          GList           *frames);
+mpd_battery_icon_animate (MpdBatteryIcon        *self,
+                          MpdBatteryIconFrames  *frames);
 
-GList *
+MpdBatteryIconFrames *
 mpd_battery_icon_load_frames_from_dir (char const  *path,
                                        GError     **error);
 
+MpdBatteryIconFrames *
+mpd_battery_icon_frames_ref (MpdBatteryIconFrames *frames);
+
+void
+mpd_battery_icon_frames_unref (MpdBatteryIconFrames *frames);
+
 G_END_DECLS
 
 #endif /* MPD_BATTERY_ICON_H */
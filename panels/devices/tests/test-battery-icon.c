@@ -27,8 +27,8 @@
 
 typedef struct
 {
-  ClutterActor  *icon;
-  GList         *frames;
+  ClutterActor          *icon;
+  MpdBatteryIconFrames  *frames;
 } TestBatteryIcon;
 
 static void
@@ -93,8 +93,7 @@ main (int     argc,
   clutter_actor_show_all (stage);
   clutter_main ();
 
-  g_list_foreach (app.frames, (GFunc) cogl_handle_unref, NULL);
-  g_list_free (app.frames);
+  mpd_battery_icon_frames_unref (app.frames);
 
   return EXIT_SUCCESS;
 }
@@ -108,3 +108,25 @@ dawati_home_plugins_app_get_configuration (DawatiHomePluginsApp *self)
 
   g_return_val_if_reached (NULL);
 }
+
+/**
+ * dawati_home_plugins_app_set_active:
+ * @self: ourselves
+ * @active: whether the widget is currently visible
+ *
+ * Called when the widget scrolls in or out of view. Implementations should
+ * stop any timers, animations or polling while inactive. Optional.
+ */
+void
+dawati_home_plugins_app_set_active (DawatiHomePluginsApp *self,
+    gboolean active)
+{
+  DawatiHomePluginsAppInterface *iface;
+
+  g_return_if_fail (DAWATI_IS_HOME_APP_PLUGIN (self));
+
+  iface = DAWATI_HOME_APP_PLUGIN_GET_IFACE (self);
+
+  if (iface->set_active != NULL)
+    iface->set_active (self, active);
+}
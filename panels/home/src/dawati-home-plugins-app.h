@@ -46,6 +46,7 @@ struct _DawatiHomePluginsAppInterface
   void (* deinit) (DawatiHomePluginsApp *self);
   ClutterActor * (* get_widget) (DawatiHomePluginsApp *self);
   ClutterActor * (* get_configuration) (DawatiHomePluginsApp *self);
+  void (* set_active) (DawatiHomePluginsApp *self, gboolean active);
 };
 
 GType dawati_home_plugins_app_get_type (void) G_GNUC_CONST;
@@ -54,6 +55,8 @@ void dawati_home_plugins_app_init (DawatiHomePluginsApp *self);
 void dawati_home_plugins_app_deinit (DawatiHomePluginsApp *self);
 ClutterActor *dawati_home_plugins_app_get_widget (DawatiHomePluginsApp *self);
 ClutterActor *dawati_home_plugins_app_get_configuration (DawatiHomePluginsApp *self);
+void dawati_home_plugins_app_set_active (DawatiHomePluginsApp *self,
+    gboolean active);
 
 G_END_DECLS
 
@@ -19,6 +19,7 @@
  */
 
 #include <locale.h>
+#include <signal.h>
 #include <glib/gi18n.h>
 
 #include <clutter/clutter.h>
@@ -69,6 +70,10 @@ main (int    argc,
   bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
   textdomain (GETTEXT_PACKAGE);
 
+  /* isolated widgets run in helpers we write to over a pipe; one dying under
+   * a write mustn't take the panel along */
+  signal (SIGPIPE, SIG_IGN);
+
   context = g_option_context_new ("- mutter-dawati home panel");
   g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
   g_option_context_add_group (context, clutter_get_option_group_without_init ());
@@ -17,9 +17,12 @@
  * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <stdio.h>
 #include <string.h>
 
+#include <gio/gunixinputstream.h>
 #include <clutter/clutter.h>
+#include <clutter/x11/clutter-x11.h>
 #include <mx/mx.h>
 
 #include "mnb-home-plugins-engine.h"
@@ -33,6 +36,237 @@
 /* size of a tile */
 #define TILE_SIZE ((GRID_SQUARE + BORDER_PADDING) * 2)
 
+static gboolean embedded = FALSE;
+static gchar *settings_path = NULL;
+
+static GOptionEntry entries[] = {
+  { "embedded", 'e', 0, G_OPTION_ARG_NONE, &embedded,
+    "Render the widget offscreen for the home panel and print its window", NULL },
+  { "settings-path", 's', 0, G_OPTION_ARG_STRING, &settings_path,
+    "GSettings path of the widget", "PATH" },
+  { NULL }
+};
+
+/*
+ * Isolation mode of the home panel: only the widget is shown, in an
+ * override-redirect window placed off-screen. The panel redirects it and
+ * paints its pixmap, so the window id is all it needs from us. In return it
+ * sends us commands on stdin, one per line: "edit" and "view" switch
+ * between the configuration and the widget, and the pointer events it gets
+ * on its texture come as "button-press X Y BUTTON", "button-release X Y
+ * BUTTON", "motion X Y" and "scroll X Y DIRECTION", in window coordinates.
+ */
+typedef struct
+{
+  DawatiHomePluginsApp *app;
+  ClutterActor *stage;
+  ClutterActor *widget;
+  ClutterActor *config;
+  GDataInputStream *input;
+} Embedded;
+
+static void embedded_read_command (Embedded *embedded);
+
+static void
+embedded_add_actor (Embedded *embedded,
+    ClutterActor *actor)
+{
+  clutter_container_add_actor (CLUTTER_CONTAINER (embedded->stage), actor);
+  clutter_actor_add_constraint (actor,
+      clutter_bind_constraint_new (embedded->stage, CLUTTER_BIND_SIZE, 0));
+}
+
+static void
+embedded_set_edit_mode (Embedded *embedded,
+    gboolean edit_mode)
+{
+  if (edit_mode && embedded->config == NULL)
+    {
+      embedded->config = dawati_home_plugins_app_get_configuration (
+          embedded->app);
+
+      if (!CLUTTER_IS_ACTOR (embedded->config))
+        embedded->config = mx_label_new_with_text ("Broken plugin");
+
+      embedded_add_actor (embedded, embedded->config);
+    }
+
+  if (embedded->config != NULL)
+    clutter_actor_set_visible (embedded->config, edit_mode);
+
+  clutter_actor_set_visible (embedded->widget, !edit_mode);
+}
+
+static void
+embedded_put_event (Embedded *embedded,
+    ClutterEventType type,
+    gint x,
+    gint y,
+    gint detail)
+{
+  ClutterDeviceManager *manager = clutter_device_manager_get_default ();
+  ClutterEvent *event;
+
+  event = clutter_event_new (type);
+  clutter_event_set_stage (event, CLUTTER_STAGE (embedded->stage));
+  clutter_event_set_device (event,
+      clutter_device_manager_get_core_device (manager,
+        CLUTTER_POINTER_DEVICE));
+  clutter_event_set_time (event, CLUTTER_CURRENT_TIME);
+  clutter_event_set_coords (event, x, y);
+
+  /* we don't get to pick from a real pointer position, so do it here */
+  clutter_event_set_source (event,
+      clutter_stage_get_actor_at_pos (CLUTTER_STAGE (embedded->stage),
+        CLUTTER_PICK_REACTIVE, x, y));
+
+  if (type == CLUTTER_BUTTON_PRESS || type == CLUTTER_BUTTON_RELEASE)
+    {
+      clutter_event_set_button (event, detail);
+      event->button.click_count = 1;
+    }
+  else if (type == CLUTTER_SCROLL)
+    {
+      clutter_event_set_scroll_direction (event, detail);
+    }
+
+  clutter_event_put (event);
+  clutter_event_free (event);
+}
+
+static void
+embedded_command (Embedded *embedded,
+    const gchar *line)
+{
+  gchar command[16];
+  gint x, y, detail = 0;
+
+  if (sscanf (line, "%15s %d %d %d", command, &x, &y, &detail) < 1)
+    return;
+
+  if (0 == strcmp (command, "edit"))
+    embedded_set_edit_mode (embedded, TRUE);
+  else if (0 == strcmp (command, "view"))
+    embedded_set_edit_mode (embedded, FALSE);
+  else if (0 == strcmp (command, "button-press"))
+    embedded_put_event (embedded, CLUTTER_BUTTON_PRESS, x, y, detail);
+  else if (0 == strcmp (command, "button-release"))
+    embedded_put_event (embedded, CLUTTER_BUTTON_RELEASE, x, y, detail);
+  else if (0 == strcmp (command, "motion"))
+    embedded_put_event (embedded, CLUTTER_MOTION, x, y, 0);
+  else if (0 == strcmp (command, "scroll"))
+    embedded_put_event (embedded, CLUTTER_SCROLL, x, y, detail);
+  else
+    DEBUG ("Unknown command '%s'", line);
+}
+
+static void
+embedded_command_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer data)
+{
+  Embedded *embedded = data;
+  GError *error = NULL;
+  gchar *line;
+
+  line = g_data_input_stream_read_line_finish (G_DATA_INPUT_STREAM (source),
+      result, NULL, &error);
+
+  if (line == NULL)
+    {
+      /* the panel went away */
+      if (error != NULL)
+        {
+          DEBUG ("Could not read command: %s", error->message);
+          g_error_free (error);
+        }
+
+      clutter_main_quit ();
+      return;
+    }
+
+  embedded_command (embedded, line);
+  g_free (line);
+
+  embedded_read_command (embedded);
+}
+
+static void
+embedded_read_command (Embedded *embedded)
+{
+  g_data_input_stream_read_line_async (embedded->input, G_PRIORITY_DEFAULT,
+      NULL, embedded_command_cb, embedded);
+}
+
+static void
+run_embedded (DawatiHomePluginsApp *app)
+{
+  Embedded embedded = { app, };
+  GInputStream *stream;
+  XSetWindowAttributes attrs;
+  Display *xdpy;
+  Window xwin;
+
+  embedded.stage = clutter_stage_get_default ();
+  embedded.widget = dawati_home_plugins_app_get_widget (app);
+
+  clutter_actor_set_size (embedded.stage, TILE_SIZE, TILE_SIZE);
+  embedded_add_actor (&embedded, embedded.widget);
+
+  clutter_actor_realize (embedded.stage);
+
+  xdpy = clutter_x11_get_default_display ();
+  xwin = clutter_x11_get_stage_window (CLUTTER_STAGE (embedded.stage));
+
+  attrs.override_redirect = True;
+  XChangeWindowAttributes (xdpy, xwin, CWOverrideRedirect, &attrs);
+  XMoveWindow (xdpy, xwin, -2 * TILE_SIZE, -2 * TILE_SIZE);
+
+  clutter_actor_show (embedded.stage);
+
+  g_print ("%lu\n", (gulong) xwin);
+  fflush (stdout);
+
+  stream = g_unix_input_stream_new (0, FALSE);
+  embedded.input = g_data_input_stream_new (stream);
+  g_object_unref (stream);
+
+  embedded_read_command (&embedded);
+
+  clutter_main ();
+
+  g_object_unref (embedded.input);
+}
+
+/* The module is named in the .plugin file, not necessarily after it */
+static gchar *
+get_plugin_module (const char *filename)
+{
+  GKeyFile *keyfile = g_key_file_new ();
+  GError *error = NULL;
+  gchar *module = NULL;
+  char *p;
+
+  if (g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, &error))
+    module = g_key_file_get_string (keyfile, "Plugin", "Module", &error);
+
+  if (module == NULL)
+    {
+      DEBUG ("No module in '%s': %s", filename, error->message);
+      g_error_free (error);
+
+      module = g_path_get_basename (filename);
+
+      p = strrchr (module, '.');
+      g_assert (p != NULL);
+      *p = '\0';
+    }
+
+  g_key_file_free (keyfile);
+
+  return module;
+}
+
 static int
 load_plugin (const char *filename)
 {
@@ -42,7 +276,6 @@ load_plugin (const char *filename)
   ClutterActor *edit, *quit;
   DawatiHomePluginsApp *app;
   char *path, *module;
-  char *p;
 
   if (!g_str_has_suffix (filename, ".plugin"))
     {
@@ -51,20 +284,26 @@ load_plugin (const char *filename)
     }
 
   path = g_path_get_dirname (filename);
-  module = g_path_get_basename (filename);
-
-  p = strrchr (module, '.');
-  g_assert (p != NULL);
-  *p = '\0';
+  module = get_plugin_module (filename);
 
   DEBUG ("Add path: '%s'", path);
   DEBUG ("Module: '%s'", module);
 
   peas_engine_add_search_path (PEAS_ENGINE (engine), path, NULL);
-  app = mnb_home_plugins_engine_create_app (engine, module, "/");
+  app = mnb_home_plugins_engine_create_app (engine, module,
+      settings_path != NULL ? settings_path : "/");
+
+  if (app == NULL)
+    return -1;
 
   dawati_home_plugins_app_init (app);
 
+  if (embedded)
+    {
+      run_embedded (app);
+      goto out;
+    }
+
   stage = clutter_stage_get_default ();
   table = mx_table_new ();
   stack = mx_stack_new ();
@@ -111,6 +350,7 @@ load_plugin (const char *filename)
 
   clutter_main ();
 
+out:
   dawati_home_plugins_app_deinit (app);
 
   g_free (path);
@@ -128,6 +368,7 @@ main (int argc,
   GError *error = NULL;
 
   context = g_option_context_new ("- launch a Dawati Home plugin in a window");
+  g_option_context_add_main_entries (context, entries, NULL);
   g_option_context_add_group (context, clutter_get_option_group ());
 
   if (!g_option_context_parse (context, &argc, &argv, &error))
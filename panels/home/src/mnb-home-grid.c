@@ -73,11 +73,15 @@ struct _MnbHomeGridPrivate
   guint cols, rows;
 
   GList *children;
-  GArray *cells; /* TODO?: replace gboolean by actual ClutterActors */
+  GArray *cells; /* ClutterActor occupying each cell, row-major */
 
-  /* Grid showing available cells */
+  /* Children not painted at their cells position (being dragged or
+   * animating back into the grid) */
+  GList *floating;
+
+  /* Grid showing available cells, 6 vertices per cell, row-major */
   CoglMaterial *pipeline;
-  float *edition_verts;
+  CoglPrimitive *edition_prim;
   ClutterActor *edit_texture;
 
   /* Temporary stuff (used to speed up processing on motion events */
@@ -99,6 +103,10 @@ struct _MnbHomeGridPrivate
   MxAdjustment *vadjustment;
 
   guint spacing;
+
+  /* Pending update of which widgets are on screen */
+  guint activity_idle_id;
+  gfloat alloc_width, alloc_height;
 };
 
 enum
@@ -115,6 +123,8 @@ static CoglHandle texture_template_pipeline = NULL;
 
 /**/
 
+static void mnb_home_grid_queue_update_activity (MnbHomeGrid *grid);
+
 static void
 mnb_home_grid_insert_item_cells (MnbHomeGrid   *grid,
                                  ClutterActor  *child)
@@ -144,6 +154,9 @@ mnb_home_grid_insert_item_cells (MnbHomeGrid   *grid,
           *val = child;
         }
     }
+
+  /* the child may have moved in or out of the viewport */
+  mnb_home_grid_queue_update_activity (grid);
 }
 
 static void
@@ -218,26 +231,126 @@ mnb_home_grid_lookup_position (MnbHomeGrid *grid,
   return FALSE;
 }
 
+#define VERTS_PER_CELL (6)
+
 static void
 mnb_home_grid_recompute_edition_vertexes (MnbHomeGrid *grid)
 {
   MnbHomeGridPrivate *priv = grid->priv;
+  CoglContext *ctx =
+    clutter_backend_get_cogl_context (clutter_get_default_backend ());
+  CoglVertexP2T2 *verts;
   gint i, j, k;
 
-  if (priv->edition_verts)
-    g_free (priv->edition_verts);
-  priv->edition_verts = g_malloc (sizeof (float) * priv->cols * priv->rows * 4);
+  if (priv->edition_prim)
+    cogl_object_unref (priv->edition_prim);
+
+  verts = g_new (CoglVertexP2T2, priv->cols * priv->rows * VERTS_PER_CELL);
 
   for (i = 0, k = 0; i < priv->rows; i++)
     {
       for (j = 0; j < priv->cols; j++)
         {
-          priv->edition_verts[k++] = j * (priv->spacing + UNIT_SIZE);
-          priv->edition_verts[k++] = i * (priv->spacing + UNIT_SIZE);
-          priv->edition_verts[k++] = j * (priv->spacing + UNIT_SIZE) + UNIT_SIZE;
-          priv->edition_verts[k++] = i * (priv->spacing + UNIT_SIZE) + UNIT_SIZE;
+          gfloat x1 = j * (priv->spacing + UNIT_SIZE);
+          gfloat y1 = i * (priv->spacing + UNIT_SIZE);
+          gfloat x2 = x1 + UNIT_SIZE;
+          gfloat y2 = y1 + UNIT_SIZE;
+          CoglVertexP2T2 quad[VERTS_PER_CELL] = {
+            { x1, y1, 0, 0 }, { x1, y2, 0, 1 }, { x2, y2, 1, 1 },
+            { x1, y1, 0, 0 }, { x2, y2, 1, 1 }, { x2, y1, 1, 0 }
+          };
+
+          memcpy (&verts[k], quad, sizeof (quad));
+          k += VERTS_PER_CELL;
+        }
+    }
+
+  /* The vertex data gets uploaded into a buffer owned by the primitive */
+  priv->edition_prim = cogl_primitive_new_p2t2 (ctx,
+                                                COGL_VERTICES_MODE_TRIANGLES,
+                                                k, verts);
+  g_free (verts);
+}
+
+/* Range of cells intersecting @box, in grid coordinates */
+static void
+mnb_home_grid_get_visible_cells (MnbHomeGrid           *grid,
+                                 const ClutterActorBox *box,
+                                 gint                  *col1,
+                                 gint                  *row1,
+                                 gint                  *col2,
+                                 gint                  *row2)
+{
+  MnbHomeGridPrivate *priv = grid->priv;
+  MxPadding padding;
+  gfloat unit = UNIT_SIZE + priv->spacing;
+
+  mx_widget_get_padding (MX_WIDGET (grid), &padding);
+
+  *col1 = CLAMP (floorf ((box->x1 - padding.left) / unit), 0, priv->cols - 1);
+  *col2 = CLAMP (floorf ((box->x2 - padding.left) / unit), 0, priv->cols - 1);
+  *row1 = CLAMP (floorf ((box->y1 - padding.top) / unit), 0, priv->rows - 1);
+  *row2 = CLAMP (floorf ((box->y2 - padding.top) / unit), 0, priv->rows - 1);
+}
+
+/*
+ * Paints children occupying the cells visible through @box, then the
+ * floating ones on top. A child spanning several cells is only painted from
+ * its top-left visible cell.
+ */
+static void
+mnb_home_grid_paint_visible_children (MnbHomeGrid           *grid,
+                                      const ClutterActorBox *box)
+{
+  MnbHomeGridPrivate *priv = grid->priv;
+  gint col1, row1, col2, row2, i, j;
+  GList *l;
+
+  mnb_home_grid_get_visible_cells (grid, box, &col1, &row1, &col2, &row2);
+
+  for (i = row1; i <= row2; i++)
+    {
+      for (j = col1; j <= col2; j++)
+        {
+          ClutterActor *child = g_array_index (priv->cells, ClutterActor *,
+                                               i * priv->cols + j);
+
+          if (!child || g_list_find (priv->floating, child))
+            continue;
+
+          if (j > col1 &&
+              g_array_index (priv->cells, ClutterActor *,
+                             i * priv->cols + j - 1) == child)
+            continue;
+
+          if (i > row1 &&
+              g_array_index (priv->cells, ClutterActor *,
+                             (i - 1) * priv->cols + j) == child)
+            continue;
+
+          clutter_actor_paint (child);
         }
     }
+
+  for (l = priv->floating; l != NULL; l = g_list_next (l))
+    clutter_actor_paint (CLUTTER_ACTOR (l->data));
+}
+
+static void
+mnb_home_grid_paint_edition_cells (MnbHomeGrid           *grid,
+                                   const ClutterActorBox *box)
+{
+  MnbHomeGridPrivate *priv = grid->priv;
+  gint col1, row1, col2, row2;
+
+  mnb_home_grid_get_visible_cells (grid, box, &col1, &row1, &col2, &row2);
+
+  /* Rows are contiguous in the vertex buffer, only draw the visible ones */
+  cogl_primitive_set_first_vertex (priv->edition_prim,
+                                   row1 * priv->cols * VERTS_PER_CELL);
+  cogl_primitive_set_n_vertices (priv->edition_prim,
+                                 (row2 - row1 + 1) * priv->cols * VERTS_PER_CELL);
+  cogl_primitive_draw (priv->edition_prim);
 }
 
 /*
@@ -264,6 +377,69 @@ mnb_home_grid_stylable_iface_init (MxStylableIface *iface)
     }
 }
 
+/*
+ * Widgets activity: only widgets intersecting the viewport of a mapped grid
+ * run their plugin.
+ */
+
+static void mnb_home_grid_get_viewport_box (ClutterActor    *self,
+                                            ClutterActorBox *box);
+
+static gboolean
+mnb_home_grid_update_activity_cb (gpointer data)
+{
+  MnbHomeGrid *grid = MNB_HOME_GRID (data);
+  MnbHomeGridPrivate *priv = grid->priv;
+  gboolean mapped = CLUTTER_ACTOR_IS_MAPPED (grid);
+  gint col1 = 0, row1 = 0, col2 = -1, row2 = -1;
+  ClutterActorBox box;
+  GList *l;
+
+  priv->activity_idle_id = 0;
+
+  if (mapped)
+    {
+      mnb_home_grid_get_viewport_box (CLUTTER_ACTOR (grid), &box);
+      mnb_home_grid_get_visible_cells (grid, &box, &col1, &row1, &col2, &row2);
+    }
+
+  for (l = priv->children; l != NULL; l = l->next)
+    {
+      ClutterActor *child = CLUTTER_ACTOR (l->data);
+      MnbHomeGridChild *meta = (MnbHomeGridChild *)
+        clutter_container_get_child_meta (CLUTTER_CONTAINER (grid), child);
+      gboolean visible;
+
+      visible = mapped &&
+        (meta->col <= col2) && (meta->col + meta->width - 1 >= col1) &&
+        (meta->row <= row2) && (meta->row + meta->height - 1 >= row1);
+
+      mnb_home_widget_set_active (MNB_HOME_WIDGET (child), visible);
+    }
+
+  return FALSE;
+}
+
+static void
+mnb_home_grid_queue_update_activity (MnbHomeGrid *grid)
+{
+  MnbHomeGridPrivate *priv = grid->priv;
+
+  /* Widgets change their children when (de)activated, which we can't do in
+   * the middle of an allocation */
+  if (priv->activity_idle_id == 0)
+    priv->activity_idle_id =
+      g_idle_add (mnb_home_grid_update_activity_cb, grid);
+}
+
+static void
+mnb_home_grid_mapped_notify_cb (MnbHomeGrid *grid,
+                                GParamSpec  *pspec,
+                                gpointer     data)
+{
+  mnb_home_grid_queue_update_activity (grid);
+}
+
 /*
  * MxScrollable Interface Implementation
  */
@@ -273,6 +449,7 @@ adjustment_value_notify_cb (MxAdjustment *adjustment,
                             GParamSpec   *pspec,
                             MnbHomeGrid   *grid)
 {
+  mnb_home_grid_queue_update_activity (grid);
   clutter_actor_queue_redraw (CLUTTER_ACTOR (grid));
 }
 
@@ -427,6 +604,7 @@ mnb_home_grid_remove_actor (ClutterContainer *container,
   g_object_ref (actor);
 
   mnb_home_grid_remove_item_cells (grid, actor);
+  priv->floating = g_list_remove (priv->floating, actor);
 
   /* if ((ClutterActor *)priv->last_focus == actor) */
   /*   priv->last_focus = NULL; */
@@ -683,6 +861,18 @@ stage_motion_event_cb (ClutterActor         *stage,
   return TRUE;
 }
 
+static void
+selection_animation_completed_cb (ClutterAnimation *animation,
+                                  MnbHomeGrid      *self)
+{
+  MnbHomeGridPrivate *priv = self->priv;
+  ClutterActor *child = CLUTTER_ACTOR (clutter_animation_get_object (animation));
+
+  /* Back at its cells position */
+  if (child != priv->selection)
+    priv->floating = g_list_remove (priv->floating, child);
+}
+
 static gboolean
 stage_button_release_event_cb (ClutterActor       *stage,
                                ClutterButtonEvent *event,
@@ -690,6 +880,7 @@ stage_button_release_event_cb (ClutterActor       *stage,
 {
   MnbHomeGridPrivate *priv = self->priv;
   MnbHomeGridChild *meta;
+  ClutterAnimation *animation;
   gfloat pos_x, pos_y;
 
   /* Hide selection hint */
@@ -711,10 +902,13 @@ stage_button_release_event_cb (ClutterActor       *stage,
   pos_x = priv->tmp_padding.left + (UNIT_SIZE + priv->spacing) * meta->col;
   pos_y = priv->tmp_padding.top + (UNIT_SIZE + priv->spacing) * meta->row;
 
-  clutter_actor_animate (priv->selection, CLUTTER_LINEAR, 200,
-                         "x", pos_x,
-                         "y", pos_y,
-                         NULL);
+  animation = clutter_actor_animate (priv->selection, CLUTTER_LINEAR, 200,
+                                     "x", pos_x,
+                                     "y", pos_y,
+                                     NULL);
+  g_signal_connect_after (animation, "completed",
+                          G_CALLBACK (selection_animation_completed_cb),
+                          self);
 
   g_signal_emit (self, signals[DRAG_END], 0, priv->selection);
 
@@ -789,6 +983,9 @@ mnb_home_grid_button_press_event (ClutterActor       *self,
       priv->selection = child;
       clutter_actor_raise_top (priv->selection);
 
+      if (!g_list_find (priv->floating, child))
+        priv->floating = g_list_append (priv->floating, child);
+
       clutter_actor_get_size (child, &child_width, &child_height);
 
       priv->selection_cols = ceilf (child_width / (UNIT_SIZE + priv->spacing));
@@ -916,6 +1113,15 @@ mnb_home_grid_allocate (ClutterActor           *self,
 
   clutter_actor_allocate_preferred_size (priv->hint_position, flags);
 
+  if (box->x2 - box->x1 != priv->alloc_width ||
+      box->y2 - box->y1 != priv->alloc_height)
+    {
+      priv->alloc_width = box->x2 - box->x1;
+      priv->alloc_height = box->y2 - box->y1;
+
+      mnb_home_grid_queue_update_activity (grid);
+    }
+
   /* update adjustments for scrolling */
   if (priv->vadjustment)
     {
@@ -988,14 +1194,11 @@ mnb_home_grid_get_paint_volume (ClutterActor       *actor,
 }
 
 static void
-mnb_home_grid_paint (ClutterActor *self)
+mnb_home_grid_get_viewport_box (ClutterActor    *self,
+                                ClutterActorBox *box)
 {
   MnbHomeGridPrivate *priv = MNB_HOME_GRID (self)->priv;
-  GList *l;
   gdouble x, y;
-  ClutterActorBox box_b, child_b;
-
-  CLUTTER_ACTOR_CLASS (mnb_home_grid_parent_class)->paint (self);
 
   if (priv->hadjustment)
     x = mx_adjustment_get_value (priv->hadjustment);
@@ -1007,11 +1210,23 @@ mnb_home_grid_paint (ClutterActor *self)
   else
     y = 0;
 
-  clutter_actor_get_allocation_box (self, &box_b);
-  box_b.x2 = (box_b.x2 - box_b.x1) + x;
-  box_b.x1 = x;
-  box_b.y2 = (box_b.y2 - box_b.y1) + y;
-  box_b.y1 = y;
+  clutter_actor_get_allocation_box (self, box);
+  box->x2 = (box->x2 - box->x1) + x;
+  box->x1 = x;
+  box->y2 = (box->y2 - box->y1) + y;
+  box->y1 = y;
+}
+
+static void
+mnb_home_grid_paint (ClutterActor *self)
+{
+  MnbHomeGrid *grid = MNB_HOME_GRID (self);
+  MnbHomeGridPrivate *priv = grid->priv;
+  ClutterActorBox box_b;
+
+  CLUTTER_ACTOR_CLASS (mnb_home_grid_parent_class)->paint (self);
+
+  mnb_home_grid_get_viewport_box (self, &box_b);
 
   if (priv->in_edit_mode)
     {
@@ -1022,107 +1237,35 @@ mnb_home_grid_paint (ClutterActor *self)
       cogl_material_set_layer (priv->pipeline, 0, texture);
       cogl_material_set_color4ub (priv->pipeline, alpha, alpha, alpha, alpha);
       cogl_set_source (priv->pipeline);
-      cogl_rectangles (priv->edition_verts, priv->cols * priv->rows);
+      mnb_home_grid_paint_edition_cells (grid, &box_b);
 
       clutter_actor_paint (priv->hint_position);
-      for (l = priv->children; l != NULL; l = g_list_next (l))
-        {
-          ClutterActor *child = CLUTTER_ACTOR (l->data);
-
-          clutter_actor_get_allocation_box (child, &child_b);
-
-          if ((child_b.x1 < box_b.x2) &&
-              (child_b.x2 > box_b.x1) &&
-              (child_b.y1 < box_b.y2) &&
-              (child_b.y2 > box_b.y1))
-            {
-              clutter_actor_paint (CLUTTER_ACTOR (child));
-            }
-        }
     }
-  else /* !edit_mode */
-    {
-      for (l = priv->children; l != NULL; l = g_list_next (l))
-        {
-          ClutterActor *child = CLUTTER_ACTOR (l->data);
 
-          clutter_actor_get_allocation_box (child, &child_b);
-
-          if ((child_b.x1 < box_b.x2) &&
-              (child_b.x2 > box_b.x1) &&
-              (child_b.y1 < box_b.y2) &&
-              (child_b.y2 > box_b.y1))
-            {
-              clutter_actor_paint (child);
-            }
-        }
-    }
+  mnb_home_grid_paint_visible_children (grid, &box_b);
 }
 
 static void
 mnb_home_grid_pick (ClutterActor       *self,
                     const ClutterColor *color)
 {
-  MnbHomeGridPrivate *priv = MNB_HOME_GRID (self)->priv;
-  GList *l;
-  gdouble x, y;
-  ClutterActorBox box_b, child_b;
+  MnbHomeGrid *grid = MNB_HOME_GRID (self);
+  MnbHomeGridPrivate *priv = grid->priv;
+  ClutterActorBox box_b;
 
   CLUTTER_ACTOR_CLASS (mnb_home_grid_parent_class)->pick (self, color);
 
-  if (priv->hadjustment)
-    x = mx_adjustment_get_value (priv->hadjustment);
-  else
-    x = 0;
-
-  if (priv->vadjustment)
-    y = mx_adjustment_get_value (priv->vadjustment);
-  else
-    y = 0;
-
-  clutter_actor_get_allocation_box (self, &box_b);
-  box_b.x2 = (box_b.x2 - box_b.x1) + x;
-  box_b.x1 = x;
-  box_b.y2 = (box_b.y2 - box_b.y1) + y;
-  box_b.y1 = y;
+  mnb_home_grid_get_viewport_box (self, &box_b);
 
   if (priv->in_edit_mode)
     {
-      cogl_rectangles (priv->edition_verts, priv->cols * priv->rows);
+      /* The parent class left the pick color as the current source */
+      mnb_home_grid_paint_edition_cells (grid, &box_b);
 
       clutter_actor_paint (priv->hint_position);
-      for (l = priv->children; l != NULL; l = g_list_next (l))
-        {
-          ClutterActor *child = CLUTTER_ACTOR (l->data);
-
-          clutter_actor_get_allocation_box (child, &child_b);
-
-          if ((child_b.x1 < box_b.x2) &&
-              (child_b.x2 > box_b.x1) &&
-              (child_b.y1 < box_b.y2) &&
-              (child_b.y2 > box_b.y1))
-            {
-              clutter_actor_paint (child);
-            }
-        }
     }
-  else
-    {
-      for (l = priv->children; l != NULL; l = g_list_next (l))
-        {
-          ClutterActor *child = CLUTTER_ACTOR (l->data);
 
-          clutter_actor_get_allocation_box (child, &child_b);
-
-          if ((child_b.x1 < box_b.x2) &&
-              (child_b.x2 > box_b.x1) &&
-              (child_b.y1 < box_b.y2) &&
-              (child_b.y2 > box_b.y1))
-            {
-              clutter_actor_paint (child);
-            }
-        }
-    }
+  mnb_home_grid_paint_visible_children (grid, &box_b);
 }
 
 /*
@@ -1220,6 +1363,21 @@ mnb_home_grid_dispose (GObject *object)
       priv->pipeline = NULL;
     }
 
+  if (priv->edition_prim != NULL)
+    {
+      cogl_object_unref (priv->edition_prim);
+      priv->edition_prim = NULL;
+    }
+
+  g_list_free (priv->floating);
+  priv->floating = NULL;
+
+  if (priv->activity_idle_id != 0)
+    {
+      g_source_remove (priv->activity_idle_id);
+      priv->activity_idle_id = 0;
+    }
+
   G_OBJECT_CLASS (mnb_home_grid_parent_class)->dispose (object);
 }
 
@@ -1352,6 +1510,8 @@ mnb_home_grid_init (MnbHomeGrid *self)
 
   g_signal_connect (self, "style-changed",
                     G_CALLBACK (mnb_home_grid_style_changed), NULL);
+  g_signal_connect (self, "notify::mapped",
+                    G_CALLBACK (mnb_home_grid_mapped_notify_cb), NULL);
 }
 
 ClutterActor *
@@ -143,3 +143,68 @@ mnb_home_plugins_engine_create_app (MnbHomePluginsEngine *self,
         "settings-path", settings_path,
         NULL));
 }
+
+/**
+ * mnb_home_plugins_engine_get_plugin_file:
+ *
+ * Returns: the path of the .plugin file describing @module, suitable for
+ * handing to dawati-plugin-launcher. Free with g_free().
+ */
+gchar *
+mnb_home_plugins_engine_get_plugin_file (MnbHomePluginsEngine *self,
+    const char *module)
+{
+  PeasPluginInfo *plugin_info;
+  const gchar *module_dir, *module_name, *name;
+  gchar *filename = NULL;
+  GDir *dir;
+
+  g_return_val_if_fail (MNB_IS_HOME_PLUGINS_ENGINE (self), NULL);
+
+  plugin_info = peas_engine_get_plugin_info (PEAS_ENGINE (self), module);
+
+  if (plugin_info == NULL)
+    return NULL;
+
+  /* PeasPluginInfo doesn't give out its file name, so find the .plugin file
+   * next to the module that describes it */
+  module_dir = peas_plugin_info_get_module_dir (plugin_info);
+  module_name = peas_plugin_info_get_module_name (plugin_info);
+
+  dir = g_dir_open (module_dir, 0, NULL);
+
+  if (dir == NULL)
+    return NULL;
+
+  while (filename == NULL && (name = g_dir_read_name (dir)) != NULL)
+    {
+      GKeyFile *keyfile;
+      gchar *path, *key;
+
+      if (!g_str_has_suffix (name, ".plugin"))
+        continue;
+
+      path = g_build_filename (module_dir, name, NULL);
+      keyfile = g_key_file_new ();
+
+      if (g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, NULL))
+        {
+          key = g_key_file_get_string (keyfile, "Plugin", "Module", NULL);
+
+          if (0 == g_strcmp0 (key, module_name))
+            filename = g_strdup (path);
+
+          g_free (key);
+        }
+
+      g_key_file_free (keyfile);
+      g_free (path);
+    }
+
+  g_dir_close (dir);
+
+  if (filename == NULL)
+    DEBUG ("No .plugin file for '%s' in '%s'", module, module_dir);
+
+  return filename;
+}
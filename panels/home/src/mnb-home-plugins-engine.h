@@ -60,6 +60,9 @@ DawatiHomePluginsApp *mnb_home_plugins_engine_create_app (
     const char *module,
     const char *settings_path);
 
+gchar *mnb_home_plugins_engine_get_plugin_file (MnbHomePluginsEngine *self,
+    const char *module);
+
 G_END_DECLS
 
 #endif
@@ -17,7 +17,18 @@
  * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#define _GNU_SOURCE /* for RUSAGE_THREAD */
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
 #include <glib/gi18n.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+#include <clutter/x11/clutter-x11.h>
 
 #include "mnb-home-new-widget-dialog.h"
 #include "mnb-home-plugins-engine.h"
@@ -29,6 +40,9 @@
 #define GSETTINGS_PLUGIN_SCHEMA       "org.dawati.shell.home.plugin"
 #define GSETTINGS_PLUGIN_PATH_PREFIX  "/org/dawati/shell/home/plugin/"
 
+#define PLUGIN_LAUNCHER               LIBEXECDIR "/dawati-plugin-launcher"
+#define USAGE_SAMPLE_INTERVAL         (10) /* seconds */
+
 G_DEFINE_TYPE (MnbHomeWidget, mnb_home_widget, MX_TYPE_FRAME);
 
 enum /* properties */
@@ -39,6 +53,9 @@ enum /* properties */
   PROP_SETTINGS_PATH,
   PROP_MODULE,
   PROP_EDIT_MODE,
+  PROP_ACTIVE,
+  PROP_CPU_TIME,
+  PROP_MEMORY,
   PROP_LAST
 };
 
@@ -53,9 +70,28 @@ struct _MnbHomeWidgetPrivate
   gchar *settings_path;
   gboolean edit_mode;
   gchar *module;
+
+  /* The app is only created once the widget first becomes visible */
+  gboolean active;
+  gboolean app_failed;
+
+  /* Isolation mode, see home_widget_spawn_helper() */
+  GPid helper_pid;
+  guint helper_watch_id;
+  GCancellable *helper_cancellable;
+  GDataInputStream *helper_stdout;
+  GOutputStream *helper_stdin;
+  ClutterActor *helper_texture;
+
+  /* Accounting, see mnb_home_widget_get_usage() */
+  gint64 cpu_time_us;
+  gint64 memory_kb;
+  guint usage_timeout_id;
+  ClutterActor *usage_label;
 };
 
 static void home_widget_set_module (MnbHomeWidget *self, const gchar* module);
+static void home_widget_stop_helper (MnbHomeWidget *self);
 
 
 static void
@@ -88,6 +124,18 @@ mnb_home_widget_get_property (GObject *self,
         g_value_set_boolean (value, priv->edit_mode);
         break;
 
+      case PROP_ACTIVE:
+        g_value_set_boolean (value, priv->active);
+        break;
+
+      case PROP_CPU_TIME:
+        g_value_set_int64 (value, priv->cpu_time_us);
+        break;
+
+      case PROP_MEMORY:
+        g_value_set_int64 (value, priv->memory_kb);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
         break;
@@ -126,12 +174,431 @@ mnb_home_widget_set_property (GObject *self,
             g_value_get_boolean (value));
         break;
 
+      case PROP_ACTIVE:
+        mnb_home_widget_set_active (MNB_HOME_WIDGET (self),
+            g_value_get_boolean (value));
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
         break;
     }
 }
 
+static gboolean
+home_widget_is_isolated (void)
+{
+  static gint isolated = -1;
+
+  if (isolated < 0)
+    isolated = !STR_EMPTY (g_getenv ("DAWATI_HOME_PLUGINS_ISOLATE"));
+
+  return isolated;
+}
+
+/* CPU time used so far by the calling thread, in microseconds */
+static gint64
+home_widget_thread_cpu_time (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_THREAD, &usage) != 0)
+    return 0;
+
+  return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) *
+    G_USEC_PER_SEC + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/*
+ * In-process plugins share our main loop and gjs runtime, so the CPU time
+ * we can pin on them is what our thread uses inside their entry points.
+ */
+static void
+home_widget_account_cpu_time (MnbHomeWidget *self,
+    gint64 start)
+{
+  self->priv->cpu_time_us += home_widget_thread_cpu_time () - start;
+  g_object_notify (G_OBJECT (self), "cpu-time");
+}
+
+/* Creates the in-process app; the time spent in it is accounted to us */
+static void
+home_widget_ensure_app (MnbHomeWidget *self)
+{
+  MnbHomeWidgetPrivate *priv = self->priv;
+  gint64 start;
+
+  if (priv->app != NULL || priv->app_failed || STR_EMPTY (priv->module))
+    return;
+
+  DEBUG ("module = '%s' (%s)", priv->module, priv->settings_path);
+
+  start = home_widget_thread_cpu_time ();
+
+  if (priv->engine == NULL)
+    priv->engine = mnb_home_plugins_engine_dup ();
+
+  priv->app = mnb_home_plugins_engine_create_app (priv->engine,
+      priv->module, priv->settings_path);
+
+  if (priv->app != NULL)
+    dawati_home_plugins_app_init (priv->app);
+  else
+    priv->app_failed = TRUE;
+
+  home_widget_account_cpu_time (self, start);
+}
+
+static gboolean
+home_widget_sample_usage (gpointer data)
+{
+  MnbHomeWidget *self = data;
+  MnbHomeWidgetPrivate *priv = self->priv;
+  gchar *filename, *contents, *p;
+  gulong utime, stime, resident;
+  gint64 cpu_time_us = priv->cpu_time_us, memory_kb = priv->memory_kb;
+
+  if (priv->helper_pid == 0)
+    return TRUE;
+
+  filename = g_strdup_printf ("/proc/%d/stat", priv->helper_pid);
+
+  if (g_file_get_contents (filename, &contents, NULL, NULL))
+    {
+      /* skip the command name, it may contain spaces */
+      p = strrchr (contents, ')');
+
+      if (p != NULL &&
+          sscanf (p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                  &utime, &stime) == 2)
+        {
+          cpu_time_us =
+            (gint64) (utime + stime) * G_USEC_PER_SEC / sysconf (_SC_CLK_TCK);
+        }
+
+      g_free (contents);
+    }
+
+  g_free (filename);
+
+  filename = g_strdup_printf ("/proc/%d/statm", priv->helper_pid);
+
+  if (g_file_get_contents (filename, &contents, NULL, NULL))
+    {
+      if (sscanf (contents, "%*u %lu", &resident) == 1)
+        memory_kb = (gint64) resident * (sysconf (_SC_PAGESIZE) / 1024);
+
+      g_free (contents);
+    }
+
+  g_free (filename);
+
+  if (cpu_time_us != priv->cpu_time_us)
+    {
+      priv->cpu_time_us = cpu_time_us;
+      g_object_notify (G_OBJECT (self), "cpu-time");
+    }
+
+  if (memory_kb != priv->memory_kb)
+    {
+      priv->memory_kb = memory_kb;
+      g_object_notify (G_OBJECT (self), "memory");
+    }
+
+  return TRUE;
+}
+
+/* outlives the widget: only reaps a helper we have already let go of */
+static void
+home_widget_helper_reap_cb (GPid pid,
+    gint status,
+    gpointer data)
+{
+  g_spawn_close_pid (pid);
+}
+
+static void
+home_widget_helper_exited_cb (GPid pid,
+    gint status,
+    gpointer data)
+{
+  MnbHomeWidget *self = data;
+
+  g_spawn_close_pid (pid);
+
+  DEBUG ("helper for '%s' exited with status %d", self->priv->module, status);
+
+  self->priv->helper_pid = 0;
+  self->priv->helper_watch_id = 0;
+  self->priv->app_failed = TRUE;
+
+  home_widget_stop_helper (self);
+  mnb_home_widget_set_edit_mode (self, self->priv->edit_mode);
+}
+
+/* Sends one command line to the helper, see dawati-plugin-launcher.c */
+static void
+home_widget_helper_send (MnbHomeWidget *self,
+    const gchar *format,
+    ...)
+{
+  GError *error = NULL;
+  gchar *line;
+  va_list args;
+
+  if (self->priv->helper_stdin == NULL)
+    return;
+
+  va_start (args, format);
+  line = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  if (!g_output_stream_write_all (self->priv->helper_stdin, line,
+        strlen (line), NULL, NULL, &error))
+    {
+      g_warning ("Could not talk to the helper of '%s': %s",
+          self->priv->module, error->message);
+      g_error_free (error);
+    }
+
+  g_free (line);
+}
+
+/*
+ * The helper's window isn't really on screen, so the pointer events we get
+ * on its texture are passed on for it to replay.
+ */
+static gboolean
+home_widget_helper_event_cb (ClutterActor *texture,
+    ClutterEvent *event,
+    MnbHomeWidget *self)
+{
+  ClutterEventType type = clutter_event_type (event);
+  gfloat x, y, width, height;
+  gint base_width, base_height;
+
+  if (type != CLUTTER_BUTTON_PRESS && type != CLUTTER_BUTTON_RELEASE &&
+      type != CLUTTER_MOTION && type != CLUTTER_SCROLL)
+    return FALSE;
+
+  clutter_event_get_coords (event, &x, &y);
+
+  if (!clutter_actor_transform_stage_point (texture, x, y, &x, &y))
+    return FALSE;
+
+  /* the texture is scaled to our size, the window isn't */
+  clutter_actor_get_size (texture, &width, &height);
+  clutter_texture_get_base_size (CLUTTER_TEXTURE (texture),
+      &base_width, &base_height);
+
+  if (width <= 0 || height <= 0)
+    return FALSE;
+
+  x = x * base_width / width;
+  y = y * base_height / height;
+
+  switch (type)
+    {
+      case CLUTTER_BUTTON_PRESS:
+      case CLUTTER_BUTTON_RELEASE:
+        home_widget_helper_send (self, "%s %d %d %u\n",
+            type == CLUTTER_BUTTON_PRESS ? "button-press" : "button-release",
+            (gint) x, (gint) y, clutter_event_get_button (event));
+        break;
+
+      case CLUTTER_MOTION:
+        home_widget_helper_send (self, "motion %d %d\n", (gint) x, (gint) y);
+        break;
+
+      case CLUTTER_SCROLL:
+        home_widget_helper_send (self, "scroll %d %d %d\n", (gint) x, (gint) y,
+            clutter_event_get_scroll_direction (event));
+        break;
+
+      default:
+        break;
+    }
+
+  return TRUE;
+}
+
+static void
+home_widget_helper_window_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer data)
+{
+  MnbHomeWidget *self;
+  GError *error = NULL;
+  gchar *line;
+  Window xwin;
+
+  line = g_data_input_stream_read_line_finish (G_DATA_INPUT_STREAM (source),
+      result, NULL, &error);
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      /* we have been disposed or the module changed */
+      g_error_free (error);
+      return;
+    }
+
+  self = data;
+
+  if (line == NULL)
+    {
+      g_warning ("No window from the helper of '%s': %s", self->priv->module,
+          error != NULL ? error->message : "end of stream");
+      g_clear_error (&error);
+      return;
+    }
+
+  xwin = g_ascii_strtoull (line, NULL, 10);
+  g_free (line);
+
+  DEBUG ("helper for '%s' renders into window 0x%lx", self->priv->module,
+      (gulong) xwin);
+
+  self->priv->helper_texture =
+    g_object_ref_sink (clutter_x11_texture_pixmap_new_with_window (xwin));
+  clutter_x11_texture_pixmap_set_automatic (
+      CLUTTER_X11_TEXTURE_PIXMAP (self->priv->helper_texture), TRUE);
+
+  clutter_actor_set_reactive (self->priv->helper_texture, TRUE);
+  g_signal_connect (self->priv->helper_texture, "event",
+      G_CALLBACK (home_widget_helper_event_cb), self);
+
+  mnb_home_widget_set_edit_mode (self, self->priv->edit_mode);
+}
+
+/*
+ * Isolation mode: the widget runs in its own dawati-plugin-launcher process
+ * that renders into an offscreen window, which we paint through a texture
+ * pixmap. A stuck or leaking widget only affects its own process, which we
+ * can also stop while the widget is off-screen and account for. Its
+ * configuration is shown the same way, and pointer events on the texture
+ * are forwarded to it over its stdin.
+ */
+static void
+home_widget_spawn_helper (MnbHomeWidget *self)
+{
+  MnbHomeWidgetPrivate *priv = self->priv;
+  GInputStream *stream;
+  GError *error = NULL;
+  gchar *plugin_file;
+  gint in_fd, out_fd;
+  gchar *argv[] = {
+      PLUGIN_LAUNCHER,
+      "--embedded",
+      "--settings-path", priv->settings_path,
+      NULL, /* plugin file */
+      NULL
+  };
+
+  if (priv->helper_pid != 0 || priv->app_failed || STR_EMPTY (priv->module))
+    return;
+
+  if (priv->engine == NULL)
+    priv->engine = mnb_home_plugins_engine_dup ();
+
+  plugin_file = mnb_home_plugins_engine_get_plugin_file (priv->engine,
+      priv->module);
+
+  if (plugin_file == NULL)
+    {
+      priv->app_failed = TRUE;
+      return;
+    }
+
+  argv[4] = plugin_file;
+
+  if (!g_spawn_async_with_pipes (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD,
+        NULL, NULL, &priv->helper_pid, &in_fd, &out_fd, NULL, &error))
+    {
+      g_warning ("Could not spawn helper for '%s': %s", priv->module,
+          error->message);
+      g_error_free (error);
+      g_free (plugin_file);
+      priv->app_failed = TRUE;
+      return;
+    }
+
+  g_free (plugin_file);
+
+  /* spawned for edit mode while off-screen */
+  if (!priv->active)
+    kill (priv->helper_pid, SIGSTOP);
+
+  priv->helper_watch_id = g_child_watch_add (priv->helper_pid,
+      home_widget_helper_exited_cb, self);
+
+  stream = g_unix_input_stream_new (out_fd, TRUE);
+  priv->helper_stdout = g_data_input_stream_new (stream);
+  g_object_unref (stream);
+
+  priv->helper_stdin = g_unix_output_stream_new (in_fd, TRUE);
+
+  priv->helper_cancellable = g_cancellable_new ();
+  g_data_input_stream_read_line_async (priv->helper_stdout,
+      G_PRIORITY_DEFAULT, priv->helper_cancellable,
+      home_widget_helper_window_cb, self);
+
+  priv->usage_timeout_id = g_timeout_add_seconds (USAGE_SAMPLE_INTERVAL,
+      home_widget_sample_usage, self);
+}
+
+static void
+home_widget_stop_helper (MnbHomeWidget *self)
+{
+  MnbHomeWidgetPrivate *priv = self->priv;
+
+  if (priv->helper_cancellable != NULL)
+    {
+      g_cancellable_cancel (priv->helper_cancellable);
+      g_clear_object (&priv->helper_cancellable);
+    }
+
+  g_clear_object (&priv->helper_stdout);
+  g_clear_object (&priv->helper_stdin);
+
+  if (priv->helper_watch_id != 0)
+    {
+      g_source_remove (priv->helper_watch_id);
+      priv->helper_watch_id = 0;
+    }
+
+  if (priv->helper_pid != 0)
+    {
+      /* it might be stopped because we're off-screen */
+      kill (priv->helper_pid, SIGCONT);
+      kill (priv->helper_pid, SIGTERM);
+
+      /* keep watching so that it gets reaped once it is gone */
+      g_child_watch_add (priv->helper_pid, home_widget_helper_reap_cb, NULL);
+      priv->helper_pid = 0;
+    }
+
+  if (priv->usage_timeout_id != 0)
+    {
+      g_source_remove (priv->usage_timeout_id);
+      priv->usage_timeout_id = 0;
+    }
+
+  if (priv->helper_texture != NULL)
+    {
+      g_signal_handlers_disconnect_by_data (priv->helper_texture, self);
+      g_clear_object (&priv->helper_texture);
+    }
+}
+
+static void
+home_widget_load (MnbHomeWidget *self)
+{
+  if (home_widget_is_isolated ())
+    home_widget_spawn_helper (self);
+  else
+    home_widget_ensure_app (self);
+}
+
 static void
 home_widget_set_module (MnbHomeWidget *self,
     const gchar *module)
@@ -149,6 +616,12 @@ home_widget_set_module (MnbHomeWidget *self,
     dawati_home_plugins_app_deinit (self->priv->app);
 
   g_clear_object (&self->priv->app);
+  home_widget_stop_helper (self);
+  self->priv->app_failed = FALSE;
+  self->priv->cpu_time_us = 0;
+  self->priv->memory_kb = -1;
+  g_object_notify (G_OBJECT (self), "cpu-time");
+  g_object_notify (G_OBJECT (self), "memory");
 
   if (STR_EMPTY (self->priv->module))
     {
@@ -156,19 +629,14 @@ home_widget_set_module (MnbHomeWidget *self,
           self->priv->settings_path);
       mnb_home_widget_set_edit_mode (self, TRUE);
     }
+  else if (self->priv->active)
+    {
+      home_widget_load (self);
+    }
   else
     {
-      DEBUG ("module = '%s' (%s)", self->priv->module,
+      DEBUG ("module = '%s' (%s), deferred until visible", self->priv->module,
           self->priv->settings_path);
-
-      if (self->priv->engine == NULL)
-        self->priv->engine = mnb_home_plugins_engine_dup ();
-
-      self->priv->app =
-        mnb_home_plugins_engine_create_app (self->priv->engine,
-            self->priv->module, self->priv->settings_path);
-      if (self->priv->app != NULL)
-        dawati_home_plugins_app_init (self->priv->app);
     }
 
   /* reload the widget */
@@ -206,6 +674,8 @@ mnb_home_widget_dispose (GObject *self)
 {
   MnbHomeWidgetPrivate *priv = MNB_HOME_WIDGET (self)->priv;
 
+  home_widget_stop_helper (MNB_HOME_WIDGET (self));
+
   g_clear_object (&priv->settings);
   g_clear_object (&priv->engine);
   g_clear_object (&priv->app);
@@ -271,6 +741,55 @@ mnb_home_widget_class_init (MnbHomeWidgetClass *klass)
         "%TRUE if we are editing the settings for this widget",
         FALSE,
         G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ACTIVE,
+      g_param_spec_boolean ("active",
+        "Active",
+        "%TRUE if the widget is visible and its plugin should run",
+        FALSE,
+        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CPU_TIME,
+      g_param_spec_int64 ("cpu-time",
+        "CPU time",
+        "CPU time used by the plugin, in microseconds",
+        0, G_MAXINT64, 0,
+        G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MEMORY,
+      g_param_spec_int64 ("memory",
+        "Memory",
+        "Resident memory of the plugin in kB, or -1 if not known",
+        -1, G_MAXINT64, -1,
+        G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+home_widget_update_usage_label (MnbHomeWidget *self)
+{
+  MnbHomeWidgetPrivate *priv = self->priv;
+  gchar *text;
+
+  if (priv->usage_label == NULL)
+    return;
+
+  if (priv->memory_kb >= 0)
+    text = g_strdup_printf (_("CPU: %.1f s, memory: %" G_GINT64_FORMAT " kB"),
+        (gdouble) priv->cpu_time_us / G_USEC_PER_SEC, priv->memory_kb);
+  else
+    text = g_strdup_printf (_("CPU: %.1f s"),
+        (gdouble) priv->cpu_time_us / G_USEC_PER_SEC);
+
+  mx_label_set_text (MX_LABEL (priv->usage_label), text);
+  g_free (text);
+}
+
+static void
+home_widget_usage_notify_cb (MnbHomeWidget *self,
+    GParamSpec *pspec,
+    gpointer data)
+{
+  home_widget_update_usage_label (self);
 }
 
 static void
@@ -279,6 +798,13 @@ mnb_home_widget_init (MnbHomeWidget *self)
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, MNB_TYPE_HOME_WIDGET,
       MnbHomeWidgetPrivate);
 
+  self->priv->memory_kb = -1;
+
+  g_signal_connect (self, "notify::cpu-time",
+      G_CALLBACK (home_widget_usage_notify_cb), NULL);
+  g_signal_connect (self, "notify::memory",
+      G_CALLBACK (home_widget_usage_notify_cb), NULL);
+
   g_object_set (self,
       "x-fill", TRUE,
       "y-fill", TRUE,
@@ -335,6 +861,8 @@ void
 mnb_home_widget_set_edit_mode (MnbHomeWidget *self,
     gboolean edit_mode)
 {
+  ClutterActor *helper_texture = self->priv->helper_texture;
+
   //if (edit_mode == self->priv->edit_mode)
   //  return;
 
@@ -343,6 +871,14 @@ mnb_home_widget_set_edit_mode (MnbHomeWidget *self,
   self->priv->edit_mode = edit_mode;
   //g_object_notify (G_OBJECT (self), "edit-mode");
 
+  /* the helper's texture is reused in both modes, keep it out of the way of
+   * the table being thrown away */
+  if (helper_texture != NULL && clutter_actor_get_parent (helper_texture))
+    clutter_actor_remove_child (clutter_actor_get_parent (helper_texture),
+        helper_texture);
+
+  self->priv->usage_label = NULL;
+
   /* FIXME: should hold refs to the actors rather than destroy/recreate them? */
   mx_bin_set_child (MX_BIN (self), NULL);
 
@@ -356,7 +892,7 @@ mnb_home_widget_set_edit_mode (MnbHomeWidget *self,
 
       if (!STR_EMPTY (self->priv->module))
         {
-          ClutterActor *config, *remove;
+          ClutterActor *config = NULL, *remove;
 
           remove = mx_button_new_with_label ("x");
           mx_table_insert_actor_with_properties (MX_TABLE (table), remove, 0, 1,
@@ -369,11 +905,39 @@ mnb_home_widget_set_edit_mode (MnbHomeWidget *self,
           g_signal_connect (remove, "clicked",
               G_CALLBACK (home_widget_remove_module), self);
 
-          if (self->priv->app != NULL)
-            config = dawati_home_plugins_app_get_configuration (
-                self->priv->app);
+          if (home_widget_is_isolated ())
+            {
+              /* the helper shows its configuration in place of the widget */
+              home_widget_load (self);
+              helper_texture = self->priv->helper_texture;
+
+              if (helper_texture != NULL)
+                {
+                  home_widget_helper_send (self, "edit\n");
+                  config = helper_texture;
+                }
+              else if (self->priv->app_failed)
+                {
+                  config = mx_label_new_with_text (_("Plugin missing"));
+                }
+            }
           else
-            config = mx_label_new_with_text (_("Plugin missing"));
+            {
+              home_widget_ensure_app (self);
+
+              if (self->priv->app != NULL)
+                {
+                  gint64 start = home_widget_thread_cpu_time ();
+
+                  config = dawati_home_plugins_app_get_configuration (
+                      self->priv->app);
+                  home_widget_account_cpu_time (self, start);
+                }
+              else
+                {
+                  config = mx_label_new_with_text (_("Plugin missing"));
+                }
+            }
 
           if (CLUTTER_IS_ACTOR (config))
             mx_table_insert_actor_with_properties (MX_TABLE (table), config, 1, 0,
@@ -382,6 +946,22 @@ mnb_home_widget_set_edit_mode (MnbHomeWidget *self,
                                                    "x-fill", TRUE,
                                                    "y-fill", TRUE,
                                                    NULL);
+
+          if (self->priv->app != NULL || self->priv->helper_pid != 0)
+            {
+              home_widget_sample_usage (self);
+
+              self->priv->usage_label = mx_label_new ();
+              mx_table_insert_actor_with_properties (MX_TABLE (table),
+                                                     self->priv->usage_label,
+                                                     0, 0,
+                                                     "x-expand", TRUE,
+                                                     "y-expand", FALSE,
+                                                     "x-fill", TRUE,
+                                                     "y-fill", FALSE,
+                                                     NULL);
+              home_widget_update_usage_label (self);
+            }
         }
       else /* STR_EMPTY (self->priv->module) */
         {
@@ -400,9 +980,21 @@ mnb_home_widget_set_edit_mode (MnbHomeWidget *self,
     {
       ClutterActor *widget = NULL;
 
-      if (self->priv->app != NULL)
+      if (helper_texture != NULL)
+        {
+          home_widget_helper_send (self, "view\n");
+          widget = helper_texture;
+        }
+      else if (self->priv->helper_pid != 0)
+        {
+          /* still waiting for the helper's window */
+        }
+      else if (self->priv->app != NULL && !home_widget_is_isolated ())
         {
+          gint64 start = home_widget_thread_cpu_time ();
+
           widget = dawati_home_plugins_app_get_widget (self->priv->app);
+          home_widget_account_cpu_time (self, start);
 
           if (!CLUTTER_IS_ACTOR (widget))
             /* FIXME: make this better */
@@ -410,7 +1002,7 @@ mnb_home_widget_set_edit_mode (MnbHomeWidget *self,
             widget = mx_label_new_with_text (_("Broken plugin"));
             }
         }
-      else if (!STR_EMPTY (self->priv->module))
+      else if (self->priv->app_failed)
         {
           widget = mx_label_new_with_text (_("Plugin missing"));
         }
@@ -419,3 +1011,86 @@ mnb_home_widget_set_edit_mode (MnbHomeWidget *self,
         mx_bin_set_child (MX_BIN (self), widget);
     }
 }
+
+/**
+ * mnb_home_widget_set_active:
+ * @self: a #MnbHomeWidget
+ * @active: whether the widget is visible
+ *
+ * The plugin is only loaded the first time the widget becomes active, and is
+ * told to freeze (or its helper process is stopped) while inactive.
+ */
+void
+mnb_home_widget_set_active (MnbHomeWidget *self,
+    gboolean active)
+{
+  MnbHomeWidgetPrivate *priv;
+
+  g_return_if_fail (MNB_IS_HOME_WIDGET (self));
+
+  priv = self->priv;
+
+  if (priv->active == active)
+    return;
+
+  DEBUG ("%d -> %d for widget %s", priv->active, active,
+      priv->settings_path);
+  priv->active = active;
+
+  if (active &&
+      priv->app == NULL && priv->helper_pid == 0 &&
+      !STR_EMPTY (priv->module))
+    {
+      home_widget_load (self);
+      mnb_home_widget_set_edit_mode (self, priv->edit_mode);
+    }
+
+  if (priv->app != NULL)
+    {
+      gint64 start = home_widget_thread_cpu_time ();
+
+      dawati_home_plugins_app_set_active (priv->app, active);
+      home_widget_account_cpu_time (self, start);
+    }
+
+  if (priv->helper_pid != 0)
+    kill (priv->helper_pid, active ? SIGCONT : SIGSTOP);
+
+  g_object_notify (G_OBJECT (self), "active");
+}
+
+gboolean
+mnb_home_widget_get_active (MnbHomeWidget *self)
+{
+  g_return_val_if_fail (MNB_IS_HOME_WIDGET (self), FALSE);
+
+  return self->priv->active;
+}
+
+/**
+ * mnb_home_widget_get_usage:
+ * @self: a #MnbHomeWidget
+ * @cpu_time_us: (out): CPU time used by the plugin, in microseconds
+ * @memory_kb: (out): resident memory of the plugin in kB, or -1
+ *
+ * In isolation mode these are the figures of the helper process. In-process
+ * plugins only account the CPU time spent in their entry points; their
+ * memory can't be told apart from ours, so it is -1. Also available as the
+ * #MnbHomeWidget:cpu-time and #MnbHomeWidget:memory properties, and shown
+ * in edit mode.
+ */
+void
+mnb_home_widget_get_usage (MnbHomeWidget *self,
+    gint64 *cpu_time_us,
+    gint64 *memory_kb)
+{
+  g_return_if_fail (MNB_IS_HOME_WIDGET (self));
+
+  if (self->priv->helper_pid != 0)
+    home_widget_sample_usage (self);
+
+  if (cpu_time_us != NULL)
+    *cpu_time_us = self->priv->cpu_time_us;
+  if (memory_kb != NULL)
+    *memory_kb = self->priv->memory_kb;
+}
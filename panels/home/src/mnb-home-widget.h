@@ -51,6 +51,10 @@ struct _MnbHomeWidgetClass
 GType mnb_home_widget_get_type (void);
 ClutterActor *mnb_home_widget_new (const char *object_path);
 void mnb_home_widget_set_edit_mode (MnbHomeWidget *self, gboolean edit_mode);
+void mnb_home_widget_set_active (MnbHomeWidget *self, gboolean active);
+gboolean mnb_home_widget_get_active (MnbHomeWidget *self);
+void mnb_home_widget_get_usage (MnbHomeWidget *self, gint64 *cpu_time_us,
+    gint64 *memory_kb);
 
 G_END_DECLS
 
@@ -17,7 +17,6 @@ const DBus = imports.dbus;
 const Mainloop = imports.mainloop;
 const Path = imports.path;
 const Zeitgeist = imports.zeitgeist;
-const Tracker = imports.trackerResultSet;
 
 Gettext.textdomain("dawati-shell");
 Gettext.bindtextdomain("dawati-shell", Path.LOCALE_DIR);
@@ -69,27 +68,36 @@ AudioLibrary.prototype = {
 
         this.listview_actor = new GtkClutter.Actor({ contents: scroll });
 
-        this.results = new Array();
-
-
-        this.results.push(new Tracker.ResultSet("select" +
-                                                " nie:url(?u)" +
-                                                " nie:title(?u)" +
-                                                " nmm:artistName(nmm:performer(?u)) " +
-                                                " nmm:albumTitle(nmm:musicAlbum(?u))" +
-                                                " where { ?u a nmm:MusicPiece }" +
-                                                " ORDER BY DESC(nie:contentAccessed(?u))" +
-                                                " LIMIT 10"));
-        this.results.push(new Zeitgeist.ResultSet(Zeitgeist.ResultType.MOST_RECENT_SUBJECTS));
-        this.results.push(new Zeitgeist.ResultSet(Zeitgeist.ResultType.MOST_POPULAR_SUBJECTS));
-        this.results.push(new Tracker.ResultSet("select" +
-                                                " nie:url(?u)" +
-                                                " nie:title(?u)" +
-                                                " nmm:artistName(nmm:performer(?u)) " +
-                                                " nmm:albumTitle(nmm:musicAlbum(?u))" +
-                                                " where { ?u a nmm:MusicPiece }" +
-                                               " ORDER BY ASC(tracker:added(?u))" +
-                                                " LIMIT 50"));
+        // Results of the views listed in the combo box, in the same order
+        this.views = [ 'recently-added',
+                       'recently-played',
+                       'favorites',
+                       'rediscover' ];
+        this.results = DawatiPanel.MplAudioResults.new();
+        this.results.add_query_view(this.views[0],
+                                    "select" +
+                                    " nie:url(?u)" +
+                                    " nie:title(?u)" +
+                                    " nmm:artistName(nmm:performer(?u)) " +
+                                    " nmm:albumTitle(nmm:musicAlbum(?u))" +
+                                    " where { ?u a nmm:MusicPiece }" +
+                                    " ORDER BY DESC(nie:contentAccessed(?u))",
+                                    10);
+        this._zeitgeist = [
+            new Zeitgeist.ResultSet(this.results, this.views[1],
+                                    Zeitgeist.ResultType.MOST_RECENT_SUBJECTS),
+            new Zeitgeist.ResultSet(this.results, this.views[2],
+                                    Zeitgeist.ResultType.MOST_POPULAR_SUBJECTS)
+        ];
+        this.results.add_query_view(this.views[3],
+                                    "select" +
+                                    " nie:url(?u)" +
+                                    " nie:title(?u)" +
+                                    " nmm:artistName(nmm:performer(?u)) " +
+                                    " nmm:albumTitle(nmm:musicAlbum(?u))" +
+                                    " where { ?u a nmm:MusicPiece }" +
+                                    " ORDER BY ASC(tracker:added(?u))",
+                                    50);
 
         // GtkIconView setup
         // let icon = new Gtk.CellRendererPixbuf();
@@ -136,7 +144,8 @@ AudioLibrary.prototype = {
     },
 
     _switched_model: function() {
-        this.iconview.set_model(this.results[this.combo.get_index()].store);
+        let view = this.views[this.combo.get_index()];
+        this.iconview.set_model(this.results.get_store(view));
     }
 };
 
@@ -0,0 +1,154 @@
+/*
+ * Carrick - a connection panel for the Dawati Netbook
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+/*
+ * The model is only updated from connman's PropertyChanged signal, so the
+ * benchmark feeds synthetic "Services" values straight to the handler
+ * through carrick_network_model_update_property().
+ */
+#include <dbus/dbus-glib.h>
+
+#include "carrick-network-model-private.h"
+
+#include "dawati-bench.h"
+
+typedef struct
+{
+  CarrickNetworkModel *model;
+  GValue               forward;
+  GValue               reversed;
+  GValue               half;
+  gboolean             flip;
+} BenchData;
+
+static void
+make_services (GValue *value,
+               gint    n,
+               gint    first,
+               gint    step)
+{
+  GPtrArray *paths = g_ptr_array_new_with_free_func (g_free);
+  gint       i;
+
+  for (i = 0; i < n; i++)
+    g_ptr_array_add (paths,
+                     g_strdup_printf ("/profile/default/wifi_%08x_managed_psk",
+                                      first + i * step));
+
+  g_value_init (value,
+                dbus_g_type_get_collection ("GPtrArray",
+                                            DBUS_TYPE_G_OBJECT_PATH));
+  g_value_take_boxed (value, paths);
+}
+
+static void
+reset_empty (gpointer data)
+{
+  BenchData *bench = data;
+
+  if (bench->model)
+    g_object_unref (bench->model);
+
+  bench->model = g_object_new (CARRICK_TYPE_NETWORK_MODEL, NULL);
+}
+
+static void
+reset_populated (gpointer data)
+{
+  BenchData *bench = data;
+
+  reset_empty (bench);
+  carrick_network_model_update_property (bench->model, "Services",
+                                         &bench->forward);
+}
+
+static void
+populate (gpointer data)
+{
+  BenchData *bench = data;
+
+  carrick_network_model_update_property (bench->model, "Services",
+                                         &bench->forward);
+}
+
+/* connman re-sorts the list on every signal strength change */
+static void
+reorder (gpointer data)
+{
+  BenchData *bench = data;
+
+  bench->flip = !bench->flip;
+  carrick_network_model_update_property (bench->model, "Services",
+                                         bench->flip ?
+                                         &bench->reversed : &bench->forward);
+}
+
+static void
+remove_half (gpointer data)
+{
+  BenchData *bench = data;
+
+  carrick_network_model_update_property (bench->model, "Services",
+                                         &bench->half);
+}
+
+int
+main (int argc, char **argv)
+{
+  DawatiBench      bench;
+  BenchData        data = { NULL, };
+  DBusGConnection *connection;
+
+  g_type_init ();
+
+  dawati_bench_init (&bench, "carrick-network-model", &argc, &argv);
+
+  /* The model cannot create its service proxies without the system bus */
+  connection = dbus_g_bus_get (DBUS_BUS_SYSTEM, NULL);
+  if (!connection)
+    {
+      dawati_bench_skip (&bench, "populate", "no system bus");
+      dawati_bench_skip (&bench, "reorder", "no system bus");
+      dawati_bench_skip (&bench, "remove-half", "no system bus");
+
+      return dawati_bench_finish (&bench);
+    }
+
+  make_services (&data.forward, bench.size, 0, 1);
+  make_services (&data.reversed, bench.size, bench.size - 1, -1);
+  make_services (&data.half, bench.size / 2, 0, 2);
+
+  dawati_bench_run (&bench, "populate", bench.size,
+                    reset_empty, populate, &data);
+  dawati_bench_run (&bench, "reorder", bench.size,
+                    NULL, reorder, &data);
+  dawati_bench_run (&bench, "remove-half", bench.size,
+                    reset_populated, remove_half, &data);
+
+  g_object_unref (data.model);
+
+  g_value_unset (&data.forward);
+  g_value_unset (&data.reversed);
+  g_value_unset (&data.half);
+
+  dbus_g_connection_unref (connection);
+
+  return dawati_bench_finish (&bench);
+}
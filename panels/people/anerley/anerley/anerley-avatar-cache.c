@@ -0,0 +1,488 @@
+/*
+ * Anerley - people feeds and widgets
+ * Copyright (C) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "anerley-avatar-cache.h"
+
+G_DEFINE_TYPE (AnerleyAvatarCache, anerley_avatar_cache, G_TYPE_OBJECT)
+
+#define GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), ANERLEY_TYPE_AVATAR_CACHE, AnerleyAvatarCachePrivate))
+
+typedef struct _AnerleyAvatarCachePrivate AnerleyAvatarCachePrivate;
+
+struct _AnerleyAvatarCachePrivate {
+  gint size;
+
+  /* Decoded textures, keyed on the avatar icon itself */
+  GHashTable *entries;
+  GQueue *lru;
+
+  /* Loads queued or in progress, keyed the same way */
+  GHashTable *jobs;
+  GQueue *urgent_jobs;
+  GQueue *deferred_jobs;
+
+  GThreadPool *pool;
+  guint n_running;
+};
+
+enum
+{
+  PROP_0,
+  PROP_SIZE
+};
+
+#define DEFAULT_SIZE 48
+#define MAX_ENTRIES 256
+#define MAX_THREADS 2
+
+typedef struct {
+  GLoadableIcon *avatar;
+  CoglHandle texture;
+  GList link;
+} CacheEntry;
+
+typedef struct {
+  AnerleyAvatarCacheFunc func;
+  gpointer userdata;
+} JobWaiter;
+
+/*
+ * One per avatar however many tiles are waiting on it. queue is NULL once
+ * the job has been handed to the pool; pixbuf and error are only touched by
+ * the worker until the result is back in the main loop.
+ */
+typedef struct {
+  AnerleyAvatarCache *cache;
+  GLoadableIcon *avatar;
+  gint size;
+  GList *waiters;
+  GQueue *queue;
+  GList link;
+  GdkPixbuf *pixbuf;
+  GError *error;
+} LoadJob;
+
+static void
+_cache_entry_free (CacheEntry *entry)
+{
+  cogl_handle_unref (entry->texture);
+  g_object_unref (entry->avatar);
+  g_slice_free (CacheEntry, entry);
+}
+
+static void
+_load_job_free (LoadJob *job)
+{
+  g_list_foreach (job->waiters, (GFunc)g_free, NULL);
+  g_list_free (job->waiters);
+
+  if (job->pixbuf)
+    g_object_unref (job->pixbuf);
+
+  g_clear_error (&job->error);
+  g_object_unref (job->avatar);
+  g_object_unref (job->cache);
+  g_slice_free (LoadJob, job);
+}
+
+static void
+anerley_avatar_cache_get_property (GObject *object, guint property_id,
+                                   GValue *value, GParamSpec *pspec)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (object);
+
+  switch (property_id) {
+    case PROP_SIZE:
+      g_value_set_int (value, priv->size);
+      break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+  }
+}
+
+static void
+anerley_avatar_cache_set_property (GObject *object, guint property_id,
+                                   const GValue *value, GParamSpec *pspec)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (object);
+
+  switch (property_id) {
+    case PROP_SIZE:
+      priv->size = g_value_get_int (value);
+      break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+  }
+}
+
+static void
+anerley_avatar_cache_finalize (GObject *object)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (object);
+  GList *link;
+
+  /* Running jobs hold a reference, so only queued ones can be left */
+  g_thread_pool_free (priv->pool, TRUE, FALSE);
+
+  /* The links are part of the jobs and entries, so empty the queues first */
+  while ((link = g_queue_pop_head_link (priv->urgent_jobs)))
+    _load_job_free ((LoadJob *)link->data);
+  while ((link = g_queue_pop_head_link (priv->deferred_jobs)))
+    _load_job_free ((LoadJob *)link->data);
+  g_queue_free (priv->urgent_jobs);
+  g_queue_free (priv->deferred_jobs);
+  g_hash_table_unref (priv->jobs);
+
+  while ((link = g_queue_pop_head_link (priv->lru)))
+    _cache_entry_free ((CacheEntry *)link->data);
+  g_queue_free (priv->lru);
+  g_hash_table_unref (priv->entries);
+
+  G_OBJECT_CLASS (anerley_avatar_cache_parent_class)->finalize (object);
+}
+
+static void
+anerley_avatar_cache_class_init (AnerleyAvatarCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GParamSpec *pspec;
+
+  g_type_class_add_private (klass, sizeof (AnerleyAvatarCachePrivate));
+
+  object_class->get_property = anerley_avatar_cache_get_property;
+  object_class->set_property = anerley_avatar_cache_set_property;
+  object_class->finalize = anerley_avatar_cache_finalize;
+
+  pspec = g_param_spec_int ("size",
+                            "Size",
+                            "Size avatars are scaled to",
+                            1,
+                            G_MAXINT,
+                            DEFAULT_SIZE,
+                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+  g_object_class_install_property (object_class, PROP_SIZE, pspec);
+}
+
+/* Runs in the pool; the result goes back to the main loop from an idle */
+static gboolean _load_job_done_cb (LoadJob *job);
+
+static void
+_load_job_run (LoadJob            *job,
+               AnerleyAvatarCache *cache)
+{
+  GInputStream *input;
+
+  input = g_loadable_icon_load (job->avatar, job->size, NULL, NULL,
+                                &job->error);
+
+  if (input)
+  {
+    job->pixbuf = gdk_pixbuf_new_from_stream_at_scale (input,
+                                                       job->size,
+                                                       job->size,
+                                                       TRUE,
+                                                       NULL,
+                                                       &job->error);
+    g_object_unref (input);
+  }
+
+  g_idle_add ((GSourceFunc)_load_job_done_cb, job);
+}
+
+static void
+anerley_avatar_cache_init (AnerleyAvatarCache *self)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (self);
+
+  priv->size = DEFAULT_SIZE;
+
+  priv->entries = g_hash_table_new ((GHashFunc)g_icon_hash,
+                                    (GEqualFunc)g_icon_equal);
+  priv->lru = g_queue_new ();
+
+  priv->jobs = g_hash_table_new ((GHashFunc)g_icon_hash,
+                                 (GEqualFunc)g_icon_equal);
+  priv->urgent_jobs = g_queue_new ();
+  priv->deferred_jobs = g_queue_new ();
+
+  priv->pool = g_thread_pool_new ((GFunc)_load_job_run,
+                                  self,
+                                  MAX_THREADS,
+                                  FALSE,
+                                  NULL);
+}
+
+AnerleyAvatarCache *
+anerley_avatar_cache_get_default (void)
+{
+  static AnerleyAvatarCache *cache = NULL;
+
+  if (!cache)
+    cache = g_object_new (ANERLEY_TYPE_AVATAR_CACHE, NULL);
+
+  return cache;
+}
+
+static void
+_cache_insert (AnerleyAvatarCache *cache,
+               GLoadableIcon      *avatar,
+               CoglHandle          texture)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (cache);
+  CacheEntry *entry;
+
+  entry = g_hash_table_lookup (priv->entries, avatar);
+
+  if (entry)
+  {
+    cogl_handle_unref (entry->texture);
+    entry->texture = cogl_handle_ref (texture);
+    g_queue_unlink (priv->lru, &entry->link);
+    g_queue_push_head_link (priv->lru, &entry->link);
+    return;
+  }
+
+  entry = g_slice_new0 (CacheEntry);
+  entry->avatar = g_object_ref (avatar);
+  entry->texture = cogl_handle_ref (texture);
+  entry->link.data = entry;
+
+  g_hash_table_insert (priv->entries, entry->avatar, entry);
+  g_queue_push_head_link (priv->lru, &entry->link);
+
+  while (g_queue_get_length (priv->lru) > MAX_ENTRIES)
+  {
+    GList *link = g_queue_pop_tail_link (priv->lru);
+
+    entry = (CacheEntry *)link->data;
+    g_hash_table_remove (priv->entries, entry->avatar);
+    _cache_entry_free (entry);
+  }
+}
+
+static void
+_dispatch_jobs (AnerleyAvatarCache *cache)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (cache);
+
+  while (priv->n_running < MAX_THREADS)
+  {
+    GList *link;
+    LoadJob *job;
+
+    link = g_queue_pop_head_link (priv->urgent_jobs);
+
+    if (!link)
+      link = g_queue_pop_head_link (priv->deferred_jobs);
+
+    if (!link)
+      break;
+
+    job = (LoadJob *)link->data;
+    job->queue = NULL;
+
+    priv->n_running++;
+    g_thread_pool_push (priv->pool, job, NULL);
+  }
+}
+
+static gboolean
+_load_job_done_cb (LoadJob *job)
+{
+  AnerleyAvatarCache *cache = job->cache;
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (cache);
+  CoglHandle texture = COGL_INVALID_HANDLE;
+  GList *waiters, *l;
+
+  priv->n_running--;
+  g_hash_table_remove (priv->jobs, job->avatar);
+
+  if (job->pixbuf)
+  {
+    GdkPixbuf *pixbuf = job->pixbuf;
+    gboolean has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+
+    texture = cogl_texture_new_from_data (gdk_pixbuf_get_width (pixbuf),
+                                          gdk_pixbuf_get_height (pixbuf),
+                                          COGL_TEXTURE_NONE,
+                                          has_alpha ?
+                                          COGL_PIXEL_FORMAT_RGBA_8888 :
+                                          COGL_PIXEL_FORMAT_RGB_888,
+                                          COGL_PIXEL_FORMAT_ANY,
+                                          gdk_pixbuf_get_rowstride (pixbuf),
+                                          gdk_pixbuf_get_pixels (pixbuf));
+  } else {
+    g_debug (G_STRLOC ": Unable to load avatar: %s",
+             job->error ? job->error->message : "no data");
+  }
+
+  if (texture != COGL_INVALID_HANDLE)
+    _cache_insert (cache, job->avatar, texture);
+
+  /* Waiters may queue or cancel loads from their callbacks */
+  waiters = job->waiters;
+  job->waiters = NULL;
+
+  for (l = waiters; l; l = l->next)
+  {
+    JobWaiter *waiter = (JobWaiter *)l->data;
+
+    waiter->func (cache, job->avatar, texture, waiter->userdata);
+    g_free (waiter);
+  }
+
+  g_list_free (waiters);
+
+  if (texture != COGL_INVALID_HANDLE)
+    cogl_handle_unref (texture);
+
+  _load_job_free (job);
+
+  _dispatch_jobs (cache);
+
+  return FALSE;
+}
+
+CoglHandle
+anerley_avatar_cache_lookup (AnerleyAvatarCache *cache,
+                             GLoadableIcon      *avatar)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (cache);
+  CacheEntry *entry;
+
+  entry = g_hash_table_lookup (priv->entries, avatar);
+
+  if (!entry)
+    return COGL_INVALID_HANDLE;
+
+  g_queue_unlink (priv->lru, &entry->link);
+  g_queue_push_head_link (priv->lru, &entry->link);
+
+  return entry->texture;
+}
+
+/*
+ * Calls func once the avatar has been loaded and scaled. Urgent loads, for
+ * tiles already on screen, go ahead of the others; requests for an avatar
+ * that is already being loaded share the one load.
+ */
+void
+anerley_avatar_cache_load (AnerleyAvatarCache     *cache,
+                           GLoadableIcon          *avatar,
+                           gboolean                urgent,
+                           AnerleyAvatarCacheFunc  func,
+                           gpointer                userdata)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (cache);
+  CoglHandle texture;
+  LoadJob *job;
+  JobWaiter *waiter;
+
+  texture = anerley_avatar_cache_lookup (cache, avatar);
+
+  if (texture != COGL_INVALID_HANDLE)
+  {
+    func (cache, avatar, texture, userdata);
+    return;
+  }
+
+  job = g_hash_table_lookup (priv->jobs, avatar);
+
+  if (!job)
+  {
+    job = g_slice_new0 (LoadJob);
+    job->cache = g_object_ref (cache);
+    job->avatar = g_object_ref (avatar);
+    job->size = priv->size;
+    job->link.data = job;
+    job->queue = urgent ? priv->urgent_jobs : priv->deferred_jobs;
+
+    g_queue_push_tail_link (job->queue, &job->link);
+    g_hash_table_insert (priv->jobs, job->avatar, job);
+  } else if (urgent) {
+    anerley_avatar_cache_prioritise (cache, avatar);
+  }
+
+  waiter = g_new0 (JobWaiter, 1);
+  waiter->func = func;
+  waiter->userdata = userdata;
+  job->waiters = g_list_prepend (job->waiters, waiter);
+
+  _dispatch_jobs (cache);
+}
+
+/* Moves a queued load ahead of the ones for tiles that are not on screen */
+void
+anerley_avatar_cache_prioritise (AnerleyAvatarCache *cache,
+                                 GLoadableIcon      *avatar)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (cache);
+  LoadJob *job;
+
+  job = g_hash_table_lookup (priv->jobs, avatar);
+
+  if (!job || job->queue != priv->deferred_jobs)
+    return;
+
+  g_queue_unlink (priv->deferred_jobs, &job->link);
+  job->queue = priv->urgent_jobs;
+  g_queue_push_tail_link (priv->urgent_jobs, &job->link);
+}
+
+/*
+ * A load nobody is waiting on any more is dropped if it has not started;
+ * one that has is left to finish and fill the cache.
+ */
+void
+anerley_avatar_cache_cancel (AnerleyAvatarCache     *cache,
+                             GLoadableIcon          *avatar,
+                             AnerleyAvatarCacheFunc  func,
+                             gpointer                userdata)
+{
+  AnerleyAvatarCachePrivate *priv = GET_PRIVATE (cache);
+  LoadJob *job;
+  GList *l;
+
+  job = g_hash_table_lookup (priv->jobs, avatar);
+
+  if (!job)
+    return;
+
+  for (l = job->waiters; l; l = l->next)
+  {
+    JobWaiter *waiter = (JobWaiter *)l->data;
+
+    if (waiter->func == func && waiter->userdata == userdata)
+    {
+      job->waiters = g_list_delete_link (job->waiters, l);
+      g_free (waiter);
+      break;
+    }
+  }
+
+  if (!job->waiters && job->queue)
+  {
+    g_queue_unlink (job->queue, &job->link);
+    g_hash_table_remove (priv->jobs, job->avatar);
+    _load_job_free (job);
+  }
+}
@@ -0,0 +1,81 @@
+/*
+ * Anerley - people feeds and widgets
+ * Copyright (C) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef _ANERLEY_AVATAR_CACHE
+#define _ANERLEY_AVATAR_CACHE
+
+#include <glib-object.h>
+#include <gio/gio.h>
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+#define ANERLEY_TYPE_AVATAR_CACHE anerley_avatar_cache_get_type()
+
+#define ANERLEY_AVATAR_CACHE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), ANERLEY_TYPE_AVATAR_CACHE, AnerleyAvatarCache))
+
+#define ANERLEY_AVATAR_CACHE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), ANERLEY_TYPE_AVATAR_CACHE, AnerleyAvatarCacheClass))
+
+#define ANERLEY_IS_AVATAR_CACHE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), ANERLEY_TYPE_AVATAR_CACHE))
+
+#define ANERLEY_IS_AVATAR_CACHE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), ANERLEY_TYPE_AVATAR_CACHE))
+
+#define ANERLEY_AVATAR_CACHE_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), ANERLEY_TYPE_AVATAR_CACHE, AnerleyAvatarCacheClass))
+
+typedef struct {
+  GObject parent;
+} AnerleyAvatarCache;
+
+typedef struct {
+  GObjectClass parent_class;
+} AnerleyAvatarCacheClass;
+
+/* texture is COGL_INVALID_HANDLE if the avatar could not be loaded */
+typedef void (*AnerleyAvatarCacheFunc) (AnerleyAvatarCache *cache,
+                                        GLoadableIcon      *avatar,
+                                        CoglHandle          texture,
+                                        gpointer            userdata);
+
+GType anerley_avatar_cache_get_type (void);
+
+AnerleyAvatarCache *anerley_avatar_cache_get_default (void);
+
+CoglHandle anerley_avatar_cache_lookup (AnerleyAvatarCache *cache,
+                                        GLoadableIcon      *avatar);
+void anerley_avatar_cache_load (AnerleyAvatarCache     *cache,
+                                GLoadableIcon          *avatar,
+                                gboolean                urgent,
+                                AnerleyAvatarCacheFunc  func,
+                                gpointer                userdata);
+void anerley_avatar_cache_prioritise (AnerleyAvatarCache *cache,
+                                      GLoadableIcon      *avatar);
+void anerley_avatar_cache_cancel (AnerleyAvatarCache     *cache,
+                                  GLoadableIcon          *avatar,
+                                  AnerleyAvatarCacheFunc  func,
+                                  gpointer                userdata);
+
+G_END_DECLS
+
+#endif /* _ANERLEY_AVATAR_CACHE */
@@ -23,12 +23,12 @@
 
 #include "penge-magic-texture.h"
 
+#include "anerley-avatar-cache.h"
 #include "anerley-tile.h"
 #include "anerley-item.h"
 #include "anerley-tile-view.h"
 
 #include <glib/gi18n-lib.h>
-#include <gdk-pixbuf/gdk-pixbuf.h>
 
 G_DEFINE_TYPE (AnerleyTile, anerley_tile, MX_TYPE_WIDGET)
 
@@ -49,6 +49,10 @@ struct _AnerleyTilePrivate {
   ClutterActor *presence_label;
   ClutterActor *presence_icon;
 
+  /* Avatar being loaded by the avatar cache, if any */
+  GLoadableIcon *loading_avatar;
+  gboolean loading_avatar_urgent;
+
   guint update_presence_tooltip_idle_id;
 };
 
@@ -90,49 +94,84 @@ _get_default_avatar_texture (void)
   return handle;
 }
 
+static void
+_avatar_loaded_cb (AnerleyAvatarCache *cache,
+                   GLoadableIcon      *avatar,
+                   CoglHandle          texture,
+                   gpointer            userdata)
+{
+  AnerleyTilePrivate *priv = GET_PRIVATE (userdata);
+
+  g_clear_object (&priv->loading_avatar);
+
+  if (texture == COGL_INVALID_HANDLE)
+    return;
+
+  clutter_texture_set_cogl_texture ((ClutterTexture *)priv->avatar, texture);
+}
+
+static void
+anerley_tile_cancel_avatar_load (AnerleyTile *tile)
+{
+  AnerleyTilePrivate *priv = GET_PRIVATE (tile);
+
+  if (!priv->loading_avatar)
+    return;
+
+  anerley_avatar_cache_cancel (anerley_avatar_cache_get_default (),
+                               priv->loading_avatar,
+                               _avatar_loaded_cb,
+                               tile);
+  g_clear_object (&priv->loading_avatar);
+}
+
 static void
 _item_avatar_changed_cb (AnerleyItem *item,
                          gpointer     userdata)
 {
   AnerleyTilePrivate *priv = GET_PRIVATE (userdata);
+  AnerleyAvatarCache *cache = anerley_avatar_cache_get_default ();
   GLoadableIcon *avatar;
-  GInputStream *input;
-  GdkPixbufLoader *loader;
-  GdkPixbuf *pixbuf;
-  guchar buffer[512];
-  gssize count;
+  CoglHandle texture;
 
   avatar = anerley_item_get_avatar (priv->item);
 
-  if (!avatar)
-  {
-    clutter_texture_set_cogl_texture ((ClutterTexture *)priv->avatar,
-                                      _get_default_avatar_texture());
+  if (priv->loading_avatar && avatar &&
+      g_icon_equal (G_ICON (priv->loading_avatar), G_ICON (avatar)))
     return;
-  }
 
-  /* FIXME: Do it async */
-  input = g_loadable_icon_load (avatar, 48, NULL, NULL, NULL);
-  loader = gdk_pixbuf_loader_new ();
-  while ((count = g_input_stream_read (input, buffer, sizeof (buffer), NULL, NULL)) > 0)
+  anerley_tile_cancel_avatar_load ((AnerleyTile *)userdata);
+
+  if (avatar)
   {
-    gdk_pixbuf_loader_write (loader, buffer, count, NULL);
+    texture = anerley_avatar_cache_lookup (cache, avatar);
+
+    if (texture != COGL_INVALID_HANDLE)
+    {
+      clutter_texture_set_cogl_texture ((ClutterTexture *)priv->avatar,
+                                        texture);
+      return;
+    }
   }
-  gdk_pixbuf_loader_close (loader, NULL);
-
-  pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
-  clutter_texture_set_from_rgb_data ((ClutterTexture *)priv->avatar,
-                                     gdk_pixbuf_get_pixels (pixbuf),
-                                     gdk_pixbuf_get_has_alpha (pixbuf),
-                                     gdk_pixbuf_get_width (pixbuf),
-                                     gdk_pixbuf_get_height (pixbuf),
-                                     gdk_pixbuf_get_rowstride (pixbuf),
-                                     gdk_pixbuf_get_has_alpha (pixbuf) ? 4 : 3,
-                                     CLUTTER_TEXTURE_NONE,
-                                     NULL);
-
-  g_object_unref (loader);
-  g_object_unref (input);
+
+  /* Until the real one turns up */
+  clutter_texture_set_cogl_texture ((ClutterTexture *)priv->avatar,
+                                    _get_default_avatar_texture());
+
+  if (!avatar)
+    return;
+
+  /*
+   * Tiles are mapped whether or not they are scrolled into view; the load
+   * is bumped up the queue when the tile is first painted.
+   */
+  priv->loading_avatar = g_object_ref (avatar);
+  priv->loading_avatar_urgent = FALSE;
+  anerley_avatar_cache_load (cache,
+                             avatar,
+                             FALSE,
+                             _avatar_loaded_cb,
+                             userdata);
 }
 
 static void
@@ -243,6 +282,7 @@ anerley_tile_update_item (AnerleyTile *tile,
     g_signal_handlers_disconnect_by_func (priv->item,
                                           _item_presence_changed_cb,
                                           tile);
+    anerley_tile_cancel_avatar_load (tile);
     g_object_unref (priv->item);
     priv->item = NULL;
   }
@@ -356,6 +396,9 @@ anerley_tile_unmap (ClutterActor *actor)
 
   CLUTTER_ACTOR_CLASS (anerley_tile_parent_class)->unmap (actor);
 
+  /* Mapping again asks for the avatar again */
+  anerley_tile_cancel_avatar_load ((AnerleyTile *)actor);
+
   clutter_actor_unmap (priv->avatar_frame);
   clutter_actor_unmap (priv->primary_label);
   if (priv->presence_label)
@@ -369,6 +412,13 @@ anerley_tile_paint (ClutterActor *actor)
 {
   AnerleyTilePrivate *priv = GET_PRIVATE (actor);
 
+  if (priv->loading_avatar && !priv->loading_avatar_urgent)
+  {
+    anerley_avatar_cache_prioritise (anerley_avatar_cache_get_default (),
+                                     priv->loading_avatar);
+    priv->loading_avatar_urgent = TRUE;
+  }
+
   CLUTTER_ACTOR_CLASS (anerley_tile_parent_class)->paint (actor);
 
   clutter_actor_paint (priv->avatar_frame);
@@ -40,8 +40,16 @@ typedef struct _AnerleyTpFeedPrivate AnerleyTpFeedPrivate;
 struct _AnerleyTpFeedPrivate {
   FolksIndividualAggregator *aggregator;
   GHashTable *ids_to_items;
+
+  /* Changes not announced yet: ids to individuals and to items */
+  GHashTable *pending_added;
+  GHashTable *pending_removed;
+  guint flush_id;
 };
 
+/* How long to collect changes for once the aggregator is quiescent */
+#define FLUSH_TIMEOUT 100
+
 enum
 {
   PROP_0,
@@ -83,8 +91,19 @@ anerley_tp_feed_dispose (GObject *object)
 {
   AnerleyTpFeedPrivate *priv = GET_PRIVATE (object);
 
+  if (priv->flush_id)
+  {
+    g_source_remove (priv->flush_id);
+    priv->flush_id = 0;
+  }
+
+  if (priv->aggregator)
+    g_signal_handlers_disconnect_by_data (priv->aggregator, object);
+
   g_clear_object (&priv->aggregator);
   tp_clear_pointer (&priv->ids_to_items, g_hash_table_unref);
+  tp_clear_pointer (&priv->pending_added, g_hash_table_unref);
+  tp_clear_pointer (&priv->pending_removed, g_hash_table_unref);
 
   G_OBJECT_CLASS (anerley_tp_feed_parent_class)->dispose (object);
 }
@@ -106,6 +125,99 @@ _make_item_from_contact (AnerleyTpFeed *feed,
   return item;
 }
 
+/*
+ * Announces everything that changed since the last flush as one batch, so
+ * the model is only resorted and refiltered once; the items of the added
+ * individuals are only made now.
+ */
+static void
+_flush_pending_changes (AnerleyTpFeed *self)
+{
+  AnerleyTpFeedPrivate *priv = GET_PRIVATE (self);
+  GHashTableIter iter;
+  gpointer key, value;
+  GList *added_set = NULL, *removed_set = NULL;
+
+  if (priv->flush_id)
+  {
+    g_source_remove (priv->flush_id);
+    priv->flush_id = 0;
+  }
+
+  g_hash_table_iter_init (&iter, priv->pending_removed);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+  {
+    removed_set = g_list_prepend (removed_set, value);
+    g_hash_table_iter_steal (&iter);
+    g_free (key);
+  }
+
+  g_hash_table_iter_init (&iter, priv->pending_added);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+  {
+    AnerleyItem *item;
+
+    /* anerley_tp_feed_get_item_by_uid() may have made it already */
+    item = g_hash_table_lookup (priv->ids_to_items, key);
+    if (item == NULL)
+      item = _make_item_from_contact (self, value);
+
+    added_set = g_list_prepend (added_set, g_object_ref (item));
+  }
+  g_hash_table_remove_all (priv->pending_added);
+
+  if (removed_set != NULL)
+  {
+    g_signal_emit_by_name (self, "items-removed", removed_set);
+    g_list_free_full (removed_set, g_object_unref);
+  }
+
+  if (added_set != NULL)
+  {
+    g_signal_emit_by_name (self, "items-added", added_set);
+    g_list_free_full (added_set, g_object_unref);
+  }
+}
+
+static gboolean
+_flush_timeout_cb (gpointer userdata)
+{
+  AnerleyTpFeedPrivate *priv = GET_PRIVATE (userdata);
+
+  priv->flush_id = 0;
+  _flush_pending_changes (ANERLEY_TP_FEED (userdata));
+
+  return FALSE;
+}
+
+/*
+ * While the aggregator is preparing it sends the roster in many small
+ * pieces, so we hold on to the changes until it is quiescent; after that,
+ * changes arriving close together are still collected for a short while.
+ */
+static void
+_queue_flush (AnerleyTpFeed *self)
+{
+  AnerleyTpFeedPrivate *priv = GET_PRIVATE (self);
+
+  if (priv->flush_id)
+    return;
+
+  if (!folks_individual_aggregator_get_is_quiescent (priv->aggregator))
+    return;
+
+  priv->flush_id = g_timeout_add (FLUSH_TIMEOUT, _flush_timeout_cb, self);
+}
+
+static void
+aggregator_is_quiescent_notify_cb (FolksIndividualAggregator *aggregator,
+                                   GParamSpec                *pspec,
+                                   AnerleyTpFeed             *self)
+{
+  if (folks_individual_aggregator_get_is_quiescent (aggregator))
+    _flush_pending_changes (self);
+}
+
 /* Modified code from empathy, with copyright holder permission */
 static void
 aggregator_individuals_changed_cb (FolksIndividualAggregator *aggregator,
@@ -116,7 +228,6 @@ aggregator_individuals_changed_cb (FolksIndividualAggregator *aggregator,
   GeeIterator *iter;
   GeeSet *removed;
   GeeCollection *added;
-  GList *added_set = NULL, *removed_set = NULL;
 
   /* We're not interested in the relationships between the added and removed
    * individuals, so just extract collections of them. Note that the added
@@ -130,22 +241,30 @@ aggregator_individuals_changed_cb (FolksIndividualAggregator *aggregator,
   while (gee_iterator_next (iter))
   {
     FolksIndividual *ind = gee_iterator_get (iter);
-    AnerleyItem *item;
+    const gchar *id;
+    gpointer key, item;
 
     if (ind == NULL)
       continue;
 
-    item = g_hash_table_lookup (priv->ids_to_items,
-                               folks_individual_get_id (ind));
-    if (item == NULL)
+    id = folks_individual_get_id (ind);
+
+    /* Never announced, so there is nothing to take back */
+    if (g_hash_table_remove (priv->pending_added, id))
+    {
+      g_hash_table_remove (priv->ids_to_items, id);
+      g_object_unref (ind);
+      continue;
+    }
+
+    if (!g_hash_table_lookup_extended (priv->ids_to_items, id, &key, &item))
     {
       g_object_unref (ind);
       continue;
     }
 
-    removed_set = g_list_prepend (removed_set, g_object_ref (item));
-    g_hash_table_remove (priv->ids_to_items,
-                         folks_individual_get_id (ind));
+    g_hash_table_steal (priv->ids_to_items, id);
+    g_hash_table_replace (priv->pending_removed, key, item);
 
     g_clear_object (&ind);
   }
@@ -155,40 +274,31 @@ aggregator_individuals_changed_cb (FolksIndividualAggregator *aggregator,
   while (gee_iterator_next (iter))
   {
     FolksIndividual *ind = gee_iterator_get (iter);
-    AnerleyItem *item;
+    const gchar *id;
 
     if (ind == NULL)
       continue;
 
-    item = g_hash_table_lookup (priv->ids_to_items,
-        folks_individual_get_id (ind));
-    if (item != NULL)
+    id = folks_individual_get_id (ind);
+
+    if (g_hash_table_lookup (priv->ids_to_items, id) != NULL ||
+        g_hash_table_lookup (priv->pending_added, id) != NULL)
     {
       g_object_unref (ind);
       continue;
     }
 
-    item = _make_item_from_contact (self, ind);
-    added_set = g_list_prepend (added_set, g_object_ref (item));
-
-    g_clear_object (&ind);
+    /* Move the ownership of the reference to the hash table */
+    g_hash_table_insert (priv->pending_added, g_strdup (id), ind);
   }
   g_clear_object (&iter);
 
-  if (removed_set != NULL)
-  {
-    g_signal_emit_by_name (self, "items-removed", removed_set);
-    g_list_free_full (removed_set, g_object_unref);
-  }
-
-  if (added_set != NULL)
-  {
-    g_signal_emit_by_name (self, "items-added", added_set);
-    g_list_free_full (added_set, g_object_unref);
-  }
-
   g_object_unref (added);
   g_object_unref (removed);
+
+  if (g_hash_table_size (priv->pending_added) > 0 ||
+      g_hash_table_size (priv->pending_removed) > 0)
+    _queue_flush (self);
 }
 
 static void
@@ -202,6 +312,9 @@ anerley_tp_feed_constructed (GObject *object)
   g_signal_connect (priv->aggregator, "individuals-changed-detailed",
                     G_CALLBACK (aggregator_individuals_changed_cb),
                     self);
+  g_signal_connect (priv->aggregator, "notify::is-quiescent",
+                    G_CALLBACK (aggregator_is_quiescent_notify_cb),
+                    self);
   folks_individual_aggregator_prepare (priv->aggregator, NULL, NULL);
 }
 
@@ -235,6 +348,14 @@ anerley_tp_feed_init (AnerleyTpFeed *self)
                                               g_str_equal,
                                               g_free,
                                               (GDestroyNotify)g_object_unref);
+  priv->pending_added = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               g_free,
+                                               (GDestroyNotify)g_object_unref);
+  priv->pending_removed = g_hash_table_new_full (g_str_hash,
+                                                 g_str_equal,
+                                                 g_free,
+                                                 (GDestroyNotify)g_object_unref);
 }
 
 AnerleyTpFeed *
@@ -257,6 +378,17 @@ anerley_tp_feed_get_item_by_uid (AnerleyTpFeed *feed,
                                  const gchar   *uid)
 {
   AnerleyTpFeedPrivate *priv = GET_PRIVATE (feed);
+  AnerleyItem *item;
+  FolksIndividual *ind;
+
+  item = g_hash_table_lookup (priv->ids_to_items, uid);
+  if (item != NULL)
+    return item;
 
-  return g_hash_table_lookup (priv->ids_to_items, uid);
+  /* Not announced yet; the item made here is reused when it is */
+  ind = g_hash_table_lookup (priv->pending_added, uid);
+  if (ind != NULL)
+    item = _make_item_from_contact (feed, ind);
+
+  return item;
 }
@@ -0,0 +1,219 @@
+/*
+ * Anerley - people feeds and widgets
+ * Copyright (C) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <anerley/anerley-feed.h>
+#include <anerley/anerley-feed-model.h>
+#include <anerley/anerley-item.h>
+
+#include <clutter/clutter.h>
+
+#include "dawati-bench.h"
+
+/*
+ * A feed with no backend of its own; the benchmark pushes synthetic items
+ * through it with the same signal AnerleyTpFeed uses.
+ */
+typedef GObject      BenchFeed;
+typedef GObjectClass BenchFeedClass;
+
+static GType bench_feed_get_type (void);
+
+G_DEFINE_TYPE_WITH_CODE (BenchFeed, bench_feed, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (ANERLEY_TYPE_FEED, NULL));
+
+static void
+bench_feed_class_init (BenchFeedClass *klass)
+{
+}
+
+static void
+bench_feed_init (BenchFeed *self)
+{
+}
+
+static const gchar *first_names[] = {
+  "Alice", "Bob", "Carol", "Dave", "Eve", "Frank", "Grace", "Heidi"
+};
+
+static const gchar *needles[] = {
+  "a", "al", "alice", "ce 1", "grace 99", "zzz"
+};
+
+static const FolksPresenceType presences[] = {
+  FOLKS_PRESENCE_TYPE_AVAILABLE,
+  FOLKS_PRESENCE_TYPE_AWAY,
+  FOLKS_PRESENCE_TYPE_BUSY,
+  FOLKS_PRESENCE_TYPE_OFFLINE
+};
+
+typedef struct
+{
+  BenchFeed    *feed;
+  ClutterModel *model;
+  GList        *items;
+} BenchData;
+
+static void
+reset_model (gpointer data)
+{
+  BenchData *bench = data;
+
+  if (bench->model)
+    g_object_unref (bench->model);
+
+  bench->model = anerley_feed_model_new (ANERLEY_FEED (bench->feed));
+}
+
+static void
+items_added (gpointer data)
+{
+  BenchData *bench = data;
+
+  g_signal_emit_by_name (bench->feed, "items-added", bench->items);
+}
+
+/* What a view does on filter-changed: walk the rows the filter lets through */
+static guint
+count_rows (ClutterModel *model)
+{
+  ClutterModelIter *iter;
+  guint             n = 0;
+
+  iter = clutter_model_get_first_iter (model);
+
+  while (iter && !clutter_model_iter_is_last (iter))
+    {
+      n++;
+      clutter_model_iter_next (iter);
+    }
+
+  if (iter)
+    g_object_unref (iter);
+
+  return n;
+}
+
+static void
+filter_text (gpointer data)
+{
+  BenchData *bench = data;
+  guint      i;
+
+  for (i = 0; i < G_N_ELEMENTS (needles); i++)
+    {
+      anerley_feed_model_set_filter_text (ANERLEY_FEED_MODEL (bench->model),
+                                          needles[i]);
+      count_rows (bench->model);
+    }
+
+  anerley_feed_model_set_filter_text (ANERLEY_FEED_MODEL (bench->model), NULL);
+}
+
+static void
+show_offline (gpointer data)
+{
+  BenchData *bench = data;
+
+  anerley_feed_model_set_show_offline (ANERLEY_FEED_MODEL (bench->model),
+                                       TRUE);
+  count_rows (bench->model);
+  anerley_feed_model_set_show_offline (ANERLEY_FEED_MODEL (bench->model),
+                                       FALSE);
+  count_rows (bench->model);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  DawatiBench  bench;
+  BenchData    data = { NULL, };
+  gboolean     named = TRUE;
+  gint         i;
+
+  g_type_init ();
+
+  dawati_bench_init (&bench, "anerley-feed-model", &argc, &argv);
+
+  data.feed = g_object_new (bench_feed_get_type (), NULL);
+
+  for (i = 0; i < bench.size; i++)
+    {
+      FolksIndividual *individual;
+      AnerleyItem     *item;
+      gchar           *alias;
+
+      /*
+       * Individuals without personas: the alias and presence are set on the
+       * individual directly, as no backend is involved.
+       */
+      individual = folks_individual_new (NULL);
+      alias = g_strdup_printf ("%s %d",
+                               first_names[i % G_N_ELEMENTS (first_names)], i);
+      g_object_set (individual, "alias", alias, NULL);
+
+      item = anerley_item_new (individual);
+      g_free (alias);
+
+      if (!anerley_item_get_display_name (item))
+        {
+          g_object_unref (item);
+          g_object_unref (individual);
+          named = FALSE;
+          break;
+        }
+
+      g_object_set (individual,
+                    "presence-type", presences[i % G_N_ELEMENTS (presences)],
+                    NULL);
+      g_object_unref (individual);
+
+      data.items = g_list_prepend (data.items, item);
+    }
+
+  /* The model sorts and filters on the display name, so it cannot be NULL */
+  if (!named)
+    {
+      const gchar *reason = "folks does not keep an alias without personas";
+
+      dawati_bench_skip (&bench, "items-added", reason);
+      dawati_bench_skip (&bench, "filter-text", reason);
+      dawati_bench_skip (&bench, "show-offline", reason);
+    }
+  else
+    {
+      dawati_bench_run (&bench, "items-added", bench.size,
+                        reset_model, items_added, &data);
+
+      /* The model is left populated by the last items-added run */
+      dawati_bench_run (&bench, "filter-text",
+                        bench.size * G_N_ELEMENTS (needles),
+                        NULL, filter_text, &data);
+      dawati_bench_run (&bench, "show-offline", bench.size * 2,
+                        NULL, show_offline, &data);
+    }
+
+  if (data.model)
+    g_object_unref (data.model);
+
+  g_list_free_full (data.items, g_object_unref);
+  g_object_unref (data.feed);
+
+  return dawati_bench_finish (&bench);
+}
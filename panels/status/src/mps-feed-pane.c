@@ -51,6 +51,8 @@
 
 G_DEFINE_TYPE (MpsFeedPane, mps_feed_pane, MX_TYPE_TABLE)
 
+#define STATUS_SETTINGS_SCHEMA "org.dawati.shell.panels.status"
+
 #define GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), MPS_TYPE_FEED_PANE, MpsFeedPanePrivate))
 
@@ -61,6 +63,7 @@ struct _MpsFeedPanePrivate {
   SwClientService *service;
   SwClientItemView *view;
   MpsViewBridge *bridge;
+  GSettings *settings;
 
   ClutterActor *update_hbox;
   ClutterActor *entry;
@@ -157,6 +160,12 @@ mps_feed_pane_dispose (GObject *object)
     priv->view = NULL;
   }
 
+  if (priv->settings)
+  {
+    g_object_unref (priv->settings);
+    priv->settings = NULL;
+  }
+
   if (priv->bridge)
   {
     g_object_unref (priv->bridge);
@@ -605,6 +614,11 @@ mps_feed_pane_init (MpsFeedPane *self)
   mps_view_bridge_set_container (priv->bridge,
                                  CLUTTER_CONTAINER (priv->box_layout));
 
+  priv->settings = g_settings_new (STATUS_SETTINGS_SCHEMA);
+  g_settings_bind (priv->settings, "max-items",
+                   priv->bridge, "max-items",
+                   G_SETTINGS_BIND_GET);
+
   priv->something_wrong_frame = mx_frame_new ();
   priv->something_wrong_label = mx_label_new_with_text (SOMETHING_WRONG_TEXT);
   mx_stylable_set_style_class (MX_STYLABLE (priv->something_wrong_label),
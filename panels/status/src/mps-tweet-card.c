@@ -510,7 +510,13 @@ mps_tweet_card_set_item (MpsTweetCard *card,
   GError *error = NULL;
   ClutterActor *tmp_text;
 
-  priv->item = sw_item_ref (item);
+  /* Cards are reused for newer items by the view bridge */
+  sw_item_ref (item);
+
+  if (priv->item)
+    sw_item_unref (priv->item);
+
+  priv->item = item;
 
   author_icon = sw_item_get_value (item, "authoricon");
 
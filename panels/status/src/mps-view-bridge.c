@@ -17,6 +17,8 @@
  * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <mx/mx.h>
+
 #include "mps-view-bridge.h"
 #include "mps-tweet-card.h"
 
@@ -31,30 +33,52 @@ struct _MpsViewBridgePrivate {
   SwClientItemView *view;
   ClutterContainer *container;
 
-  GHashTable *item_uid_to_actor;
+  /* Of MpsViewBridgeCard, newest (top) first */
+  GQueue *cards;
+  GHashTable *item_uid_to_card;
+  guint max_items;
+  ClutterActor *bottom_actor;
+
   ClutterScore *score;
 
   GList *actors_to_animate;
+  guint n_actors_to_animate;
   ClutterTimeline *current_timeline;
+  ClutterActor *animating_actor;
+  ClutterBehaviour *animating_behaviour;
 
   MpsViewBridgeFactoryFunc func;
   gpointer userdata;
 
+  MxAdjustment *vadjustment;
+  guint tick;
   guint refresh_id;
 };
 
+/*
+ * A card actor and the item it currently shows. Once max_items cards exist
+ * the oldest one is handed the next new item instead of creating another.
+ */
+typedef struct {
+  ClutterActor *actor;
+  gchar *uid;
+  guint tick; /* When the time label was last brought up to date */
+} MpsViewBridgeCard;
+
 enum
 {
   PROP_0,
   PROP_VIEW,
-  PROP_CONTAINER
+  PROP_CONTAINER,
+  PROP_MAX_ITEMS
 };
 
 #define THRESHOLD 5
 #define CARD_HEIGHT 84.0
-#define REFRESH_TIME (600) /* 10 min */
+#define DEFAULT_MAX_ITEMS 50
+#define REFRESH_TIME (60) /* 1 min */
 
-gboolean _view_refresh_items_cb (MpsViewBridge *bridge);
+static gboolean _view_refresh_items_cb (MpsViewBridge *bridge);
 
 static void
 mps_view_bridge_get_property (GObject *object, guint property_id,
@@ -69,6 +93,9 @@ mps_view_bridge_get_property (GObject *object, guint property_id,
     case PROP_CONTAINER:
       g_value_set_object (value, mps_view_bridge_get_container (bridge));
       break;
+    case PROP_MAX_ITEMS:
+      g_value_set_uint (value, mps_view_bridge_get_max_items (bridge));
+      break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
@@ -89,11 +116,27 @@ mps_view_bridge_set_property (GObject *object, guint property_id,
       mps_view_bridge_set_container (bridge,
                                      (ClutterContainer *)g_value_get_object (value));
       break;
+    case PROP_MAX_ITEMS:
+      mps_view_bridge_set_max_items (bridge, g_value_get_uint (value));
+      break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
   }
 }
 
+static void _vadjustment_value_notify_cb (MxAdjustment  *adjustment,
+                                          GParamSpec    *pspec,
+                                          MpsViewBridge *bridge);
+static void _stop_running_animation (MpsViewBridge *bridge);
+
+static void
+_card_free (MpsViewBridgeCard *card)
+{
+  clutter_actor_destroy (card->actor);
+  g_free (card->uid);
+  g_slice_free (MpsViewBridgeCard, card);
+}
+
 static void
 mps_view_bridge_dispose (GObject *object)
 {
@@ -105,16 +148,35 @@ mps_view_bridge_dispose (GObject *object)
     priv->refresh_id = 0;
   }
 
+  if (priv->vadjustment)
+  {
+    g_signal_handlers_disconnect_by_func (priv->vadjustment,
+                                          _vadjustment_value_notify_cb,
+                                          object);
+    g_object_unref (priv->vadjustment);
+    priv->vadjustment = NULL;
+  }
+
   if (priv->score)
   {
     g_object_unref (priv->score);
     priv->score = NULL;
   }
 
-  if (priv->item_uid_to_actor)
+  if (priv->cards)
   {
-    g_hash_table_unref (priv->item_uid_to_actor);
-    priv->item_uid_to_actor = NULL;
+    _stop_running_animation (MPS_VIEW_BRIDGE (object));
+    g_list_free (priv->actors_to_animate);
+    priv->actors_to_animate = NULL;
+    priv->n_actors_to_animate = 0;
+
+    g_hash_table_unref (priv->item_uid_to_card);
+    priv->item_uid_to_card = NULL;
+
+    g_queue_foreach (priv->cards, (GFunc)_card_free, NULL);
+    g_queue_free (priv->cards);
+    priv->cards = NULL;
+    priv->bottom_actor = NULL;
   }
 
   if (priv->view)
@@ -143,6 +205,36 @@ mps_view_bridge_class_init (MpsViewBridgeClass *klass)
   object_class->set_property = mps_view_bridge_set_property;
   object_class->dispose = mps_view_bridge_dispose;
   object_class->finalize = mps_view_bridge_finalize;
+
+  g_object_class_install_property (object_class,
+                                   PROP_MAX_ITEMS,
+                                   g_param_spec_uint ("max-items",
+                                                      "Maximum items",
+                                                      "Number of items kept "
+                                                      "in the container",
+                                                      1,
+                                                      G_MAXUINT,
+                                                      DEFAULT_MAX_ITEMS,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+}
+
+/*
+ * The relative times go no finer than minutes, so refresh them on the minute
+ * rather than at some arbitrary offset from when the panel started.
+ */
+static gboolean
+_view_refresh_align_cb (MpsViewBridge *bridge)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+
+  _view_refresh_items_cb (bridge);
+
+  priv->refresh_id = g_timeout_add_seconds (REFRESH_TIME,
+                                            (GSourceFunc) _view_refresh_items_cb,
+                                            bridge);
+
+  return FALSE;
 }
 
 static void
@@ -150,15 +242,17 @@ mps_view_bridge_init (MpsViewBridge *self)
 {
   MpsViewBridgePrivate *priv = GET_PRIVATE (self);
 
-  priv->item_uid_to_actor = g_hash_table_new_full (g_str_hash,
-                                                   g_str_equal,
-                                                   g_free,
-                                                   (GDestroyNotify)clutter_actor_destroy);
+  GTimeVal now;
 
-  priv->refresh_id = g_timeout_add_seconds (REFRESH_TIME,
-                                            (GSourceFunc) _view_refresh_items_cb,
-                                            self);
+  priv->cards = g_queue_new ();
+  priv->item_uid_to_card = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->max_items = DEFAULT_MAX_ITEMS;
 
+  g_get_current_time (&now);
+  priv->refresh_id =
+    g_timeout_add_seconds (REFRESH_TIME - now.tv_sec % REFRESH_TIME,
+                           (GSourceFunc) _view_refresh_align_cb,
+                           self);
 }
 
 MpsViewBridge *
@@ -308,6 +402,16 @@ _animation_completed_cb (ClutterAnimation *animation,
   MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
 
   priv->current_timeline = NULL;
+  priv->animating_actor = NULL;
+
+  /* The opacity fade may still be finishing; don't let it clear the slot
+   * once it belongs to the next card */
+  if (priv->animating_behaviour)
+  {
+    g_object_remove_weak_pointer (G_OBJECT (priv->animating_behaviour),
+                                  (gpointer *)&priv->animating_behaviour);
+    priv->animating_behaviour = NULL;
+  }
 
   _do_next_card_animation (bridge);
 }
@@ -330,8 +434,9 @@ _do_next_card_animation (MpsViewBridge *bridge)
 
   /* Get current actor and update head of list */
   actor = (ClutterActor *)priv->actors_to_animate->data;
-  priv->actors_to_animate = g_list_remove (priv->actors_to_animate,
-                                           actor);
+  priv->actors_to_animate = g_list_delete_link (priv->actors_to_animate,
+                                                priv->actors_to_animate);
+  priv->n_actors_to_animate--;
 
   animation = clutter_actor_animate (actor,
                                      CLUTTER_LINEAR,
@@ -343,6 +448,7 @@ _do_next_card_animation (MpsViewBridge *bridge)
   clutter_timeline_set_delay (timeline, 600);
   clutter_timeline_start (timeline);
   priv->current_timeline = timeline;
+  priv->animating_actor = actor;
 
   opacity_timeline = clutter_timeline_new (150);
   clutter_timeline_set_delay (opacity_timeline, 850);
@@ -352,6 +458,9 @@ _do_next_card_animation (MpsViewBridge *bridge)
                                           0,
                                           255);
   clutter_behaviour_apply (behave, actor);
+  priv->animating_behaviour = behave;
+  g_object_add_weak_pointer (G_OBJECT (behave),
+                             (gpointer *)&priv->animating_behaviour);
   g_signal_connect_swapped (opacity_timeline,
                             "completed",
                             (GCallback)g_object_unref,
@@ -364,23 +473,222 @@ _do_next_card_animation (MpsViewBridge *bridge)
                           bridge);
 }
 
-gboolean
-_view_refresh_items_cb (MpsViewBridge *bridge)
+/* Cards scrolled out of view or on a hidden panel are left alone */
+static gboolean
+_card_is_visible (MpsViewBridge     *bridge,
+                  MpsViewBridgeCard *card)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+  ClutterActorBox box;
+  gdouble value, page_size;
+
+  if (!CLUTTER_ACTOR_IS_MAPPED (card->actor))
+    return FALSE;
+
+  if (!priv->vadjustment)
+    return TRUE;
+
+  mx_adjustment_get_values (priv->vadjustment, &value, NULL, NULL,
+                            NULL, NULL, &page_size);
+  clutter_actor_get_allocation_box (card->actor, &box);
+
+  return (box.y2 > value && box.y1 < value + page_size);
+}
+
+static void
+_refresh_visible_cards (MpsViewBridge *bridge)
 {
   MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
-  GHashTableIter iter;
-  gpointer key;
-  MpsTweetCard *card;
+  GList *l;
+  gboolean seen_visible = FALSE;
+
+  for (l = priv->cards->head; l; l = l->next)
+  {
+    MpsViewBridgeCard *card = (MpsViewBridgeCard *)l->data;
+
+    if (!_card_is_visible (bridge, card))
+    {
+      /* The visible cards are contiguous */
+      if (seen_visible)
+        break;
+
+      continue;
+    }
+
+    seen_visible = TRUE;
 
-  g_hash_table_iter_init (&iter, priv->item_uid_to_actor);
+    if (card->tick != priv->tick)
+    {
+      card->tick = priv->tick;
 
-  while (g_hash_table_iter_next (&iter, &key, (gpointer *) &card)) {
-    mps_tweet_card_refresh (card);
+      if (MPS_IS_TWEET_CARD (card->actor))
+        mps_tweet_card_refresh (MPS_TWEET_CARD (card->actor));
+    }
   }
+}
+
+static gboolean
+_view_refresh_items_cb (MpsViewBridge *bridge)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+
+  /* Everything else catches up as it is scrolled into view */
+  priv->tick++;
+  _refresh_visible_cards (bridge);
 
   return TRUE;
 }
 
+static void
+_vadjustment_value_notify_cb (MxAdjustment  *adjustment,
+                              GParamSpec    *pspec,
+                              MpsViewBridge *bridge)
+{
+  _refresh_visible_cards (bridge);
+}
+
+static void
+_container_vadjustment_notify_cb (ClutterContainer *container,
+                                  GParamSpec       *pspec,
+                                  MpsViewBridge    *bridge)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+  MxAdjustment *vadjustment = NULL;
+
+  mx_scrollable_get_adjustments (MX_SCROLLABLE (container),
+                                 NULL,
+                                 &vadjustment);
+
+  if (vadjustment == priv->vadjustment)
+    return;
+
+  if (priv->vadjustment)
+  {
+    g_signal_handlers_disconnect_by_func (priv->vadjustment,
+                                          _vadjustment_value_notify_cb,
+                                          bridge);
+    g_object_unref (priv->vadjustment);
+    priv->vadjustment = NULL;
+  }
+
+  if (vadjustment)
+  {
+    priv->vadjustment = g_object_ref (vadjustment);
+    g_signal_connect (priv->vadjustment,
+                      "notify::value",
+                      (GCallback)_vadjustment_value_notify_cb,
+                      bridge);
+  }
+}
+
+/* Cuts the slide-in that is running short, leaving the card fully shown */
+static void
+_stop_running_animation (MpsViewBridge *bridge)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+  ClutterActor *actor = priv->animating_actor;
+  ClutterAnimation *animation;
+
+  if (!actor)
+    return;
+
+  animation = clutter_actor_get_animation (actor);
+  if (animation)
+  {
+    g_signal_handlers_disconnect_by_func (animation,
+                                          _animation_completed_cb,
+                                          bridge);
+    clutter_actor_detach_animation (actor);
+  }
+
+  if (priv->animating_behaviour)
+  {
+    g_object_remove_weak_pointer (G_OBJECT (priv->animating_behaviour),
+                                  (gpointer *)&priv->animating_behaviour);
+    clutter_behaviour_remove (priv->animating_behaviour, actor);
+    priv->animating_behaviour = NULL;
+  }
+
+  priv->current_timeline = NULL;
+  priv->animating_actor = NULL;
+
+  clutter_actor_set_height (actor, CARD_HEIGHT);
+  clutter_actor_set_opacity (actor, 255);
+}
+
+static void
+_card_stop_pending_animation (MpsViewBridge     *bridge,
+                              MpsViewBridgeCard *card)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+  GList *link;
+
+  if (card->actor == priv->animating_actor)
+  {
+    _stop_running_animation (bridge);
+    return;
+  }
+
+  link = g_list_find (priv->actors_to_animate, card->actor);
+
+  if (link)
+  {
+    priv->actors_to_animate = g_list_delete_link (priv->actors_to_animate,
+                                                  link);
+    priv->n_actors_to_animate--;
+
+    clutter_actor_set_height (card->actor, CARD_HEIGHT);
+    clutter_actor_set_opacity (card->actor, 255);
+  }
+}
+
+static void
+_update_bottom_actor (MpsViewBridge *bridge)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+  MpsViewBridgeCard *bottom;
+
+  bottom = (MpsViewBridgeCard *)g_queue_peek_tail (priv->cards);
+
+  if (!bottom || bottom->actor == priv->bottom_actor)
+    return;
+
+  if (priv->bottom_actor)
+    mx_stylable_set_style_class (MX_STYLABLE (priv->bottom_actor), NULL);
+
+  priv->bottom_actor = bottom->actor;
+  mx_stylable_set_style_class (MX_STYLABLE (priv->bottom_actor),
+                               "mps-tweet-card-last");
+}
+
+/* Drop the oldest cards until no more than max_items are left */
+static void
+_trim_cards (MpsViewBridge *bridge)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+
+  while (g_queue_get_length (priv->cards) > priv->max_items)
+  {
+    MpsViewBridgeCard *card;
+
+    card = (MpsViewBridgeCard *)g_queue_pop_tail (priv->cards);
+
+    _card_stop_pending_animation (bridge, card);
+    g_hash_table_remove (priv->item_uid_to_card, card->uid);
+
+    if (card->actor == priv->bottom_actor)
+      priv->bottom_actor = NULL;
+
+    _card_free (card);
+  }
+
+  _update_bottom_actor (bridge);
+
+  /* Carry on with the rest if the running animation was cut short */
+  if (!priv->current_timeline)
+    _do_next_card_animation (bridge);
+}
+
 static void
 _view_items_added_cb (SwClientItemView *view,
                       GList            *items,
@@ -390,7 +698,6 @@ _view_items_added_cb (SwClientItemView *view,
   gint item_count = 0;
   GList *l;
   gint i = 0;
-  static ClutterActor *bottom_actor = NULL;
 
   g_debug (G_STRLOC ": %s called", G_STRFUNC);
 
@@ -400,38 +707,78 @@ _view_items_added_cb (SwClientItemView *view,
 
   item_count = g_list_length (items);
 
+  /* Items that would be pushed straight out again are not worth a card */
+  l = items;
+  if (item_count > priv->max_items)
+  {
+    l = g_list_nth (items, item_count - priv->max_items);
+    item_count = priv->max_items;
+  }
 
-  for (l = items; l; l = l->next)
+  for (; l; l = l->next)
   {
     SwItem *item = (SwItem *)l->data;
+    MpsViewBridgeCard *card;
     ClutterActor *actor;
 
-    if (priv->func)
+    card = g_hash_table_lookup (priv->item_uid_to_card, item->uuid);
+
+    if (card)
+    {
+      g_object_set (card->actor,
+                    "item", item,
+                    NULL);
+      i++;
+      continue;
+    }
+
+    if (g_queue_get_length (priv->cards) >= priv->max_items)
     {
-      actor = priv->func (bridge, item, priv->userdata);
+      /* Recycle the oldest card for the new item */
+      card = (MpsViewBridgeCard *)g_queue_pop_tail (priv->cards);
+
+      _card_stop_pending_animation (bridge, card);
+      g_hash_table_remove (priv->item_uid_to_card, card->uid);
+      g_free (card->uid);
+
+      actor = card->actor;
+      g_object_set (actor,
+                    "item", item,
+                    NULL);
     } else {
-      actor = g_object_new (MPS_TYPE_TWEET_CARD,
-                            "item", item,
-                            NULL);
+      if (priv->func)
+      {
+        actor = priv->func (bridge, item, priv->userdata);
+      } else {
+        actor = g_object_new (MPS_TYPE_TWEET_CARD,
+                              "item", item,
+                              NULL);
+      }
+
+      clutter_container_add_actor (CLUTTER_CONTAINER (priv->container),
+                                   actor);
+
+      clutter_container_child_set (CLUTTER_CONTAINER (priv->container),
+                                   actor,
+                                   "x-fill", TRUE,
+                                   "y-fill", FALSE,
+                                   "expand", FALSE,
+                                   NULL);
+
+      card = g_slice_new0 (MpsViewBridgeCard);
+      card->actor = actor;
     }
 
-    clutter_container_add_actor (CLUTTER_CONTAINER (priv->container),
-                                 actor);
+    /* Setting the item brought the time label up to date */
+    card->uid = g_strdup (item->uuid);
+    card->tick = priv->tick;
 
-    g_hash_table_insert (priv->item_uid_to_actor,
-                         g_strdup (item->uuid),
-                         actor);
+    g_queue_push_head (priv->cards, card);
+    g_hash_table_insert (priv->item_uid_to_card, card->uid, card);
 
     /* Position it at the top */
     clutter_container_lower_child (priv->container, actor, NULL);
 
-    clutter_container_child_set (CLUTTER_CONTAINER (priv->container),
-                                 actor,
-                                 "x-fill", TRUE,
-                                 "y-fill", FALSE,
-                                 "expand", FALSE,
-                                 NULL);
-
     if (i < item_count - THRESHOLD)
     {
       clutter_actor_set_height (actor, CARD_HEIGHT);
@@ -439,27 +786,26 @@ _view_items_added_cb (SwClientItemView *view,
       clutter_actor_set_height (actor, 0);
       priv->actors_to_animate = g_list_append (priv->actors_to_animate,
                                                actor);
+      priv->n_actors_to_animate++;
       clutter_actor_set_opacity (actor, 0);
     }
 
-    if (!bottom_actor)
-    {
-      bottom_actor = actor;
-      mx_stylable_set_style_class (MX_STYLABLE (actor), "mps-tweet-card-last");
-    }
-
     i++;
   }
 
+  _update_bottom_actor (bridge);
+
   /* Deal with the overflow on the pending items */
-  while (g_list_length (priv->actors_to_animate) > THRESHOLD)
+  while (priv->n_actors_to_animate > THRESHOLD)
   {
     ClutterActor *actor = (ClutterActor *)priv->actors_to_animate->data;
 
     clutter_actor_set_height (actor, CARD_HEIGHT);
     clutter_actor_set_opacity (actor, 255);
 
-    priv->actors_to_animate = g_list_remove (priv->actors_to_animate, actor);
+    priv->actors_to_animate = g_list_delete_link (priv->actors_to_animate,
+                                                  priv->actors_to_animate);
+    priv->n_actors_to_animate--;
   }
 
   /* We have a started chain of animations */
@@ -486,16 +832,17 @@ _view_items_changed_cb (SwClientItemView *view,
   for (l = items; l; l = l->next)
   {
     SwItem *item = (SwItem *)l->data;
-    ClutterActor *actor;
+    MpsViewBridgeCard *card;
 
-    actor = g_hash_table_lookup (priv->item_uid_to_actor,
-                                 item->uuid);
+    card = g_hash_table_lookup (priv->item_uid_to_card,
+                                item->uuid);
 
-    if (actor)
+    if (card)
     {
-      g_object_set (actor,
+      g_object_set (card->actor,
                     "item", item,
                     NULL);
+      card->tick = priv->tick;
     }
   }
 }
@@ -547,6 +894,41 @@ mps_view_bridge_set_container (MpsViewBridge    *bridge,
   /* Can only be called once */
   g_assert (!priv->container);
   priv->container = g_object_ref (container);
+
+  /* The scroll view hands the container its adjustments once it is added */
+  if (MX_IS_SCROLLABLE (container))
+  {
+    g_signal_connect (container,
+                      "notify::vertical-adjustment",
+                      (GCallback)_container_vadjustment_notify_cb,
+                      bridge);
+    _container_vadjustment_notify_cb (container, NULL, bridge);
+  }
+}
+
+void
+mps_view_bridge_set_max_items (MpsViewBridge *bridge,
+                               guint          max_items)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+
+  g_return_if_fail (max_items > 0);
+
+  if (priv->max_items == max_items)
+    return;
+
+  priv->max_items = max_items;
+  _trim_cards (bridge);
+
+  g_object_notify (G_OBJECT (bridge), "max-items");
+}
+
+guint
+mps_view_bridge_get_max_items (MpsViewBridge *bridge)
+{
+  MpsViewBridgePrivate *priv = GET_PRIVATE (bridge);
+
+  return priv->max_items;
 }
 
 SwClientItemView *
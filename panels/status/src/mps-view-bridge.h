@@ -66,6 +66,9 @@ void mps_view_bridge_set_factory_func (MpsViewBridge            *bridge,
                                        gpointer                  userdata);
 SwClientItemView *mps_view_bridge_get_view (MpsViewBridge *bridge);
 ClutterContainer *mps_view_bridge_get_container (MpsViewBridge *bridge);
+void mps_view_bridge_set_max_items (MpsViewBridge *bridge,
+                                    guint          max_items);
+guint mps_view_bridge_get_max_items (MpsViewBridge *bridge);
 
 G_END_DECLS
 
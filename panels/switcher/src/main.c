@@ -15,6 +15,7 @@
 #include <dawati-panel/mpl-panel-clutter.h>
 #include <dawati-panel/mpl-panel-common.h>
 #include <dawati-panel/mpl-application-view.h>
+#include <dawati-panel/mpl-window-thumbnail.h>
 
 #include <glib/gi18n.h>
 #include <locale.h>
@@ -35,6 +36,9 @@ typedef struct
   ClutterActor   *background;
   WnckScreen     *screen;
   ClutterActor   *placeholder;
+  GHashTable     *tiles;
+  MxAdjustment   *vadjust;
+  guint           visibility_idle_id;
 } ZonePanelData;
 
 typedef struct
@@ -58,10 +62,13 @@ _client_set_size_cb (MplPanelClient *client,
 }
 
 static gboolean standalone = FALSE;
+static gint     thumbnail_fps = 4;
 
 static GOptionEntry entries[] = {
   {"standalone", 's', 0, G_OPTION_ARG_NONE, &standalone,
     "Do not embed into the mutter-dawati panel", NULL},
+  {"thumbnail-fps", 'f', 0, G_OPTION_ARG_INT, &thumbnail_fps,
+    "Maximum number of thumbnail updates per second (default: 4)", "FPS"},
   { NULL }
 };
 
@@ -154,6 +161,194 @@ app_tile_activated (ClutterActor  *actor,
   return FALSE;
 }
 
+/*
+ * Thumbnails
+ *
+ * Tiles do not show the live window pixmap. Each tile keeps an off-stage
+ * ClutterX11TexturePixmap which only tracks damage while the tile is visible
+ * in the scroll view, and a MplWindowThumbnail copying it at most
+ * thumbnail_fps times a second.
+ */
+typedef struct
+{
+  ClutterActor *tile;
+  ClutterActor *pixmap;
+  ClutterActor *texture;
+
+  gboolean      visible : 1;
+} SwThumbnail;
+
+static void
+sw_thumbnail_clear_pixmap (SwThumbnail *thumb)
+{
+  if (thumb->pixmap)
+    {
+      g_signal_handlers_disconnect_by_data (thumb->pixmap, thumb);
+      clutter_actor_destroy (thumb->pixmap);
+      g_object_unref (thumb->pixmap);
+      thumb->pixmap = NULL;
+    }
+}
+
+static void
+sw_thumbnail_free (SwThumbnail *thumb)
+{
+  sw_thumbnail_clear_pixmap (thumb);
+
+  g_slice_free (SwThumbnail, thumb);
+}
+
+static CoglHandle
+sw_thumbnail_get_window_texture (gpointer user_data)
+{
+  SwThumbnail *thumb = user_data;
+
+  if (!thumb->pixmap)
+    return COGL_INVALID_HANDLE;
+
+  return clutter_texture_get_cogl_texture (CLUTTER_TEXTURE (thumb->pixmap));
+}
+
+static void
+sw_thumbnail_update_area_cb (ClutterX11TexturePixmap *pixmap,
+                             gint                     x,
+                             gint                     y,
+                             gint                     width,
+                             gint                     height,
+                             SwThumbnail             *thumb)
+{
+  mpl_window_thumbnail_damage (MPL_WINDOW_THUMBNAIL (thumb->texture));
+}
+
+static void
+sw_thumbnail_set_window (SwThumbnail *thumb,
+                         WnckWindow  *window)
+{
+  sw_thumbnail_clear_pixmap (thumb);
+
+  thumb->pixmap =
+    clutter_x11_texture_pixmap_new_with_window (wnck_window_get_xid (window));
+  g_object_ref_sink (thumb->pixmap);
+
+  clutter_x11_texture_pixmap_set_automatic (CLUTTER_X11_TEXTURE_PIXMAP (thumb->pixmap),
+                                            thumb->visible);
+  g_signal_connect (thumb->pixmap, "update-area",
+                    G_CALLBACK (sw_thumbnail_update_area_cb), thumb);
+
+  mpl_window_thumbnail_damage (MPL_WINDOW_THUMBNAIL (thumb->texture));
+
+  if (thumb->visible)
+    mpl_window_thumbnail_update (MPL_WINDOW_THUMBNAIL (thumb->texture));
+}
+
+static void
+sw_thumbnail_set_visible (SwThumbnail *thumb,
+                          gboolean     visible)
+{
+  MplWindowThumbnail *texture = MPL_WINDOW_THUMBNAIL (thumb->texture);
+
+  if (thumb->visible == visible)
+    return;
+
+  thumb->visible = visible;
+
+  if (thumb->pixmap)
+    clutter_x11_texture_pixmap_set_automatic (CLUTTER_X11_TEXTURE_PIXMAP (thumb->pixmap),
+                                              visible);
+
+  if (visible)
+    {
+      gfloat tile_width;
+
+      clutter_actor_get_preferred_width (thumb->tile, -1, NULL, &tile_width);
+      mpl_window_thumbnail_set_max_size (texture, tile_width);
+    }
+  else
+    {
+      /* damage is not tracked while hidden; pick it up when shown again */
+      mpl_window_thumbnail_damage (texture);
+    }
+
+  mpl_window_thumbnail_set_live (texture, visible);
+}
+
+static SwThumbnail *
+sw_tile_get_thumbnail (ClutterActor *tile)
+{
+  return g_object_get_data (G_OBJECT (tile), "sw-thumbnail");
+}
+
+/*
+ * Only tiles that intersect the visible part of the scroll view keep
+ * their thumbnails live.
+ */
+static gboolean
+sw_update_visibility_cb (gpointer user_data)
+{
+  ZonePanelData *data = user_data;
+  GHashTableIter iter;
+  gpointer value;
+  gdouble top, bottom, page_size = 0;
+  gboolean mapped;
+
+  data->visibility_idle_id = 0;
+
+  if (!data->grid)
+    return FALSE;
+
+  mapped = CLUTTER_ACTOR_IS_MAPPED (data->grid);
+  top = bottom = 0;
+
+  if (data->vadjust)
+    {
+      mx_adjustment_get_values (data->vadjust, &top, NULL, NULL,
+                                NULL, NULL, &page_size);
+      bottom = top + page_size;
+    }
+
+  g_hash_table_iter_init (&iter, data->tiles);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      ClutterActor *tile = value;
+      ClutterActorBox box;
+      gboolean visible = mapped;
+
+      if (visible && data->vadjust)
+        {
+          clutter_actor_get_allocation_box (tile, &box);
+          visible = (box.y2 > top && box.y1 < bottom);
+        }
+
+      sw_thumbnail_set_visible (sw_tile_get_thumbnail (tile), visible);
+    }
+
+  return FALSE;
+}
+
+static void
+sw_queue_update_visibility (ZonePanelData *data)
+{
+  if (!data->visibility_idle_id)
+    data->visibility_idle_id =
+      g_idle_add (sw_update_visibility_cb, data);
+}
+
+static void
+sw_update_placeholder (ZonePanelData *data)
+{
+  if (g_hash_table_size (data->tiles) == 0)
+    {
+      /* show the placeholder when no more workspaces are open */
+      clutter_actor_show (data->placeholder);
+      clutter_actor_hide (data->grid);
+    }
+  else
+    {
+      clutter_actor_hide (data->placeholder);
+      clutter_actor_show (data->grid);
+    }
+}
+
 static void
 app_view_closed_cb (MplApplicationView *view,
                     ZonePanelData      *data)
@@ -162,7 +357,6 @@ app_view_closed_cb (MplApplicationView *view,
   WnckWindow *window;
   WnckWorkspace *workspace;
   GList *windows;
-  GList *children;
 
   window = g_object_get_data (G_OBJECT (view), "wnck-window");
 
@@ -183,35 +377,42 @@ app_view_closed_cb (MplApplicationView *view,
 
   clutter_actor_destroy (CLUTTER_ACTOR (view));
 
-  children = clutter_container_get_children (CLUTTER_CONTAINER (data->grid));
-  if (!children)
-    {
-      /* show the placeholder when no more workspaces are open */
-      clutter_actor_hide (data->grid);
-      clutter_actor_show (data->placeholder);
-    }
-  else
-    g_list_free (children);
+  sw_update_placeholder (data);
 }
 
-static ClutterActor *
-sw_create_app_tile (ZonePanelData   *data,
-                    WnckWindow      *window,
-                    WnckApplication *application)
+static void
+sw_tile_destroy_cb (ClutterActor  *tile,
+                    ZonePanelData *data)
+{
+  WnckWorkspace *workspace;
+
+  /* stop tracking the window straight away, the tile may outlive this */
+  sw_thumbnail_clear_pixmap (sw_tile_get_thumbnail (tile));
+
+  workspace = g_object_get_data (G_OBJECT (tile), "wnck-workspace");
+
+  if (g_hash_table_lookup (data->tiles, workspace) == tile)
+    g_hash_table_remove (data->tiles, workspace);
+}
+
+static void
+sw_tile_set_window (ClutterActor *tile,
+                    WnckWindow   *window)
 {
-  ClutterActor *tile, *icon, *thumbnail;
+  WnckApplication *application;
+  ClutterActor *icon;
 
-  tile = (ClutterActor *) g_object_new (MPL_TYPE_APPLICATION_VIEW,
-                                        "title",
-                                        wnck_application_get_name (application),
-                                        "subtitle",
-                                        wnck_window_get_name (window),
-                                        NULL);
+  if (g_object_get_data (G_OBJECT (tile), "wnck-window") == window)
+    return;
+
+  application = wnck_window_get_application (window);
+
+  g_object_set (tile,
+                "title", wnck_application_get_name (application),
+                "subtitle", wnck_window_get_name (window),
+                NULL);
 
   g_object_set_data (G_OBJECT (tile), "wnck-window", window);
-  g_signal_connect (tile, "activated",
-                    G_CALLBACK (app_tile_activated), data);
-  g_signal_connect (tile, "closed", G_CALLBACK (app_view_closed_cb), data);
 
   /* icon */
   icon = gtk_clutter_texture_new ();
@@ -220,26 +421,228 @@ sw_create_app_tile (ZonePanelData   *data,
                                        NULL);
   mpl_application_view_set_icon (MPL_APPLICATION_VIEW (tile), icon);
 
+  sw_thumbnail_set_window (sw_tile_get_thumbnail (tile), window);
+}
+
+static ClutterActor *
+sw_create_app_tile (ZonePanelData *data,
+                    WnckWindow    *window,
+                    WnckWorkspace *workspace)
+{
+  ClutterActor *tile;
+  SwThumbnail *thumb;
+
+  tile = (ClutterActor *) g_object_new (MPL_TYPE_APPLICATION_VIEW, NULL);
+
+  g_object_set_data (G_OBJECT (tile), "wnck-workspace", workspace);
+  g_signal_connect (tile, "activated",
+                    G_CALLBACK (app_tile_activated), data);
+  g_signal_connect (tile, "closed", G_CALLBACK (app_view_closed_cb), data);
+  g_signal_connect (tile, "destroy", G_CALLBACK (sw_tile_destroy_cb), data);
 
   /* application thumbnail */
-  thumbnail = clutter_x11_texture_pixmap_new_with_window (wnck_window_get_xid (window));
-  clutter_x11_texture_pixmap_set_automatic (CLUTTER_X11_TEXTURE_PIXMAP (thumbnail),
-                                            TRUE);
-  clutter_texture_set_keep_aspect_ratio (CLUTTER_TEXTURE (thumbnail), TRUE);
+  thumb = g_slice_new0 (SwThumbnail);
+  thumb->tile = tile;
+  thumb->texture = mpl_window_thumbnail_new ();
+  g_object_set (thumb->texture,
+                "interval", 1000 / MAX (1, thumbnail_fps),
+                "live", FALSE,
+                NULL);
+  mpl_window_thumbnail_set_source_func (MPL_WINDOW_THUMBNAIL (thumb->texture),
+                                        sw_thumbnail_get_window_texture,
+                                        thumb, NULL);
   mpl_application_view_set_thumbnail (MPL_APPLICATION_VIEW (tile),
-                                      thumbnail);
+                                      thumb->texture);
+  g_object_set_data_full (G_OBJECT (tile), "sw-thumbnail", thumb,
+                          (GDestroyNotify) sw_thumbnail_free);
+
+  sw_tile_set_window (tile, window);
 
   return tile;
 }
 
+/*
+ * Returns the top-most window on @workspace that we show a tile for.
+ */
+static WnckWindow *
+sw_find_window (ZonePanelData *data,
+                WnckWorkspace *workspace)
+{
+  WnckWindow *window = NULL;
+  GList *l;
+
+  for (l = wnck_screen_get_windows_stacked (data->screen); l; l = l->next)
+    {
+      if (wnck_window_is_skip_pager (l->data)
+          || wnck_window_is_skip_tasklist (l->data))
+        continue;
+
+      if (wnck_window_get_workspace (l->data) == workspace)
+        window = l->data;
+    }
+
+  return window;
+}
+
+/*
+ * Makes the tile for @workspace show @window, creating it or destroying it
+ * (when @window is %NULL) as needed; tiles for other workspaces are left
+ * alone.
+ */
+static void
+sw_workspace_set_window (ZonePanelData *data,
+                         WnckWorkspace *workspace,
+                         WnckWindow    *window)
+{
+  ClutterActor *tile;
+
+  tile = g_hash_table_lookup (data->tiles, workspace);
+
+  if (!window)
+    {
+      if (!tile)
+        return;
+
+      clutter_actor_destroy (tile);
+    }
+  else if (!tile)
+    {
+      GList *children, *l;
+      gint number, index = 0;
+
+      tile = sw_create_app_tile (data, window, workspace);
+      g_hash_table_insert (data->tiles, workspace, tile);
+
+      /* keep the tiles in workspace order */
+      number = wnck_workspace_get_number (workspace);
+      children = clutter_container_get_children (CLUTTER_CONTAINER (data->grid));
+      for (l = children; l; l = l->next)
+        {
+          WnckWorkspace *ws = g_object_get_data (l->data, "wnck-workspace");
+
+          if (ws && wnck_workspace_get_number (ws) < number)
+            index++;
+        }
+      g_list_free (children);
+
+      clutter_actor_insert_child_at_index (data->grid, tile, index);
+    }
+  else if (g_object_get_data (G_OBJECT (tile), "wnck-window") != window)
+    sw_tile_set_window (tile, window);
+  else
+    return;
+
+  sw_update_placeholder (data);
+  sw_queue_update_visibility (data);
+}
+
+static void
+sw_update_workspace (ZonePanelData *data,
+                     WnckWorkspace *workspace)
+{
+  if (workspace)
+    sw_workspace_set_window (data, workspace,
+                             sw_find_window (data, workspace));
+}
+
+/*
+ * Finds the top-most window of every workspace in a single walk of the
+ * stack, and only touches the tiles whose window changed.
+ */
+static void
+sw_sync_workspaces (ZonePanelData *data)
+{
+  GHashTable *top;
+  GList *l;
+
+  top = g_hash_table_new (NULL, NULL);
+
+  for (l = wnck_screen_get_windows_stacked (data->screen); l; l = l->next)
+    {
+      WnckWorkspace *workspace;
+
+      if (wnck_window_is_skip_pager (l->data)
+          || wnck_window_is_skip_tasklist (l->data))
+        continue;
+
+      workspace = wnck_window_get_workspace (l->data);
+      if (workspace)
+        g_hash_table_insert (top, workspace, l->data);
+    }
+
+  for (l = wnck_screen_get_workspaces (data->screen); l; l = l->next)
+    sw_workspace_set_window (data, l->data,
+                             g_hash_table_lookup (top, l->data));
+
+  g_hash_table_destroy (top);
+}
+
+static void
+sw_window_workspace_changed_cb (WnckWindow    *window,
+                                ZonePanelData *data)
+{
+  /* we do not know which workspace the window came from */
+  sw_sync_workspaces (data);
+}
+
+static void
+sw_window_opened_cb (WnckScreen    *screen,
+                     WnckWindow    *window,
+                     ZonePanelData *data)
+{
+  g_signal_connect (window, "workspace-changed",
+                    G_CALLBACK (sw_window_workspace_changed_cb), data);
+
+  sw_update_workspace (data, wnck_window_get_workspace (window));
+}
+
+static void
+sw_window_closed_cb (WnckScreen    *screen,
+                     WnckWindow    *window,
+                     ZonePanelData *data)
+{
+  WnckWorkspace *workspace = wnck_window_get_workspace (window);
+
+  g_signal_handlers_disconnect_by_func (window,
+                                        sw_window_workspace_changed_cb, data);
+
+  if (workspace)
+    sw_update_workspace (data, workspace);
+  else
+    sw_sync_workspaces (data);
+}
+
+static void
+sw_stacking_changed_cb (WnckScreen    *screen,
+                        ZonePanelData *data)
+{
+  sw_sync_workspaces (data);
+}
+
+static void
+sw_workspace_destroyed_cb (WnckScreen    *screen,
+                           WnckWorkspace *workspace,
+                           ZonePanelData *data)
+{
+  ClutterActor *tile = g_hash_table_lookup (data->tiles, workspace);
+
+  if (tile)
+    clutter_actor_destroy (tile);
+
+  sw_update_placeholder (data);
+}
+
 static void
 setup (ZonePanelData *data)
 {
   ClutterScript *script;
   MxLabel *title;
+  GList *l;
   GError *error = NULL;
-  GList *workspaces, *l, *windows, *list;
-  gint count;
+
+  /* the tiles are kept up to date while the panel is hidden */
+  if (data->toplevel)
+    return;
 
   /* load custom style */
   mx_style_load_from_file (mx_style_get_default (),
@@ -286,69 +689,68 @@ setup (ZonePanelData *data)
   /* application grid */
   data->grid = (ClutterActor*) clutter_script_get_object (script, "grid");
 
-  wnck_screen_force_update (data->screen);
-
-  workspaces = wnck_screen_get_workspaces (data->screen);
-  windows = wnck_screen_get_windows_stacked (data->screen);
+  g_signal_connect_swapped (data->grid, "allocation-changed",
+                            G_CALLBACK (sw_queue_update_visibility), data);
+  g_signal_connect_swapped (data->grid, "notify::mapped",
+                            G_CALLBACK (sw_queue_update_visibility), data);
 
-  count = 0;
-  for (l = workspaces; l; l = g_list_next (l))
+  mx_scrollable_get_adjustments (MX_SCROLLABLE (data->grid),
+                                 NULL, &data->vadjust);
+  if (data->vadjust)
     {
-      WnckWindow *window = NULL;
-      WnckWorkspace *workspace = l->data;
-      WnckApplication *application;
-      ClutterActor *tile;
-
-      /* find the appropriate window */
-      for (list = windows; list; list = g_list_next (list))
-        {
-          if (wnck_window_is_skip_pager (list->data)
-              || wnck_window_is_skip_tasklist (list->data))
-            continue;
-
-          if (wnck_window_get_workspace (list->data) == workspace)
-            window = list->data;
-        }
-
-      /* skip workspaces with no windows */
-      if (!window)
-        continue;
-
-      application = wnck_window_get_application (window);
+      g_object_add_weak_pointer (G_OBJECT (data->vadjust),
+                                 (gpointer *) &data->vadjust);
+      g_signal_connect_swapped (data->vadjust, "notify::value",
+                                G_CALLBACK (sw_queue_update_visibility), data);
+      g_signal_connect_swapped (data->vadjust, "notify::page-size",
+                                G_CALLBACK (sw_queue_update_visibility), data);
+    }
 
-      tile = sw_create_app_tile (data, window, application);
+  wnck_screen_force_update (data->screen);
 
+  sw_sync_workspaces (data);
+  sw_update_placeholder (data);
 
-      clutter_container_add_actor (CLUTTER_CONTAINER (data->grid), tile);
-      count++;
-    }
+  /* from now on, only touch the tiles that change */
+  for (l = wnck_screen_get_windows (data->screen); l; l = l->next)
+    g_signal_connect (l->data, "workspace-changed",
+                      G_CALLBACK (sw_window_workspace_changed_cb), data);
 
-  if (count == 0)
-    {
-      clutter_actor_show (data->placeholder);
-      clutter_actor_hide (data->grid);
-    }
-  else
-    {
-      clutter_actor_hide (data->placeholder);
-      clutter_actor_show (data->grid);
-    }
+  g_signal_connect (data->screen, "window-opened",
+                    G_CALLBACK (sw_window_opened_cb), data);
+  g_signal_connect (data->screen, "window-closed",
+                    G_CALLBACK (sw_window_closed_cb), data);
+  g_signal_connect (data->screen, "window-stacking-changed",
+                    G_CALLBACK (sw_stacking_changed_cb), data);
+  g_signal_connect (data->screen, "workspace-destroyed",
+                    G_CALLBACK (sw_workspace_destroyed_cb), data);
 }
 
 static void
 show (ZonePanelData *data)
 {
   setup (data);
+
+  if (!data->toplevel)
+    return;
+
   clutter_actor_show_all (data->toplevel);
-  clutter_container_add_actor (CLUTTER_CONTAINER (data->stage), data->toplevel);
+  sw_update_placeholder (data);
+
+  if (!clutter_actor_get_parent (data->toplevel))
+    clutter_container_add_actor (CLUTTER_CONTAINER (data->stage),
+                                 data->toplevel);
 }
 
 static void
 hide (ZonePanelData *data)
 {
-  clutter_actor_destroy (data->toplevel);
-  data->toplevel = NULL;
-  data->overview = NULL;
+  /*
+   * Keep the tiles around for the next show; once unmapped their thumbnails
+   * stop tracking damage (see sw_update_visibility_cb).
+   */
+  if (data->toplevel)
+    clutter_actor_hide (data->toplevel);
 }
 
 int
@@ -367,6 +769,7 @@ main (int argc, char **argv)
 
 
   data = g_new0 (ZonePanelData, 1);
+  data->tiles = g_hash_table_new (NULL, NULL);
 
   context = g_option_context_new ("- mutter-dawati switcher panel");
   g_option_context_add_main_entries (context, entries, NULL);
@@ -449,6 +852,7 @@ main (int argc, char **argv)
   clutter_main ();
 
 
+  g_hash_table_destroy (data->tiles);
   g_free (data);
 
   return 0;
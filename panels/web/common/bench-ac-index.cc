@@ -0,0 +1,208 @@
+/*
+ * Dawati-Web-Browser: The web browser for Dawati
+ * Copyright (c) 2012, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <sqlite3.h>
+#include <glib/gstdio.h>
+
+#include "mwb-ac-index.h"
+#include "dawati-bench.h"
+
+#define BENCH_LIMIT 10
+
+typedef struct
+{
+  MwbAcIndex *index;
+  gchar      *places_db;
+  gchar      *typed;
+  guint       n_rows;
+} BenchData;
+
+static void
+result_cb (void       *context,
+           int         type,
+           const char *url,
+           const char *value,
+           int         favicon_id)
+{
+  BenchData *bench = (BenchData *) context;
+
+  bench->n_rows++;
+}
+
+/*
+ * Results come back on the main loop, all rows of a result in one go. Every
+ * query the benchmark makes matches something, so the first row means the
+ * query is done.
+ */
+static void
+query_and_wait (BenchData   *bench,
+                const gchar *text)
+{
+  bench->n_rows = 0;
+
+  mwb_ac_index_query (bench->index, text, BENCH_LIMIT);
+
+  while (!bench->n_rows)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static gboolean
+make_places_db (const gchar *places_db,
+                gint         size)
+{
+  sqlite3 *dbcon = NULL;
+  sqlite3_stmt *stmt = NULL;
+  gint i;
+
+  if (sqlite3_open (places_db, &dbcon))
+    {
+      sqlite3_close (dbcon);
+      return FALSE;
+    }
+
+  sqlite3_exec (dbcon,
+                "CREATE TABLE bookmarks (url TEXT, title TEXT, "
+                "favicon_id INTEGER);"
+                "CREATE TABLE urls (url TEXT, title TEXT, favicon_id INTEGER, "
+                "visit_count INTEGER);"
+                "BEGIN;", NULL, NULL, NULL);
+
+  sqlite3_prepare_v2 (dbcon, "INSERT INTO urls VALUES (?, ?, ?, ?)", -1,
+                      &stmt, NULL);
+
+  for (i = 0; i < size; i++)
+    {
+      gchar *url = g_strdup_printf ("http://www.site%d.example.com/page/%d",
+                                    i % 97, i);
+      gchar *title = g_strdup_printf ("Page %d of Site %d", i, i % 97);
+
+      sqlite3_bind_text (stmt, 1, url, -1, g_free);
+      sqlite3_bind_text (stmt, 2, title, -1, g_free);
+      sqlite3_bind_int (stmt, 3, i % 13);
+      sqlite3_bind_int (stmt, 4, i % 31);
+      sqlite3_step (stmt);
+      sqlite3_reset (stmt);
+
+      /* Every tenth page is bookmarked as well */
+      if (i % 10 == 0)
+        {
+          gchar *sql = sqlite3_mprintf ("INSERT INTO bookmarks "
+                                        "VALUES ('http://www.site%d.example."
+                                        "com/page/%d', 'Bookmark %d', 0)",
+                                        i % 97, i, i);
+
+          sqlite3_exec (dbcon, sql, NULL, NULL, NULL);
+          sqlite3_free (sql);
+        }
+    }
+
+  sqlite3_finalize (stmt);
+  sqlite3_exec (dbcon, "COMMIT;", NULL, NULL, NULL);
+  sqlite3_close (dbcon);
+
+  return TRUE;
+}
+
+/* Includes one full-scan query, which is how the build is known to be done */
+static void
+rebuild (gpointer data)
+{
+  BenchData *bench = (BenchData *) data;
+
+  mwb_ac_index_rebuild (bench->index, bench->places_db);
+  query_and_wait (bench, "h");
+}
+
+/* One query per keystroke, as the autocomplete list does while typing */
+static void
+typing (gpointer data)
+{
+  BenchData *bench = (BenchData *) data;
+  gchar     *text = g_strdup (bench->typed);
+  gint       len = strlen (bench->typed);
+  gint       i;
+
+  for (i = 1; i <= len; i++)
+    {
+      gchar c = text[i];
+
+      text[i] = '\0';
+      query_and_wait (bench, text);
+      text[i] = c;
+    }
+
+  g_free (text);
+}
+
+/* Two-character queries cannot use the trigram index */
+static void
+short_query (gpointer data)
+{
+  BenchData *bench = (BenchData *) data;
+
+  query_and_wait (bench, "ht");
+}
+
+int
+main (int argc, char **argv)
+{
+  DawatiBench  bench;
+  BenchData    data = { NULL, };
+  gchar       *tmpdir;
+
+  g_thread_init (NULL);
+  g_type_init ();
+
+  dawati_bench_init (&bench, "mwb-ac-index", &argc, &argv);
+
+  tmpdir = g_dir_make_tmp ("dawati-bench-XXXXXX", NULL);
+  if (!tmpdir)
+    g_error ("Could not create temporary directory");
+
+  data.places_db = g_build_filename (tmpdir, "places.db", NULL);
+
+  if (!make_places_db (data.places_db, bench.size))
+    g_error ("Could not create %s", data.places_db);
+
+  data.index = mwb_ac_index_new (result_cb, &data);
+  data.typed = g_strdup_printf ("www.site%d.example.com/page/%d",
+                                (bench.size / 2) % 97, bench.size / 2);
+
+  dawati_bench_run (&bench, "rebuild", bench.size,
+                    NULL, rebuild, &data);
+  dawati_bench_run (&bench, "typing", strlen (data.typed),
+                    NULL, typing, &data);
+  dawati_bench_run (&bench, "short-query", 1,
+                    NULL, short_query, &data);
+
+  mwb_ac_index_free (data.index);
+
+  g_unlink (data.places_db);
+  g_rmdir (tmpdir);
+
+  g_free (data.typed);
+  g_free (data.places_db);
+  g_free (tmpdir);
+
+  return dawati_bench_finish (&bench);
+}
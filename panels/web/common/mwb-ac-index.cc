@@ -0,0 +1,666 @@
+/*
+ * Dawati-Web-Browser: The web browser for Dawati
+ * Copyright (c) 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <sqlite3.h>
+
+extern "C" {
+#include <clutter/clutter.h>
+}
+
+#include "mwb-ac-index.h"
+
+/* Same rows and scores the autocomplete query used to LIKE over: bookmarks
+   count as 100 visits */
+#define AC_INDEX_SQL "SELECT url, url||' - '||title, favicon_id, 100 "\
+                     "FROM bookmarks "\
+                     "UNION ALL "\
+                     "SELECT url, url||' - '||title, favicon_id, visit_count "\
+                     "FROM urls"
+
+/* How many candidates (or places rows, while building) to look at between
+   checks for a newer query or a pending free */
+#define AC_INDEX_CANCEL_CHECK_MASK 0xff
+
+typedef struct
+{
+  gchar *url;
+  gchar *label;
+  /* ASCII lower-cased label, matched the same way LIKE did */
+  gchar *folded;
+  gint   favicon_id;
+  gint   score;
+} MwbAcIndexEntry;
+
+typedef struct
+{
+  guint id;
+  gint  score;
+  gint  offset;
+} MwbAcIndexHit;
+
+typedef struct
+{
+  gchar *url;
+  gchar *label;
+  gint   favicon_id;
+} MwbAcIndexRow;
+
+typedef struct
+{
+  gint    generation;
+  GArray *rows;
+} MwbAcIndexResult;
+
+typedef enum
+{
+  MWB_AC_INDEX_JOB_BUILD,
+  MWB_AC_INDEX_JOB_QUERY,
+  MWB_AC_INDEX_JOB_QUIT
+} MwbAcIndexJobType;
+
+typedef struct
+{
+  MwbAcIndexJobType type;
+  gint              generation;
+  gchar            *text;
+  guint             limit;
+} MwbAcIndexJob;
+
+struct _MwbAcIndex
+{
+  MwbAcIndexResultFunc callback;
+  void                *context;
+
+  GThread             *thread;
+  GAsyncQueue         *jobs;
+
+  /* Bumped for every query; anything older is stale */
+  volatile gint        generation;
+
+  /* Set once the owner has let go; the worker frees the index */
+  volatile gint        quitting;
+
+  GMutex               results_lock;
+  GList               *results;
+  guint                results_idle_id;
+
+  /* Everything below is only touched from the worker thread */
+  GArray              *entries;
+  GHashTable          *trigrams;
+  guint                serial;
+
+  /* The full match set of the previous query, so that a query which
+     extends it only needs to filter these */
+  gchar               *last_text;
+  GArray              *last_matches;
+  guint                last_serial;
+};
+
+static inline guint32
+mwb_ac_index_trigram (const gchar *s)
+{
+  return (((guint32)(guint8) s[0] << 16) |
+          ((guint32)(guint8) s[1] << 8) |
+          (guint32)(guint8) s[2]);
+}
+
+static void
+mwb_ac_index_job_free (MwbAcIndexJob *job)
+{
+  g_free (job->text);
+  g_slice_free (MwbAcIndexJob, job);
+}
+
+static void
+mwb_ac_index_push_job (MwbAcIndex        *index,
+                       MwbAcIndexJobType  type,
+                       const gchar       *text,
+                       guint              limit)
+{
+  MwbAcIndexJob *job = g_slice_new0 (MwbAcIndexJob);
+
+  job->type = type;
+  job->generation = g_atomic_int_get (&index->generation);
+  job->text = g_strdup (text);
+  job->limit = limit;
+
+  g_async_queue_push (index->jobs, job);
+}
+
+static void
+mwb_ac_index_result_free (MwbAcIndexResult *result)
+{
+  guint i;
+
+  for (i = 0; i < result->rows->len; i++)
+    {
+      MwbAcIndexRow *row = &g_array_index (result->rows, MwbAcIndexRow, i);
+
+      g_free (row->url);
+      g_free (row->label);
+    }
+
+  g_array_free (result->rows, TRUE);
+  g_slice_free (MwbAcIndexResult, result);
+}
+
+static void
+mwb_ac_index_posting_free (gpointer data)
+{
+  g_array_free ((GArray *) data, TRUE);
+}
+
+static void
+mwb_ac_index_clear (MwbAcIndex *index)
+{
+  guint i;
+
+  for (i = 0; i < index->entries->len; i++)
+    {
+      MwbAcIndexEntry *entry =
+        &g_array_index (index->entries, MwbAcIndexEntry, i);
+
+      g_free (entry->url);
+      g_free (entry->label);
+      g_free (entry->folded);
+    }
+
+  g_array_set_size (index->entries, 0);
+  g_hash_table_remove_all (index->trigrams);
+
+  g_free (index->last_text);
+  index->last_text = NULL;
+  g_array_set_size (index->last_matches, 0);
+
+  index->serial++;
+}
+
+static void
+mwb_ac_index_add_trigrams (MwbAcIndex *index,
+                           guint       id)
+{
+  MwbAcIndexEntry *entry = &g_array_index (index->entries, MwbAcIndexEntry, id);
+  const gchar *p;
+
+  if (strlen (entry->folded) < 3)
+    return;
+
+  for (p = entry->folded; p[2]; p++)
+    {
+      guint32 key = mwb_ac_index_trigram (p);
+      GArray *posting;
+
+      posting = (GArray *) g_hash_table_lookup (index->trigrams,
+                                                GUINT_TO_POINTER (key));
+      if (!posting)
+        {
+          posting = g_array_new (FALSE, FALSE, sizeof (guint));
+          g_hash_table_insert (index->trigrams, GUINT_TO_POINTER (key),
+                               posting);
+        }
+
+      /* Ids are added in order, so this is enough to avoid duplicates */
+      if (posting->len == 0
+          || g_array_index (posting, guint, posting->len - 1) != id)
+        g_array_append_val (posting, id);
+    }
+}
+
+static void
+mwb_ac_index_build (MwbAcIndex  *index,
+                    const gchar *places_db)
+{
+  sqlite3 *dbcon = NULL;
+  sqlite3_stmt *stmt = NULL;
+  GHashTable *seen;
+  gint64 start = g_get_monotonic_time ();
+  gint rc;
+
+  mwb_ac_index_clear (index);
+
+  /* Use our own read-only connection, the panel's one belongs to the
+     main thread */
+  rc = sqlite3_open_v2 (places_db, &dbcon, SQLITE_OPEN_READONLY, NULL);
+  if (rc)
+    {
+      g_warning ("[netpanel] unable to open places db for autocomplete: %s",
+                 sqlite3_errmsg (dbcon));
+      sqlite3_close (dbcon);
+      return;
+    }
+
+  rc = sqlite3_prepare_v2 (dbcon, AC_INDEX_SQL, -1, &stmt, NULL);
+  if (rc)
+    {
+      g_warning ("[netpanel] sqlite3_prepare_v2 (): %s",
+                 sqlite3_errmsg (dbcon));
+      sqlite3_close (dbcon);
+      return;
+    }
+
+  /* label -> id + 1, so that bookmarked history is only listed once */
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+  while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+      /* Don't hold up a free with a large history */
+      if ((index->entries->len & AC_INDEX_CANCEL_CHECK_MASK) == 0
+          && g_atomic_int_get (&index->quitting))
+        break;
+
+      const gchar *url = (const gchar *) sqlite3_column_text (stmt, 0);
+      const gchar *label = (const gchar *) sqlite3_column_text (stmt, 1);
+      gint score = sqlite3_column_int (stmt, 3);
+      MwbAcIndexEntry entry;
+      guint id;
+
+      if (!url || !label)
+        continue;
+
+      id = GPOINTER_TO_UINT (g_hash_table_lookup (seen, label));
+      if (id)
+        {
+          MwbAcIndexEntry *old =
+            &g_array_index (index->entries, MwbAcIndexEntry, id - 1);
+
+          old->score = MAX (old->score, score);
+          continue;
+        }
+
+      entry.url = g_strdup (url);
+      entry.label = g_strdup (label);
+      entry.folded = g_ascii_strdown (label, -1);
+      entry.favicon_id = sqlite3_column_int (stmt, 2);
+      entry.score = score;
+
+      g_array_append_val (index->entries, entry);
+      id = index->entries->len;
+      g_hash_table_insert (seen, entry.label, GUINT_TO_POINTER (id));
+
+      mwb_ac_index_add_trigrams (index, id - 1);
+    }
+
+  g_hash_table_destroy (seen);
+  sqlite3_finalize (stmt);
+  sqlite3_close (dbcon);
+
+  g_debug ("[netpanel] indexed %u places for autocomplete in %" G_GINT64_FORMAT
+           " ms", index->entries->len,
+           (g_get_monotonic_time () - start) / 1000);
+}
+
+/*
+ * Keeps @top sorted best first and no longer than @limit: highest score,
+ * then earliest match.
+ */
+static void
+mwb_ac_index_rank (GArray        *top,
+                   MwbAcIndexHit *hit,
+                   guint          limit)
+{
+  guint i;
+
+  for (i = top->len; i > 0; i--)
+    {
+      MwbAcIndexHit *other = &g_array_index (top, MwbAcIndexHit, i - 1);
+
+      if (other->score > hit->score
+          || (other->score == hit->score && other->offset <= hit->offset))
+        break;
+    }
+
+  if (i >= limit)
+    return;
+
+  g_array_insert_val (top, i, *hit);
+
+  if (top->len > limit)
+    g_array_set_size (top, limit);
+}
+
+/*
+ * Finds the entries that can possibly match @text. Returns FALSE if that is
+ * all of them; otherwise *candidates is set, or NULL if there can't be any.
+ */
+static gboolean
+mwb_ac_index_get_candidates (MwbAcIndex   *index,
+                             const gchar  *text,
+                             GArray      **candidates)
+{
+  const gchar *p;
+
+  *candidates = NULL;
+
+  if (index->last_text
+      && index->last_serial == index->serial
+      && strstr (text, index->last_text))
+    {
+      *candidates = index->last_matches;
+      return TRUE;
+    }
+
+  if (strlen (text) < 3)
+    return FALSE;
+
+  /* Every match contains all of the query's trigrams, so the shortest
+     posting list is a complete candidate set */
+  for (p = text; p[2]; p++)
+    {
+      GArray *posting;
+
+      posting = (GArray *) g_hash_table_lookup
+        (index->trigrams, GUINT_TO_POINTER (mwb_ac_index_trigram (p)));
+
+      if (!posting)
+        {
+          *candidates = NULL;
+          break;
+        }
+
+      if (!*candidates || posting->len < (*candidates)->len)
+        *candidates = posting;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+mwb_ac_index_dispatch_cb (gpointer data)
+{
+  MwbAcIndex *index = (MwbAcIndex *) data;
+  GList *results, *l;
+  guint i;
+
+  g_mutex_lock (&index->results_lock);
+  results = index->results;
+  index->results = NULL;
+  index->results_idle_id = 0;
+  g_mutex_unlock (&index->results_lock);
+
+  for (l = results; l; l = l->next)
+    {
+      MwbAcIndexResult *result = (MwbAcIndexResult *) l->data;
+
+      /* Drop anything that was superseded while it was in flight */
+      if (result->generation == g_atomic_int_get (&index->generation))
+        for (i = 0; i < result->rows->len; i++)
+          {
+            MwbAcIndexRow *row =
+              &g_array_index (result->rows, MwbAcIndexRow, i);
+
+            index->callback (index->context, 0,
+                             row->url, row->label, row->favicon_id);
+          }
+
+      mwb_ac_index_result_free (result);
+    }
+
+  g_list_free (results);
+
+  return FALSE;
+}
+
+static void
+mwb_ac_index_post_result (MwbAcIndex       *index,
+                          MwbAcIndexResult *result)
+{
+  g_mutex_lock (&index->results_lock);
+
+  if (index->quitting)
+    {
+      g_mutex_unlock (&index->results_lock);
+      mwb_ac_index_result_free (result);
+      return;
+    }
+
+  index->results = g_list_append (index->results, result);
+
+  if (!index->results_idle_id)
+    index->results_idle_id =
+      clutter_threads_add_idle (mwb_ac_index_dispatch_cb, index);
+
+  g_mutex_unlock (&index->results_lock);
+}
+
+static void
+mwb_ac_index_run_query (MwbAcIndex    *index,
+                        MwbAcIndexJob *job)
+{
+  MwbAcIndexResult *result;
+  GArray *candidates, *matches, *top;
+  guint i, n;
+
+  if (mwb_ac_index_get_candidates (index, job->text, &candidates))
+    n = candidates ? candidates->len : 0;
+  else
+    n = index->entries->len;
+
+  matches = g_array_new (FALSE, FALSE, sizeof (guint));
+  top = g_array_sized_new (FALSE, FALSE, sizeof (MwbAcIndexHit),
+                           job->limit + 1);
+
+  for (i = 0; i < n; i++)
+    {
+      MwbAcIndexEntry *entry;
+      MwbAcIndexHit hit;
+      const gchar *match;
+
+      /* Give up as soon as the user has typed something else */
+      if ((i & AC_INDEX_CANCEL_CHECK_MASK) == 0
+          && g_atomic_int_get (&index->generation) != job->generation)
+        {
+          g_array_free (matches, TRUE);
+          g_array_free (top, TRUE);
+          return;
+        }
+
+      hit.id = candidates ? g_array_index (candidates, guint, i) : i;
+      entry = &g_array_index (index->entries, MwbAcIndexEntry, hit.id);
+
+      if (!(match = strstr (entry->folded, job->text)))
+        continue;
+
+      g_array_append_val (matches, hit.id);
+
+      hit.score = entry->score;
+      hit.offset = match - entry->folded;
+      mwb_ac_index_rank (top, &hit, job->limit);
+    }
+
+  g_array_free (index->last_matches, TRUE);
+  index->last_matches = matches;
+  g_free (index->last_text);
+  index->last_text = g_strdup (job->text);
+  index->last_serial = index->serial;
+
+  result = g_slice_new (MwbAcIndexResult);
+  result->generation = job->generation;
+  result->rows = g_array_sized_new (FALSE, FALSE, sizeof (MwbAcIndexRow),
+                                    top->len);
+
+  for (i = 0; i < top->len; i++)
+    {
+      MwbAcIndexHit *hit = &g_array_index (top, MwbAcIndexHit, i);
+      MwbAcIndexEntry *entry =
+        &g_array_index (index->entries, MwbAcIndexEntry, hit->id);
+      MwbAcIndexRow row;
+
+      row.url = g_strdup (entry->url);
+      row.label = g_strdup (entry->label);
+      row.favicon_id = entry->favicon_id;
+      g_array_append_val (result->rows, row);
+    }
+
+  g_array_free (top, TRUE);
+
+  mwb_ac_index_post_result (index, result);
+}
+
+static void
+mwb_ac_index_destroy (MwbAcIndex *index)
+{
+  GList *l;
+
+  for (l = index->results; l; l = l->next)
+    mwb_ac_index_result_free ((MwbAcIndexResult *) l->data);
+  g_list_free (index->results);
+
+  mwb_ac_index_clear (index);
+  g_array_free (index->entries, TRUE);
+  g_array_free (index->last_matches, TRUE);
+  g_hash_table_destroy (index->trigrams);
+
+  g_mutex_clear (&index->results_lock);
+  g_async_queue_unref (index->jobs);
+
+  g_slice_free (MwbAcIndex, index);
+}
+
+static gpointer
+mwb_ac_index_thread (gpointer data)
+{
+  MwbAcIndex *index = (MwbAcIndex *) data;
+  gboolean quit = FALSE;
+
+  while (!quit)
+    {
+      MwbAcIndexJob *job = (MwbAcIndexJob *) g_async_queue_pop (index->jobs);
+
+      switch (job->type)
+        {
+        case MWB_AC_INDEX_JOB_BUILD:
+          if (!g_atomic_int_get (&index->quitting))
+            mwb_ac_index_build (index, job->text);
+          break;
+
+        case MWB_AC_INDEX_JOB_QUERY:
+          /* Skip queries that were superseded while queued */
+          if (job->generation == g_atomic_int_get (&index->generation))
+            mwb_ac_index_run_query (index, job);
+          break;
+
+        case MWB_AC_INDEX_JOB_QUIT:
+          quit = TRUE;
+          break;
+        }
+
+      mwb_ac_index_job_free (job);
+    }
+
+  /* The owner is gone by now, see mwb_ac_index_free() */
+  mwb_ac_index_destroy (index);
+
+  return NULL;
+}
+
+MwbAcIndex *
+mwb_ac_index_new (MwbAcIndexResultFunc callback,
+                  void                *context)
+{
+  MwbAcIndex *index = g_slice_new0 (MwbAcIndex);
+  GError *error = NULL;
+
+  index->callback = callback;
+  index->context = context;
+
+  index->jobs = g_async_queue_new ();
+  g_mutex_init (&index->results_lock);
+
+  index->entries = g_array_new (FALSE, FALSE, sizeof (MwbAcIndexEntry));
+  index->trigrams = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                           NULL, mwb_ac_index_posting_free);
+  index->last_matches = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  index->thread = g_thread_try_new ("mwb-ac-index", mwb_ac_index_thread,
+                                    index, &error);
+  if (!index->thread)
+    {
+      g_warning ("[netpanel] unable to start autocomplete thread: %s",
+                 error->message);
+      g_error_free (error);
+    }
+
+  return index;
+}
+
+void
+mwb_ac_index_free (MwbAcIndex *index)
+{
+  GThread *thread = index->thread;
+
+  if (!thread)
+    {
+      mwb_ac_index_destroy (index);
+      return;
+    }
+
+  /* Don't block the main loop waiting for a build or query to finish:
+     cancel it, and leave the worker to free the index on its way out */
+  mwb_ac_index_cancel (index);
+
+  g_mutex_lock (&index->results_lock);
+  g_atomic_int_set (&index->quitting, TRUE);
+  if (index->results_idle_id)
+    {
+      g_source_remove (index->results_idle_id);
+      index->results_idle_id = 0;
+    }
+  g_mutex_unlock (&index->results_lock);
+
+  /* index may be gone as soon as the worker sees this */
+  mwb_ac_index_push_job (index, MWB_AC_INDEX_JOB_QUIT, NULL, 0);
+  g_thread_unref (thread);
+}
+
+void
+mwb_ac_index_rebuild (MwbAcIndex  *index,
+                      const gchar *places_db)
+{
+  g_return_if_fail (places_db != NULL);
+
+  if (index->thread)
+    mwb_ac_index_push_job (index, MWB_AC_INDEX_JOB_BUILD, places_db, 0);
+}
+
+void
+mwb_ac_index_query (MwbAcIndex  *index,
+                    const gchar *text,
+                    guint        limit)
+{
+  gchar *folded;
+
+  g_atomic_int_inc (&index->generation);
+
+  if (!index->thread || limit == 0)
+    return;
+
+  folded = g_ascii_strdown (text, -1);
+  mwb_ac_index_push_job (index, MWB_AC_INDEX_JOB_QUERY, folded, limit);
+  g_free (folded);
+}
+
+void
+mwb_ac_index_cancel (MwbAcIndex *index)
+{
+  g_atomic_int_inc (&index->generation);
+}
@@ -0,0 +1,57 @@
+/*
+ * Dawati-Web-Browser: The web browser for Dawati
+ * Copyright (c) 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef _MWB_AC_INDEX_H
+#define _MWB_AC_INDEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * In-memory trigram index over the bookmarks and history of a places
+ * database, used by the autocomplete list. Building the index and running
+ * queries both happen on a worker thread; results are delivered on the
+ * main loop, and only for the most recent query.
+ */
+typedef struct _MwbAcIndex MwbAcIndex;
+
+typedef void (* MwbAcIndexResultFunc) (void       *context,
+                                       int         type,
+                                       const char *url,
+                                       const char *value,
+                                       int         favicon_id);
+
+MwbAcIndex *mwb_ac_index_new (MwbAcIndexResultFunc callback,
+                              void                *context);
+
+void mwb_ac_index_free (MwbAcIndex *index);
+
+void mwb_ac_index_rebuild (MwbAcIndex  *index,
+                           const gchar *places_db);
+
+void mwb_ac_index_query (MwbAcIndex  *index,
+                         const gchar *text,
+                         guint        limit);
+
+void mwb_ac_index_cancel (MwbAcIndex *index);
+
+G_END_DECLS
+
+#endif /* _MWB_AC_INDEX_H */
@@ -28,6 +28,8 @@
 #include <cogl/cogl.h>
 
 #include "mwb-ac-list.h"
+#include "mwb-ac-index.h"
+#include "mwb-icon-cache.h"
 #include "mwb-separator.h"
 #include "mwb-utils.h"
 
@@ -89,7 +91,7 @@ struct _MwbAcListPrivate
   gchar         *search_engine_url;
 
   sqlite3       *dbcon;
-  sqlite3_stmt  *search_stmt;
+  MwbAcIndex    *index;
 
   /* List of suggested TLD completions */
   GHashTable    *tld_suggestions;
@@ -108,6 +110,8 @@ struct _MwbAcListEntry
   gint type;
   gint match_start, match_end;
   CoglHandle texture;
+  /* Icon file the texture is being loaded from */
+  gchar *icon_path;
 
   /* This is used for drawing the highlight and also for picking. Its
      color gets set to the highlight color but it will not be painted
@@ -153,6 +157,12 @@ static void mwb_ac_list_add_default_entries (MwbAcList *self);
 
 static void mwb_ac_list_forget_search_engine (MwbAcList *self);
 
+static void mwb_ac_list_result_received (void       *context,
+                                         int         type,
+                                         const char *url,
+                                         const char *value,
+                                         int         favicon_id);
+
 #define MWB_AC_LIST_SEARCH_ENTRY    0
 #define MWB_AC_LIST_HOSTNAME_ENTRY  1
 #define MWB_AC_LIST_N_FIXED_ENTRIES 2
@@ -221,6 +231,12 @@ mwb_ac_list_dispose (GObject *object)
 {
   MwbAcListPrivate *priv = MWB_AC_LIST (object)->priv;
 
+  if (priv->index)
+    {
+      mwb_ac_index_free (priv->index);
+      priv->index = NULL;
+    }
+
   if (priv->clear_timeout)
     {
       g_source_remove (priv->clear_timeout);
@@ -865,7 +881,7 @@ mwb_ac_list_init (MwbAcList *self)
                     G_CALLBACK (mwb_ac_list_style_changed_cb), NULL);
 
   priv->dbcon = NULL;
-  priv->search_stmt = NULL;
+  priv->index = mwb_ac_index_new (mwb_ac_list_result_received, self);
 }
 
 MxWidget*
@@ -874,79 +890,50 @@ mwb_ac_list_new (void)
   return MX_WIDGET (g_object_new (MWB_TYPE_AC_LIST, NULL));
 }
 
-#define FAVICON_SQL "SELECT url FROM favicons WHERE id='%d'"
-
 static void
-mwb_ac_list_set_icon (MwbAcList *self, MwbAcListEntry *entry)
+mwb_ac_list_icon_loaded_cb (GObject     *target,
+                            const gchar *path,
+                            CoglHandle   texture)
 {
-
+  MwbAcList *self = MWB_AC_LIST (target);
   MwbAcListPrivate *priv = self->priv;
+  guint i;
 
-  GError *texture_error = NULL;
-
-  if (!entry)
+  if (texture == COGL_INVALID_HANDLE)
     return;
 
-  gchar *favi_url = NULL;
-  gchar *icon_path = NULL;
-
-  sqlite3_stmt *favicon_stmt;
-  gchar *stmt = g_strdup_printf(FAVICON_SQL, entry->type);
-  int rc = sqlite3_prepare_v2 (priv->dbcon,
-                           stmt,
-                           -1,
-                           &favicon_stmt, NULL);
-  if (rc)
-    g_warning ("[netpanel] sqlite3_prepare_v2():tab_stmt %s",
-               sqlite3_errmsg(priv->dbcon));
-
-  if (priv->dbcon && favicon_stmt)
+  for (i = 0; i < priv->entries->len; i++)
     {
-      if (sqlite3_step (favicon_stmt) == SQLITE_ROW)
-        {
-          favi_url = (gchar*)sqlite3_column_text(favicon_stmt, 0);
-        }
-    }
+      MwbAcListEntry *entry = &g_array_index (priv->entries, MwbAcListEntry, i);
 
-  if(favi_url)
-    {
-      gchar *csum = g_compute_checksum_for_string (G_CHECKSUM_MD5, favi_url, -1);
-      gchar *thumbnail_filename = g_strconcat (csum, ".ico", NULL);
-      icon_path = g_build_filename (g_get_home_dir (),
-                                    ".config",
-                                    "internet-panel",
-                                    "favicons",
-                                    thumbnail_filename,
-                                    NULL);
-      if (!g_file_test (icon_path, G_FILE_TEST_EXISTS))
-        {
-          g_free (icon_path);
-          icon_path = g_strdup_printf ("%s%s", THEMEDIR, "o2_globe.png");
-        }
-      g_free(csum);
-      g_free(thumbnail_filename);
-    }
-  else
-    {
-      icon_path = g_strdup_printf("%s%s", THEMEDIR, "o2_globe.png");
+      if (entry->texture == COGL_INVALID_HANDLE
+          && !g_strcmp0 (entry->icon_path, path))
+        entry->texture = cogl_handle_ref (texture);
     }
-  sqlite3_finalize(favicon_stmt);
 
-  if (icon_path)
-    {
-      entry->texture =  cogl_texture_new_from_file (icon_path,
-                                                    COGL_TEXTURE_NONE,
-                                                    COGL_PIXEL_FORMAT_ANY,
-                                                    &texture_error);
-      if (texture_error)
-        {
-          g_warning ("[netpanel] unable to open ac-list icon: %s\n",
-                     texture_error->message);
-          g_error_free (texture_error);
-        }
-      clutter_actor_queue_redraw (CLUTTER_ACTOR (self));
-      g_free(icon_path);
-    }
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (self));
+}
+
+static void
+mwb_ac_list_set_icon (MwbAcList *self, MwbAcListEntry *entry)
+{
+  gchar *favicon_path;
+
+  if (!entry)
+    return;
+
+  favicon_path =
+    mwb_icon_cache_get_favicon_path (mwb_icon_cache_get_default (),
+                                     entry->type);
+
+  entry->icon_path = favicon_path ? favicon_path
+    : g_strdup (THEMEDIR "o2_globe.png");
+
+  /* The texture is filled in by the callback, straight away if the icon is
+     already cached */
+  mwb_icon_cache_load (mwb_icon_cache_get_default (), entry->icon_path,
+                       MWB_AC_LIST_ICON_SIZE, MWB_AC_LIST_ICON_SIZE,
+                       G_PRIORITY_DEFAULT, G_OBJECT (self), mwb_ac_list_icon_loaded_cb);
 }
 
 static void
@@ -1074,6 +1061,7 @@ mwb_ac_list_clear_entries (MwbAcList *self)
         g_free (entry->label_text);
       if (entry->url)
         g_free (entry->url);
+      g_free (entry->icon_path);
       if (entry->texture != COGL_INVALID_HANDLE)
         cogl_handle_unref (entry->texture);
     }
@@ -1322,15 +1310,6 @@ mwb_ac_list_clear_timeout_cb (MwbAcList *self)
   return FALSE;
 }
 
-#define AC_LIST_SQL "SELECT DISTINCT url, url||' - '||title as vl, favicon_id "\
-                    "FROM ( "\
-                          "SELECT url, title, favicon_id, 100 as visit_count "\
-                          "FROM bookmarks "\
-                          "UNION "\
-                          "SELECT url, title, favicon_id, visit_count "\
-                          "FROM urls"\
-                         ") WHERE vl like ? ORDER BY visit_count DESC"
-
 void
 mwb_ac_list_set_search_text (MwbAcList *self,
                              const gchar *search_text)
@@ -1361,26 +1340,20 @@ mwb_ac_list_set_search_text (MwbAcList *self,
 
       g_object_notify (G_OBJECT (self), "search-text");
 
-      if (search_text_len == 0 || !priv->search_stmt)
-        return;
-
-      sqlite3_reset(priv->search_stmt);
-
-      gchar param[search_text_len + 3];
-      sprintf(param, "%%%s%%", search_text);
-      int rc = sqlite3_bind_text(priv->search_stmt, 1, param, search_text_len + 2, SQLITE_TRANSIENT);
-      if (rc)
-          g_warning("[netpanel] sqlite3_bind_text(): %s", sqlite3_errmsg(priv->dbcon));
-
-      priv->entries->len = 0;
-      while (sqlite3_step(priv->search_stmt) == SQLITE_ROW)
+      if (search_text_len == 0 || !priv->dbcon || !priv->index)
         {
-          mwb_ac_list_result_received(self,
-                  0,
-                  (gchar*) sqlite3_column_text(priv->search_stmt, 0), // url
-                  (gchar*) sqlite3_column_text(priv->search_stmt, 1), // title
-                  sqlite3_column_int(priv->search_stmt, 2));          // favicon_id
+          /* Make sure results for older text don't turn up */
+          if (priv->index)
+            mwb_ac_index_cancel (priv->index);
+          return;
         }
+
+      /* Results come back from the index's worker thread and are added
+         through mwb_ac_list_result_received; only ask for as many as we
+         have rows for */
+      mwb_ac_index_query (priv->index, search_text,
+                          MWB_AC_LIST_MAX_ENTRIES
+                          - MWB_AC_LIST_N_FIXED_ENTRIES);
     }
 }
 
@@ -1465,7 +1438,7 @@ mwb_ac_list_get_tld_suggestions (MwbAcList *self)
 void
 mwb_ac_list_db_stmt_prepare (MwbAcList *self, void *dbcon)
 {
-  gint rc;
+  const gchar *places_db;
   MwbAcListPrivate *priv = self->priv;
   priv->dbcon = (sqlite3 *)dbcon;
 
@@ -1475,17 +1448,11 @@ mwb_ac_list_db_stmt_prepare (MwbAcList *self, void *dbcon)
       return;
     }
 
-  if (!priv->search_stmt)
-    {
-      rc = sqlite3_prepare_v2 (priv->dbcon,
-                               AC_LIST_SQL,
-                               -1,
-                               &priv->search_stmt,
-                               NULL);
-    if (rc)
-      g_warning("[netpanel] sqlite3_prepare_v2 (): %s",
-                sqlite3_errmsg(priv->dbcon));
-    }
+  /* (Re)build the autocomplete index from the same database, the
+     history may have changed since we were last shown */
+  places_db = sqlite3_db_filename (priv->dbcon, "main");
+  if (places_db && *places_db && priv->index)
+    mwb_ac_index_rebuild (priv->index, places_db);
 }
 
 void
@@ -1493,9 +1460,8 @@ mwb_ac_list_db_stmt_finalize (MwbAcList *self)
 {
   MwbAcListPrivate *priv = self->priv;
 
-  if (priv->search_stmt)
-    sqlite3_finalize(priv->search_stmt);
+  if (priv->index)
+    mwb_ac_index_cancel (priv->index);
 
-  priv->search_stmt = NULL;
   priv->dbcon = NULL; /*  let panel to close db */
 }
@@ -0,0 +1,569 @@
+/*
+ * Dawati-Web-Browser: The web browser for Dawati
+ * Copyright (c) 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "mwb-icon-cache.h"
+
+#define NETPANEL_DIR ".config/internet-panel"
+
+/* Enough for a full panel of thumbnails plus a page of favicons */
+#define MWB_ICON_CACHE_SIZE 64
+
+#define FAVICON_ID_SQL  "SELECT favicon_id FROM urls WHERE url = ?"
+#define FAVICON_URL_SQL "SELECT url FROM favicons WHERE id = ?"
+
+typedef struct
+{
+  gchar      *key;
+  CoglHandle  texture;
+  /* Modification time of the file when it was decoded */
+  time_t      mtime;
+  GList      *link;
+} MwbIconCacheEntry;
+
+typedef struct
+{
+  GObject          *target;
+  MwbIconCacheFunc  callback;
+} MwbIconCacheWaiter;
+
+typedef struct
+{
+  gchar     *key;
+  gchar     *path;
+  gint       width;
+  gint       height;
+  time_t     mtime;
+  GList     *waiters;
+
+  /* Decode order: lowest priority first, then first come first served */
+  gint       priority;
+  guint      serial;
+
+  /* Set by the worker thread */
+  GdkPixbuf *pixbuf;
+} MwbIconCacheRequest;
+
+struct _MwbIconCache
+{
+  sqlite3      *dbcon;
+  sqlite3_stmt *favicon_id_stmt;
+  sqlite3_stmt *favicon_url_stmt;
+
+  /* favicon id -> file name, "" if there is none */
+  GHashTable   *favicon_paths;
+
+  /* key -> MwbIconCacheEntry, most recently used at the head of lru */
+  GHashTable   *textures;
+  GQueue        lru;
+
+  /* key -> MwbIconCacheRequest still being decoded */
+  GHashTable   *pending;
+
+  GThreadPool  *pool;
+  guint         serial;
+  GMutex        done_lock;
+  GList        *done;
+  guint         done_idle_id;
+};
+
+static gchar *
+mwb_icon_cache_make_key (const gchar *path,
+                         gint         width,
+                         gint         height)
+{
+  return g_strdup_printf ("%s@%dx%d", path, width, height);
+}
+
+static time_t
+mwb_icon_cache_get_mtime (const gchar *path)
+{
+  struct stat buf;
+
+  if (g_stat (path, &buf) != 0)
+    return 0;
+
+  return buf.st_mtime;
+}
+
+static void
+mwb_icon_cache_entry_free (gpointer data)
+{
+  MwbIconCacheEntry *entry = (MwbIconCacheEntry *) data;
+
+  cogl_handle_unref (entry->texture);
+
+  g_free (entry->key);
+  g_slice_free (MwbIconCacheEntry, entry);
+}
+
+static void
+mwb_icon_cache_remove (MwbIconCache      *cache,
+                       MwbIconCacheEntry *entry)
+{
+  g_queue_delete_link (&cache->lru, entry->link);
+  g_hash_table_remove (cache->textures, entry->key);
+}
+
+static void
+mwb_icon_cache_insert (MwbIconCache *cache,
+                       const gchar  *key,
+                       time_t        mtime,
+                       CoglHandle    texture)
+{
+  MwbIconCacheEntry *entry;
+
+  while (cache->lru.length >= MWB_ICON_CACHE_SIZE)
+    {
+      entry = (MwbIconCacheEntry *) g_queue_pop_tail (&cache->lru);
+      g_hash_table_remove (cache->textures, entry->key);
+    }
+
+  entry = g_slice_new (MwbIconCacheEntry);
+  entry->key = g_strdup (key);
+  entry->texture = cogl_handle_ref (texture);
+  entry->mtime = mtime;
+
+  g_queue_push_head (&cache->lru, entry);
+  entry->link = cache->lru.head;
+
+  g_hash_table_insert (cache->textures, entry->key, entry);
+}
+
+static void
+mwb_icon_cache_waiter_notify (MwbIconCacheWaiter *waiter,
+                              const gchar        *path,
+                              CoglHandle          texture)
+{
+  if (waiter->target)
+    {
+      g_object_remove_weak_pointer (waiter->target,
+                                    (gpointer *) &waiter->target);
+      waiter->callback (waiter->target, path, texture);
+    }
+
+  g_slice_free (MwbIconCacheWaiter, waiter);
+}
+
+static CoglHandle
+mwb_icon_cache_texture_from_pixbuf (GdkPixbuf *pixbuf)
+{
+  return cogl_texture_new_from_data (gdk_pixbuf_get_width (pixbuf),
+                                     gdk_pixbuf_get_height (pixbuf),
+                                     COGL_TEXTURE_NONE,
+                                     gdk_pixbuf_get_has_alpha (pixbuf)
+                                     ? COGL_PIXEL_FORMAT_RGBA_8888
+                                     : COGL_PIXEL_FORMAT_RGB_888,
+                                     COGL_PIXEL_FORMAT_ANY,
+                                     gdk_pixbuf_get_rowstride (pixbuf),
+                                     gdk_pixbuf_get_pixels (pixbuf));
+}
+
+/*
+ * Uploads everything that was decoded since the last run in one go and
+ * hands the textures to whoever asked for them.
+ */
+static gboolean
+mwb_icon_cache_done_cb (gpointer data)
+{
+  MwbIconCache *cache = (MwbIconCache *) data;
+  GList *done, *l, *w;
+
+  g_mutex_lock (&cache->done_lock);
+  done = cache->done;
+  cache->done = NULL;
+  cache->done_idle_id = 0;
+  g_mutex_unlock (&cache->done_lock);
+
+  for (l = done; l; l = l->next)
+    {
+      MwbIconCacheRequest *request = (MwbIconCacheRequest *) l->data;
+      CoglHandle texture = COGL_INVALID_HANDLE;
+
+      if (request->pixbuf)
+        {
+          texture = mwb_icon_cache_texture_from_pixbuf (request->pixbuf);
+          g_object_unref (request->pixbuf);
+        }
+
+      g_hash_table_remove (cache->pending, request->key);
+
+      /* Failures are not cached, the file may well turn up later */
+      if (texture != COGL_INVALID_HANDLE)
+        mwb_icon_cache_insert (cache, request->key, request->mtime, texture);
+
+      for (w = request->waiters; w; w = w->next)
+        mwb_icon_cache_waiter_notify ((MwbIconCacheWaiter *) w->data,
+                                      request->path, texture);
+      g_list_free (request->waiters);
+
+      if (texture != COGL_INVALID_HANDLE)
+        cogl_handle_unref (texture);
+
+      g_free (request->key);
+      g_free (request->path);
+      g_slice_free (MwbIconCacheRequest, request);
+    }
+
+  g_list_free (done);
+
+  return FALSE;
+}
+
+static void
+mwb_icon_cache_decode (gpointer data,
+                       gpointer user_data)
+{
+  MwbIconCacheRequest *request = (MwbIconCacheRequest *) data;
+  MwbIconCache *cache = (MwbIconCache *) user_data;
+  GError *error = NULL;
+
+  request->pixbuf = gdk_pixbuf_new_from_file_at_scale (request->path,
+                                                       request->width,
+                                                       request->height,
+                                                       TRUE,
+                                                       &error);
+  if (error)
+    {
+      g_warning ("[netpanel] unable to open %s: %s",
+                 request->path, error->message);
+      g_error_free (error);
+    }
+
+  g_mutex_lock (&cache->done_lock);
+  cache->done = g_list_append (cache->done, request);
+  if (!cache->done_idle_id)
+    cache->done_idle_id = clutter_threads_add_idle (mwb_icon_cache_done_cb,
+                                                    cache);
+  g_mutex_unlock (&cache->done_lock);
+}
+
+static gint
+mwb_icon_cache_compare_requests (gconstpointer a,
+                                 gconstpointer b,
+                                 gpointer      user_data)
+{
+  const MwbIconCacheRequest *ra = (const MwbIconCacheRequest *) a;
+  const MwbIconCacheRequest *rb = (const MwbIconCacheRequest *) b;
+
+  if (ra->priority != rb->priority)
+    return ra->priority < rb->priority ? -1 : 1;
+
+  return ra->serial < rb->serial ? -1 : (ra->serial > rb->serial);
+}
+
+MwbIconCache *
+mwb_icon_cache_get_default (void)
+{
+  static MwbIconCache *cache = NULL;
+
+  if (!cache)
+    {
+      cache = g_slice_new0 (MwbIconCache);
+
+      cache->favicon_paths = g_hash_table_new_full (g_direct_hash,
+                                                    g_direct_equal,
+                                                    NULL, g_free);
+      cache->textures = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               NULL,
+                                               mwb_icon_cache_entry_free);
+      cache->pending = g_hash_table_new (g_str_hash, g_str_equal);
+      g_queue_init (&cache->lru);
+
+      g_mutex_init (&cache->done_lock);
+      cache->pool = g_thread_pool_new (mwb_icon_cache_decode, cache,
+                                       1, FALSE, NULL);
+      g_thread_pool_set_sort_function (cache->pool,
+                                       mwb_icon_cache_compare_requests, NULL);
+    }
+
+  return cache;
+}
+
+void
+mwb_icon_cache_set_dbcon (MwbIconCache *cache,
+                          sqlite3      *dbcon)
+{
+  gint rc;
+
+  if (cache->favicon_id_stmt)
+    sqlite3_finalize (cache->favicon_id_stmt);
+  if (cache->favicon_url_stmt)
+    sqlite3_finalize (cache->favicon_url_stmt);
+
+  cache->favicon_id_stmt = NULL;
+  cache->favicon_url_stmt = NULL;
+  cache->dbcon = dbcon;
+
+  /* Favicons may have changed since the database was last open */
+  g_hash_table_remove_all (cache->favicon_paths);
+
+  if (!dbcon)
+    return;
+
+  rc = sqlite3_prepare_v2 (dbcon, FAVICON_ID_SQL, -1,
+                           &cache->favicon_id_stmt, NULL);
+  if (rc)
+    g_warning ("[netpanel] sqlite3_prepare_v2 (): %s", sqlite3_errmsg (dbcon));
+
+  rc = sqlite3_prepare_v2 (dbcon, FAVICON_URL_SQL, -1,
+                           &cache->favicon_url_stmt, NULL);
+  if (rc)
+    g_warning ("[netpanel] sqlite3_prepare_v2 (): %s", sqlite3_errmsg (dbcon));
+}
+
+gchar *
+mwb_icon_cache_get_favicon_path (MwbIconCache *cache,
+                                 gint          favicon_id)
+{
+  const gchar *cached;
+  gchar *path = NULL;
+
+  if (favicon_id <= 0)
+    return NULL;
+
+  cached = (const gchar *) g_hash_table_lookup (cache->favicon_paths,
+                                                GINT_TO_POINTER (favicon_id));
+  if (cached)
+    return *cached ? g_strdup (cached) : NULL;
+
+  if (!cache->favicon_url_stmt)
+    return NULL;
+
+  sqlite3_bind_int (cache->favicon_url_stmt, 1, favicon_id);
+
+  if (sqlite3_step (cache->favicon_url_stmt) == SQLITE_ROW)
+    {
+      const gchar *favi_url =
+        (const gchar *) sqlite3_column_text (cache->favicon_url_stmt, 0);
+
+      if (favi_url)
+        {
+          gchar *csum = g_compute_checksum_for_string (G_CHECKSUM_MD5,
+                                                       favi_url, -1);
+          gchar *filename = g_strconcat (csum, ".ico", NULL);
+
+          path = g_build_filename (g_get_home_dir (),
+                                   NETPANEL_DIR,
+                                   "favicons",
+                                   filename,
+                                   NULL);
+          g_free (csum);
+          g_free (filename);
+
+          if (!g_file_test (path, G_FILE_TEST_EXISTS))
+            {
+              g_free (path);
+              path = NULL;
+            }
+        }
+    }
+
+  sqlite3_reset (cache->favicon_url_stmt);
+
+  g_hash_table_insert (cache->favicon_paths, GINT_TO_POINTER (favicon_id),
+                       g_strdup (path ? path : ""));
+
+  return path;
+}
+
+gchar *
+mwb_icon_cache_get_favicon_path_for_url (MwbIconCache *cache,
+                                         const gchar  *url)
+{
+  gint favicon_id = 0;
+
+  if (!url || !cache->favicon_id_stmt)
+    return NULL;
+
+  sqlite3_bind_text (cache->favicon_id_stmt, 1, url, -1, SQLITE_TRANSIENT);
+
+  if (sqlite3_step (cache->favicon_id_stmt) == SQLITE_ROW)
+    favicon_id = sqlite3_column_int (cache->favicon_id_stmt, 0);
+
+  sqlite3_reset (cache->favicon_id_stmt);
+
+  return mwb_icon_cache_get_favicon_path (cache, favicon_id);
+}
+
+gchar *
+mwb_icon_cache_get_thumbnail_path (MwbIconCache *cache,
+                                   const gchar  *url)
+{
+  gchar *csum = g_compute_checksum_for_string (G_CHECKSUM_MD5, url, -1);
+  gchar *filename = g_strconcat (csum, ".png", NULL);
+  gchar *path = g_build_filename (g_get_home_dir (),
+                                  NETPANEL_DIR,
+                                  "thumbnails",
+                                  filename,
+                                  NULL);
+  g_free (csum);
+  g_free (filename);
+
+  return path;
+}
+
+/**
+ * mwb_icon_cache_load:
+ *
+ * Calls @callback with the texture for @path scaled to fit @width x
+ * @height. This happens straight away if it is cached and the file has
+ * not changed since, otherwise once it has been decoded, provided @target
+ * is still alive. Queued decodes are done in @priority order, lowest
+ * first, as for GSource priorities.
+ */
+void
+mwb_icon_cache_load (MwbIconCache     *cache,
+                     const gchar      *path,
+                     gint              width,
+                     gint              height,
+                     gint              priority,
+                     GObject          *target,
+                     MwbIconCacheFunc  callback)
+{
+  MwbIconCacheEntry *entry;
+  MwbIconCacheRequest *request;
+  MwbIconCacheWaiter *waiter;
+  time_t mtime;
+  gchar *key;
+
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (G_IS_OBJECT (target));
+
+  key = mwb_icon_cache_make_key (path, width, height);
+  mtime = mwb_icon_cache_get_mtime (path);
+
+  entry = (MwbIconCacheEntry *) g_hash_table_lookup (cache->textures, key);
+
+  /* Thumbnails get rewritten in place when a page is revisited */
+  if (entry && entry->mtime != mtime)
+    {
+      mwb_icon_cache_remove (cache, entry);
+      entry = NULL;
+    }
+
+  if (entry)
+    {
+      g_queue_unlink (&cache->lru, entry->link);
+      g_queue_push_head_link (&cache->lru, entry->link);
+
+      g_free (key);
+      callback (target, path, entry->texture);
+      return;
+    }
+
+  waiter = g_slice_new (MwbIconCacheWaiter);
+  waiter->target = target;
+  waiter->callback = callback;
+  g_object_add_weak_pointer (target, (gpointer *) &waiter->target);
+
+  /* Piggy-back on a decode that is already in flight */
+  request = (MwbIconCacheRequest *) g_hash_table_lookup (cache->pending, key);
+  if (request)
+    {
+      request->waiters = g_list_append (request->waiters, waiter);
+      g_free (key);
+      return;
+    }
+
+  request = g_slice_new0 (MwbIconCacheRequest);
+  request->key = key;
+  request->path = g_strdup (path);
+  request->width = width;
+  request->height = height;
+  request->mtime = mtime;
+  request->priority = priority;
+  request->serial = cache->serial++;
+  request->waiters = g_list_append (NULL, waiter);
+
+  g_hash_table_insert (cache->pending, request->key, request);
+  g_thread_pool_push (cache->pool, request, NULL);
+}
+
+static void
+mwb_icon_cache_image_loaded_cb (GObject     *target,
+                                const gchar *path,
+                                CoglHandle   texture)
+{
+  MxImage *image = MX_IMAGE (target);
+  const gchar *wanted, *fallback;
+  gint width, height, priority;
+
+  /* The image may have been given something else to show since */
+  wanted = (const gchar *) g_object_get_data (target, "mwb-icon-path");
+  if (g_strcmp0 (wanted, path) != 0)
+    return;
+
+  if (texture != COGL_INVALID_HANDLE)
+    {
+      mx_image_set_from_cogl_texture (image, texture);
+      return;
+    }
+
+  fallback = (const gchar *) g_object_get_data (target, "mwb-icon-fallback");
+  if (!fallback || !strcmp (fallback, path))
+    return;
+
+  width = GPOINTER_TO_INT (g_object_get_data (target, "mwb-icon-width"));
+  height = GPOINTER_TO_INT (g_object_get_data (target, "mwb-icon-height"));
+  priority = GPOINTER_TO_INT (g_object_get_data (target, "mwb-icon-priority"));
+
+  mwb_icon_cache_load_image (mwb_icon_cache_get_default (), image,
+                             fallback, NULL, width, height, priority);
+}
+
+/**
+ * mwb_icon_cache_load_image:
+ *
+ * Asynchronously shows @path in @image, or @fallback if it can't be
+ * loaded.
+ */
+void
+mwb_icon_cache_load_image (MwbIconCache *cache,
+                           MxImage      *image,
+                           const gchar  *path,
+                           const gchar  *fallback,
+                           gint          width,
+                           gint          height,
+                           gint          priority)
+{
+  GObject *object = G_OBJECT (image);
+
+  if (!path)
+    path = fallback;
+
+  if (!path)
+    return;
+
+  g_object_set_data_full (object, "mwb-icon-path", g_strdup (path), g_free);
+  g_object_set_data_full (object, "mwb-icon-fallback",
+                          g_strdup (fallback), g_free);
+  g_object_set_data (object, "mwb-icon-width", GINT_TO_POINTER (width));
+  g_object_set_data (object, "mwb-icon-height", GINT_TO_POINTER (height));
+  g_object_set_data (object, "mwb-icon-priority", GINT_TO_POINTER (priority));
+
+  mwb_icon_cache_load (cache, path, width, height, priority,
+                       object, mwb_icon_cache_image_loaded_cb);
+}
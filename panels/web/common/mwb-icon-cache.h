@@ -0,0 +1,77 @@
+/*
+ * Dawati-Web-Browser: The web browser for Dawati
+ * Copyright (c) 2009, Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef _MWB_ICON_CACHE_H
+#define _MWB_ICON_CACHE_H
+
+#include <sqlite3.h>
+#include <glib-object.h>
+extern "C" {
+#include <clutter/clutter.h>
+#include <mx/mx.h>
+}
+
+G_BEGIN_DECLS
+
+/*
+ * Favicon and page thumbnail service shared by the autocomplete list and
+ * the tabs/favourites views. Favicon lookups use prepared statements on
+ * the places database, images are decoded on a worker thread, and the
+ * resulting textures are kept in a small LRU keyed on file and size, and
+ * dropped again when the file changes. Failed loads are not cached.
+ */
+typedef struct _MwbIconCache MwbIconCache;
+
+/* @texture is COGL_INVALID_HANDLE if the file could not be loaded. It is
+   only valid for the duration of the call; take a reference to keep it. */
+typedef void (* MwbIconCacheFunc) (GObject     *target,
+                                   const gchar *path,
+                                   CoglHandle   texture);
+
+MwbIconCache *mwb_icon_cache_get_default (void);
+
+void mwb_icon_cache_set_dbcon (MwbIconCache *cache,
+                               sqlite3      *dbcon);
+
+gchar *mwb_icon_cache_get_favicon_path (MwbIconCache *cache,
+                                        gint          favicon_id);
+gchar *mwb_icon_cache_get_favicon_path_for_url (MwbIconCache *cache,
+                                                const gchar  *url);
+gchar *mwb_icon_cache_get_thumbnail_path (MwbIconCache *cache,
+                                          const gchar  *url);
+
+void mwb_icon_cache_load (MwbIconCache     *cache,
+                          const gchar      *path,
+                          gint              width,
+                          gint              height,
+                          gint              priority,
+                          GObject          *target,
+                          MwbIconCacheFunc  callback);
+
+void mwb_icon_cache_load_image (MwbIconCache *cache,
+                                MxImage      *image,
+                                const gchar  *path,
+                                const gchar  *fallback,
+                                gint          width,
+                                gint          height,
+                                gint          priority);
+
+G_END_DECLS
+
+#endif /* _MWB_ICON_CACHE_H */
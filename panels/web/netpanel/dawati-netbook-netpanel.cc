@@ -37,6 +37,7 @@ extern "C" {
 #include "dawati-netbook-netpanel.h"
 #include "mnb-netpanel-bar.h"
 #include "mwb-utils.h"
+#include "mwb-icon-cache.h"
 }
 
 /* Number of favorites columns to display */
@@ -910,138 +911,12 @@ create_favs_placeholder (DawatiNetbookNetpanel *self)
   clutter_actor_set_parent (priv->favs_scrollview, CLUTTER_ACTOR (self));
 }
 
-typedef struct _TextureData{
-  ClutterActor *tex;
-  ClutterActor *favi;
-  gchar *url;
-  gchar *ff;
-}TextureData;
-
-#define NETPANEL_DIR ".config/internet-panel"
-
-static gchar *
-get_favicon_filename(DawatiNetbookNetpanel *self, const char *url)
-{
-  DawatiNetbookNetpanelPrivate *priv = self->priv;
-  gchar *result = NULL;
-
-  gchar *id_stmt = g_strdup_printf("select favicon_id from urls where url='%s'", url);
-  sqlite3_stmt *f1_stmt = NULL;
-  int rc = sqlite3_prepare_v2 (priv->dbcon,
-                           id_stmt,
-                           -1,
-                           &f1_stmt, NULL);
-  int f_id = 0;
-  if (!rc && sqlite3_step (f1_stmt) == SQLITE_ROW)
-    {
-      f_id = sqlite3_column_int(f1_stmt, 0);
-    }
-  sqlite3_finalize(f1_stmt);
-
-  gchar *fv_stmt = g_strdup_printf("select url from favicons where id=%d", f_id);
-  if( f_id!= 0 )
-    {
-      sqlite3_stmt *f2_stmt = NULL;
-      rc = sqlite3_prepare_v2 (priv->dbcon,
-                               fv_stmt,
-                               -1,
-                               &f2_stmt, NULL);
-      if (!rc && sqlite3_step (f2_stmt) == SQLITE_ROW)
-        {
-          gchar *csum = g_compute_checksum_for_string (G_CHECKSUM_MD5,
-                                (gchar*)sqlite3_column_text(f2_stmt, 0), -1);
-          gchar *thumbnail_filename = g_strconcat (csum, ".ico", NULL);
-          result = g_build_filename (g_get_home_dir (),
-                                     NETPANEL_DIR,
-                                     "favicons",
-                                     thumbnail_filename,
-                                     NULL);
-          g_free(csum);
-          g_free(thumbnail_filename);
-        }
-      sqlite3_finalize(f2_stmt);
-    }
-
-  g_free(id_stmt);
-  g_free(fv_stmt);
-
-  return result;
-}
-
-static gboolean
-add_texture_to_scrollview(void*data)
-{
-
-  ClutterActor *tex = ((TextureData*)data)->tex;
-  ClutterActor *favi = ((TextureData*)data)->favi;
-  gchar *url = ((TextureData*)data)->url;
-  gchar *ff = ((TextureData*)data)->ff;
-
-  gchar *csum = g_compute_checksum_for_string (G_CHECKSUM_MD5, url, -1);
-  gchar *thumbnail_filename = g_strconcat (csum, ".png", NULL);
-  gchar *path = g_build_filename (g_get_home_dir (),
-                                  NETPANEL_DIR,
-                                  "thumbnails",
-                                  thumbnail_filename,
-                                  NULL);
-  g_free(csum);
-  g_free(thumbnail_filename);
-  GError *error = NULL;
-
-  if (path)
-    {
-      mx_image_set_from_file_at_size (MX_IMAGE (tex), path,
-                                      CELL_WIDTH, CELL_HEIGHT,
-                                      &error);
-      g_free (path);
-      if (error)
-        {
-          g_warning ("[netpanel] unable to open thumbnail: %s\n",
-                     error->message);
-          g_error_free (error);
-        }
-    }
-  if (!path || error)
-    {
-      error = NULL;
-      mx_image_set_from_file_at_size (MX_IMAGE (tex),
-                                      THEMEDIR "/fallback-page.png",
-                                      CELL_WIDTH, CELL_HEIGHT,
-                                      &error);
-      if (error)
-        {
-          g_warning ("[netpanel] unable to open fallback thumbnail: %s\n",
-                     error->message);
-          g_error_free (error);
-        }
-    }
-
-  error = NULL;
-  if(ff)
-    {
-      mx_image_set_from_file_at_size (MX_IMAGE (favi), ff,
-                                      FAVI_SIZE, FAVI_SIZE,
-                                      &error);
-      if (error)
-        {
-          g_warning ("[netpanel] unable to open thumbnail: %s\n",
-                     error->message);
-          g_error_free (error);
-        }
-    }
-
-  g_free(url);
-  g_free(ff);
-  g_free(data);
-  return FALSE;
-}
-
 static MxWidget *
 add_thumbnail_to_scrollview (ClutterActor *scrollview,
                              const gchar *url, const gchar *title,
                              const gchar *favicon_filename, const int priority)
 {
-  GError *error = NULL;
+  MwbIconCache *cache = mwb_icon_cache_get_default ();
   ClutterActor *vbox, *hbox;
   ClutterActor *button, *tex;
   ClutterActor *label, *favi_tex;
@@ -1092,13 +967,16 @@ add_thumbnail_to_scrollview (ClutterActor *scrollview,
 
   clutter_container_add_actor (CLUTTER_CONTAINER (scrollview), vbox);
 
-  TextureData *tex_data = (TextureData*) g_malloc0 (sizeof (TextureData));
-  tex_data->tex = tex;
-  tex_data->favi = favi_tex;
-  tex_data->url = g_strdup (url);
-  tex_data->ff = g_strdup (favicon_filename);
-  clutter_threads_add_idle_full (priority, add_texture_to_scrollview,
-                                 (void*) tex_data, NULL);
+  /* Decoded off the main loop and shared with the autocomplete list */
+  path = mwb_icon_cache_get_thumbnail_path (cache, url);
+  mwb_icon_cache_load_image (cache, MX_IMAGE (tex), path,
+                             THEMEDIR "/fallback-page.png",
+                             CELL_WIDTH, CELL_HEIGHT, priority);
+  g_free (path);
+
+  if (favicon_filename)
+    mwb_icon_cache_load_image (cache, MX_IMAGE (favi_tex), favicon_filename,
+                               NULL, FAVI_SIZE, FAVI_SIZE, priority);
 
   return MX_WIDGET (button);
 }
@@ -1125,8 +1003,10 @@ favs_received (void *context, const char* url, const char *title, const int prio
   if (!priv->favs_box)
     return;
 
-  gchar *favicon_filename = get_favicon_filename(self, url);
-  button = add_thumbnail_to_scrollview (priv->favs_box, url, title, favicon_filename,  priority);
+  gchar *favicon_filename =
+    mwb_icon_cache_get_favicon_path_for_url (mwb_icon_cache_get_default (),
+                                             url);
+  button = add_thumbnail_to_scrollview (priv->favs_box, url, title, favicon_filename, priority);
   g_free(favicon_filename);
 
   if (button)
@@ -1217,8 +1097,10 @@ static void tabs_received(void* context, int tab_id,
         //sprintf(prev_url, "%s#%d,%d", url, tab_id, navigation_index);
         sprintf(prev_url, "%s", url);
 
-        gchar *favicon_filename = get_favicon_filename(self, url);
-        button = add_thumbnail_to_scrollview (priv->tabs_box, url, title, favicon_filename,  priority);
+        gchar *favicon_filename =
+          mwb_icon_cache_get_favicon_path_for_url (mwb_icon_cache_get_default (),
+                                                   url);
+        button = add_thumbnail_to_scrollview (priv->tabs_box, url, title, favicon_filename, priority);
         g_free(favicon_filename);
         //free(prev_url);
 
@@ -1321,23 +1203,16 @@ create_history (DawatiNetbookNetpanel *self)
         {
           if (priv->n_favs < NR_FAVORITE)
             {
-              /*XXX: Duplicated computing */
               gchar* url = (gchar*)sqlite3_column_text(fav_stmt, 0);
-              gchar *csum = g_compute_checksum_for_string (G_CHECKSUM_MD5, url, -1);
-              gchar *thumbnail_filename = g_strconcat (csum, ".png", NULL);
-              gchar *path = g_build_filename (g_get_home_dir (),
-                                              NETPANEL_DIR,
-                                              "thumbnails",
-                                              thumbnail_filename,
-                                              NULL);
+              gchar *path =
+                mwb_icon_cache_get_thumbnail_path (mwb_icon_cache_get_default (),
+                                                   url);
 
               if(g_file_test(path, G_FILE_TEST_EXISTS))
                 favs_received (self,
                                (gchar*) sqlite3_column_text (fav_stmt, 0),  // url
                                (gchar*) sqlite3_column_text (fav_stmt, 1),  // title
                                priority++);
-              g_free(csum);
-              g_free(thumbnail_filename);
               g_free(path);
             }
         }
@@ -1427,6 +1302,8 @@ dawati_netbook_netpanel_show (ClutterActor *actor)
 
   mwb_utils_places_db_connect(priv->places_db, &priv->dbcon);
 
+  mwb_icon_cache_set_dbcon (mwb_icon_cache_get_default (), priv->dbcon);
+
 //   mwb_utils_db_stmt_prepare(priv->dbcon, &priv->fav_stmt,
 //           &priv->tab_stmt, &priv->thumbnail_stmt);
 
@@ -1513,6 +1390,8 @@ dawati_netbook_netpanel_hide (ClutterActor *actor)
 
   mnb_netpanel_bar_clear_dbcon (G_OBJECT (priv->entry));
 
+  mwb_icon_cache_set_dbcon (mwb_icon_cache_get_default (), NULL);
+
   mwb_utils_places_db_close (priv->dbcon);
 
   CLUTTER_ACTOR_CLASS (dawati_netbook_netpanel_parent_class)->hide (actor);
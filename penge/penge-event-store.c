@@ -0,0 +1,521 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "penge-event-store.h"
+
+#include <libjana-ecal/jana-ecal.h>
+#include <libical/ical.h>
+
+/*
+ * Events are kept in a GSequence ordered by start time. Together with the
+ * longest duration seen so far this gives us the overlap query
+ * "all events intersecting [start, end]" in O(log n + k): everything that can
+ * overlap the window must start in [start - max_duration, end].
+ *
+ * Recurring events are not expanded up front; their instances are generated
+ * on demand for the window being queried and cached until the master
+ * component changes or a query falls outside the expanded window.
+ */
+
+G_DEFINE_TYPE (PengeEventStore, penge_event_store, G_TYPE_OBJECT)
+
+#define GET_PRIVATE_REAL(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), PENGE_TYPE_EVENT_STORE, PengeEventStorePrivate))
+
+#define GET_PRIVATE(o) ((PengeEventStore *)o)->priv
+
+struct _PengeEventStorePrivate {
+  GSequence *events; /* non-recurring PengeEventData, sorted by start */
+  GHashTable *uid_to_entry;
+  GHashTable *recurring; /* uid to recurring PengeEventEntry */
+
+  time_t max_duration;
+};
+
+typedef struct {
+  JanaStore *store;
+  JanaComponent *component;
+
+  /* Non-recurring events */
+  PengeEventData *data;
+  GSequenceIter *iter;
+
+  /* Recurring events */
+  gboolean recurs;
+  gboolean expanded;
+  time_t expanded_start;
+  time_t expanded_end;
+  GList *instances;
+} PengeEventEntry;
+
+static PengeEventData *
+penge_event_data_new (JanaEvent *event,
+                      JanaStore *store,
+                      time_t     start,
+                      time_t     end)
+{
+  PengeEventData *data;
+
+  data = g_slice_new0 (PengeEventData);
+  data->event = event; /* Takes ownership */
+  data->store = g_object_ref (store);
+  data->start = start;
+  data->end = end;
+
+  return data;
+}
+
+static void
+penge_event_data_free (PengeEventData *data)
+{
+  g_object_unref (data->event);
+  g_object_unref (data->store);
+
+  g_slice_free (PengeEventData, data);
+}
+
+static void
+penge_event_entry_clear_instances (PengeEventEntry *entry)
+{
+  GList *l;
+
+  for (l = entry->instances; l; l = g_list_delete_link (l, l))
+    penge_event_data_free ((PengeEventData *)l->data);
+
+  entry->instances = NULL;
+  entry->expanded = FALSE;
+}
+
+static void
+penge_event_entry_free (PengeEventEntry *entry)
+{
+  if (entry->iter)
+    g_sequence_remove (entry->iter);
+
+  if (entry->data)
+    penge_event_data_free (entry->data);
+
+  penge_event_entry_clear_instances (entry);
+
+  g_object_unref (entry->component);
+  g_object_unref (entry->store);
+
+  g_slice_free (PengeEventEntry, entry);
+}
+
+static gint
+_event_data_compare_func (gconstpointer a,
+                          gconstpointer b,
+                          gpointer      userdata)
+{
+  const PengeEventData *data_a = (const PengeEventData *)a;
+  const PengeEventData *data_b = (const PengeEventData *)b;
+
+  if (data_a->start < data_b->start)
+    return -1;
+  else if (data_a->start > data_b->start)
+    return 1;
+  else
+    return 0;
+}
+
+static gint
+_event_data_list_compare_func (gconstpointer a,
+                               gconstpointer b)
+{
+  return _event_data_compare_func (a, b, NULL);
+}
+
+static time_t
+_jana_time_to_time_t (JanaTime *time)
+{
+  time_t t;
+
+  t = jana_ecal_time_to_time_t ((JanaEcalTime *)time);
+  g_object_unref (time);
+
+  return t;
+}
+
+static void
+penge_event_store_dispose (GObject *object)
+{
+  PengeEventStorePrivate *priv = GET_PRIVATE (object);
+
+  if (priv->recurring)
+  {
+    g_hash_table_unref (priv->recurring);
+    priv->recurring = NULL;
+  }
+
+  if (priv->uid_to_entry)
+  {
+    g_hash_table_unref (priv->uid_to_entry);
+    priv->uid_to_entry = NULL;
+  }
+
+  G_OBJECT_CLASS (penge_event_store_parent_class)->dispose (object);
+}
+
+static void
+penge_event_store_finalize (GObject *object)
+{
+  PengeEventStorePrivate *priv = GET_PRIVATE (object);
+
+  /* Entries own their sequence nodes, so this is empty by now */
+  g_sequence_free (priv->events);
+
+  G_OBJECT_CLASS (penge_event_store_parent_class)->finalize (object);
+}
+
+static void
+penge_event_store_class_init (PengeEventStoreClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (PengeEventStorePrivate));
+
+  object_class->dispose = penge_event_store_dispose;
+  object_class->finalize = penge_event_store_finalize;
+}
+
+static void
+penge_event_store_init (PengeEventStore *self)
+{
+  PengeEventStorePrivate *priv = GET_PRIVATE_REAL (self);
+
+  self->priv = priv;
+
+  priv->events = g_sequence_new (NULL);
+  priv->uid_to_entry = g_hash_table_new_full (g_str_hash,
+                                              g_str_equal,
+                                              g_free,
+                                              (GDestroyNotify)penge_event_entry_free);
+  priv->recurring = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+PengeEventStore *
+penge_event_store_new (void)
+{
+  return g_object_new (PENGE_TYPE_EVENT_STORE, NULL);
+}
+
+void
+penge_event_store_add_component (PengeEventStore *event_store,
+                                 JanaStore       *store,
+                                 JanaComponent   *component)
+{
+  PengeEventStorePrivate *priv = GET_PRIVATE (event_store);
+  PengeEventEntry *entry;
+  gchar *uid;
+
+  g_return_if_fail (PENGE_IS_EVENT_STORE (event_store));
+
+  if (jana_component_get_component_type (component) != JANA_COMPONENT_EVENT)
+    return;
+
+  uid = jana_component_get_uid (component);
+
+  /* Replaces any previous version of this component */
+  penge_event_store_remove_uid (event_store, uid);
+
+  entry = g_slice_new0 (PengeEventEntry);
+  entry->store = g_object_ref (store);
+  entry->component = g_object_ref (component);
+  entry->recurs = jana_event_has_recurrence (JANA_EVENT (component));
+
+  if (entry->recurs)
+  {
+    g_hash_table_insert (priv->recurring, uid, entry);
+  } else {
+    JanaEvent *event = JANA_EVENT (component);
+    time_t start, end;
+
+    start = _jana_time_to_time_t (jana_event_get_start (event));
+    end = _jana_time_to_time_t (jana_event_get_end (event));
+
+    if (end - start > priv->max_duration)
+      priv->max_duration = end - start;
+
+    entry->data = penge_event_data_new (g_object_ref (event),
+                                        store,
+                                        start,
+                                        end);
+    entry->iter = g_sequence_insert_sorted (priv->events,
+                                            entry->data,
+                                            _event_data_compare_func,
+                                            NULL);
+  }
+
+  /* Takes ownership of uid */
+  g_hash_table_insert (priv->uid_to_entry, uid, entry);
+}
+
+gboolean
+penge_event_store_remove_uid (PengeEventStore *event_store,
+                              const gchar     *uid)
+{
+  PengeEventStorePrivate *priv = GET_PRIVATE (event_store);
+
+  g_return_val_if_fail (PENGE_IS_EVENT_STORE (event_store), FALSE);
+
+  /* Must go first, the uid key is shared with uid_to_entry */
+  g_hash_table_remove (priv->recurring, uid);
+
+  return g_hash_table_remove (priv->uid_to_entry, uid);
+}
+
+void
+penge_event_store_remove_store (PengeEventStore *event_store,
+                                JanaStore       *store)
+{
+  PengeEventStorePrivate *priv = GET_PRIVATE (event_store);
+  GHashTableIter iter;
+  const gchar *uid;
+  PengeEventEntry *entry;
+
+  g_return_if_fail (PENGE_IS_EVENT_STORE (event_store));
+
+  g_hash_table_iter_init (&iter, priv->uid_to_entry);
+
+  while (g_hash_table_iter_next (&iter,
+                                 (gpointer)&uid,
+                                 (gpointer)&entry))
+  {
+    if (entry->store == store)
+    {
+      g_hash_table_remove (priv->recurring, uid);
+      g_hash_table_iter_remove (&iter);
+    }
+  }
+}
+
+gboolean
+penge_event_store_has_uid (PengeEventStore *event_store,
+                           const gchar     *uid)
+{
+  PengeEventStorePrivate *priv = GET_PRIVATE (event_store);
+
+  return g_hash_table_lookup (priv->uid_to_entry, uid) != NULL;
+}
+
+typedef struct
+{
+  PengeEventEntry *entry;
+  GList *instances;
+} PengeRecurrenceClosure;
+
+static gboolean
+_recur_instance_generate_func (ECalComponent *ecomp,
+                               time_t         start,
+                               time_t         end,
+                               gpointer       data)
+{
+  PengeRecurrenceClosure *closure = (PengeRecurrenceClosure *)data;
+  JanaEvent *jevent;
+  JanaTime *stime, *etime;
+  ECalComponentRange erange;
+
+  jevent = jana_ecal_event_new_from_ecalcomp (ecomp);
+
+  e_cal_component_get_recurid (ecomp, &erange);
+
+  stime = jana_ecal_time_new_from_ecaltime (&(erange.datetime));
+  etime = jana_time_duplicate (stime);
+
+  jana_utils_time_adjust (etime, 0, 0, 0, 0, 0, end - start);
+
+  jana_event_set_start (jevent, stime);
+  jana_event_set_end (jevent, etime);
+
+  g_object_unref (stime);
+  g_object_unref (etime);
+
+  closure->instances = g_list_prepend (closure->instances,
+                                       penge_event_data_new (jevent,
+                                                             closure->entry->store,
+                                                             start,
+                                                             end));
+
+  return TRUE;
+}
+
+static void
+penge_event_entry_expand (PengeEventEntry *entry,
+                          time_t           start,
+                          time_t           end)
+{
+  ECalComponent *ecomp;
+  ECal *ecal;
+  icalcomponent *icomp;
+  PengeRecurrenceClosure closure;
+
+  if (entry->expanded &&
+      entry->expanded_start <= start &&
+      entry->expanded_end >= end)
+  {
+    return;
+  }
+
+  penge_event_entry_clear_instances (entry);
+
+  g_object_get (entry->component,
+                "ecalcomp", &ecomp,
+                NULL);
+
+  g_object_get (entry->store,
+                "ecal", &ecal,
+                NULL);
+
+  icomp = e_cal_component_get_icalcomponent (ecomp);
+
+  closure.entry = entry;
+  closure.instances = NULL;
+
+  e_cal_generate_instances_for_object (ecal,
+                                       icomp,
+                                       start,
+                                       end,
+                                       _recur_instance_generate_func,
+                                       &closure);
+
+  g_object_unref (ecomp);
+  g_object_unref (ecal);
+
+  entry->instances = g_list_reverse (closure.instances);
+  entry->expanded = TRUE;
+  entry->expanded_start = start;
+  entry->expanded_end = end;
+}
+
+/*
+ * Returns the instances overlapping [start, end] sorted by start time. The
+ * list must be freed with g_list_free(); the data belongs to the store and is
+ * only valid until the store is next modified or queried.
+ */
+GList *
+penge_event_store_get_events (PengeEventStore *event_store,
+                              time_t           start,
+                              time_t           end)
+{
+  PengeEventStorePrivate *priv = GET_PRIVATE (event_store);
+  GList *events = NULL;
+  GList *recurring_events = NULL;
+  GSequenceIter *iter, *prev;
+  PengeEventData key;
+  PengeEventData *data;
+  GHashTableIter hash_iter;
+  PengeEventEntry *entry;
+  GList *l;
+
+  g_return_val_if_fail (PENGE_IS_EVENT_STORE (event_store), NULL);
+
+  /* Nothing starting before this can reach into the window */
+  key.start = start - priv->max_duration;
+
+  iter = g_sequence_search (priv->events,
+                            &key,
+                            _event_data_compare_func,
+                            NULL);
+
+  /* g_sequence_search() may land after a run of equal keys */
+  while (!g_sequence_iter_is_begin (iter))
+  {
+    prev = g_sequence_iter_prev (iter);
+    data = (PengeEventData *)g_sequence_get (prev);
+
+    if (data->start < key.start)
+      break;
+
+    iter = prev;
+  }
+
+  for (; !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter))
+  {
+    data = (PengeEventData *)g_sequence_get (iter);
+
+    if (data->start > end)
+      break;
+
+    if (data->end >= start)
+      events = g_list_prepend (events, data);
+  }
+
+  events = g_list_reverse (events);
+
+  g_hash_table_iter_init (&hash_iter, priv->recurring);
+
+  while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer)&entry))
+  {
+    penge_event_entry_expand (entry, start, end);
+
+    for (l = entry->instances; l; l = l->next)
+    {
+      data = (PengeEventData *)l->data;
+
+      if (data->start <= end && data->end >= start)
+        recurring_events = g_list_prepend (recurring_events, data);
+    }
+  }
+
+  if (recurring_events)
+  {
+    events = g_list_concat (events, recurring_events);
+    events = g_list_sort (events, _event_data_list_compare_func);
+  }
+
+  return events;
+}
+
+/*
+ * Returns the instances of @uid overlapping [start, end]. Same ownership rules
+ * as penge_event_store_get_events().
+ */
+GList *
+penge_event_store_get_events_for_uid (PengeEventStore *event_store,
+                                      const gchar     *uid,
+                                      time_t           start,
+                                      time_t           end)
+{
+  PengeEventStorePrivate *priv = GET_PRIVATE (event_store);
+  PengeEventEntry *entry;
+  PengeEventData *data;
+  GList *events = NULL;
+  GList *l;
+
+  g_return_val_if_fail (PENGE_IS_EVENT_STORE (event_store), NULL);
+
+  entry = g_hash_table_lookup (priv->uid_to_entry, uid);
+
+  if (!entry)
+    return NULL;
+
+  if (!entry->recurs)
+    return g_list_prepend (NULL, entry->data);
+
+  penge_event_entry_expand (entry, start, end);
+
+  for (l = entry->instances; l; l = l->next)
+  {
+    data = (PengeEventData *)l->data;
+
+    if (data->start <= end && data->end >= start)
+      events = g_list_prepend (events, data);
+  }
+
+  return g_list_reverse (events);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2008 - 2009 Intel Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef _PENGE_EVENT_STORE
+#define _PENGE_EVENT_STORE
+
+#include <time.h>
+#include <glib-object.h>
+#include <libjana/jana.h>
+
+G_BEGIN_DECLS
+
+#define PENGE_TYPE_EVENT_STORE penge_event_store_get_type()
+
+#define PENGE_EVENT_STORE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), PENGE_TYPE_EVENT_STORE, PengeEventStore))
+
+#define PENGE_EVENT_STORE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), PENGE_TYPE_EVENT_STORE, PengeEventStoreClass))
+
+#define PENGE_IS_EVENT_STORE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), PENGE_TYPE_EVENT_STORE))
+
+#define PENGE_IS_EVENT_STORE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), PENGE_TYPE_EVENT_STORE))
+
+#define PENGE_EVENT_STORE_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), PENGE_TYPE_EVENT_STORE, PengeEventStoreClass))
+
+typedef struct _PengeEventStorePrivate PengeEventStorePrivate;
+
+typedef struct {
+  GObject parent;
+  PengeEventStorePrivate *priv;
+} PengeEventStore;
+
+typedef struct {
+  GObjectClass parent_class;
+} PengeEventStoreClass;
+
+/* A single (possibly recurring) instance of an event. Owned by the store. */
+typedef struct {
+  JanaEvent *event;
+  JanaStore *store;
+  time_t start;
+  time_t end;
+} PengeEventData;
+
+GType penge_event_store_get_type (void);
+
+PengeEventStore *penge_event_store_new (void);
+
+void penge_event_store_add_component (PengeEventStore *event_store,
+                                      JanaStore       *store,
+                                      JanaComponent   *component);
+gboolean penge_event_store_remove_uid (PengeEventStore *event_store,
+                                       const gchar     *uid);
+void penge_event_store_remove_store (PengeEventStore *event_store,
+                                     JanaStore       *store);
+gboolean penge_event_store_has_uid (PengeEventStore *event_store,
+                                    const gchar     *uid);
+
+GList *penge_event_store_get_events (PengeEventStore *event_store,
+                                     time_t           start,
+                                     time_t           end);
+GList *penge_event_store_get_events_for_uid (PengeEventStore *event_store,
+                                             const gchar     *uid,
+                                             time_t           start,
+                                             time_t           end);
+
+G_END_DECLS
+
+#endif /* _PENGE_EVENT_STORE */
@@ -26,6 +26,7 @@
 #include <libjana-ecal/jana-ecal.h>
 #include <libical/ical.h>
 
+#include "penge-event-store.h"
 #include "penge-event-tile.h"
 #include "penge-utils.h"
 
@@ -43,7 +44,7 @@ struct _PengeEventsPanePrivate {
   JanaDuration *duration;
   JanaTime *time;
 
-  GHashTable *uid_to_events_list; /* uid to list of event data structures */
+  PengeEventStore *event_store;
   GHashTable *uid_rid_to_actors; /* uid & rid concatenated to actor */
 
   ClutterActor *no_events_bin;
@@ -60,11 +61,6 @@ enum
   PROP_MULTILINE_SUMMARY
 };
 
-typedef struct {
-  JanaEvent *event;
-  JanaStore *store;
-} PengeEventData;
-
 #define TILE_WIDTH 216
 #define TILE_HEIGHT 52
 
@@ -76,10 +72,6 @@ static void penge_events_pane_update_duration (PengeEventsPane *pane,
 static void penge_events_pane_update_durations (PengeEventsPane *pane);
 static void penge_events_pane_update (PengeEventsPane *pane);
 
-static PengeEventData *penge_event_data_new (void);
-static void penge_event_data_free (PengeEventData *data);
-static void penge_event_data_list_free (GList *event_data_list);
-
 static void penge_events_pane_setup_stores (PengeEventsPane *pane);
 
 static void
@@ -147,10 +139,10 @@ penge_events_pane_dispose (GObject *object)
 {
   PengeEventsPanePrivate *priv = GET_PRIVATE (object);
 
-  if (priv->uid_to_events_list)
+  if (priv->event_store)
   {
-    g_hash_table_unref (priv->uid_to_events_list);
-    priv->uid_to_events_list = NULL;
+    g_object_unref (priv->event_store);
+    priv->event_store = NULL;
   }
 
   if (priv->uid_rid_to_actors)
@@ -226,52 +218,6 @@ penge_events_pane_class_init (PengeEventsPaneClass *klass)
   g_object_class_install_property (object_class, PROP_MULTILINE_SUMMARY, pspec);
 }
 
-static gint
-_event_compare_func (gconstpointer a,
-                     gconstpointer b)
-{
-  PengeEventData *ed_a = (PengeEventData *)a;
-  PengeEventData *ed_b = (PengeEventData *)b;
-
-  JanaEvent *event_a = ed_a->event;
-  JanaEvent *event_b = ed_b->event;
-
-  JanaTime *start_a, *start_b;
-  gint retval;
-
-  start_a = jana_event_get_start (event_a);
-  start_b = jana_event_get_start (event_b);
-
-  retval = jana_utils_time_compare (start_a,
-                                    start_b,
-                                    FALSE);
-
-  g_object_unref (start_a);
-  g_object_unref (start_b);
-
-  return retval;
-}
-
-static GList *
-penge_events_pane_flatten_events (PengeEventsPane *pane)
-{
-  PengeEventsPanePrivate *priv = GET_PRIVATE (pane);
-  GList *events = NULL, *l;
-  GList *event_lists;
-
-  event_lists = g_hash_table_get_values (priv->uid_to_events_list);
-
-  for (l = event_lists; l; l = l->next)
-  {
-    /* Have to copy the list to avoid upsetting it */
-    events = g_list_concat (events, g_list_copy ((GList *)(l->data)));
-  }
-
-  g_list_free (event_lists);
-
-  return events;
-}
-
 static void
 penge_events_pane_update (PengeEventsPane *pane)
 {
@@ -285,7 +231,7 @@ penge_events_pane_update (PengeEventsPane *pane)
   gchar *uid, *rid, *uid_rid;
   GList *old_actors;
   JanaTime *on_the_hour;
-  JanaTime *t = NULL;
+  time_t start, end;
   ClutterActor *label;
   gboolean event_displayed = FALSE;
 
@@ -294,29 +240,23 @@ penge_events_pane_update (PengeEventsPane *pane)
   /* So we can remove the "old" actors */
   old_actors = g_hash_table_get_values (priv->uid_rid_to_actors);
 
-  events = penge_events_pane_flatten_events (pane);
-  events = g_list_sort (events, _event_compare_func);
-
   on_the_hour = jana_time_duplicate (priv->time);
 
   jana_time_set_minutes (on_the_hour, 0);
   jana_time_set_seconds (on_the_hour, 0);
 
+  /* Only events that haven't already finished */
+  start = jana_ecal_time_to_time_t ((JanaEcalTime *)on_the_hour);
+  end = jana_ecal_time_to_time_t ((JanaEcalTime *)priv->duration->end);
+
+  events = penge_event_store_get_events (priv->event_store, start, end);
+
   count = 0;
   for (l = events; l; l = l->next)
   {
     event_data = (PengeEventData *)l->data;
     event = event_data->event;
 
-    /* Skip events that are already finished */
-    t = jana_event_get_end (event);
-    if (jana_utils_time_compare (t, on_the_hour, FALSE) < 0)
-    {
-      g_object_unref (t);
-      continue;
-    }
-    g_object_unref (t);
-
     uid = jana_component_get_uid (JANA_COMPONENT (event));
     rid = jana_ecal_component_get_recurrence_id (JANA_ECAL_COMPONENT (event));
 
@@ -424,102 +364,6 @@ penge_events_pane_update (PengeEventsPane *pane)
   g_object_unref (on_the_hour);
 }
 
-typedef struct
-{
-  JanaStore *store;
-  GList *events_list;
-} PengeRecurrenceClosure;
-
-static gboolean
-_recur_instance_generate_func (ECalComponent *ecomp,
-                               time_t         start,
-                               time_t         end,
-                               gpointer       data)
-{
-  PengeRecurrenceClosure *closure = (PengeRecurrenceClosure *)data;
-  PengeEventData *event_data;
-  JanaEvent *jevent;
-  JanaTime *stime, *etime;
-  ECalComponentRange erange;
-
-  jevent = jana_ecal_event_new_from_ecalcomp (ecomp);
-
-  event_data = penge_event_data_new ();
-  event_data->store = g_object_ref (closure->store);
-  event_data->event = jevent;
-
-  e_cal_component_get_recurid (ecomp, &erange);
-
-  stime = jana_ecal_time_new_from_ecaltime (&(erange.datetime));
-  etime = jana_time_duplicate (stime);
-
-  jana_utils_time_adjust (etime, 0, 0, 0, 0, 0, end - start);
-
-  jana_event_set_start (jevent, stime);
-  jana_event_set_end (jevent, etime);
-
-  closure->events_list = g_list_append (closure->events_list, event_data);
-
-  return TRUE;
-}
-
-static GList *
-_create_event_list_for_event (PengeEventsPane *pane,
-                              JanaComponent   *component,
-                              JanaStore       *store)
-{
-  PengeEventsPanePrivate *priv = GET_PRIVATE (pane);
-  GList *events_list = NULL;
-
-  if (!jana_event_has_recurrence (JANA_EVENT (component)))
-  {
-    PengeEventData *event_data;
-    JanaEvent *event;
-
-    event = (JanaEvent *)component;
-
-    event_data = penge_event_data_new ();
-
-    /* Gives us a new reference, no need to ref-up */
-    event_data->event = g_object_ref (event);
-    event_data->store = g_object_ref (store);
-    events_list = g_list_append (events_list, event_data);
-  } else {
-    ECalComponent *ecomp;
-    ECal *ecal;
-    icalcomponent *icomp;
-    time_t tt_start, tt_end;
-    PengeRecurrenceClosure closure;
-
-    g_object_get (component,
-                  "ecalcomp", &ecomp,
-                  NULL);
-
-    g_object_get (store,
-                  "ecal", &ecal,
-                  NULL);
-
-    icomp = e_cal_component_get_icalcomponent (ecomp);
-
-    tt_start = jana_ecal_time_to_time_t ((JanaEcalTime *)priv->duration->start);
-    tt_end = jana_ecal_time_to_time_t ((JanaEcalTime *)priv->duration->end);
-
-    closure.store = store;
-    closure.events_list = NULL;
-
-    e_cal_generate_instances_for_object (ecal,
-                                         icomp,
-                                         tt_start,
-                                         tt_end,
-                                         _recur_instance_generate_func,
-                                         &closure);
-    g_object_unref (ecomp);
-    events_list = closure.events_list;
-  }
-
-  return events_list;
-}
-
 static void
 _store_view_added_cb (JanaStoreView *view,
                       GList         *components,
@@ -528,25 +372,16 @@ _store_view_added_cb (JanaStoreView *view,
   PengeEventsPane *pane = (PengeEventsPane *)userdata;
   PengeEventsPanePrivate *priv = GET_PRIVATE (pane);
   GList *l;
-  JanaComponent *component;
-  gchar *uid;
   JanaStore *store;
-  GList *events_list;
 
   store = jana_store_view_get_store (view);
 
+  /* Recurrences are expanded lazily when the pane asks for its window */
   for (l = components; l; l = l->next)
   {
-    component = (JanaComponent *)l->data;
-
-    if (jana_component_get_component_type (component) == JANA_COMPONENT_EVENT)
-    {
-      uid = jana_component_get_uid (component);
-      events_list = _create_event_list_for_event (pane, component, store);
-      g_hash_table_insert (priv->uid_to_events_list,
-                           uid,
-                           events_list);
-    }
+    penge_event_store_add_component (priv->event_store,
+                                     store,
+                                     (JanaComponent *)l->data);
   }
 
   g_object_unref (store);
@@ -565,27 +400,28 @@ _store_view_modified_cb (JanaStoreView *view,
   JanaComponent *component;
   gchar *uid;
   ClutterActor *actor;
-  GList *old_events_list = NULL;
   GList *events_list = NULL;
   JanaStore *store;
+  time_t start, end;
 
   store = jana_store_view_get_store (view);
 
+  start = jana_ecal_time_to_time_t ((JanaEcalTime *)priv->duration->start);
+  end = jana_ecal_time_to_time_t ((JanaEcalTime *)priv->duration->end);
+
   for (l = components; l; l = l->next)
   {
     component = (JanaComponent *)l->data;
 
     uid = jana_component_get_uid (component);
-    old_events_list = g_hash_table_lookup (priv->uid_to_events_list,
-                                           uid);
 
-    if (old_events_list)
+    if (penge_event_store_has_uid (priv->event_store, uid))
     {
-      events_list = _create_event_list_for_event (pane, component, store);
-      g_hash_table_remove (priv->uid_to_events_list, uid);
-      g_hash_table_insert (priv->uid_to_events_list,
-                           g_strdup (uid),
-                           events_list);
+      penge_event_store_add_component (priv->event_store, store, component);
+      events_list = penge_event_store_get_events_for_uid (priv->event_store,
+                                                          uid,
+                                                          start,
+                                                          end);
     } else {
       /* Our range contains events that we might not have actors for */
     }
@@ -616,6 +452,8 @@ _store_view_modified_cb (JanaStoreView *view,
       g_free (uid_rid);
     }
 
+    g_list_free (events_list);
+    events_list = NULL;
     g_free (uid);
   }
 
@@ -638,8 +476,7 @@ _store_view_removed_cb (JanaStoreView *view,
   {
     uid = (const gchar *)l->data;
 
-    if (!g_hash_table_remove (priv->uid_to_events_list,
-                              uid))
+    if (!penge_event_store_remove_uid (priv->event_store, uid))
     {
       /* Our range might contain events that we aren't presenting */
     }
@@ -754,28 +591,11 @@ penge_events_pane_setup_stores (PengeEventsPane *pane)
   {
     JanaStore *store;
     const gchar *uid = (const gchar *)l->data;
-    GHashTableIter iter;
-    gchar *event_uid;
-    GList *events_list = NULL;
-    PengeEventData *event_data;
-    GList *l;
 
     store = g_hash_table_lookup (priv->stores, uid);
     g_hash_table_remove (priv->views, store);
 
-    g_hash_table_iter_init (&iter, priv->uid_to_events_list);
-
-    while (g_hash_table_iter_next (&iter,
-                                   (gpointer)&event_uid,
-                                   (gpointer)&events_list))
-    {
-      for (l = events_list; l; l = l->next)
-      {
-        event_data = (PengeEventData *)l->data;
-        if (event_data->store == store)
-          g_hash_table_iter_remove (&iter);
-      }
-    }
+    penge_event_store_remove_store (priv->event_store, store);
   }
 
   penge_events_pane_update (pane);
@@ -798,11 +618,9 @@ penge_events_pane_init (PengeEventsPane *self)
 
   self->priv = priv;
 
+  priv->event_store = penge_event_store_new ();
+
   /* Create hashes to store our view membership in */
-  priv->uid_to_events_list = g_hash_table_new_full (g_str_hash,
-                                                    g_str_equal,
-                                                    g_free,
-                                                    (GDestroyNotify)penge_event_data_list_free);
   priv->uid_rid_to_actors = g_hash_table_new_full (g_str_hash,
                                                    g_str_equal,
                                                    g_free,
@@ -854,34 +672,6 @@ penge_events_pane_update_durations (PengeEventsPane *pane)
   g_list_free (views);
 }
 
-static PengeEventData *
-penge_event_data_new (void)
-{
-  return g_slice_new0 (PengeEventData);
-}
-
-static void
-penge_event_data_free (PengeEventData *data)
-{
-  g_object_unref (data->event);
-  g_object_unref (data->store);
-
-  g_slice_free (PengeEventData, data);
-}
-
-static void
-penge_event_data_list_free (GList *event_data_list)
-{
-  PengeEventData *event_data;
-  GList *l;
-
-  for (l = event_data_list; l; l = l->next)
-  {
-    event_data = (PengeEventData *)l->data;
-    penge_event_data_free (event_data);
-  }
-}
-
 void 
 penge_events_pane_set_duration (PengeEventsPane *pane, JanaDuration *duration)
 {
@@ -25,16 +25,26 @@
 #include <clutter/x11/clutter-x11.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <meta/meta-shaped-texture.h>
+#include <dawati-panel/mpl-window-thumbnail.h>
 
 #include "mnb-alttab-overlay.h"
 #include "mnb-alttab-overlay-app.h"
 
+/*
+ * Thumbnails are downscaled copies of the window texture, refreshed at most
+ * once every THUMBNAIL_REFRESH_INTERVAL ms while the overlay is up, and on
+ * the next show otherwise.
+ */
+#define THUMBNAIL_REFRESH_INTERVAL 250
+
 static void mnb_alttab_overlay_app_origin_weak_notify (gpointer, GObject *);
 
 struct _MnbAlttabOverlayAppPrivate
 {
   MetaWindowActor *mcw;     /* MetaWindowActor we represent */
 
+  ClutterActor    *thumbnail;
+
   gboolean      active   : 1;
 };
 
@@ -114,11 +124,15 @@ static void
 mnb_alttab_overlay_app_origin_weak_notify (gpointer data, GObject *obj)
 {
   ClutterActor *self = data;
+  ClutterActor *parent = clutter_actor_get_parent (self);
+
+  MNB_ALTTAB_OVERLAY_APP (self)->priv->mcw = NULL;
 
   /*
    * The original MutterWindow destroyed, destroy self.
    */
-  clutter_actor_remove_child (clutter_actor_get_parent (self), self);
+  if (parent)
+    clutter_actor_remove_child (parent, self);
 }
 
 static void
@@ -148,26 +162,34 @@ mnb_alttab_overlay_app_init (MnbAlttabOverlayApp *self)
   self->priv = MNB_ALTTAB_OVERLAY_APP_GET_PRIVATE (self);
 }
 
-MnbAlttabOverlayApp *
-mnb_alttab_overlay_app_new (MetaWindowActor *mcw)
+static CoglHandle
+mnb_alttab_overlay_app_get_window_texture (gpointer data)
 {
-  MetaWindow   *mw;
-  GdkPixbuf    *pixbuf = NULL;
-  CoglHandle    cogl_texture;
-  ClutterActor *meta_texture;
-  ClutterActor *icon = NULL, *thumbnail;
+  MnbAlttabOverlayApp *app = data;
+  ClutterActor        *meta_texture;
 
-  g_return_val_if_fail (META_IS_WINDOW_ACTOR (mcw), NULL);
+  if (!app->priv->mcw)
+    return COGL_INVALID_HANDLE;
 
-  mw = meta_window_actor_get_meta_window (mcw);
+  meta_texture = meta_window_actor_get_texture (app->priv->mcw);
 
-  meta_texture = meta_window_actor_get_texture (mcw);
-  cogl_texture =
-    meta_shaped_texture_get_texture (META_SHAPED_TEXTURE (meta_texture));
+  return meta_shaped_texture_get_texture (META_SHAPED_TEXTURE (meta_texture));
+}
 
-  thumbnail = clutter_texture_new ();
-  clutter_texture_set_cogl_texture (CLUTTER_TEXTURE (thumbnail), cogl_texture);
-  clutter_texture_set_keep_aspect_ratio (CLUTTER_TEXTURE (thumbnail), TRUE);
+static void
+mnb_alttab_overlay_app_damage_cb (ClutterActor        *texture,
+                                  ClutterActor        *origin,
+                                  MnbAlttabOverlayApp *app)
+{
+  mpl_window_thumbnail_damage (MPL_WINDOW_THUMBNAIL (app->priv->thumbnail));
+}
+
+static void
+mnb_alttab_overlay_app_update_icon (MnbAlttabOverlayApp *app)
+{
+  MetaWindow   *mw = meta_window_actor_get_meta_window (app->priv->mcw);
+  GdkPixbuf    *pixbuf = NULL;
+  ClutterActor *icon = NULL;
 
   g_object_get (mw, "icon", &pixbuf, NULL);
 
@@ -186,14 +208,84 @@ mnb_alttab_overlay_app_new (MetaWindowActor *mcw)
       g_object_unref (pixbuf);
     }
 
-  return g_object_new (MNB_TYPE_ALTTAB_OVERLAY_APP,
-                       "mutter-window", mcw,
-                       "icon", icon,
-                       "title", meta_window_get_description (mw),
-                       "subtitle", meta_window_get_title (mw),
-                       "thumbnail", thumbnail,
-                       "can-close", FALSE,
-                       NULL);
+  mpl_application_view_set_icon (MPL_APPLICATION_VIEW (app), icon);
+}
+
+static void
+mnb_alttab_overlay_app_icon_notify_cb (MetaWindow          *mw,
+                                       GParamSpec          *pspec,
+                                       MnbAlttabOverlayApp *app)
+{
+  mnb_alttab_overlay_app_update_icon (app);
+}
+
+MnbAlttabOverlayApp *
+mnb_alttab_overlay_app_new (MetaWindowActor *mcw)
+{
+  MnbAlttabOverlayApp        *app;
+  MnbAlttabOverlayAppPrivate *priv;
+  MetaWindow                 *mw;
+
+  g_return_val_if_fail (META_IS_WINDOW_ACTOR (mcw), NULL);
+
+  mw = meta_window_actor_get_meta_window (mcw);
+
+  app = g_object_new (MNB_TYPE_ALTTAB_OVERLAY_APP,
+                      "mutter-window", mcw,
+                      "title", meta_window_get_description (mw),
+                      "subtitle", meta_window_get_title (mw),
+                      "can-close", FALSE,
+                      NULL);
+  priv = app->priv;
+
+  priv->thumbnail = mpl_window_thumbnail_new ();
+  g_object_set (priv->thumbnail,
+                "max-size", mpl_application_get_tile_width (),
+                "interval", THUMBNAIL_REFRESH_INTERVAL,
+                NULL);
+  mpl_window_thumbnail_set_source_func (MPL_WINDOW_THUMBNAIL (priv->thumbnail),
+                                        mnb_alttab_overlay_app_get_window_texture,
+                                        app, NULL);
+  mpl_application_view_set_thumbnail (MPL_APPLICATION_VIEW (app),
+                                      priv->thumbnail);
+
+  mnb_alttab_overlay_app_update_icon (app);
+  mpl_window_thumbnail_update (MPL_WINDOW_THUMBNAIL (priv->thumbnail));
+
+  g_signal_connect_object (meta_window_actor_get_texture (mcw), "queue-redraw",
+                           G_CALLBACK (mnb_alttab_overlay_app_damage_cb),
+                           app, 0);
+  g_signal_connect_object (mw, "notify::icon",
+                           G_CALLBACK (mnb_alttab_overlay_app_icon_notify_cb),
+                           app, 0);
+
+  return app;
+}
+
+/*
+ * Brings a cached app up to date before the overlay is shown again.
+ */
+void
+mnb_alttab_overlay_app_update (MnbAlttabOverlayApp *app)
+{
+  MnbAlttabOverlayAppPrivate *priv;
+  MetaWindow                 *mw;
+
+  g_return_if_fail (MNB_IS_ALTTAB_OVERLAY_APP (app));
+
+  priv = app->priv;
+
+  if (!priv->mcw)
+    return;
+
+  mw = meta_window_actor_get_meta_window (priv->mcw);
+
+  mpl_application_view_set_title (MPL_APPLICATION_VIEW (app),
+                                  meta_window_get_description (mw));
+  mpl_application_view_set_subtitle (MPL_APPLICATION_VIEW (app),
+                                     meta_window_get_title (mw));
+
+  mpl_window_thumbnail_update (MPL_WINDOW_THUMBNAIL (priv->thumbnail));
 }
 
 void
@@ -61,6 +61,7 @@ struct _MnbAlttabOverlayAppClass
 GType mnb_alttab_overlay_app_get_type (void);
 
 MnbAlttabOverlayApp *mnb_alttab_overlay_app_new (MetaWindowActor *mcw);
+void                 mnb_alttab_overlay_app_update (MnbAlttabOverlayApp *app);
 
 void             mnb_alttab_overlay_app_set_active (MnbAlttabOverlayApp *app,
                                                     gboolean             active);
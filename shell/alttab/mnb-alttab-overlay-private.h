@@ -35,6 +35,7 @@ struct _MnbAlttabOverlayPrivate
   MnbAlttabOverlayApp *active;
   ClutterActor        *grid;
   ClutterActor        *scrollview;
+  GHashTable          *apps; /* MetaWindowActor -> MnbAlttabOverlayApp */
 
   gint                 screen_width;
   gint                 screen_height;
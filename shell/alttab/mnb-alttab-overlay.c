@@ -147,15 +147,37 @@ mnb_alttab_overlay_get_app_list (MnbAlttabOverlay *self)
   return filtered;
 }
 
+static gboolean
+remove_app_cb (gpointer key, gpointer value, gpointer app)
+{
+  return value == app;
+}
+
+static void
+mnb_alttab_overlay_app_weak_notify (gpointer data, GObject *app)
+{
+  MnbAlttabOverlay *self = data;
+
+  if ((GObject *) self->priv->active == app)
+    self->priv->active = NULL;
+
+  g_hash_table_foreach_remove (self->priv->apps, remove_app_cb, app);
+}
+
 /*
  * If there are less that 2 applications, no population is done, and return
  * value is FALSE.
+ *
+ * The apps are kept around between invocations, one per window, and only get
+ * reordered to match the MRU order; see mnb_alttab_overlay_app_update().
  */
 static gboolean
 mnb_alttab_overlay_populate (MnbAlttabOverlay *self)
 {
   MnbAlttabOverlayPrivate   *priv = self->priv;
-  GList                     *l, *filtered = NULL, *active = NULL;
+  GList                     *l, *filtered = NULL;
+  ClutterActor              *child;
+  gint                       i;
 
   filtered = mnb_alttab_overlay_get_app_list (self);
 
@@ -165,28 +187,46 @@ mnb_alttab_overlay_populate (MnbAlttabOverlay *self)
       return FALSE;
     }
 
-  for (l = filtered; l; l = l->next)
+  for (l = filtered, i = 0; l; l = l->next, i++)
     {
       MetaWindowActor     *m = l->data;
       MnbAlttabOverlayApp *app;
 
-      app = mnb_alttab_overlay_app_new (m);
+      app = g_hash_table_lookup (priv->apps, m);
+
+      if (app)
+        {
+          mnb_alttab_overlay_app_update (app);
+          clutter_actor_set_child_at_index (priv->grid,
+                                            (ClutterActor *) app, i);
+        }
+      else
+        {
+          app = mnb_alttab_overlay_app_new (m);
+
+          g_hash_table_insert (priv->apps, m, app);
+          g_object_weak_ref (G_OBJECT (app),
+                             mnb_alttab_overlay_app_weak_notify, self);
 
-      if (!active)
-        active = l->next;
+          clutter_actor_insert_child_at_index (priv->grid,
+                                               (ClutterActor *) app, i);
+        }
 
       /*
        * Mark second application active.
        */
-      if (l == active)
-        {
-          mnb_alttab_overlay_app_set_active (app, TRUE);
-          priv->active = app;
-        }
+      mnb_alttab_overlay_app_set_active (app, i == 1);
 
-      clutter_actor_add_child (priv->grid, (ClutterActor *) app);
+      if (i == 1)
+        priv->active = app;
     }
 
+  /*
+   * Whatever is left past the current windows no longer qualifies.
+   */
+  while ((child = clutter_actor_get_child_at_index (priv->grid, i)))
+    clutter_actor_destroy (child);
+
   g_list_free (filtered);
 
   return TRUE;
@@ -196,12 +236,36 @@ static void
 mnb_alttab_overlay_depopulate (MnbAlttabOverlay *self)
 {
   MnbAlttabOverlayPrivate *priv = self->priv;
-  ClutterActorIter iter;
-  ClutterActor *child;
 
-  clutter_actor_iter_init (&iter, priv->grid);
-  while (clutter_actor_iter_next (&iter, &child))
-    clutter_actor_iter_destroy (&iter);
+  /* The apps stay in the grid for the next time around */
+  if (priv->active)
+    {
+      mnb_alttab_overlay_app_set_active (priv->active, FALSE);
+      priv->active = NULL;
+    }
+}
+
+static void
+mnb_alttab_overlay_dispose (GObject *object)
+{
+  MnbAlttabOverlayPrivate *priv = MNB_ALTTAB_OVERLAY (object)->priv;
+
+  if (priv->apps)
+    {
+      GHashTableIter iter;
+      gpointer       app;
+
+      g_hash_table_iter_init (&iter, priv->apps);
+      while (g_hash_table_iter_next (&iter, NULL, &app))
+        g_object_weak_unref (app, mnb_alttab_overlay_app_weak_notify, object);
+
+      g_hash_table_unref (priv->apps);
+      priv->apps = NULL;
+    }
+
+  priv->active = NULL;
+
+  G_OBJECT_CLASS (mnb_alttab_overlay_parent_class)->dispose (object);
 }
 
 static void
@@ -368,6 +432,7 @@ mnb_alttab_overlay_class_init (MnbAlttabOverlayClass *klass)
   object_class->get_property         = mnb_alttab_overlay_get_property;
   object_class->set_property         = mnb_alttab_overlay_set_property;
   object_class->constructed          = mnb_alttab_overlay_constructed;
+  object_class->dispose              = mnb_alttab_overlay_dispose;
 
   actor_class->get_preferred_width   = mnb_alttab_overlay_get_preferred_width;
   actor_class->get_preferred_height  = mnb_alttab_overlay_get_preferred_height;
@@ -382,6 +447,8 @@ mnb_alttab_overlay_init (MnbAlttabOverlay *self)
 {
   self->priv = MNB_ALTTAB_OVERLAY_GET_PRIVATE (self);
 
+  self->priv->apps = g_hash_table_new (NULL, NULL);
+
   mnb_alttab_overlay_setup_metacity_keybindings (self);
 }
 
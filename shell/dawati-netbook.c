@@ -30,6 +30,7 @@
 #include "alttab/mnb-alttab-overlay.h"
 #include "mnb-statusbar.h"
 #include "mnb-toolbar.h"
+#include "effects/mnb-effect-stats.h"
 #include "effects/mnb-switch-zones-effect.h"
 #include "notifications/ntf-overlay.h"
 #include "presence/mnb-presence.h"
@@ -55,6 +56,7 @@
 #include <gdk/gdkx.h>
 
 #include <dawati-panel/mpl-panel-common.h>
+#include <dawati-panel/mpl-trace.h>
 #include <clutter/clutter.h>
 #include <clutter/x11/clutter-x11.h>
 #include <gmodule.h>
@@ -73,6 +75,8 @@
 #define MYZONE_TIMEOUT              200
 #define INIT_TIMEOUT                0
 #define ACTOR_DATA_KEY "MCCP-dawati-netbook-actor-data"
+#define WORKSPACE_WINDOWS_KEY "MCCP-dawati-netbook-workspace-windows"
+#define WM_CLASS_KEY "MCCP-dawati-netbook-wm-class"
 #define THEME_KEY_DIR "/apps/metacity/general"
 #define KEY_THEME THEME_KEY_DIR "/theme"
 #define KEY_BUTTONS THEME_KEY_DIR "/button_layout"
@@ -85,6 +89,7 @@ static const GDebugKey options_keys[] =
   { "disable-ws-clamp",           MNB_OPTION_DISABLE_WS_CLAMP },
   { "disable-panel-restart",      MNB_OPTION_DISABLE_PANEL_RESTART },
   { "composite-fullscreen-apps",  MNB_OPTION_COMPOSITE_FULLSCREEN_APPS },
+  { "effect-stats",               MNB_OPTION_EFFECT_STATS },
 };
 
 static MetaPlugin *plugin_singleton = NULL;
@@ -113,6 +118,8 @@ static void dawati_netbook_handle_screen_size (MetaPlugin *plugin,
 static void last_focus_weak_notify_cb (gpointer data, GObject *meta_win);
 
 static GQuark actor_data_quark = 0;
+static GQuark workspace_windows_quark = 0;
+static GQuark wm_class_quark = 0;
 
 static void     check_for_empty_workspace (MetaPlugin *plugin,
                                            gint workspace, MetaWindow *ignore,
@@ -191,8 +198,12 @@ dawati_netbook_plugin_dispose (GObject *object)
 static void
 dawati_netbook_plugin_finalize (GObject *object)
 {
+  DawatiNetbookPluginPrivate *priv = DAWATI_NETBOOK_PLUGIN (object)->priv;
+
   mnb_input_manager_destroy ();
 
+  g_hash_table_destroy (priv->wm_class_windows);
+
   G_OBJECT_CLASS (dawati_netbook_plugin_parent_class)->finalize (object);
 }
 
@@ -300,6 +311,83 @@ dawati_netbook_fullscreen_apps_present_on_workspace (MetaPlugin *plugin,
   return FALSE;
 }
 
+/*
+ * Each workspace carries the set of windows mutter has placed on it, kept
+ * up to date from the workspace's window-added and window-removed signals,
+ * so that check_for_empty_workspace() only has to look at the windows on
+ * the workspace in question rather than at every window on the screen.
+ */
+static GHashTable *
+dawati_netbook_workspace_get_windows (MetaWorkspace *workspace)
+{
+  return g_object_get_qdata (G_OBJECT (workspace), workspace_windows_quark);
+}
+
+static void
+dawati_netbook_workspace_track_added_cb (MetaWorkspace *workspace,
+                                         MetaWindow    *mw,
+                                         MetaPlugin    *plugin)
+{
+  GHashTable *windows = dawati_netbook_workspace_get_windows (workspace);
+
+  g_hash_table_insert (windows, mw, mw);
+}
+
+static void
+dawati_netbook_workspace_track_removed_cb (MetaWorkspace *workspace,
+                                           MetaWindow    *mw,
+                                           MetaPlugin    *plugin)
+{
+  GHashTable *windows = dawati_netbook_workspace_get_windows (workspace);
+
+  g_hash_table_remove (windows, mw);
+}
+
+/*
+ * Must be called before any other window-removed handler is connected to the
+ * workspace, so that the set is current by the time those handlers run.
+ */
+static void
+dawati_netbook_workspace_track_windows (MetaWorkspace *workspace,
+                                        MetaPlugin    *plugin)
+{
+  GHashTable *windows;
+  GList      *l, *list;
+
+  if (G_UNLIKELY (workspace_windows_quark == 0))
+    workspace_windows_quark =
+      g_quark_from_static_string (WORKSPACE_WINDOWS_KEY);
+
+  if (dawati_netbook_workspace_get_windows (workspace))
+    return;
+
+  windows = g_hash_table_new (NULL, NULL);
+
+  list = meta_workspace_list_windows (workspace);
+
+  for (l = list; l; l = l->next)
+    {
+      MetaWindow *mw = l->data;
+
+      if (meta_window_get_workspace (mw) == workspace)
+        g_hash_table_insert (windows, mw, mw);
+    }
+
+  g_list_free (list);
+
+  g_object_set_qdata_full (G_OBJECT (workspace), workspace_windows_quark,
+                           windows, (GDestroyNotify) g_hash_table_destroy);
+
+  g_signal_connect (workspace,
+                    "window-added",
+                    G_CALLBACK (dawati_netbook_workspace_track_added_cb),
+                    plugin);
+  g_signal_connect (workspace,
+                    "window-removed",
+                    G_CALLBACK (dawati_netbook_workspace_track_removed_cb),
+                    plugin);
+}
+
 static void
 dawati_netbook_workspace_removed_window_cb (MetaWorkspace *workspace,
                                             MetaWindow    *mw,
@@ -320,6 +408,8 @@ dawati_netbook_workspace_added_cb (MetaScreen *screen,
 
   dawati_netbook_set_struts (plugin, -1, -1, -1, -1);
 
+  dawati_netbook_workspace_track_windows (workspace, plugin);
+
   g_signal_connect (workspace,
                     "window-removed",
                     G_CALLBACK (dawati_netbook_workspace_removed_window_cb),
@@ -435,6 +525,77 @@ dawati_netbook_panel_window_show_cb (MetaWindowActor *mcw, MetaPlugin *plugin)
                                         plugin);
 }
 
+/*
+ * Index of all windows by their WM_CLASS, for
+ * check_for_windows_of_wm_class_and_name(); maps the class to a set of
+ * MetaWindows. The class each window is filed under is stored on the window.
+ */
+static void
+dawati_netbook_wm_class_index_remove (MetaPlugin *plugin, MetaWindow *mw)
+{
+  DawatiNetbookPluginPrivate *priv = DAWATI_NETBOOK_PLUGIN (plugin)->priv;
+  const gchar                *wm_class;
+  GHashTable                 *windows;
+
+  if (!(wm_class = g_object_get_qdata (G_OBJECT (mw), wm_class_quark)))
+    return;
+
+  if ((windows = g_hash_table_lookup (priv->wm_class_windows, wm_class)))
+    {
+      g_hash_table_remove (windows, mw);
+
+      if (!g_hash_table_size (windows))
+        g_hash_table_remove (priv->wm_class_windows, wm_class);
+    }
+
+  g_object_set_qdata (G_OBJECT (mw), wm_class_quark, NULL);
+}
+
+static void
+dawati_netbook_wm_class_index_add (MetaPlugin *plugin, MetaWindow *mw)
+{
+  DawatiNetbookPluginPrivate *priv = DAWATI_NETBOOK_PLUGIN (plugin)->priv;
+  const gchar                *wm_class;
+  GHashTable                 *windows;
+
+  if (!(wm_class = meta_window_get_wm_class (mw)))
+    return;
+
+  if (!(windows = g_hash_table_lookup (priv->wm_class_windows, wm_class)))
+    {
+      windows = g_hash_table_new (NULL, NULL);
+      g_hash_table_insert (priv->wm_class_windows, g_strdup (wm_class),
+                           windows);
+    }
+
+  g_hash_table_insert (windows, mw, mw);
+
+  g_object_set_qdata_full (G_OBJECT (mw), wm_class_quark,
+                           g_strdup (wm_class), g_free);
+}
+
+static void
+dawati_netbook_window_wm_class_notify_cb (MetaWindow *mw,
+                                          GParamSpec *pspec,
+                                          MetaPlugin *plugin)
+{
+  dawati_netbook_wm_class_index_remove (plugin, mw);
+  dawati_netbook_wm_class_index_add (plugin, mw);
+}
+
+static void
+dawati_netbook_window_unmanaged_cb (MetaWindow *mw, MetaPlugin *plugin)
+{
+  dawati_netbook_wm_class_index_remove (plugin, mw);
+
+  g_signal_handlers_disconnect_by_func (mw,
+                                        dawati_netbook_window_wm_class_notify_cb,
+                                        plugin);
+  g_signal_handlers_disconnect_by_func (mw,
+                                        dawati_netbook_window_unmanaged_cb,
+                                        plugin);
+}
+
 static void
 dawati_netbook_display_window_created_cb (MetaDisplay  *display,
                                          MetaWindow   *win,
@@ -446,6 +607,15 @@ dawati_netbook_display_window_created_cb (MetaDisplay  *display,
   MetaWindowType              type;
   MnbPanel                   *panel;
 
+  dawati_netbook_wm_class_index_add (plugin, win);
+
+  g_signal_connect (win, "notify::wm-class",
+                    G_CALLBACK (dawati_netbook_window_wm_class_notify_cb),
+                    plugin);
+  g_signal_connect (win, "unmanaged",
+                    G_CALLBACK (dawati_netbook_window_unmanaged_cb),
+                    plugin);
+
   mcw =  (MetaWindowActor*) meta_window_get_compositor_private (win);
 
   g_return_if_fail (mcw);
@@ -741,6 +911,8 @@ cleanup_workspaces_at_start (MetaPlugin *plugin)
       MetaWorkspace *workspace = META_WORKSPACE (workspaces->data);
       GList         *window, *windows;
 
+      dawati_netbook_workspace_track_windows (workspace, plugin);
+
       /* Leave at least one workspace safe */
       if ((workspaces->next == NULL) &&
           (got_at_least_one == FALSE))
@@ -802,6 +974,24 @@ cleanup_workspaces_at_start (MetaPlugin *plugin)
   return FALSE;
 }
 
+/*
+ * Paints of the stage are the compositor frames; everything else the
+ * compositor does happens between them.
+ */
+static MplTraceSpan stage_paint_span;
+
+static void
+dawati_netbook_stage_paint_cb (ClutterActor *stage, gpointer data)
+{
+  stage_paint_span = mpl_trace_span_start ("compositor", "paint");
+}
+
+static void
+dawati_netbook_stage_paint_after_cb (ClutterActor *stage, gpointer data)
+{
+  mpl_trace_span_end (&stage_paint_span);
+}
+
 static void
 dawati_netbook_plugin_start (MetaPlugin *plugin)
 {
@@ -820,6 +1010,18 @@ dawati_netbook_plugin_start (MetaPlugin *plugin)
 
   plugin_singleton = plugin;
 
+  mpl_trace_init ("dawati-netbook");
+  mpl_trace_instrument_main_context (NULL);
+
+  g_signal_connect (stage, "paint",
+                    G_CALLBACK (dawati_netbook_stage_paint_cb), NULL);
+  g_signal_connect_after (stage, "paint",
+                          G_CALLBACK (dawati_netbook_stage_paint_after_cb),
+                          NULL);
+
+  mnb_effect_stats_init (stage,
+                         compositor_options & MNB_OPTION_EFFECT_STATS);
+
   gconf_client = priv->gconf_client = gconf_client_get_default ();
   priv->settings = g_settings_new ("org.dawati.shell.toolbar");
 
@@ -997,6 +1199,13 @@ dawati_netbook_plugin_init (DawatiNetbookPlugin *self)
     }
 
   priv->scaled_background = TRUE;
+
+  priv->wm_class_windows =
+    g_hash_table_new_full (g_str_hash, g_str_equal,
+                           g_free, (GDestroyNotify) g_hash_table_destroy);
+
+  if (G_UNLIKELY (wm_class_quark == 0))
+    wm_class_quark = g_quark_from_static_string (WM_CLASS_KEY);
 }
 
 /*
@@ -1020,6 +1229,9 @@ on_minimize_effect_complete (ClutterTimeline *timeline, EffectCompleteData *data
   apriv = get_actor_private (mcw);
   apriv->tml_minimize = NULL;
 
+  mpl_trace_async_end ("effect", "minimize", GPOINTER_TO_SIZE (data->actor));
+  mnb_effect_stats_end (MNB_EFFECT_MINIMIZE);
+
   clutter_actor_hide (data->actor);
 
   clutter_actor_set_scale (data->actor, 1.0, 1.0);
@@ -1042,6 +1254,7 @@ minimize (MetaPlugin * plugin, MetaWindowActor *mcw)
 {
   MetaWindowType type;
   ClutterActor      *actor  = CLUTTER_ACTOR (mcw);
+  MPL_TRACE_SCOPE ("effect", "minimize");
 
   type = meta_window_get_window_type (meta_window_actor_get_meta_window (mcw));
 
@@ -1063,6 +1276,9 @@ minimize (MetaPlugin * plugin, MetaWindowActor *mcw)
                                          "scale-y", 0.0,
                                          NULL);
 
+      mpl_trace_async_begin ("effect", "minimize", GPOINTER_TO_SIZE (actor));
+      mnb_effect_stats_begin (MNB_EFFECT_MINIMIZE);
+
       data->actor = actor;
       data->plugin = plugin;
 
@@ -1091,6 +1307,9 @@ on_maximize_effect_complete (ClutterTimeline *timeline, EffectCompleteData *data
 
   apriv->tml_maximize = NULL;
 
+  mpl_trace_async_end ("effect", "maximize", GPOINTER_TO_SIZE (data->actor));
+  mnb_effect_stats_end (MNB_EFFECT_MAXIMIZE);
+
   clutter_actor_set_scale (data->actor, 1.0, 1.0);
   clutter_actor_move_anchor_point_from_gravity (data->actor,
                                                 CLUTTER_GRAVITY_NORTH_WEST);
@@ -1120,6 +1339,7 @@ maximize (MetaPlugin *plugin, MetaWindowActor *mcw,
   gdouble  scale_y  = 1.0;
   gfloat   anchor_x = 0;
   gfloat   anchor_y = 0;
+  MPL_TRACE_SCOPE ("effect", "maximize");
 
   type = meta_window_get_window_type (meta_window_actor_get_meta_window (mcw));
 
@@ -1157,6 +1377,9 @@ maximize (MetaPlugin *plugin, MetaWindowActor *mcw,
                                          "scale-y", scale_y,
                                          NULL);
 
+      mpl_trace_async_begin ("effect", "maximize", GPOINTER_TO_SIZE (actor));
+      mnb_effect_stats_begin (MNB_EFFECT_MAXIMIZE);
+
       data->actor = actor;
       data->plugin = plugin;
 
@@ -1180,6 +1403,7 @@ unmaximize (MetaPlugin *plugin, MetaWindowActor *mcw,
             gint end_x, gint end_y, gint end_width, gint end_height)
 {
   MetaWindowType  type;
+  MPL_TRACE_SCOPE ("effect", "unmaximize");
 
   type = meta_window_get_window_type (meta_window_actor_get_meta_window (mcw));
 
@@ -1324,6 +1548,9 @@ on_map_effect_complete (ClutterTimeline *timeline, EffectCompleteData *data)
 
   apriv->tml_map = NULL;
 
+  mpl_trace_async_end ("effect", "map", GPOINTER_TO_SIZE (data->actor));
+  mnb_effect_stats_end (MNB_EFFECT_MAP);
+
   clutter_actor_move_anchor_point_from_gravity (data->actor,
                                                 CLUTTER_GRAVITY_NORTH_WEST);
 
@@ -1338,10 +1565,13 @@ check_for_empty_workspace (MetaPlugin *plugin,
                            gint workspace, MetaWindow *ignore,
                            gboolean win_destroyed)
 {
-  MetaScreen *screen = meta_plugin_get_screen (plugin);
-  gboolean    workspace_empty = TRUE;
-  GList      *l;
-  Window      xwin = None;
+  MetaScreen     *screen = meta_plugin_get_screen (plugin);
+  MetaWorkspace  *current_ws;
+  GHashTable     *windows;
+  GHashTableIter  iter;
+  gpointer        key;
+  gboolean        workspace_empty = TRUE;
+  Window          xwin = None;
 
   /*
    * Mutter now treats all OR windows as sticky, and the -1 will trigger
@@ -1354,15 +1584,24 @@ check_for_empty_workspace (MetaPlugin *plugin,
   if (meta_screen_get_n_workspaces (screen) <= 1)
     return;
 
+  current_ws = meta_screen_get_workspace_by_index (screen, workspace);
+
+  /*
+   * Workspaces we are not tracking yet (i.e., before the start up clean up
+   * has run) are never considered empty.
+   */
+  if (!current_ws ||
+      !(windows = dawati_netbook_workspace_get_windows (current_ws)))
+    return;
+
   if (ignore)
     xwin = meta_window_get_xwindow (ignore);
 
-  l = meta_get_window_actors (screen);
+  g_hash_table_iter_init (&iter, windows);
 
-  while (l)
+  while (g_hash_table_iter_next (&iter, &key, NULL))
     {
-      MetaWindowActor *m  = l->data;
-      MetaWindow      *mw = meta_window_actor_get_meta_window (m);
+      MetaWindow      *mw = key;
       Window           xt = meta_window_get_transient_for_as_xid (mw);
 
       /*
@@ -1391,30 +1630,18 @@ check_for_empty_workspace (MetaPlugin *plugin,
            (!win_destroyed && !meta_window_is_ancestor_of_transient (ignore,
                                                                      mw))))
         {
-          /* g_debug ("querying workspace for [%s]", */
-          /*          meta_window_actor_get_description (m)); */
-
-          gint w = meta_window_actor_get_workspace (m);
-
-          if (w == workspace)
-            {
-              workspace_empty = FALSE;
-              break;
-            }
+          workspace_empty = FALSE;
+          break;
         }
-
-      l = l->next;
     }
 
   if (workspace_empty)
     {
-      MetaWorkspace  *current_ws;
       MetaWorkspace  *active_ws;
       guint32         timestamp;
       gint            next_index = -1;
 
       timestamp  = clutter_x11_get_current_event_time ();
-      current_ws = meta_screen_get_workspace_by_index (screen, workspace);
       active_ws  = meta_screen_get_active_workspace (screen);
 
       if (active_ws == current_ws)
@@ -1474,33 +1701,35 @@ check_for_windows_of_wm_class_and_name (MetaPlugin *plugin,
                                         const gchar  *wm_name,
                                         MetaWindowActor *ignore)
 {
-  MetaScreen *screen = meta_plugin_get_screen (plugin);
-  GList      *l;
+  DawatiNetbookPluginPrivate *priv = DAWATI_NETBOOK_PLUGIN (plugin)->priv;
+  MetaWindow                 *ignore_win = NULL;
+  GHashTable                 *windows;
+  GHashTableIter              iter;
+  gpointer                    key;
 
   if (!wm_class)
     return FALSE;
 
-  l = meta_get_window_actors (screen);
+  if (!(windows = g_hash_table_lookup (priv->wm_class_windows, wm_class)))
+    return FALSE;
 
-  while (l)
-    {
-      MetaWindowActor *m = l->data;
+  if (ignore)
+    ignore_win = meta_window_actor_get_meta_window (ignore);
 
-      if (m != ignore)
-        {
-          MetaWindow  *win;
-          const gchar *klass;
-          const gchar *name;
+  g_hash_table_iter_init (&iter, windows);
 
-          win   = meta_window_actor_get_meta_window (m);
-          klass = meta_window_get_wm_class (win);
-          name  = meta_window_get_title (win);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      MetaWindow  *win = key;
+      const gchar *name;
 
-          if (klass && !strcmp (wm_class, klass) && strstr (name, wm_name))
-            return TRUE;
-        }
+      if (win == ignore_win)
+        continue;
 
-      l = l->next;
+      name = meta_window_get_title (win);
+
+      if (name && strstr (name, wm_name))
+        return TRUE;
     }
 
   return FALSE;
@@ -1849,6 +2078,7 @@ map (MetaPlugin *plugin, MetaWindowActor *mcw)
   MetaWindow                 *mw;
   gboolean                    fullscreen = FALSE;
   gboolean                    move_window = FALSE;
+  MPL_TRACE_SCOPE ("effect", "map");
 
   active_panel = (MnbPanelOop*) mnb_toolbar_get_active_panel (toolbar);
   xwin         = meta_window_actor_get_x_window (mcw);
@@ -2050,6 +2280,9 @@ map (MetaPlugin *plugin, MetaWindowActor *mcw)
           data->actor = actor;
           apriv->tml_map = clutter_animation_get_timeline (animation);
 
+          mpl_trace_async_begin ("effect", "map", GPOINTER_TO_SIZE (actor));
+          mnb_effect_stats_begin (MNB_EFFECT_MAP);
+
           g_signal_connect (apriv->tml_map,
                             "completed",
                             G_CALLBACK (on_map_effect_complete),
@@ -2068,6 +2301,7 @@ destroy (MetaPlugin *plugin, MetaWindowActor *mcw)
   DawatiNetbookPluginPrivate *priv = DAWATI_NETBOOK_PLUGIN (plugin)->priv;
   MetaWindowType             type;
   Window                     xwin;
+  MPL_TRACE_SCOPE ("effect", "destroy");
 
   type = meta_window_get_window_type (meta_window_actor_get_meta_window (mcw));
   xwin = meta_window_actor_get_x_window (mcw);
@@ -2095,6 +2329,7 @@ switch_workspace (MetaPlugin         *plugin,
                   MetaMotionDirection   direction)
 {
   DawatiNetbookPluginPrivate *priv = DAWATI_NETBOOK_PLUGIN (plugin)->priv;
+  MPL_TRACE_SCOPE ("effect", "switch-workspace");
 
   if (!priv->workspaces_ready)
     {
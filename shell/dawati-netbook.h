@@ -53,6 +53,7 @@ typedef enum
   MNB_OPTION_DISABLE_WS_CLAMP          = 1 << 1,
   MNB_OPTION_DISABLE_PANEL_RESTART     = 1 << 2,
   MNB_OPTION_COMPOSITE_FULLSCREEN_APPS = 1 << 3,
+  MNB_OPTION_EFFECT_STATS              = 1 << 4,
 } MnbOptionFlag;
 
 #define DAWATI_TYPE_NETBOOK_PLUGIN            (dawati_netbook_plugin_get_type ())
@@ -125,6 +126,9 @@ struct _DawatiNetbookPluginPrivate
 
   /*  */
   gboolean               workspaces_ready : 1;
+
+  /* WM_CLASS -> set of MetaWindows of that class */
+  GHashTable            *wm_class_windows;
 };
 
 GType dawati_netbook_plugin_get_type (void);
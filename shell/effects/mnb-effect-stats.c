@@ -0,0 +1,278 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/*
+ * Copyright (c) 2012 Intel Corp.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/*
+ * Frame timing of the window effects: while an effect runs, the interval
+ * between consecutive paints of the stage is added to its histogram, and
+ * any interval longer than the frame period counts the frames it missed.
+ * The first interval of a run is measured from the start of the effect, so
+ * a slow first frame shows up too.
+ */
+
+#include <string.h>
+#include <dbus/dbus-glib.h>
+
+#include "mnb-effect-stats.h"
+
+#define BUCKET_WIDTH 2000 /* microseconds */
+#define N_BUCKETS    100  /* the last bucket takes everything above */
+
+typedef struct
+{
+  guint  n_running;
+  guint  runs;
+  guint  frames;
+  guint  dropped;
+  gint64 max_interval;
+  guint  histogram[N_BUCKETS];
+
+  /* The current run, for the log */
+  gint64 run_start;
+  guint  run_frames;
+  guint  run_dropped;
+  gint64 run_max_interval;
+} MnbEffectStats;
+
+static const gchar *effect_names[MNB_N_EFFECTS] =
+{
+  "map",
+  "minimize",
+  "maximize",
+  "switch-workspace",
+};
+
+static MnbEffectStats stats[MNB_N_EFFECTS];
+static guint          n_running = 0;
+static gint64         last_frame = 0;
+static gboolean       stats_verbose = FALSE;
+
+static void
+mnb_effect_stats_paint_cb (ClutterActor *stage, gpointer data)
+{
+  gint64 now, interval, period;
+  guint  dropped = 0;
+  guint  bucket;
+  gint   i;
+
+  if (!n_running)
+    return;
+
+  now = g_get_monotonic_time ();
+  interval = now - last_frame;
+  last_frame = now;
+
+  period = G_USEC_PER_SEC / MAX (clutter_get_default_frame_rate (), 1);
+
+  /* Allow half a period of jitter before calling a frame dropped */
+  if (interval > period + period / 2)
+    dropped = (interval + period / 2) / period - 1;
+
+  bucket = MIN (interval / BUCKET_WIDTH, N_BUCKETS - 1);
+
+  for (i = 0; i < MNB_N_EFFECTS; i++)
+    {
+      MnbEffectStats *s = &stats[i];
+
+      if (!s->n_running)
+        continue;
+
+      s->frames++;
+      s->dropped += dropped;
+      s->histogram[bucket]++;
+      s->max_interval = MAX (s->max_interval, interval);
+
+      s->run_frames++;
+      s->run_dropped += dropped;
+      s->run_max_interval = MAX (s->run_max_interval, interval);
+    }
+}
+
+/*
+ * Verbose logs a summary of each run of an effect (the compositor option
+ * effect-stats).
+ */
+void
+mnb_effect_stats_init (ClutterActor *stage, gboolean verbose)
+{
+  stats_verbose = verbose;
+
+  g_signal_connect (stage, "paint",
+                    G_CALLBACK (mnb_effect_stats_paint_cb), NULL);
+}
+
+void
+mnb_effect_stats_begin (MnbEffect effect)
+{
+  MnbEffectStats *s;
+  gint64          now = g_get_monotonic_time ();
+
+  g_return_if_fail (effect < MNB_N_EFFECTS);
+
+  s = &stats[effect];
+
+  if (!n_running++)
+    last_frame = now;
+
+  s->runs++;
+
+  if (!s->n_running++)
+    {
+      s->run_start = now;
+      s->run_frames = 0;
+      s->run_dropped = 0;
+      s->run_max_interval = 0;
+    }
+}
+
+void
+mnb_effect_stats_end (MnbEffect effect)
+{
+  MnbEffectStats *s;
+
+  g_return_if_fail (effect < MNB_N_EFFECTS);
+
+  s = &stats[effect];
+
+  if (!s->n_running)
+    {
+      g_warning (G_STRLOC ": effect %s ended without starting",
+                 effect_names[effect]);
+      return;
+    }
+
+  n_running--;
+
+  if (--s->n_running)
+    return;
+
+  if (stats_verbose)
+    g_message ("Effect %s: %u frames in %" G_GINT64_FORMAT " ms, "
+               "%u dropped, longest frame %" G_GINT64_FORMAT " ms",
+               effect_names[effect], s->run_frames,
+               (g_get_monotonic_time () - s->run_start) / 1000,
+               s->run_dropped, s->run_max_interval / 1000);
+}
+
+gboolean
+mnb_effect_stats_lookup (const gchar *name, MnbEffect *effect)
+{
+  gint i;
+
+  for (i = 0; i < MNB_N_EFFECTS; i++)
+    if (!strcmp (name, effect_names[i]))
+      {
+        *effect = i;
+        return TRUE;
+      }
+
+  return FALSE;
+}
+
+/*
+ * Upper bound of the bucket holding the given percentile; the last bucket
+ * has no upper bound, so we use the longest interval seen instead.
+ */
+static guint
+mnb_effect_stats_percentile (MnbEffectStats *s, guint percent)
+{
+  guint64 target;
+  guint64 count = 0;
+  gint    i;
+
+  if (!s->frames)
+    return 0;
+
+  target = ((guint64) s->frames * percent + 99) / 100;
+
+  for (i = 0; i < N_BUCKETS - 1; i++)
+    {
+      count += s->histogram[i];
+
+      if (count >= target)
+        return (i + 1) * BUCKET_WIDTH;
+    }
+
+  return s->max_interval;
+}
+
+static void
+mnb_effect_stats_value_free (gpointer data)
+{
+  GValue *value = data;
+
+  g_value_unset (value);
+  g_slice_free (GValue, value);
+}
+
+static void
+mnb_effect_stats_insert_uint (GHashTable *hash, const gchar *key, guint v)
+{
+  GValue *value = g_slice_new0 (GValue);
+
+  g_value_init (value, G_TYPE_UINT);
+  g_value_set_uint (value, v);
+
+  g_hash_table_insert (hash, (gpointer) key, value);
+}
+
+/*
+ * Returns the stats of the effect, as a string to GValue map suitable for
+ * an a{sv} DBus reply; times are in microseconds, and the histogram counts
+ * frame intervals in BUCKET_WIDTH steps.
+ */
+GHashTable *
+mnb_effect_stats_get (MnbEffect effect)
+{
+  MnbEffectStats *s;
+  GHashTable     *hash;
+  GArray         *histogram;
+  GValue         *value;
+
+  g_return_val_if_fail (effect < MNB_N_EFFECTS, NULL);
+
+  s = &stats[effect];
+
+  hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                NULL, mnb_effect_stats_value_free);
+
+  mnb_effect_stats_insert_uint (hash, "runs", s->runs);
+  mnb_effect_stats_insert_uint (hash, "frames", s->frames);
+  mnb_effect_stats_insert_uint (hash, "dropped-frames", s->dropped);
+  mnb_effect_stats_insert_uint (hash, "p50",
+                                mnb_effect_stats_percentile (s, 50));
+  mnb_effect_stats_insert_uint (hash, "p90",
+                                mnb_effect_stats_percentile (s, 90));
+  mnb_effect_stats_insert_uint (hash, "p99",
+                                mnb_effect_stats_percentile (s, 99));
+  mnb_effect_stats_insert_uint (hash, "max", s->max_interval);
+  mnb_effect_stats_insert_uint (hash, "bucket-width", BUCKET_WIDTH);
+
+  histogram = g_array_sized_new (FALSE, FALSE, sizeof (guint), N_BUCKETS);
+  g_array_append_vals (histogram, s->histogram, N_BUCKETS);
+
+  value = g_slice_new0 (GValue);
+  g_value_init (value, dbus_g_type_get_collection ("GArray", G_TYPE_UINT));
+  g_value_take_boxed (value, histogram);
+
+  g_hash_table_insert (hash, "histogram", value);
+
+  return hash;
+}
@@ -0,0 +1,47 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/*
+ * Copyright (c) 2012 Intel Corp.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef MNB_EFFECT_STATS_H
+#define MNB_EFFECT_STATS_H
+
+#include <clutter/clutter.h>
+
+typedef enum
+{
+  MNB_EFFECT_MAP,
+  MNB_EFFECT_MINIMIZE,
+  MNB_EFFECT_MAXIMIZE,
+  MNB_EFFECT_SWITCH_WORKSPACE,
+
+  MNB_N_EFFECTS
+} MnbEffect;
+
+void        mnb_effect_stats_init    (ClutterActor *stage,
+                                      gboolean      verbose);
+
+void        mnb_effect_stats_begin   (MnbEffect     effect);
+void        mnb_effect_stats_end     (MnbEffect     effect);
+
+gboolean    mnb_effect_stats_lookup  (const gchar  *name,
+                                      MnbEffect    *effect);
+GHashTable *mnb_effect_stats_get     (MnbEffect     effect);
+
+#endif
@@ -25,6 +25,9 @@
 #include "mnb-switch-zones-effect.h"
 #include "mnb-fancy-bin.h"
 #include "mnb-zones-preview.h"
+#include "mnb-effect-stats.h"
+
+#include <dawati-panel/mpl-trace.h>
 
 static ClutterActor *zones_preview = NULL;
 static gint          running = 0;
@@ -32,8 +35,14 @@ static gint          running = 0;
 static void
 mnb_switch_zones_completed_cb (MnbZonesPreview *preview, MetaPlugin *plugin)
 {
-  clutter_actor_destroy (zones_preview);
-  zones_preview = NULL;
+  /*
+   * Keep the preview, with its workspace bins and window clones, around for
+   * the next switch.
+   */
+  clutter_actor_hide (zones_preview);
+
+  mpl_trace_async_end ("effect", "switch-zones", 0);
+  mnb_effect_stats_end (MNB_EFFECT_SWITCH_WORKSPACE);
 
   if (--running < 0)
     {
@@ -53,8 +62,8 @@ mnb_switch_zones_effect (MetaPlugin         *plugin,
                          gint                to,
                          MetaMotionDirection direction)
 {
-  GList *w;
   gint width, height;
+  gboolean active;
   MetaScreen *screen;
   ClutterActor *window_group;
 
@@ -73,7 +82,9 @@ mnb_switch_zones_effect (MetaPlugin         *plugin,
       meta_plugin_switch_workspace_completed (plugin);
     }
 
-  if ((from == to) && !zones_preview)
+  active = zones_preview && CLUTTER_ACTOR_IS_VISIBLE (zones_preview);
+
+  if ((from == to) && !active)
     {
       if (--running < 0)
         {
@@ -94,9 +105,6 @@ mnb_switch_zones_effect (MetaPlugin         *plugin,
 
       /* Construct the zones preview actor */
       zones_preview = mnb_zones_preview_new ();
-      g_object_set (G_OBJECT (zones_preview),
-                    "workspace", (gdouble)from,
-                    NULL);
 
       /* Add it to the stage */
       stage = meta_get_stage_for_screen (screen);
@@ -107,37 +115,28 @@ mnb_switch_zones_effect (MetaPlugin         *plugin,
                         G_CALLBACK (mnb_switch_zones_completed_cb), plugin);
     }
 
+  if (!active)
+    {
+      g_object_set (G_OBJECT (zones_preview),
+                    "workspace", (gdouble)from,
+                    "zoom", 1.0,
+                    NULL);
+      clutter_actor_show (zones_preview);
+
+      /* One run of the preview covers any switches made while it is up */
+      mpl_trace_async_begin ("effect", "switch-zones", 0);
+      mnb_effect_stats_begin (MNB_EFFECT_SWITCH_WORKSPACE);
+    }
+
   meta_screen_get_size (screen, &width, &height);
   g_object_set (G_OBJECT (zones_preview),
                 "workspace-width", (guint)width,
                 "workspace-height", (guint)height,
                 NULL);
 
-  mnb_zones_preview_clear (MNB_ZONES_PREVIEW (zones_preview));
   mnb_zones_preview_set_n_workspaces (MNB_ZONES_PREVIEW (zones_preview),
                                       meta_screen_get_n_workspaces (screen));
-
-  /* Add windows to zone preview actor */
-  for (w = meta_get_window_actors (screen); w; w = w->next)
-    {
-      MetaWindowActor *window_actor = w->data;
-      gint workspace = meta_window_actor_get_workspace (window_actor);
-      MetaWindow *window = meta_window_actor_get_meta_window (window_actor);
-      MetaWindowType type = meta_window_get_window_type (window);
-
-      /*
-       * Only show regular windows that are not sticky (getting stacking order
-       * right for sticky windows would be really hard, and since they appear
-       * on each workspace, they do not help in identifying which workspace
-       * it is).
-       */
-      if ((workspace < 0) ||
-          meta_window_actor_is_override_redirect (window_actor) ||
-          (type != META_WINDOW_NORMAL))
-        continue;
-
-      mnb_zones_preview_add_window (MNB_ZONES_PREVIEW (zones_preview), window_actor);
-    }
+  mnb_zones_preview_sync_windows (MNB_ZONES_PREVIEW (zones_preview));
 
   /* Make sure it's on top */
   window_group = meta_get_window_group_for_screen (screen);
@@ -62,9 +62,28 @@ typedef enum
   MNB_ZP_ZOOM_IN
 } MnbZonesPreviewPhase;
 
+/*
+ * Window clones are kept across workspace switches, keyed by their
+ * MetaWindowActor, and only updated when the windows change.
+ */
+typedef struct
+{
+  MnbZonesPreview *preview;
+  MetaWindowActor *window;
+  ClutterActor    *clone;
+  gint             workspace;
+  guint            serial;
+} MnbZonesPreviewClone;
+
 struct _MnbZonesPreviewPrivate
 {
+  MetaScreen           *screen;
   GList                *workspace_bins;
+  GHashTable           *clones;
+  guint                 sync_serial;
+  gboolean              windows_dirty;
+  gint                  first_visible;
+  gint                  last_visible;
   ClutterActor         *workspace_bg;
   guint                 spacing;
   gdouble               zoom;
@@ -75,6 +94,8 @@ struct _MnbZonesPreviewPrivate
   MnbZonesPreviewPhase  anim_phase;
 };
 
+static void mnb_zones_preview_update_bin_size (MnbZonesPreview *preview);
+
 static void
 mnb_zones_preview_get_property (GObject    *object,
                                 guint       property_id,
@@ -125,11 +146,17 @@ mnb_zones_preview_set_property (GObject      *object,
       break;
 
     case PROP_WORKSPACE_WIDTH:
+      if (priv->width == g_value_get_uint (value))
+        return;
       priv->width = g_value_get_uint (value);
+      mnb_zones_preview_update_bin_size (MNB_ZONES_PREVIEW (object));
       break;
 
     case PROP_WORKSPACE_HEIGHT:
+      if (priv->height == g_value_get_uint (value))
+        return;
       priv->height = g_value_get_uint (value);
+      mnb_zones_preview_update_bin_size (MNB_ZONES_PREVIEW (object));
       break;
 
     default:
@@ -160,22 +187,51 @@ mnb_zones_preview_dispose (GObject *object)
 static void
 mnb_zones_preview_finalize (GObject *object)
 {
+  MnbZonesPreviewPrivate *priv = MNB_ZONES_PREVIEW (object)->priv;
+
+  g_hash_table_destroy (priv->clones);
+
   G_OBJECT_CLASS (mnb_zones_preview_parent_class)->finalize (object);
 }
 
+/*
+ * Paints the bins that were found to overlap the preview in the last
+ * allocation; the others are neither allocated nor painted.
+ */
 static void
-mnb_zones_preview_paint (ClutterActor *actor)
+mnb_zones_preview_paint_bins (MnbZonesPreview *preview)
 {
+  gint n;
   GList *w;
+  MnbZonesPreviewPrivate *priv = preview->priv;
+
+  if (priv->first_visible < 0)
+    return;
+
+  for (n = priv->first_visible,
+       w = g_list_nth (priv->workspace_bins, priv->first_visible);
+       w && n <= priv->last_visible; w = w->next, n++)
+    clutter_actor_paint (CLUTTER_ACTOR (w->data));
+}
+
+static void
+mnb_zones_preview_paint (ClutterActor *actor)
+{
   MnbZonesPreviewPrivate *priv = MNB_ZONES_PREVIEW (actor)->priv;
 
   /* Chain up for background */
   CLUTTER_ACTOR_CLASS (mnb_zones_preview_parent_class)->paint (actor);
 
   clutter_actor_paint (priv->workspace_bg);
-  /* Paint bins */
-  for (w = priv->workspace_bins; w; w = w->next)
-    clutter_actor_paint (CLUTTER_ACTOR (w->data));
+  mnb_zones_preview_paint_bins (MNB_ZONES_PREVIEW (actor));
+}
+
+static void
+mnb_zones_preview_pick (ClutterActor *actor, const ClutterColor *color)
+{
+  CLUTTER_ACTOR_CLASS (mnb_zones_preview_parent_class)->pick (actor, color);
+
+  mnb_zones_preview_paint_bins (MNB_ZONES_PREVIEW (actor));
 }
 
 static void
@@ -251,6 +307,9 @@ mnb_zones_preview_allocate (ClutterActor           *actor,
   /* Make sure we zoom out from the centre */
   origin += (bin_width - (bin_width * priv->zoom)) / 2.0;
 
+  priv->first_visible = -1;
+  priv->last_visible = -1;
+
   for (n = 0, w = priv->workspace_bins; w; w = w->next, n++)
     {
       ClutterActorBox child_box;
@@ -275,7 +334,15 @@ mnb_zones_preview_allocate (ClutterActor           *actor,
                      padding.top;
       child_box.y2 = child_box.y1 + height;
 
-      clutter_actor_allocate (bin, &child_box, flags);
+      /* Only bins that overlap the preview get allocated (and painted) */
+      if ((child_box.x2 > 0) && (child_box.x1 < (box->x2 - box->x1)))
+        {
+          clutter_actor_allocate (bin, &child_box, flags);
+
+          if (priv->first_visible < 0)
+            priv->first_visible = n;
+          priv->last_visible = n;
+        }
 
       origin = (child_box.x2 - padding.right) + (priv->spacing * priv->zoom);
     }
@@ -295,6 +362,7 @@ mnb_zones_preview_class_init (MnbZonesPreviewClass *klass)
   object_class->finalize = mnb_zones_preview_finalize;
 
   actor_class->paint = mnb_zones_preview_paint;
+  actor_class->pick = mnb_zones_preview_pick;
   actor_class->map = mnb_zones_preview_map;
   actor_class->unmap = mnb_zones_preview_unmap;
   actor_class->get_preferred_width = mnb_zones_preview_get_preferred_width;
@@ -387,21 +455,121 @@ mnb_zones_preview_style_changed_cb (MxStylable          *stylable,
                      NULL);
 }
 
+static void
+mnb_zones_preview_window_added_cb (MetaWorkspace   *workspace,
+                                   MetaWindow      *window,
+                                   MnbZonesPreview *preview)
+{
+  MetaWindowActor *actor =
+    (MetaWindowActor *) meta_window_get_compositor_private (window);
+
+  /*
+   * For new windows the actor does not exist yet; pick them up on the next
+   * sync.
+   */
+  if (actor)
+    mnb_zones_preview_add_window (preview, actor);
+  else
+    preview->priv->windows_dirty = TRUE;
+}
+
+static void
+mnb_zones_preview_window_removed_cb (MetaWorkspace   *workspace,
+                                     MetaWindow      *window,
+                                     MnbZonesPreview *preview)
+{
+  MnbZonesPreviewClone *zc;
+  MetaWindowActor *actor =
+    (MetaWindowActor *) meta_window_get_compositor_private (window);
+
+  if (!actor)
+    return;
+
+  zc = g_hash_table_lookup (preview->priv->clones, actor);
+
+  if (zc && (zc->workspace == meta_workspace_index (workspace)))
+    clutter_actor_destroy (zc->clone);
+}
+
+static void
+mnb_zones_preview_watch_workspace (MnbZonesPreview *preview,
+                                   MetaWorkspace   *workspace)
+{
+  g_signal_connect_object (workspace, "window-added",
+                           G_CALLBACK (mnb_zones_preview_window_added_cb),
+                           preview, 0);
+  g_signal_connect_object (workspace, "window-removed",
+                           G_CALLBACK (mnb_zones_preview_window_removed_cb),
+                           preview, 0);
+}
+
+static void
+mnb_zones_preview_workspace_added_cb (MetaScreen      *screen,
+                                      gint             index,
+                                      MnbZonesPreview *preview)
+{
+  MetaWorkspace *workspace = meta_screen_get_workspace_by_index (screen, index);
+
+  if (workspace)
+    mnb_zones_preview_watch_workspace (preview, workspace);
+
+  preview->priv->windows_dirty = TRUE;
+}
+
+/*
+ * Removing a workspace shifts the indices of the ones after it, and restacking
+ * changes the order of the clones; both are dealt with by a full sync.
+ */
+static void
+mnb_zones_preview_workspace_removed_cb (MetaScreen      *screen,
+                                        gint             index,
+                                        MnbZonesPreview *preview)
+{
+  preview->priv->windows_dirty = TRUE;
+}
+
+static void
+mnb_zones_preview_restacked_cb (MetaScreen      *screen,
+                                MnbZonesPreview *preview)
+{
+  preview->priv->windows_dirty = TRUE;
+}
+
 static void
 mnb_zones_preview_init (MnbZonesPreview *self)
 {
   MnbZonesPreviewPrivate *priv = self->priv = ZONES_PREVIEW_PRIVATE (self);
   MetaPlugin *plugin = dawati_netbook_get_plugin_singleton ();
   MetaScreen *screen = meta_plugin_get_screen (plugin);
+  GList *l;
 
+  priv->screen = screen;
   priv->zoom = 1.0;
   priv->spacing = 0;
   priv->dest_workspace = -1;
+  priv->first_visible = -1;
+  priv->last_visible = -1;
+  priv->windows_dirty = TRUE;
+  priv->clones = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                        NULL, NULL);
   priv->workspace_bg = meta_background_actor_new_for_screen (screen);
   clutter_actor_add_child (CLUTTER_ACTOR (self), priv->workspace_bg);
 
   g_signal_connect (self, "style-changed",
                     G_CALLBACK (mnb_zones_preview_style_changed_cb), self);
+
+  for (l = meta_screen_get_workspaces (screen); l; l = l->next)
+    mnb_zones_preview_watch_workspace (self, l->data);
+
+  g_signal_connect_object (screen, "workspace-added",
+                           G_CALLBACK (mnb_zones_preview_workspace_added_cb),
+                           self, 0);
+  g_signal_connect_object (screen, "workspace-removed",
+                           G_CALLBACK (mnb_zones_preview_workspace_removed_cb),
+                           self, 0);
+  g_signal_connect_object (screen, "restacked",
+                           G_CALLBACK (mnb_zones_preview_restacked_cb),
+                           self, 0);
 }
 
 ClutterActor *
@@ -594,6 +762,21 @@ mnb_zones_preview_get_workspace_group (MnbZonesPreview *preview,
   return mnb_fancy_bin_get_child (MNB_FANCY_BIN (bin));
 }
 
+static void
+mnb_zones_preview_update_bin_size (MnbZonesPreview *preview)
+{
+  GList *w;
+  MnbZonesPreviewPrivate *priv = preview->priv;
+
+  for (w = priv->workspace_bins; w; w = w->next)
+    {
+      ClutterActor *group = mnb_fancy_bin_get_child (MNB_FANCY_BIN (w->data));
+
+      clutter_actor_set_size (group, priv->width, priv->height);
+      clutter_actor_set_clip (group, 0, 0, priv->width, priv->height);
+    }
+}
+
 void
 mnb_zones_preview_set_n_workspaces (MnbZonesPreview *preview,
                                     gint             workspace)
@@ -618,69 +801,179 @@ mnb_zones_preview_set_n_workspaces (MnbZonesPreview *preview,
     }
 }
 
-static void mnb_zones_preview_clone_destroy_cb (ClutterActor *, ClutterActor *);
+static void mnb_zones_preview_clone_destroy_cb (ClutterActor         *,
+                                                MnbZonesPreviewClone *);
 
 /*
  * If the window is destroyed, we have to destroy the clone.
  */
 static void
-mnb_zones_preview_mcw_destroy_cb (ClutterActor *mcw, ClutterActor *clone)
+mnb_zones_preview_mcw_destroy_cb (ClutterActor         *mcw,
+                                  MnbZonesPreviewClone *zc)
 {
-  /*
-   * First disconnect the clone_destroy handler to avoid circularity.
-   */
-  g_signal_handlers_disconnect_by_func (clone,
-                                        mnb_zones_preview_clone_destroy_cb,
-                                        mcw);
-
-  clutter_actor_destroy (clone);
+  clutter_actor_destroy (zc->clone);
 }
 
 /*
- * When the clone goes away, disconnect the mcw destroy handler.
+ * When the clone goes away, disconnect the mcw destroy handler and forget
+ * about the clone.
  */
 static void
-mnb_zones_preview_clone_destroy_cb (ClutterActor *clone, ClutterActor *mcw)
+mnb_zones_preview_clone_destroy_cb (ClutterActor         *clone,
+                                    MnbZonesPreviewClone *zc)
 {
-  g_signal_handlers_disconnect_by_func (mcw,
+  g_signal_handlers_disconnect_by_func (zc->window,
                                         mnb_zones_preview_mcw_destroy_cb,
-                                        clone);
+                                        zc);
+
+  g_hash_table_remove (zc->preview->priv->clones, zc->window);
+  g_slice_free (MnbZonesPreviewClone, zc);
 }
 
-void
-mnb_zones_preview_add_window (MnbZonesPreview *preview,
-                              MetaWindowActor *window)
+/*
+ * Only show regular windows that are not sticky (getting stacking order
+ * right for sticky windows would be really hard, and since they appear
+ * on each workspace, they do not help in identifying which workspace
+ * it is).
+ */
+static gboolean
+mnb_zones_preview_window_is_eligible (MetaWindowActor *window)
+{
+  MetaWindow *mw = meta_window_actor_get_meta_window (window);
+
+  return ((meta_window_actor_get_workspace (window) >= 0) &&
+          !meta_window_actor_is_override_redirect (window) &&
+          (meta_window_get_window_type (mw) == META_WINDOW_NORMAL));
+}
+
+static void
+mnb_zones_preview_update_clone_position (MnbZonesPreviewClone *zc)
 {
-  ClutterActor *clone;
-  ClutterActor *group;
   MetaRectangle rect;
+
+  meta_window_get_input_rect (meta_window_actor_get_meta_window (zc->window),
+                              &rect);
+  clutter_actor_set_position (zc->clone, rect.x, rect.y);
+}
+
+/*
+ * Makes sure the window has a clone in the bin of its current workspace,
+ * reusing the existing clone if there is one; returns NULL if the window
+ * should not be shown.
+ */
+static MnbZonesPreviewClone *
+mnb_zones_preview_ensure_clone (MnbZonesPreview *preview,
+                                MetaWindowActor *window)
+{
+  MnbZonesPreviewClone *zc;
+  ClutterActor *group;
   gint workspace;
+  MnbZonesPreviewPrivate *priv = preview->priv;
+
+  zc = g_hash_table_lookup (priv->clones, window);
+
+  if (!mnb_zones_preview_window_is_eligible (window))
+    {
+      if (zc)
+        clutter_actor_destroy (zc->clone);
+
+      return NULL;
+    }
 
-  /* TODO: Determine if we need to add a weak reference on the window
-   *       in case it gets destroyed during the animation.
-   *       I'd have thought that the clone's reference on the texture
-   *       would be enough that this wouldn't be necessary.
-   *
-   * We do; while the clone's reference is enough to keep the texture about,
-   * it is not enough to make it possible to map the clone once the texture
-   * has been unparented.
-   */
   workspace = meta_window_actor_get_workspace (window);
   group = mnb_zones_preview_get_workspace_group (preview, workspace);
 
-  clone = clutter_clone_new (meta_window_actor_get_texture (window));
+  if (!zc)
+    {
+      /*
+       * While the clone's reference is enough to keep the texture about, it
+       * is not enough to make it possible to map the clone once the texture
+       * has been unparented, so we tie the clone to the window.
+       */
+      zc = g_slice_new0 (MnbZonesPreviewClone);
+      zc->preview = preview;
+      zc->window = window;
+      zc->clone = clutter_clone_new (meta_window_actor_get_texture (window));
+
+      g_signal_connect (window, "destroy",
+                        G_CALLBACK (mnb_zones_preview_mcw_destroy_cb),
+                        zc);
+      g_signal_connect (zc->clone, "destroy",
+                        G_CALLBACK (mnb_zones_preview_clone_destroy_cb),
+                        zc);
+
+      g_hash_table_insert (priv->clones, window, zc);
+      clutter_actor_add_child (group, zc->clone);
+    }
+  else if (clutter_actor_get_parent (zc->clone) != group)
+    {
+      g_object_ref (zc->clone);
+      clutter_actor_remove_child (clutter_actor_get_parent (zc->clone),
+                                  zc->clone);
+      clutter_actor_add_child (group, zc->clone);
+      g_object_unref (zc->clone);
+    }
 
-  g_signal_connect (window, "destroy",
-                    G_CALLBACK (mnb_zones_preview_mcw_destroy_cb),
-                    clone);
-  g_signal_connect (clone, "destroy",
-                    G_CALLBACK (mnb_zones_preview_clone_destroy_cb),
-                    window);
+  zc->workspace = workspace;
+  mnb_zones_preview_update_clone_position (zc);
 
-  meta_window_get_input_rect (meta_window_actor_get_meta_window (window), &rect);
-  clutter_actor_set_position (clone, rect.x, rect.y);
+  return zc;
+}
 
-  clutter_actor_add_child (group, clone);
+void
+mnb_zones_preview_add_window (MnbZonesPreview *preview,
+                              MetaWindowActor *window)
+{
+  mnb_zones_preview_ensure_clone (preview, window);
+}
+
+/*
+ * Brings the clones up to date with the windows on the screen. Unless
+ * windows or workspaces were added, removed or restacked since the last
+ * sync, only the clone positions are refreshed.
+ */
+void
+mnb_zones_preview_sync_windows (MnbZonesPreview *preview)
+{
+  GList *l, *stale = NULL;
+  GHashTableIter iter;
+  MnbZonesPreviewClone *zc;
+  MnbZonesPreviewPrivate *priv = preview->priv;
+
+  if (!priv->windows_dirty)
+    {
+      g_hash_table_iter_init (&iter, priv->clones);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &zc))
+        mnb_zones_preview_update_clone_position (zc);
+
+      return;
+    }
+
+  priv->windows_dirty = FALSE;
+  priv->sync_serial++;
+
+  /* The window actors are in stacking order, bottom first */
+  for (l = meta_get_window_actors (priv->screen); l; l = l->next)
+    {
+      zc = mnb_zones_preview_ensure_clone (preview, l->data);
+
+      if (!zc)
+        continue;
+
+      zc->serial = priv->sync_serial;
+      clutter_actor_set_child_above_sibling (clutter_actor_get_parent (zc->clone),
+                                             zc->clone, NULL);
+    }
+
+  g_hash_table_iter_init (&iter, priv->clones);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &zc))
+    if (zc->serial != priv->sync_serial)
+      stale = g_list_prepend (stale, zc->clone);
+
+  for (l = stale; l; l = l->next)
+    clutter_actor_destroy (CLUTTER_ACTOR (l->data));
+
+  g_list_free (stale);
 }
 
 void
@@ -696,6 +989,8 @@ mnb_zones_preview_clear (MnbZonesPreview *preview)
                                                  priv->workspace_bins);
     }
 
+  priv->windows_dirty = TRUE;
+
   clutter_actor_queue_relayout (CLUTTER_ACTOR (preview));
 }
 
@@ -75,6 +75,8 @@ ClutterActor *mnb_zones_preview_new (void);
 void mnb_zones_preview_add_window (MnbZonesPreview *preview,
                                    MetaWindowActor *window);
 
+void mnb_zones_preview_sync_windows (MnbZonesPreview *preview);
+
 void mnb_zones_preview_change_workspace (MnbZonesPreview *preview,
                                          gint             workspace);
 
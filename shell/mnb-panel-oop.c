@@ -35,8 +35,10 @@
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
 #include <dawati-panel/mpl-panel-common.h>
+#include <dawati-panel/mpl-trace.h>
 #include <meta/display.h>
 #include <meta/errors.h>
+#include <meta/meta-shaped-texture.h>
 #include <clutter/x11/clutter-x11.h>
 
 /*
@@ -49,6 +51,18 @@
 /* FIME -- duplicated from MnbDropDown.c */
 #define SLIDE_DURATION 150
 
+/*
+ * The snapshot of the panel contents is kept at 1/SNAPSHOT_SCALE of the window
+ * size; once the slide-in has finished, we wait at most CROSSFADE_TIMEOUT ms
+ * for the client to finish its show-begin work before fading to the window.
+ */
+#define SNAPSHOT_SCALE     2
+#define CROSSFADE_DURATION 100
+#define CROSSFADE_TIMEOUT  500
+
+/* Minimal interval between two pre-warm hints sent to the same panel */
+#define PRE_WARM_INTERVAL  (5 * G_USEC_PER_SEC)
+
 #include <X11/Xatom.h>
 
 static void mnb_panel_iface_init (MnbPanelIface *iface);
@@ -73,6 +87,7 @@ static const gchar * mnb_panel_oop_get_button_style (MnbPanel *panel);
 static const gchar  *mnb_panel_oop_get_stylesheet    (MnbPanel *panel);
 static void mnb_panel_oop_show (MnbPanel *panel);
 static void mnb_panel_oop_show_animate      (MnbPanelOop *panel);
+static void mnb_panel_oop_drop_snapshot_actor (MnbPanelOop *panel);
 
 enum
 {
@@ -136,6 +151,8 @@ struct _MnbPanelOopPrivate
   gboolean         dont_hide_toolbar : 1;
   gboolean         delayed_show      : 1;
   gboolean         mapped            : 1;
+  gboolean         show_begin_replied : 1;
+  gboolean         slide_completed    : 1;
 
   MxButton      *button;
 
@@ -144,6 +161,18 @@ struct _MnbPanelOopPrivate
   ClutterAnimation *show_anim;
   ClutterAnimation *hide_anim;
 
+  /*
+   * Snapshot of the panel taken when it was last hidden, and the actor that
+   * shows it while sliding the panel in.
+   */
+  CoglHandle        snapshot;
+  gint              snapshot_width;
+  gint              snapshot_height;
+  ClutterActor     *snapshot_actor;
+  guint             crossfade_timeout_id;
+  guint             show_serial;
+
+  gint64            last_pre_warm;
 };
 
 static void
@@ -376,6 +405,8 @@ mnb_panel_oop_dispose (GObject *self)
       priv->button = NULL;
     }
 
+  mnb_panel_oop_drop_snapshot_actor (MNB_PANEL_OOP (self));
+
   g_signal_emit (self, signals[DESTROY], 0);
 
   G_OBJECT_CLASS (mnb_panel_oop_parent_class)->dispose (self);
@@ -395,6 +426,9 @@ mnb_panel_oop_finalize (GObject *object)
   g_free (priv->button_style_id);
   g_free (priv->child_class);
 
+  if (priv->snapshot)
+    cogl_handle_unref (priv->snapshot);
+
   G_OBJECT_CLASS (mnb_panel_oop_parent_class)->finalize (object);
 }
 
@@ -531,14 +565,66 @@ mnb_panel_oop_dbus_dumb_reply_cb (DBusGProxy *proxy,
  * Signal closures for show/hide related signals; we translate these into the
  * appropriate dbus method calls.
  */
+typedef struct
+{
+  MnbPanelOop *panel;
+  guint        serial;
+} MnbPanelOopShowBeginClosure;
+
+static void mnb_panel_oop_crossfade (MnbPanelOop *panel);
+
+/*
+ * The reply to ShowBegin tells us the client has done whatever it needed to
+ * do before being shown, so its window contents are current.
+ */
+static void
+mnb_panel_oop_show_begin_reply_cb (DBusGProxy *proxy,
+                                   GError     *error,
+                                   gpointer    data)
+{
+  MnbPanelOopShowBeginClosure *closure = data;
+  MnbPanelOopPrivate          *priv    = closure->panel->priv;
+
+  mpl_trace_async_end ("panel", "show-begin",
+                       GPOINTER_TO_SIZE (closure->panel));
+
+  if (error)
+    g_error_free (error);
+
+  if (closure->serial == priv->show_serial)
+    {
+      priv->show_begin_replied = TRUE;
+
+      if (priv->slide_completed && priv->snapshot_actor)
+        mnb_panel_oop_crossfade (closure->panel);
+    }
+
+  g_object_unref (closure->panel);
+  g_slice_free (MnbPanelOopShowBeginClosure, closure);
+}
+
 static void
 mnb_panel_oop_show_begin (MnbPanel *self)
 {
-  MnbPanelOopPrivate *priv = MNB_PANEL_OOP (self)->priv;
+  MnbPanelOopPrivate          *priv = MNB_PANEL_OOP (self)->priv;
+  MnbPanelOopShowBeginClosure *closure;
+
+  if (!priv->proxy)
+    {
+      g_warning (G_STRLOC " No DBus proxy!");
+      return;
+    }
+
+  closure = g_slice_new (MnbPanelOopShowBeginClosure);
+  closure->panel  = g_object_ref (self);
+  closure->serial = priv->show_serial;
+
+  /* This lasts as long as the client's show-begin handlers */
+  mpl_trace_async_begin ("panel", "show-begin", GPOINTER_TO_SIZE (self));
 
   com_dawati_UX_Shell_Panel_show_begin_async (priv->proxy,
-                                              mnb_panel_oop_dbus_dumb_reply_cb,
-                                              NULL);
+                                              mnb_panel_oop_show_begin_reply_cb,
+                                              closure);
 }
 
 static void
@@ -1004,6 +1090,8 @@ mnb_panel_oop_mutter_window_destroy_cb (ClutterActor *actor, gpointer data)
 
   priv->mcw = NULL;
   priv->mapped = FALSE;
+
+  mnb_panel_oop_drop_snapshot_actor (MNB_PANEL_OOP (data));
 }
 
 void
@@ -1164,22 +1252,55 @@ mnb_panel_oop_is_ancestor_of_transient (MnbPanelOop *panel, MetaWindowActor *mcw
   return meta_window_is_ancestor_of_transient (pmw, mw);
 }
 
+typedef struct
+{
+  DBusGProxy         *proxy;
+  gchar              *dbus_name;
+  MnbPanelOopPingFunc callback;
+  gpointer            data;
+} MnbPanelOopPingClosure;
+
 static void
 mnb_panel_oop_dbus_ping_cb (DBusGProxy *proxy, GError *error, gpointer data)
 {
-  g_free (data);
+  MnbPanelOopPingClosure *closure = data;
+
+  if (closure->callback)
+    closure->callback (closure->dbus_name, error, closure->data);
+
+  if (error)
+    g_error_free (error);
+
+  g_object_unref (closure->proxy);
+  g_free (closure->dbus_name);
+  g_slice_free (MnbPanelOopPingClosure, closure);
 }
 
 void
 mnb_toolbar_ping_panel_oop (DBusGConnection *dbus_conn, const gchar *dbus_name)
 {
+  mnb_toolbar_ping_panel_oop_full (dbus_conn, dbus_name, NULL, NULL);
+}
+
+/*
+ * Pings the panel service, starting it through DBus activation if needed;
+ * callback is called once the service replied, or the ping failed. Returns
+ * FALSE, without calling callback, if the ping could not be sent.
+ */
+gboolean
+mnb_toolbar_ping_panel_oop_full (DBusGConnection     *dbus_conn,
+                                 const gchar         *dbus_name,
+                                 MnbPanelOopPingFunc  callback,
+                                 gpointer             data)
+{
+  MnbPanelOopPingClosure *closure;
   DBusGProxy  *proxy;
   const gchar *p = dbus_name;
   gchar       *p2;
   gchar        c;
   gchar       *dbus_path;
 
-  g_return_if_fail (dbus_name);
+  g_return_val_if_fail (dbus_name, FALSE);
 
   /*
    * Do sanity check on the dbus_name, otherwise dbus might abort us.
@@ -1192,7 +1313,7 @@ mnb_toolbar_ping_panel_oop (DBusGConnection *dbus_conn, const gchar *dbus_name)
     {
       g_warning ("panel dbus name '%s' uses digit as first character of name",
                  dbus_name);
-      return;
+      return FALSE;
     }
 
   /*
@@ -1216,7 +1337,7 @@ mnb_toolbar_ping_panel_oop (DBusGConnection *dbus_conn, const gchar *dbus_name)
 
       g_warning ("panel dbus name '%s' contains invalid character '%c'",
                  dbus_name, c);
-      return;
+      return FALSE;
     }
 
   dbus_path = g_strconcat ("/", dbus_name, NULL);
@@ -1238,14 +1359,216 @@ mnb_toolbar_ping_panel_oop (DBusGConnection *dbus_conn, const gchar *dbus_name)
   if (!proxy)
     {
       g_warning ("Unable to create proxy for %s (reason unknown)", dbus_name);
-      return;
+      return FALSE;
     }
 
+  /*
+   * The closure holds on to the proxy, so that the call is not cancelled
+   * before the reply arrives.
+   */
+  closure = g_slice_new (MnbPanelOopPingClosure);
+  closure->proxy = proxy;
+  closure->dbus_name = g_strdup (dbus_name);
+  closure->callback = callback;
+  closure->data = data;
+
   com_dawati_UX_Shell_Panel_ping_async (proxy,
                                        mnb_panel_oop_dbus_ping_cb,
-                                       g_strdup (dbus_name));
+                                       closure);
+
+  return TRUE;
+}
+
+/*
+ * Renders the current contents of the panel window into a downscaled
+ * offscreen texture, so that the next show animation has something to slide
+ * in before the client has repainted.
+ */
+static void
+mnb_panel_oop_take_snapshot (MnbPanelOop *panel, MetaWindowActor *mcw)
+{
+  MnbPanelOopPrivate *priv = panel->priv;
+  ClutterActor       *meta_texture;
+  CoglHandle          window_texture;
+  CoglHandle          fb;
+  CoglColor           transparent;
+  gfloat              window_width, window_height;
+  guint               width, height;
+
+  meta_texture = meta_window_actor_get_texture (mcw);
+
+  if (!meta_texture)
+    return;
+
+  window_texture =
+    meta_shaped_texture_get_texture (META_SHAPED_TEXTURE (meta_texture));
+
+  if (window_texture == COGL_INVALID_HANDLE)
+    return;
+
+  clutter_actor_get_size (CLUTTER_ACTOR (mcw), &window_width, &window_height);
+
+  width  = MAX (1, cogl_texture_get_width (window_texture) / SNAPSHOT_SCALE);
+  height = MAX (1, cogl_texture_get_height (window_texture) / SNAPSHOT_SCALE);
+
+  if (priv->snapshot &&
+      (cogl_texture_get_width (priv->snapshot) != width ||
+       cogl_texture_get_height (priv->snapshot) != height))
+    {
+      cogl_handle_unref (priv->snapshot);
+      priv->snapshot = NULL;
+    }
+
+  if (!priv->snapshot)
+    priv->snapshot = cogl_texture_new_with_size (width, height,
+                                                 COGL_TEXTURE_NO_SLICING,
+                                               COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+
+  if (priv->snapshot == COGL_INVALID_HANDLE)
+    {
+      priv->snapshot = NULL;
+      return;
+    }
+
+  fb = cogl_offscreen_new_to_texture (priv->snapshot);
+
+  if (fb == COGL_INVALID_HANDLE)
+    {
+      cogl_handle_unref (priv->snapshot);
+      priv->snapshot = NULL;
+      return;
+    }
+
+  cogl_push_framebuffer (fb);
+  cogl_ortho (0, width, height, 0, -1, 1);
+
+  /* a freshly allocated texture has undefined contents */
+  cogl_color_init_from_4ub (&transparent, 0, 0, 0, 0);
+  cogl_clear (&transparent, COGL_BUFFER_BIT_COLOR);
+
+  cogl_set_source_texture (window_texture);
+  cogl_rectangle (0, 0, width, height);
+  cogl_pop_framebuffer ();
+
+  cogl_handle_unref (fb);
+
+  priv->snapshot_width  = window_width;
+  priv->snapshot_height = window_height;
+}
+
+/*
+ * Creates the actor used to slide in the snapshot in place of the panel
+ * window; returns FALSE if there is no usable snapshot.
+ */
+static gboolean
+mnb_panel_oop_setup_snapshot_actor (MnbPanelOop *panel,
+                                    gfloat       width,
+                                    gfloat       height)
+{
+  MnbPanelOopPrivate *priv = panel->priv;
+  ClutterActor       *mcw  = CLUTTER_ACTOR (priv->mcw);
+  ClutterActor       *parent;
+  ClutterActor       *actor;
+
+  if (!priv->snapshot ||
+      priv->snapshot_width != (gint) width ||
+      priv->snapshot_height != (gint) height)
+    return FALSE;
+
+  parent = clutter_actor_get_parent (mcw);
+
+  if (!CLUTTER_IS_CONTAINER (parent))
+    return FALSE;
+
+  actor = clutter_texture_new ();
+  clutter_texture_set_cogl_texture (CLUTTER_TEXTURE (actor), priv->snapshot);
+  clutter_actor_set_size (actor, width, height);
 
-  g_object_unref (proxy);
+  clutter_container_add_actor (CLUTTER_CONTAINER (parent), actor);
+  clutter_container_raise_child (CLUTTER_CONTAINER (parent), actor, mcw);
+
+  priv->snapshot_actor = actor;
+
+  return TRUE;
+}
+
+/*
+ * Destroys the snapshot actor straight away, e.g., when the show is
+ * interrupted, and makes sure the panel window is visible again.
+ */
+static void
+mnb_panel_oop_drop_snapshot_actor (MnbPanelOop *panel)
+{
+  MnbPanelOopPrivate *priv = panel->priv;
+
+  if (priv->crossfade_timeout_id)
+    {
+      g_source_remove (priv->crossfade_timeout_id);
+      priv->crossfade_timeout_id = 0;
+    }
+
+  if (!priv->snapshot_actor)
+    return;
+
+  clutter_actor_destroy (priv->snapshot_actor);
+  priv->snapshot_actor = NULL;
+
+  if (priv->mcw)
+    clutter_actor_set_opacity (CLUTTER_ACTOR (priv->mcw), 0xff);
+}
+
+static void
+mnb_panel_oop_crossfade_completed_cb (ClutterAnimation *anim,
+                                      ClutterActor     *actor)
+{
+  clutter_actor_destroy (actor);
+}
+
+static void
+mnb_panel_oop_crossfade (MnbPanelOop *panel)
+{
+  MnbPanelOopPrivate *priv  = panel->priv;
+  ClutterActor       *actor = priv->snapshot_actor;
+  ClutterAnimation   *animation;
+
+  if (priv->crossfade_timeout_id)
+    {
+      g_source_remove (priv->crossfade_timeout_id);
+      priv->crossfade_timeout_id = 0;
+    }
+
+  if (!actor)
+    return;
+
+  priv->snapshot_actor = NULL;
+
+  if (priv->mcw)
+    clutter_actor_animate (CLUTTER_ACTOR (priv->mcw), CLUTTER_LINEAR,
+                           CROSSFADE_DURATION,
+                           "opacity", 0xff,
+                           NULL);
+
+  animation = clutter_actor_animate (actor, CLUTTER_LINEAR,
+                                     CROSSFADE_DURATION,
+                                     "opacity", 0,
+                                     NULL);
+
+  g_signal_connect_after (animation,
+                          "completed",
+                          G_CALLBACK (mnb_panel_oop_crossfade_completed_cb),
+                          actor);
+}
+
+static gboolean
+mnb_panel_oop_crossfade_timeout_cb (gpointer data)
+{
+  MnbPanelOop *panel = data;
+
+  panel->priv->crossfade_timeout_id = 0;
+
+  mnb_panel_oop_crossfade (panel);
+
+  return FALSE;
 }
 
 static void
@@ -1253,11 +1576,30 @@ mnb_panel_oop_show_completed_cb (ClutterAnimation *anim, MnbPanelOop *panel)
 {
   MnbPanelOopPrivate *priv = panel->priv;
 
+  priv->slide_completed = TRUE;
+
+  /*
+   * If we slid in the snapshot, swap it for the real window as soon as the
+   * client is ready, but do not wait for it indefinitely.
+   */
+  if (priv->snapshot_actor)
+    {
+      if (priv->show_begin_replied)
+        mnb_panel_oop_crossfade (panel);
+      else if (!priv->crossfade_timeout_id)
+        priv->crossfade_timeout_id =
+          g_timeout_add (CROSSFADE_TIMEOUT,
+                         mnb_panel_oop_crossfade_timeout_cb,
+                         panel);
+    }
+
   priv->in_show_animation = FALSE;
   priv->dont_hide_toolbar = FALSE;
   priv->show_anim = NULL;
   priv->show_completed_id = 0;
 
+  mpl_trace_async_end ("panel", "show", GPOINTER_TO_SIZE (panel));
+
   if (priv->button)
     {
       if (!mx_button_get_toggled (priv->button))
@@ -1291,10 +1633,20 @@ mnb_panel_oop_show_animate (MnbPanelOop *panel)
       priv->hide_anim = NULL;
       priv->hide_completed_id = 0;
       priv->in_hide_animation = FALSE;
+
+      mpl_trace_async_end ("panel", "hide", GPOINTER_TO_SIZE (panel));
     }
 
   mnb_panel_ensure_size ((MnbPanel*)panel);
 
+  mnb_panel_oop_drop_snapshot_actor (panel);
+
+  priv->show_serial++;
+  priv->show_begin_replied = FALSE;
+  priv->slide_completed    = FALSE;
+
+  mpl_trace_async_begin ("panel", "show", GPOINTER_TO_SIZE (panel));
+
   g_signal_emit_by_name (panel, "show-begin");
 
   /*
@@ -1322,14 +1674,27 @@ mnb_panel_oop_show_animate (MnbPanelOop *panel)
     }
   else
     {
+      ClutterActor *actor = mcw;
+
       clutter_actor_get_position (mcw, &x, &y);
       clutter_actor_get_size (mcw, &width, &height);
 
-      clutter_actor_set_position (mcw, x, -height);
+      /*
+       * Slide in the snapshot of the panel while the client is still busy
+       * with show-begin; the window itself stays in place, transparent, until
+       * we cross-fade to it.
+       */
+      if (mnb_panel_oop_setup_snapshot_actor (panel, width, height))
+        {
+          actor = priv->snapshot_actor;
+          clutter_actor_set_opacity (mcw, 0);
+        }
+
+      clutter_actor_set_position (actor, x, -height);
 
       priv->in_show_animation = TRUE;
 
-      animation = clutter_actor_animate (mcw, CLUTTER_EASE_IN_SINE,
+      animation = clutter_actor_animate (actor, CLUTTER_EASE_IN_SINE,
                                          SLIDE_DURATION,
                                          "x", x,
                                          "y", y,
@@ -1358,6 +1723,8 @@ mnb_panel_oop_show (MnbPanel *panel)
       priv->hide_anim = NULL;
       priv->hide_completed_id = 0;
       priv->in_hide_animation = FALSE;
+
+      mpl_trace_async_end ("panel", "hide", GPOINTER_TO_SIZE (panel));
     }
 
   com_dawati_UX_Shell_Panel_show_async (priv->proxy,
@@ -1390,6 +1757,9 @@ mnb_panel_oop_hide_completed_cb (ClutterAnimation *anim, MnbPanelOop *panel)
     }
 
   priv->in_hide_animation = FALSE;
+
+  mpl_trace_async_end ("panel", "hide", GPOINTER_TO_SIZE (panel));
+
   g_signal_emit_by_name (panel, "hide-completed");
 
   meta_plugin_destroy_completed (plugin, priv->mcw);
@@ -1409,6 +1779,8 @@ mnb_panel_oop_hide_animate (MnbPanelOop *panel, MetaWindowActor *mcw)
 
   priv->in_hide_animation = TRUE;
 
+  mpl_trace_async_begin ("panel", "hide", GPOINTER_TO_SIZE (panel));
+
   if (priv->show_completed_id)
     {
       g_signal_handler_disconnect (priv->show_anim, priv->show_completed_id);
@@ -1417,6 +1789,8 @@ mnb_panel_oop_hide_animate (MnbPanelOop *panel, MetaWindowActor *mcw)
       priv->in_show_animation = FALSE;
       priv->dont_hide_toolbar = FALSE;
 
+      mpl_trace_async_end ("panel", "show", GPOINTER_TO_SIZE (panel));
+
       if (priv->button)
         {
           if (mx_button_get_toggled (priv->button))
@@ -1424,6 +1798,15 @@ mnb_panel_oop_hide_animate (MnbPanelOop *panel, MetaWindowActor *mcw)
         }
     }
 
+  /*
+   * Only refresh the snapshot if the window has been showing the client's
+   * real contents, i.e., we are not still waiting to cross-fade to it.
+   */
+  if (!priv->snapshot_actor)
+    mnb_panel_oop_take_snapshot (panel, mcw);
+  else
+    mnb_panel_oop_drop_snapshot_actor (panel);
+
   g_signal_emit_by_name (panel, "hide-begin");
 
   /* de-activate the button */
@@ -1670,3 +2053,56 @@ mnb_panel_oop_set_auto_modal (MnbPanelOop *panel, gboolean modal)
         g_object_notify (G_OBJECT (panel), "modal");
     }
 }
+
+/*
+ * Hints the panel that it is likely to be shown shortly, so it can start the
+ * work it would otherwise do in show-begin.
+ */
+void
+mnb_panel_oop_pre_warm (MnbPanelOop *panel)
+{
+  MnbPanelOopPrivate *priv;
+  gint64              now;
+
+  g_return_if_fail (MNB_IS_PANEL_OOP (panel));
+
+  priv = panel->priv;
+
+  if (!priv->proxy || !priv->ready || priv->mapped || priv->in_show_animation)
+    return;
+
+  now = g_get_monotonic_time ();
+
+  if (priv->last_pre_warm && now - priv->last_pre_warm < PRE_WARM_INTERVAL)
+    return;
+
+  priv->last_pre_warm = now;
+
+  com_dawati_UX_Shell_Panel_pre_warm_async (priv->proxy,
+                                            mnb_panel_oop_dbus_dumb_reply_cb,
+                                            NULL);
+}
+
+/*
+ * Passes a SetTracing request from the Toolbar on to the panel process.
+ */
+void
+mnb_panel_oop_set_tracing (MnbPanelOop *panel,
+                           gboolean     enabled,
+                           const gchar *directory)
+{
+  MnbPanelOopPrivate *priv;
+
+  g_return_if_fail (MNB_IS_PANEL_OOP (panel));
+
+  priv = panel->priv;
+
+  if (!priv->proxy || priv->dead)
+    return;
+
+  com_dawati_UX_Shell_Panel_set_tracing_async (priv->proxy,
+                                               enabled,
+                                               directory ? directory : "",
+                                               mnb_panel_oop_dbus_dumb_reply_cb,
+                                               NULL);
+}
@@ -85,8 +85,16 @@ gboolean      mnb_panel_oop_owns_window       (MnbPanelOop *panel, MetaWindowAct
 gboolean      mnb_panel_oop_is_ancestor_of_transient (MnbPanelOop     *panel,
                                                       MetaWindowActor *mcw);
 
+typedef void (*MnbPanelOopPingFunc) (const gchar *dbus_name,
+                                     const GError *error,
+                                     gpointer     data);
+
 void          mnb_toolbar_ping_panel_oop      (DBusGConnection *dbus_conn,
                                                const gchar     *dbus_name);
+gboolean      mnb_toolbar_ping_panel_oop_full (DBusGConnection     *dbus_conn,
+                                               const gchar         *dbus_name,
+                                               MnbPanelOopPingFunc  callback,
+                                               gpointer             data);
 
 void          mnb_panel_oop_hide_animate      (MnbPanelOop     *panel,
                                                MetaWindowActor *mcw);
@@ -99,6 +107,12 @@ void          mnb_panel_oop_set_delayed_show  (MnbPanelOop *panel,
 void          mnb_panel_oop_set_auto_modal    (MnbPanelOop *panel,
                                                gboolean     modal);
 
+void          mnb_panel_oop_pre_warm          (MnbPanelOop *panel);
+
+void          mnb_panel_oop_set_tracing       (MnbPanelOop *panel,
+                                               gboolean     enabled,
+                                               const gchar *directory);
+
 G_END_DECLS
 
 #endif /* _MNB_PANEL_OOP */
@@ -33,6 +33,7 @@
 #include <dbus/dbus.h>
 #include <gconf/gconf-client.h>
 #include <dawati-panel/mpl-panel-common.h>
+#include <dawati-panel/mpl-trace.h>
 #include <meta/display.h>
 #include <meta/keybindings.h>
 #include <meta/errors.h>
@@ -57,6 +58,7 @@
 #include "mnb-toolbar-shadow.h"
 #include "mnb-panel-oop.h"
 #include "mnb-spinner.h"
+#include "effects/mnb-effect-stats.h"
 #include "mnb-statusbar.h"
 
 /* For systray windows stuff */
@@ -95,6 +97,7 @@
 #define TOOLBAR_AUTOSTART_ATTEMPTS 10
 #define TOOLBAR_WAITING_FOR_PANEL_TIMEOUT 1 /* in seconds */
 #define TOOLBAR_PANEL_STUB_TIMEOUT 6        /* in seconds */
+#define TOOLBAR_ACTIVATION_LIMIT 3          /* default, see the gsettings key */
 #define DAWATI_BOOT_COUNT_KEY "/desktop/dawati/myzone/boot_count"
 
 #define CLOSE_BUTTON_GUARD_WIDTH 35
@@ -157,6 +160,7 @@ static gboolean mnb_toolbar_start_panel_service (MnbToolbar *toolbar,
                                                  MnbToolbarPanel *tp);
 static void mnb_toolbar_workarea_changed_cb (MetaScreen *screen,
                                              MnbToolbar *toolbar);
+static void mnb_toolbar_activate_next_panels (MnbToolbar *toolbar);
 
 
 enum {
@@ -205,6 +209,8 @@ struct _MnbToolbarPanel
   gboolean    required   : 1;
   gboolean    failed     : 1;
   gboolean    ready      : 1;
+
+  gint64      activation_start; /* monotonic time of the activation ping */
 };
 
 static void
@@ -296,6 +302,11 @@ struct _MnbToolbarPrivate
   GSList          *pending_panels;
   MnbToolbarPanel *tp_to_activate;
 
+  GQueue          *activation_queue; /* services waiting to be activated */
+  guint            n_activating;     /* activation pings in flight */
+  guint            activation_limit;
+  gint64           startup_time;
+
   gint             old_screen_width;
   gint             old_screen_height;
 
@@ -403,6 +414,9 @@ mnb_toolbar_finalize (GObject *object)
   g_slist_free (priv->pending_panels);
   priv->pending_panels = NULL;
 
+  g_queue_foreach (priv->activation_queue, (GFunc) g_free, NULL);
+  g_queue_free (priv->activation_queue);
+
   G_OBJECT_CLASS (mnb_toolbar_parent_class)->finalize (object);
 }
 
@@ -867,6 +881,61 @@ mnb_toolbar_dbus_hide_panel (MnbToolbar  *self,
   return TRUE;
 }
 
+/*
+ * Switches tracing in the shell and all the running panels; when stopping,
+ * each process writes its own trace into the directory.
+ */
+static gboolean
+mnb_toolbar_dbus_set_tracing (MnbToolbar  *self,
+                              gboolean     enabled,
+                              gchar       *directory,
+                              GError     **error)
+{
+  MnbToolbarPrivate *priv = self->priv;
+  GList             *l;
+
+  for (l = priv->panels; l; l = l->next)
+    {
+      MnbToolbarPanel *tp = l->data;
+
+      if (tp && tp->panel && MNB_IS_PANEL_OOP (tp->panel))
+        mnb_panel_oop_set_tracing ((MnbPanelOop*)tp->panel,
+                                   enabled, directory);
+    }
+
+  if (enabled)
+    {
+      mpl_trace_set_enabled (TRUE);
+      return TRUE;
+    }
+
+  return mpl_trace_stop (directory, error);
+}
+
+/*
+ * Frame timing of one of the window effects (map, minimize, maximize or
+ * switch-workspace), see effects/mnb-effect-stats.c.
+ */
+static gboolean
+mnb_toolbar_dbus_get_effect_stats (MnbToolbar  *self,
+                                   gchar       *effect,
+                                   GHashTable **stats,
+                                   GError     **error)
+{
+  MnbEffect e;
+
+  if (!mnb_effect_stats_lookup (effect, &e))
+    {
+      g_set_error (error, g_quark_from_static_string ("MnbToolbar"), 0,
+                   "Unknown effect '%s'", effect);
+      return FALSE;
+    }
+
+  *stats = mnb_effect_stats_get (e);
+
+  return TRUE;
+}
+
 #include "mnb-toolbar-dbus-glue.h"
 
 static void
@@ -1189,6 +1258,35 @@ mnb_toolbar_button_button_release_cb (MnbToolbarButton   *button,
   return FALSE;
 }
 
+/*
+ * The pointer entering a panel button is a good hint the panel is about to be
+ * shown; let the panel start any expensive show-begin work now (the panel
+ * rate-limits these itself).
+ */
+static gboolean
+mnb_toolbar_button_enter_event_cb (MxButton             *button,
+                                   ClutterCrossingEvent *event,
+                                   MnbToolbar           *toolbar)
+{
+  MnbToolbarPrivate *priv = toolbar->priv;
+  GList             *l;
+
+  for (l = priv->panels; l; l = l->next)
+    {
+      MnbToolbarPanel *tp = l->data;
+
+      if (!tp || tp->button != (ClutterActor*)button)
+        continue;
+
+      if (tp->panel && MNB_IS_PANEL_OOP (tp->panel))
+        mnb_panel_oop_pre_warm ((MnbPanelOop*)tp->panel);
+
+      break;
+    }
+
+  return FALSE;
+}
+
 static void
 mnb_toolbar_hide_selector (MnbToolbar *self)
 {
@@ -1276,6 +1374,7 @@ mnb_toolbar_button_toggled_cb (MxButton *button,
   GList             *l;
   gboolean           button_click;
   gboolean           previous_clicked = FALSE;
+  MPL_TRACE_SCOPE ("toolbar", "button-toggled");
 
   static gboolean    recursion = FALSE;
 
@@ -2271,6 +2370,10 @@ mnb_toolbar_append_button (MnbToolbar  *toolbar, MnbToolbarPanel *tp)
       g_signal_connect (button, "button-release-event",
                         G_CALLBACK (mnb_toolbar_button_button_release_cb),
                         toolbar);
+
+      g_signal_connect (button, "enter-event",
+                        G_CALLBACK (mnb_toolbar_button_enter_event_cb),
+                        toolbar);
     }
   else
     g_signal_connect (button, "notify::toggled",
@@ -2331,6 +2434,16 @@ mnb_toolbar_append_panel (MnbToolbar  *toolbar, MnbPanel *panel)
       tp->failed = FALSE;
     }
 
+  if (tp->activation_start)
+    {
+      g_message ("Panel %s ready %" G_GINT64_FORMAT " ms after activation",
+                 name, (g_get_monotonic_time () - tp->activation_start) / 1000);
+      tp->activation_start = 0;
+
+      mpl_trace_async_end ("toolbar", "panel-activation",
+                           GPOINTER_TO_SIZE (tp));
+    }
+
   if (panel == tp->panel)
     return;
 
@@ -2397,6 +2510,10 @@ mnb_toolbar_init (MnbToolbar *self)
 
   if (flags & MNB_OPTION_DISABLE_PANEL_RESTART)
     priv->no_autoloading = TRUE;
+
+  priv->activation_queue = g_queue_new ();
+  priv->activation_limit = TOOLBAR_ACTIVATION_LIMIT;
+  priv->startup_time = g_get_monotonic_time ();
 }
 
 static DBusGConnection *
@@ -2493,6 +2610,18 @@ mnb_toolbar_handle_dbus_name (MnbToolbar *toolbar, const gchar *name)
     }
 }
 
+static gboolean
+mnb_toolbar_is_pending_panel (MnbToolbar *toolbar, const gchar *name)
+{
+  GSList *l;
+
+  for (l = toolbar->priv->pending_panels; l; l = l->next)
+    if (!strcmp (l->data, name))
+      return TRUE;
+
+  return FALSE;
+}
+
 static void
 mnb_toolbar_noc_cb (DBusGProxy  *proxy,
                     const gchar *name,
@@ -2500,9 +2629,6 @@ mnb_toolbar_noc_cb (DBusGProxy  *proxy,
                     const gchar *new_owner,
                     MnbToolbar  *toolbar)
 {
-  MnbToolbarPrivate *priv;
-  GSList            *l;
-
   /*
    * Unfortunately, we get this for all name owner changes on the bus, so
    * return early.
@@ -2511,8 +2637,6 @@ mnb_toolbar_noc_cb (DBusGProxy  *proxy,
                         strlen (MPL_PANEL_DBUS_NAME_PREFIX)))
     return;
 
-  priv = MNB_TOOLBAR (toolbar)->priv;
-
   if (!new_owner || !*new_owner)
     {
       /*
@@ -2522,19 +2646,9 @@ mnb_toolbar_noc_cb (DBusGProxy  *proxy,
       return;
     }
 
-  l = priv->pending_panels;
-  while (l)
-    {
-      const gchar *my_name = l->data;
-
-      if (!strcmp (my_name, name))
-        {
-          /* We are already handling this one */
-          return;
-        }
-
-      l = l->next;
-    }
+  /* We might already be handling this one */
+  if (mnb_toolbar_is_pending_panel (toolbar, name))
+    return;
 
   mnb_toolbar_handle_dbus_name (toolbar, name);
 }
@@ -2602,6 +2716,123 @@ mnb_toolbar_autostart_panels_cb (gpointer toolbar)
 }
 #endif
 
+static void
+mnb_toolbar_panel_activated_cb (const gchar  *service,
+                                const GError *error,
+                                gpointer      data)
+{
+  MnbToolbar        *toolbar = MNB_TOOLBAR (data);
+  MnbToolbarPrivate *priv    = toolbar->priv;
+  MnbToolbarPanel   *tp;
+
+  tp = mnb_toolbar_panel_service_to_panel_internal (toolbar, service);
+
+  if (tp && tp->activation_start)
+    {
+      gint64 now = g_get_monotonic_time ();
+
+      if (error)
+        {
+          g_message ("Panel %s failed to start after %" G_GINT64_FORMAT
+                     " ms: %s", tp->name,
+                     (now - tp->activation_start) / 1000, error->message);
+
+          mpl_trace_async_end ("toolbar", "panel-activation",
+                               GPOINTER_TO_SIZE (tp));
+        }
+      else
+        g_message ("Panel %s started in %" G_GINT64_FORMAT " ms (%"
+                   G_GINT64_FORMAT " ms after toolbar startup)", tp->name,
+                   (now - tp->activation_start) / 1000,
+                   (now - priv->startup_time) / 1000);
+    }
+
+  if (priv->n_activating > 0)
+    priv->n_activating--;
+
+  mpl_trace_counter ("toolbar", "panels-activating", priv->n_activating);
+
+  mnb_toolbar_activate_next_panels (toolbar);
+}
+
+/*
+ * Pings the queued panel services, so that DBus activates them, keeping at
+ * most activation_limit pings in flight.
+ */
+static void
+mnb_toolbar_activate_next_panels (MnbToolbar *toolbar)
+{
+  MnbToolbarPrivate *priv = toolbar->priv;
+  gchar             *service;
+
+  while (priv->n_activating < priv->activation_limit &&
+         (service = g_queue_pop_head (priv->activation_queue)))
+    {
+      MnbToolbarPanel *tp;
+
+      tp = mnb_toolbar_panel_service_to_panel_internal (toolbar, service);
+
+      /*
+       * Skip panels that went away, or came up (or were started on demand)
+       * while queued.
+       */
+      if (tp && !tp->panel && !tp->pinged && !tp->unloaded &&
+          !mnb_toolbar_is_pending_panel (toolbar, service))
+        {
+          tp->activation_start = g_get_monotonic_time ();
+
+          if (mnb_toolbar_ping_panel_oop_full (priv->dbus_conn, service,
+                                               mnb_toolbar_panel_activated_cb,
+                                               toolbar))
+            {
+              priv->n_activating++;
+
+              mpl_trace_async_begin ("toolbar", "panel-activation",
+                                     GPOINTER_TO_SIZE (tp));
+              mpl_trace_counter ("toolbar", "panels-activating",
+                                 priv->n_activating);
+            }
+        }
+
+      g_free (service);
+    }
+}
+
+/*
+ * Queues activation of the configured panels that are not running yet;
+ * panels with a visible toolbar button go first.
+ */
+static void
+mnb_toolbar_queue_panel_activation (MnbToolbar *toolbar)
+{
+  MnbToolbarPrivate *priv = toolbar->priv;
+  GList             *l;
+  gint               pass;
+
+  if (priv->no_autoloading)
+    return;
+
+  for (pass = 0; pass < 2; pass++)
+    for (l = priv->panels; l; l = l->next)
+      {
+        MnbToolbarPanel *tp = l->data;
+        gboolean         visible;
+
+        if (!tp || !tp->service || tp->panel || tp->unloaded)
+          continue;
+
+        if (mnb_toolbar_is_pending_panel (toolbar, tp->service))
+          continue;
+
+        visible = tp->button && CLUTTER_ACTOR_IS_VISIBLE (tp->button);
+
+        if (visible == (pass == 0))
+          g_queue_push_tail (priv->activation_queue, g_strdup (tp->service));
+      }
+
+  mnb_toolbar_activate_next_panels (toolbar);
+}
+
 static void
 mnb_toolbar_dbus_list_names_cb (DBusGProxy  *proxy,
                                 char       **names,
@@ -2618,7 +2849,8 @@ mnb_toolbar_dbus_list_names_cb (DBusGProxy  *proxy,
     }
 
   /*
-   * Insert panels for any services already running.
+   * Insert panels for any services already running; the names returned by
+   * ListNames all have an owner, so there is no need to ask the bus again.
    */
   if (!error)
     {
@@ -2628,19 +2860,12 @@ mnb_toolbar_dbus_list_names_cb (DBusGProxy  *proxy,
           if (!strncmp (*p, MPL_PANEL_DBUS_NAME_PREFIX,
                         strlen (MPL_PANEL_DBUS_NAME_PREFIX)))
             {
-              gboolean  has_owner = FALSE;
+              MnbToolbarPanel *tp;
 
-              if (org_freedesktop_DBus_name_has_owner (priv->dbus_proxy,
-                                                       *p, &has_owner, NULL) &&
-                  has_owner)
-                {
-                  MnbToolbarPanel *tp;
+              tp = mnb_toolbar_panel_service_to_panel_internal (toolbar, *p);
 
-                  tp = mnb_toolbar_panel_service_to_panel_internal (toolbar,*p);
-
-                  if (tp)
-                    mnb_toolbar_handle_dbus_name (toolbar, *p);
-                }
+              if (tp)
+                mnb_toolbar_handle_dbus_name (toolbar, *p);
             }
 
           p++;
@@ -2659,6 +2884,12 @@ mnb_toolbar_dbus_list_names_cb (DBusGProxy  *proxy,
   dbus_g_proxy_connect_signal (priv->dbus_proxy, "NameOwnerChanged",
                                G_CALLBACK (mnb_toolbar_noc_cb),
                                toolbar, NULL);
+
+  /*
+   * Start whatever is not running yet; the panels come in through
+   * NameOwnerChanged as their services appear.
+   */
+  mnb_toolbar_queue_panel_activation (toolbar);
 }
 
 
@@ -2959,6 +3190,7 @@ mnb_toolbar_activate_panel_internal (MnbToolbar        *toolbar,
   MnbToolbarPrivate *priv  = toolbar->priv;
   GList             *l;
   MnbPanel          *panel = tp->panel;
+  MPL_TRACE_SCOPE ("toolbar", "activate-panel");
 
   g_return_if_fail (tp);
 
@@ -3901,6 +4133,14 @@ mnb_toolbar_panel_settings_changed_cb (GSettings  *settings,
   gchar **value;
   GSList *order;
 
+  if (!strcmp (key, "panel-activation-limit"))
+    {
+      toolbar->priv->activation_limit =
+        MAX (1, g_settings_get_int (settings, key));
+      mnb_toolbar_activate_next_panels (toolbar);
+      return;
+    }
+
   if (strcmp (key, "order") != 0)
     {
       g_warning (G_STRLOC ": Unknown key %s", key);
@@ -3982,6 +4222,8 @@ mnb_toolbar_setup_settings (MnbToolbar *toolbar)
                     G_CALLBACK (mnb_toolbar_panel_settings_changed_cb),
                     toolbar);
 
+  priv->activation_limit =
+    MAX (1, g_settings_get_int (settings, "panel-activation-limit"));
 
   mnb_toolbar_load_settings (toolbar);
 }
@@ -58,6 +58,9 @@ struct _NtfTrayPrivate
   ClutterActor *pending_removed;  /* notification pending removal on anim */
   gboolean      anim_lock;
 
+  GHashTable   *notifications;    /* (subsystem, id) -> NtfNotification */
+  guint         update_id;        /* pending control text update */
+
   gboolean urgent;
 };
 
@@ -74,6 +77,12 @@ enum
 
 /* static guint signals[N_SIGNALS] = {0}; */
 
+static inline gint64
+ntf_tray_key (gint subsystem, gint id)
+{
+  return (gint64) (((guint64) (guint32) subsystem << 32) | (guint32) id);
+}
+
 static void
 ntf_tray_paint (ClutterActor *actor)
 {
@@ -357,6 +366,23 @@ ntf_tray_dismiss_all_cb (ClutterActor *button, NtfTray *tray)
     }
 }
 
+static void
+ntf_tray_notifier_removed_cb (ClutterContainer *notifiers,
+                              ClutterActor     *actor,
+                              NtfTray          *tray)
+{
+  NtfTrayPrivate  *priv = tray->priv;
+  NtfNotification *ntf = NTF_NOTIFICATION (actor);
+  gint64           key;
+
+  key = ntf_tray_key (ntf_notification_get_subsystem (ntf),
+                      ntf_notification_get_id (ntf));
+
+  /* Only drop the entry if it still points at this notification */
+  if (g_hash_table_lookup (priv->notifications, &key) == ntf)
+    g_hash_table_remove (priv->notifications, &key);
+}
+
 static void
 ntf_tray_constructed (GObject *object)
 {
@@ -372,6 +398,9 @@ ntf_tray_constructed (GObject *object)
 
   clutter_actor_add_child (actor, priv->notifiers);
 
+  g_signal_connect (priv->notifiers, "actor-removed",
+                    G_CALLBACK (ntf_tray_notifier_removed_cb), self);
+
   /* 'Overflow' control */
   priv->control = mx_table_new ();
 
@@ -403,17 +432,34 @@ static void
 ntf_tray_init (NtfTray *self)
 {
   self->priv = NTF_TRAY_GET_PRIVATE (self);
+
+  self->priv->notifications = g_hash_table_new_full (g_int64_hash,
+                                                     g_int64_equal,
+                                                     g_free,
+                                                     NULL);
 }
 
 static void
 ntf_tray_dispose (GObject *object)
 {
+  NtfTrayPrivate *priv = NTF_TRAY (object)->priv;
+
+  if (priv->update_id)
+    {
+      g_source_remove (priv->update_id);
+      priv->update_id = 0;
+    }
+
   G_OBJECT_CLASS (ntf_tray_parent_class)->dispose (object);
 }
 
 static void
 ntf_tray_finalize (GObject *object)
 {
+  NtfTrayPrivate *priv = NTF_TRAY (object)->priv;
+
+  g_hash_table_destroy (priv->notifications);
+
   G_OBJECT_CLASS (ntf_tray_parent_class)->finalize (object);
 }
 
@@ -455,7 +501,7 @@ ntf_tray_hide_ntf_completed_cb (ClutterAnimation *anim, NtfTray *tray)
   NtfTrayPrivate *priv = tray->priv;
   ClutterActor   *actor = CLUTTER_ACTOR (clutter_animation_get_object (anim));
 
-  clutter_actor_remove_child (CLUTTER_ACTOR (tray), actor);
+  clutter_actor_remove_child (priv->notifiers, actor);
 
   /* Hide ourselves if nothing left to show */
   if (priv->n_notifiers == 0)
@@ -471,6 +517,49 @@ ntf_tray_control_hide_completed_cb (ClutterAnimation *anim,
   clutter_actor_hide (priv->control);
 }
 
+static gboolean
+ntf_tray_update_cb (gpointer data)
+{
+  NtfTray        *tray = data;
+  NtfTrayPrivate *priv = tray->priv;
+  gint            n_pending = priv->n_notifiers - 1;
+
+  priv->update_id = 0;
+
+  if (n_pending == 1)
+    mx_label_set_text (MX_LABEL (priv->control_text), _("1 pending message"));
+  else if (n_pending > 1)
+    {
+      gchar *msg;
+
+      msg = g_strdup_printf (_("%i pending messages"), n_pending);
+      mx_label_set_text (MX_LABEL (priv->control_text), msg);
+      g_free (msg);
+    }
+
+  clutter_actor_queue_relayout (CLUTTER_ACTOR (tray));
+
+  return FALSE;
+}
+
+/*
+ * Notifications can be added and closed many times within a frame; update
+ * the overflow counter and relayout the tray only once, just before the
+ * next redraw.
+ */
+static void
+ntf_tray_queue_update (NtfTray *tray)
+{
+  NtfTrayPrivate *priv = tray->priv;
+
+  if (priv->update_id)
+    return;
+
+  priv->update_id = clutter_threads_add_idle_full (G_PRIORITY_HIGH_IDLE,
+                                                   ntf_tray_update_cb,
+                                                   tray, NULL);
+}
+
 static void
 ntf_tray_notification_closed_cb (NtfNotification *ntf, NtfTray *tray)
 {
@@ -579,10 +668,7 @@ ntf_tray_notification_closed_cb (NtfNotification *ntf, NtfTray *tray)
   else
     {
       /* Just Update control text */
-      gchar *msg;
-      msg = g_strdup_printf (_("%i pending messages"), priv->n_notifiers);
-      mx_label_set_text (MX_LABEL (priv->control_text), msg);
-      g_free (msg);
+      ntf_tray_queue_update (tray);
     }
 }
 
@@ -592,6 +678,7 @@ ntf_tray_add_notification (NtfTray *tray, NtfNotification *ntf)
   NtfTrayPrivate   *priv;
   ClutterActor     *ntfa;
   MetaPlugin       *plugin;
+  gint64           *key;
 
   g_return_if_fail (NTF_IS_TRAY (tray) && NTF_IS_NOTIFICATION (ntf));
 
@@ -611,6 +698,11 @@ ntf_tray_add_notification (NtfTray *tray, NtfNotification *ntf)
 
   clutter_actor_add_child (priv->notifiers, ntfa);
 
+  key  = g_new (gint64, 1);
+  *key = ntf_tray_key (ntf_notification_get_subsystem (ntf),
+                       ntf_notification_get_id (ntf));
+  g_hash_table_replace (priv->notifications, key, ntf);
+
   priv->n_notifiers++;
 
   if (priv->n_notifiers == 1)
@@ -631,8 +723,7 @@ ntf_tray_add_notification (NtfTray *tray, NtfNotification *ntf)
   else if (priv->n_notifiers == 2)
     {
       /* slide the control into view */
-      mx_label_set_text (MX_LABEL(priv->control_text),
-                         _("1 pending message"));
+      ntf_tray_queue_update (tray);
 
       clutter_actor_show (priv->control);
 
@@ -652,45 +743,20 @@ ntf_tray_add_notification (NtfTray *tray, NtfNotification *ntf)
   else
     {
       /* simply update the control */
-      gchar *msg;
-
-      msg = g_strdup_printf (_("%i pending messages"), priv->n_notifiers-1);
-
-      mx_label_set_text (MX_LABEL (priv->control_text), msg);
-
-      g_free (msg);
+      ntf_tray_queue_update (tray);
     }
 }
 
 NtfNotification *
 ntf_tray_find_notification (NtfTray *tray, gint subsystem, gint id)
 {
-  NtfTrayPrivate  *priv;
-  GList           *notifiers, *l;
-  NtfNotification *ntf = NULL;
+  gint64 key;
 
   g_return_val_if_fail (NTF_IS_TRAY (tray), NULL);
 
-  priv = tray->priv;
-
-  notifiers =
-    clutter_container_get_children (CLUTTER_CONTAINER (priv->notifiers));
-
-  for (l = notifiers; l; l = l->next)
-    {
-      gint s = ntf_notification_get_subsystem (NTF_NOTIFICATION (l->data));
-      gint i = ntf_notification_get_id (NTF_NOTIFICATION (l->data));
-
-      if (subsystem == s && id == i)
-        {
-          ntf = l->data;
-          break;
-        }
-    }
-
-  g_list_free (notifiers);
+  key = ntf_tray_key (subsystem, id);
 
-  return ntf;
+  return g_hash_table_lookup (tray->priv->notifications, &key);
 }
 
 guint
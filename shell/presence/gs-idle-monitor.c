@@ -50,6 +50,9 @@ struct GSIdleMonitorPrivate
         Display     *display;
 
         GHashTable  *watches;
+        /* Watches with the same interval share one pair of server alarms */
+        GHashTable  *alarms_by_interval;
+        GHashTable  *alarms_by_xid;
         int          sync_event_base;
         XSyncCounter counter;
 
@@ -63,19 +66,26 @@ struct GSIdleMonitorPrivate
 typedef struct
 {
         Display               *display;
-        guint                  id;
+        guint                  interval_ms;
         XSyncValue             interval;
-        GSIdleMonitorWatchFunc callback;
-        gpointer               user_data;
         XSyncAlarm             xalarm_positive;
         XSyncAlarm             xalarm_negative;
+        GSList                *watches;
+} GSIdleMonitorAlarm;
+
+typedef struct
+{
+        guint                  id;
+        GSIdleMonitorWatchFunc callback;
+        gpointer               user_data;
+        GSIdleMonitorAlarm    *alarm;
 } GSIdleMonitorWatch;
 
 static guint32 watch_serial = 1;
 
 G_DEFINE_TYPE (GSIdleMonitor, gs_idle_monitor, G_TYPE_OBJECT)
 
-static gboolean _xsync_alarm_set (GSIdleMonitor *monitor, GSIdleMonitorWatch *watch);
+static gboolean _xsync_alarm_set (GSIdleMonitor *monitor, GSIdleMonitorAlarm *alarm);
 
 static gint64
 _xsyncvalue_to_int64 (XSyncValue value)
@@ -108,34 +118,25 @@ gs_idle_monitor_dispose (GObject *object)
                 monitor->priv->watches = NULL;
         }
 
-        G_OBJECT_CLASS (gs_idle_monitor_parent_class)->dispose (object);
-}
+        if (monitor->priv->alarms_by_xid != NULL) {
+                g_hash_table_destroy (monitor->priv->alarms_by_xid);
+                monitor->priv->alarms_by_xid = NULL;
+        }
 
-static gboolean
-_find_alarm (gpointer            key,
-             GSIdleMonitorWatch *watch,
-             XSyncAlarm         *alarm)
-{
-#if 0
-        g_debug ("Searching for %d in %d,%d", (int)*alarm, (int)watch->xalarm_positive, (int)watch->xalarm_negative);
-#endif
-        if (watch->xalarm_positive == *alarm
-            || watch->xalarm_negative == *alarm) {
-                return TRUE;
+        if (monitor->priv->alarms_by_interval != NULL) {
+                g_hash_table_destroy (monitor->priv->alarms_by_interval);
+                monitor->priv->alarms_by_interval = NULL;
         }
-        return FALSE;
+
+        G_OBJECT_CLASS (gs_idle_monitor_parent_class)->dispose (object);
 }
 
-static GSIdleMonitorWatch *
-find_watch_for_alarm (GSIdleMonitor *monitor,
-                      XSyncAlarm     alarm)
+static GSIdleMonitorAlarm *
+find_alarm_for_xalarm (GSIdleMonitor *monitor,
+                       XSyncAlarm     xalarm)
 {
-        GSIdleMonitorWatch *watch;
-
-        watch = g_hash_table_find (monitor->priv->watches,
-                                   (GHRFunc)_find_alarm,
-                                   &alarm);
-        return watch;
+        return g_hash_table_lookup (monitor->priv->alarms_by_xid,
+                                    GUINT_TO_POINTER ((guint) xalarm));
 }
 
 #ifdef HAVE_XTEST
@@ -185,9 +186,12 @@ static void
 handle_alarm_notify_event (GSIdleMonitor         *monitor,
                            XSyncAlarmNotifyEvent *alarm_event)
 {
-        GSIdleMonitorWatch *watch;
+        GSIdleMonitorAlarm *alarm;
+        GArray             *ids;
+        GSList             *l;
         gboolean            res;
         gboolean            condition;
+        guint               i;
 
         if (alarm_event->state == XSyncAlarmDestroyed) {
 #if 0
@@ -196,9 +200,9 @@ handle_alarm_notify_event (GSIdleMonitor         *monitor,
                 return;
         }
 
-        watch = find_watch_for_alarm (monitor, alarm_event->alarm);
+        alarm = find_alarm_for_xalarm (monitor, alarm_event->alarm);
 
-        if (watch == NULL) {
+        if (alarm == NULL) {
 #if 0
                 g_debug ("Unable to find watch for alarm %d", (int)alarm_event->alarm);
 #endif
@@ -206,24 +210,48 @@ handle_alarm_notify_event (GSIdleMonitor         *monitor,
         }
 
 #if 0
-        g_debug ("Watch %d fired, idle time = %ld",
-                 watch->id,
+        g_debug ("Alarm %d fired, idle time = %ld",
+                 (int)alarm_event->alarm,
                  _xsyncvalue_to_int64 (alarm_event->counter_value));
 #endif
 
-        condition = (alarm_event->alarm == watch->xalarm_positive);
-        _xsync_alarm_set (monitor, watch);
+        condition = (alarm_event->alarm == alarm->xalarm_positive);
+        _xsync_alarm_set (monitor, alarm);
+
+        /*
+         * The callbacks may add or remove watches, which can free the alarm,
+         * so take a copy of the ids first and look each one up again.
+         */
+        ids = g_array_new (FALSE, FALSE, sizeof (guint));
+        for (l = alarm->watches; l != NULL; l = l->next) {
+                GSIdleMonitorWatch *watch = l->data;
+
+                g_array_append_val (ids, watch->id);
+        }
 
         res = TRUE;
-        if (watch->callback != NULL) {
-                res = watch->callback (monitor,
+        for (i = 0; i < ids->len; i++) {
+                GSIdleMonitorWatch *watch;
+
+                watch = g_hash_table_lookup (monitor->priv->watches,
+                                             GUINT_TO_POINTER (g_array_index (ids, guint, i)));
+
+                if (watch == NULL || watch->callback == NULL) {
+                        continue;
+                }
+
+                if (! watch->callback (monitor,
                                        watch->id,
                                        condition,
-                                       watch->user_data);
+                                       watch->user_data)) {
+                        res = FALSE;
+                }
         }
 
+        g_array_free (ids, TRUE);
+
         if (! res) {
-                /* reset all timers */
+                /* reset all timers, once for all the watches on this alarm */
                 g_debug ("GSIdleMonitor: callback returned FALSE; resetting idle time");
                 gs_idle_monitor_reset (monitor);
         }
@@ -371,15 +399,12 @@ get_next_watch_serial (void)
 }
 
 static GSIdleMonitorWatch *
-idle_monitor_watch_new (guint interval)
+idle_monitor_watch_new (void)
 {
         GSIdleMonitorWatch *watch;
 
         watch = g_slice_new0 (GSIdleMonitorWatch);
-        watch->interval = _int64_to_xsyncvalue ((gint64)interval);
         watch->id = get_next_watch_serial ();
-        watch->xalarm_positive = None;
-        watch->xalarm_negative = None;
 
         return watch;
 }
@@ -390,13 +415,39 @@ idle_monitor_watch_free (GSIdleMonitorWatch *watch)
         if (watch == NULL) {
                 return;
         }
-        if (watch->xalarm_positive != None) {
-                XSyncDestroyAlarm (watch->display, watch->xalarm_positive);
+        g_slice_free (GSIdleMonitorWatch, watch);
+}
+
+static GSIdleMonitorAlarm *
+idle_monitor_alarm_new (Display *display,
+                        guint    interval)
+{
+        GSIdleMonitorAlarm *alarm;
+
+        alarm = g_slice_new0 (GSIdleMonitorAlarm);
+        alarm->display = display;
+        alarm->interval_ms = interval;
+        alarm->interval = _int64_to_xsyncvalue ((gint64)interval);
+        alarm->xalarm_positive = None;
+        alarm->xalarm_negative = None;
+
+        return alarm;
+}
+
+static void
+idle_monitor_alarm_free (GSIdleMonitorAlarm *alarm)
+{
+        if (alarm == NULL) {
+                return;
+        }
+        if (alarm->xalarm_positive != None) {
+                XSyncDestroyAlarm (alarm->display, alarm->xalarm_positive);
         }
-        if (watch->xalarm_negative != None) {
-                XSyncDestroyAlarm (watch->display, watch->xalarm_negative);
+        if (alarm->xalarm_negative != None) {
+                XSyncDestroyAlarm (alarm->display, alarm->xalarm_negative);
         }
-        g_slice_free (GSIdleMonitorWatch, watch);
+        g_slist_free (alarm->watches);
+        g_slice_free (GSIdleMonitorAlarm, alarm);
 }
 
 static void
@@ -408,6 +459,11 @@ gs_idle_monitor_init (GSIdleMonitor *monitor)
                                                         NULL,
                                                         NULL,
                                                         (GDestroyNotify)idle_monitor_watch_free);
+        monitor->priv->alarms_by_interval = g_hash_table_new_full (NULL,
+                                                                   NULL,
+                                                                   NULL,
+                                                                   (GDestroyNotify)idle_monitor_alarm_free);
+        monitor->priv->alarms_by_xid = g_hash_table_new (NULL, NULL);
 
         monitor->priv->counter = None;
 }
@@ -440,7 +496,7 @@ gs_idle_monitor_new (void)
 
 static gboolean
 _xsync_alarm_set (GSIdleMonitor      *monitor,
-                  GSIdleMonitorWatch *watch)
+                  GSIdleMonitorAlarm *alarm)
 {
         XSyncAlarmAttributes attr;
         XSyncValue           delta;
@@ -456,32 +512,32 @@ _xsync_alarm_set (GSIdleMonitor      *monitor,
         XSyncIntToValue (&delta, 0);
         attr.trigger.counter = monitor->priv->counter;
         attr.trigger.value_type = XSyncAbsolute;
-        attr.trigger.wait_value = watch->interval;
+        attr.trigger.wait_value = alarm->interval;
         attr.delta = delta;
         attr.events = TRUE;
 
         attr.trigger.test_type = XSyncPositiveTransition;
-        if (watch->xalarm_positive != None) {
+        if (alarm->xalarm_positive != None) {
                 g_debug ("GSIdleMonitor: updating alarm for positive transition wait=%lld",
                          _xsyncvalue_to_int64 (attr.trigger.wait_value));
-                XSyncChangeAlarm (monitor->priv->display, watch->xalarm_positive, flags, &attr);
+                XSyncChangeAlarm (monitor->priv->display, alarm->xalarm_positive, flags, &attr);
         } else {
                 g_debug ("GSIdleMonitor: creating new alarm for positive transition wait=%lld",
                          _xsyncvalue_to_int64 (attr.trigger.wait_value));
-                watch->xalarm_positive = XSyncCreateAlarm (monitor->priv->display, flags, &attr);
-                g_debug ("created alarm %ld", watch->xalarm_positive);
+                alarm->xalarm_positive = XSyncCreateAlarm (monitor->priv->display, flags, &attr);
+                g_debug ("created alarm %ld", alarm->xalarm_positive);
         }
 
         attr.trigger.test_type = XSyncNegativeTransition;
-        if (watch->xalarm_negative != None) {
+        if (alarm->xalarm_negative != None) {
                 g_debug ("GSIdleMonitor: updating alarm for negative transition wait=%lld",
                          _xsyncvalue_to_int64 (attr.trigger.wait_value));
-                XSyncChangeAlarm (monitor->priv->display, watch->xalarm_negative, flags, &attr);
+                XSyncChangeAlarm (monitor->priv->display, alarm->xalarm_negative, flags, &attr);
         } else {
                 g_debug ("GSIdleMonitor: creating new alarm for negative transition wait=%lld",
                          _xsyncvalue_to_int64 (attr.trigger.wait_value));
-                watch->xalarm_negative = XSyncCreateAlarm (monitor->priv->display, flags, &attr);
-                g_debug ("created alarm %ld", watch->xalarm_negative);
+                alarm->xalarm_negative = XSyncCreateAlarm (monitor->priv->display, flags, &attr);
+                g_debug ("created alarm %ld", alarm->xalarm_negative);
         }
 
         return TRUE;
@@ -494,16 +550,36 @@ gs_idle_monitor_add_watch (GSIdleMonitor         *monitor,
                            gpointer               user_data)
 {
         GSIdleMonitorWatch *watch;
+        GSIdleMonitorAlarm *alarm;
 
         g_return_val_if_fail (GS_IS_IDLE_MONITOR (monitor), 0);
         g_return_val_if_fail (callback != NULL, 0);
 
-        watch = idle_monitor_watch_new (interval);
-        watch->display = monitor->priv->display;
+        watch = idle_monitor_watch_new ();
         watch->callback = callback;
         watch->user_data = user_data;
 
-        _xsync_alarm_set (monitor, watch);
+        alarm = g_hash_table_lookup (monitor->priv->alarms_by_interval,
+                                     GUINT_TO_POINTER (interval));
+        if (alarm == NULL) {
+                alarm = idle_monitor_alarm_new (monitor->priv->display,
+                                                interval);
+
+                _xsync_alarm_set (monitor, alarm);
+
+                g_hash_table_insert (monitor->priv->alarms_by_interval,
+                                     GUINT_TO_POINTER (interval),
+                                     alarm);
+                g_hash_table_insert (monitor->priv->alarms_by_xid,
+                                     GUINT_TO_POINTER ((guint) alarm->xalarm_positive),
+                                     alarm);
+                g_hash_table_insert (monitor->priv->alarms_by_xid,
+                                     GUINT_TO_POINTER ((guint) alarm->xalarm_negative),
+                                     alarm);
+        }
+
+        watch->alarm = alarm;
+        alarm->watches = g_slist_append (alarm->watches, watch);
 
         g_hash_table_insert (monitor->priv->watches,
                              GUINT_TO_POINTER (watch->id),
@@ -515,8 +591,30 @@ void
 gs_idle_monitor_remove_watch (GSIdleMonitor *monitor,
                               guint          id)
 {
+        GSIdleMonitorWatch *watch;
+        GSIdleMonitorAlarm *alarm;
+
         g_return_if_fail (GS_IS_IDLE_MONITOR (monitor));
 
+        watch = g_hash_table_lookup (monitor->priv->watches,
+                                     GUINT_TO_POINTER (id));
+        if (watch == NULL) {
+                return;
+        }
+
+        alarm = watch->alarm;
+        alarm->watches = g_slist_remove (alarm->watches, watch);
+
+        /* Last watch on this interval; drop the server alarms too */
+        if (alarm->watches == NULL) {
+                g_hash_table_remove (monitor->priv->alarms_by_xid,
+                                     GUINT_TO_POINTER ((guint) alarm->xalarm_positive));
+                g_hash_table_remove (monitor->priv->alarms_by_xid,
+                                     GUINT_TO_POINTER ((guint) alarm->xalarm_negative));
+                g_hash_table_remove (monitor->priv->alarms_by_interval,
+                                     GUINT_TO_POINTER (alarm->interval_ms));
+        }
+
         g_hash_table_remove (monitor->priv->watches,
                              GUINT_TO_POINTER (id));
 }
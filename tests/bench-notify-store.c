@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2012 Intel Corp.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "dawati-netbook.h"
+#include "notifications/dawati-netbook-notify-store.h"
+
+#include "dawati-bench.h"
+
+/*
+ * The store calls back into the plugin for the urgent-window action, which
+ * the benchmark never invokes.
+ */
+void
+dawati_netbook_activate_window (MetaWindow *window)
+{
+}
+
+static const gchar *actions[] = { "default", "Open", "dismiss", "Dismiss", NULL };
+
+typedef struct
+{
+  DawatiNetbookNotifyStore *store;
+  guint                    *ids;
+  guint                     n_ids;
+} BenchData;
+
+static void
+close_all (gpointer data)
+{
+  BenchData *bench = data;
+  guint      i;
+
+  for (i = 0; i < bench->n_ids; i++)
+    if (bench->ids[i])
+      dawati_netbook_notify_store_close (bench->store, bench->ids[i],
+                                         ClosedProgramatically);
+
+  memset (bench->ids, 0, sizeof (guint) * bench->n_ids);
+}
+
+/* Any id the store does not know about gets a new notification */
+static void
+notify (gpointer data)
+{
+  BenchData *bench = data;
+  guint      i;
+
+  for (i = 0; i < bench->n_ids; i++)
+    bench->ids[i] =
+      notification_manager_notify_internal (bench->store, G_MAXUINT,
+                                            "bench", "dialog-information",
+                                            "Summary", "Body",
+                                            actions, NULL, -1, NULL);
+}
+
+static void
+populate (gpointer data)
+{
+  close_all (data);
+  notify (data);
+}
+
+static void
+update (gpointer data)
+{
+  BenchData *bench = data;
+  guint      i;
+
+  for (i = 0; i < bench->n_ids; i++)
+    notification_manager_notify_internal (bench->store, bench->ids[i],
+                                          "bench", "dialog-information",
+                                          "Updated summary", "Updated body",
+                                          actions, NULL, -1, NULL);
+}
+
+static void
+action (gpointer data)
+{
+  BenchData *bench = data;
+  guint      i;
+
+  /* Newest first, as the tray dismisses them from the top */
+  for (i = bench->n_ids; i > 0; i--)
+    dawati_netbook_notify_store_action (bench->store, bench->ids[i - 1],
+                                        (gchar *) "dismiss");
+
+  memset (bench->ids, 0, sizeof (guint) * bench->n_ids);
+}
+
+int
+main (int argc, char **argv)
+{
+  DawatiBench bench;
+  BenchData   data = { NULL, };
+
+  g_type_init ();
+
+  dawati_bench_init (&bench, "notify-store", &argc, &argv);
+
+  data.store = dawati_netbook_notify_store_new ();
+  data.n_ids = bench.size;
+  data.ids = g_new0 (guint, data.n_ids);
+
+  dawati_bench_run (&bench, "notify", data.n_ids,
+                    close_all, notify, &data);
+
+  /* The store is left populated by the last notify run */
+  dawati_bench_run (&bench, "update", data.n_ids,
+                    NULL, update, &data);
+  dawati_bench_run (&bench, "close", data.n_ids,
+                    populate, close_all, &data);
+  dawati_bench_run (&bench, "action", data.n_ids,
+                    populate, action, &data);
+
+  g_object_unref (data.store);
+  g_free (data.ids);
+
+  return dawati_bench_finish (&bench);
+}
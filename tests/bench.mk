@@ -0,0 +1,12 @@
+# Rules shared by the directories with headless benchmarks, included from
+# their Makefile.am after setting BENCH_PROGRAMS. 'make bench' at the top
+# level runs 'make bench' in each of them; see the top-level Makefile.am.
+
+EXTRA_PROGRAMS = $(BENCH_PROGRAMS)
+
+bench: $(BENCH_PROGRAMS)
+	@for prog in $(BENCH_PROGRAMS); do \
+	  ./$$prog $(BENCH_FLAGS) || exit 1; \
+	done
+
+.PHONY: bench
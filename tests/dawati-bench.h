@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2012 Intel Corp.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/*
+ * Minimal harness for the headless benchmarks run by 'make bench'.
+ *
+ * Each benchmark program handles --size (number of synthetic records),
+ * --iterations and --output, times its cases with the monotonic clock and
+ * writes a single line of JSON describing the suite:
+ *
+ *   {"suite":"...","size":N,"iterations":N,"results":[
+ *     {"name":"...","ops":N,"min_us":X,"median_us":X,"mean_us":X,
+ *      "ns_per_op":X}, ...]}
+ *
+ * When --output is given the line is appended to that file, so one run of
+ * 'make bench' produces a JSON Lines file with one suite per line.
+ */
+
+#ifndef _DAWATI_BENCH_H
+#define _DAWATI_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define DAWATI_BENCH_DEFAULT_SIZE       1000
+#define DAWATI_BENCH_DEFAULT_ITERATIONS 10
+
+typedef struct
+{
+  gchar   *suite;
+  gint     size;
+  gint     iterations;
+  gchar   *output;
+  GString *results;
+  guint    n_results;
+} DawatiBench;
+
+typedef void (*DawatiBenchFunc) (gpointer data);
+
+static void
+dawati_bench_append_string (GString *str, const gchar *s)
+{
+  g_string_append_c (str, '"');
+
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+        g_string_append_printf (str, "\\%c", *s);
+      else if ((guchar) *s < 0x20)
+        g_string_append_printf (str, "\\u%04x", (guchar) *s);
+      else
+        g_string_append_c (str, *s);
+    }
+
+  g_string_append_c (str, '"');
+}
+
+static void
+dawati_bench_append_double (GString *str, const gchar *key, gdouble value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append_printf (str, ",\"%s\":%s", key,
+                          g_ascii_formatd (buf, sizeof (buf), "%.3f", value));
+}
+
+static G_GNUC_UNUSED void
+dawati_bench_init (DawatiBench   *bench,
+                   const gchar   *suite,
+                   int           *argc,
+                   char        ***argv)
+{
+  GOptionContext *context;
+  GError         *error = NULL;
+  GOptionEntry    entries[] = {
+    { "size", 's', 0, G_OPTION_ARG_INT, NULL,
+      "Number of synthetic records to use", "N" },
+    { "iterations", 'i', 0, G_OPTION_ARG_INT, NULL,
+      "Number of timed runs of each case", "N" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, NULL,
+      "Append the results to FILE instead of printing them", "FILE" },
+    { NULL }
+  };
+
+  memset (bench, 0, sizeof (DawatiBench));
+
+  bench->suite      = g_strdup (suite);
+  bench->size       = DAWATI_BENCH_DEFAULT_SIZE;
+  bench->iterations = DAWATI_BENCH_DEFAULT_ITERATIONS;
+  bench->results    = g_string_new (NULL);
+
+  entries[0].arg_data = &bench->size;
+  entries[1].arg_data = &bench->iterations;
+  entries[2].arg_data = &bench->output;
+
+  context = g_option_context_new ("- run benchmarks");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, argc, argv, &error))
+    {
+      g_printerr ("%s: %s\n", suite, error->message);
+      exit (EXIT_FAILURE);
+    }
+
+  g_option_context_free (context);
+
+  bench->size       = MAX (bench->size, 1);
+  bench->iterations = MAX (bench->iterations, 1);
+}
+
+static gint
+dawati_bench_compare_times (gconstpointer a, gconstpointer b)
+{
+  gint64 ta = *(const gint64 *) a;
+  gint64 tb = *(const gint64 *) b;
+
+  return ta < tb ? -1 : (ta > tb ? 1 : 0);
+}
+
+/*
+ * Times @func over the configured number of iterations; @reset, if given, is
+ * called (untimed) before each iteration. @n_ops is the number of operations
+ * a single call to @func performs, used for the per-operation figure.
+ */
+static G_GNUC_UNUSED void
+dawati_bench_run (DawatiBench     *bench,
+                  const gchar     *name,
+                  guint            n_ops,
+                  DawatiBenchFunc  reset,
+                  DawatiBenchFunc  func,
+                  gpointer         data)
+{
+  gint64  *times = g_new (gint64, bench->iterations);
+  gint64   total = 0;
+  gdouble  median;
+  gint     i;
+
+  for (i = 0; i < bench->iterations; i++)
+    {
+      gint64 start;
+
+      if (reset)
+        reset (data);
+
+      start = g_get_monotonic_time ();
+      func (data);
+      times[i] = g_get_monotonic_time () - start;
+      total += times[i];
+    }
+
+  qsort (times, bench->iterations, sizeof (gint64), dawati_bench_compare_times);
+
+  if (bench->iterations % 2)
+    median = times[bench->iterations / 2];
+  else
+    median = (times[bench->iterations / 2 - 1] +
+              times[bench->iterations / 2]) / 2.0;
+
+  if (bench->n_results++)
+    g_string_append_c (bench->results, ',');
+
+  g_string_append (bench->results, "{\"name\":");
+  dawati_bench_append_string (bench->results, name);
+  g_string_append_printf (bench->results, ",\"ops\":%u", n_ops);
+  dawati_bench_append_double (bench->results, "min_us", times[0]);
+  dawati_bench_append_double (bench->results, "median_us", median);
+  dawati_bench_append_double (bench->results, "mean_us",
+                              (gdouble) total / bench->iterations);
+  dawati_bench_append_double (bench->results, "ns_per_op",
+                              median * 1000.0 / MAX (n_ops, 1));
+  g_string_append_c (bench->results, '}');
+
+  g_free (times);
+}
+
+/*
+ * Records a case that could not run in this environment (e.g., no system
+ * bus), so that it shows up in the results rather than silently vanishing.
+ */
+static G_GNUC_UNUSED void
+dawati_bench_skip (DawatiBench *bench,
+                   const gchar *name,
+                   const gchar *reason)
+{
+  if (bench->n_results++)
+    g_string_append_c (bench->results, ',');
+
+  g_string_append (bench->results, "{\"name\":");
+  dawati_bench_append_string (bench->results, name);
+  g_string_append (bench->results, ",\"skipped\":");
+  dawati_bench_append_string (bench->results, reason);
+  g_string_append_c (bench->results, '}');
+}
+
+/*
+ * Writes out the results and frees the harness; returns the exit status for
+ * main().
+ */
+static G_GNUC_UNUSED int
+dawati_bench_finish (DawatiBench *bench)
+{
+  GString *json = g_string_new ("{\"suite\":");
+  FILE    *out = stdout;
+  int      ret = EXIT_SUCCESS;
+
+  dawati_bench_append_string (json, bench->suite);
+  g_string_append_printf (json, ",\"size\":%d,\"iterations\":%d,\"results\":[%s]}\n",
+                          bench->size, bench->iterations, bench->results->str);
+
+  if (bench->output && !(out = fopen (bench->output, "a")))
+    {
+      g_printerr ("%s: could not open %s\n", bench->suite, bench->output);
+      ret = EXIT_FAILURE;
+    }
+  else
+    {
+      fputs (json->str, out);
+
+      if (out != stdout)
+        fclose (out);
+    }
+
+  g_string_free (json, TRUE);
+  g_string_free (bench->results, TRUE);
+  g_free (bench->output);
+  g_free (bench->suite);
+
+  return ret;
+}
+
+G_END_DECLS
+
+#endif /* _DAWATI_BENCH_H */